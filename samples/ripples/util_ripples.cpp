@@ -29,6 +29,7 @@
 #include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <stdexcept>
 
 // windows specific inclusion of alloca
 // all other platforms have alloca in stdlib.h
@@ -66,6 +67,10 @@ RippleManager::RippleManager(const TCODMap& waterMap) : width{waterMap.getWidth(
     }
   }
   zone.oldData = zone.data;
+  // bake the noise once, rendering then only samples it
+  shimmer.reset(TCOD_noise_texture_new(
+      noise3d.get_data(), TCOD_NOISE_SIMPLEX, TCOD_NOISE_MODE_PLAIN, 0.0f, width, height, 1.0f));
+  if (!shimmer) throw std::runtime_error(TCOD_get_error());
 }
 
 void RippleManager::startRipple(int x, int y) {
@@ -130,8 +135,9 @@ void RippleManager::renderRipples(const TCODImage& ground, TCODImage& groundWith
       if (getData(x, y) != NO_WATER) {
         float xOffset = (getData(x - 1, y) - getData(x + 1, y));
         const float yOffset = (getData(x, y - 1) - getData(x, y + 1));
-        const float f[3] = {static_cast<float>(x), static_cast<float>(y), elCoef};
-        xOffset += noise3d.get(f, TCOD_NOISE_SIMPLEX) * 0.3f;
+        // scroll the texture diagonally, it tiles so the offset can grow forever
+        xOffset +=
+            TCOD_noise_texture_sample(shimmer.get(), x + elCoef, y + elCoef, TCOD_NOISE_TEXTURE_BILINEAR) * 0.3f;
         if (std::abs(xOffset) < 250 && std::abs(yOffset) < 250) {
           TCODColor col = ground.getPixel(x + static_cast<int>(xOffset), y + static_cast<int>(yOffset));
           col = col + TCODColor{255, 255, 255} * xOffset * 0.1f;
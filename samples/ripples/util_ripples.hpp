@@ -23,6 +23,7 @@
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#include <memory>
 #include <vector>
 
 struct WaterZone {
@@ -32,6 +33,10 @@ struct WaterZone {
   bool isActive;  // not to use CPU is there are no ripples
 };
 
+struct NoiseTextureDeleter {
+  void operator()(TCOD_NoiseTexture* texture) const { TCOD_noise_texture_delete(texture); }
+};
+
 class RippleManager {
  public:
   RippleManager(const TCODMap& waterMap);
@@ -42,5 +47,6 @@ class RippleManager {
  private:
   int width, height;
   WaterZone zone;
+  std::unique_ptr<TCOD_NoiseTexture, NoiseTextureDeleter> shimmer;  // tileable noise scrolled over the water
   float& getData(int x, int y) noexcept { return zone.data[x + y * width]; }
 };
@@ -309,15 +309,7 @@ void WorldGenerator::buildBaseMap() {
   // DBG(("  Erosion... %g\n", t1-t0 ));
   // t0=t1;
   // compute clouds
-  float f[2];
-  for (int x = 0; x < HM_WIDTH; x++) {
-    f[0] = 6.0f * ((float)(x) / HM_WIDTH);
-    for (int y = 0; y < HM_HEIGHT; y++) {
-      f[1] = 6.0f * ((float)(y) / HM_HEIGHT);
-      // clouds[x][y] = 0.5f * (1.0f + 0.8f * noise->getFbmSimplex(f,4.0f));
-      clouds[x][y] = 0.5f * (1.0f + 0.8f * noise->getFbm(f, 4.0f, TCOD_NOISE_SIMPLEX));
-    }
-  }
+  fillClouds(0, HM_WIDTH, 0.0f);
   t1 = get_time();
   DBG(("  Init clouds... %g\n", t1 - t0));
   t0 = t1;
@@ -334,8 +326,11 @@ void WorldGenerator::smoothMap() {
 #ifndef NDEBUG
   const float t0 = get_time();
 #endif
-  hm->kernelTransform(smoothKernelSize, smoothKernelDx, smoothKernelDy, smoothKernelWeight, -1000, 1000);
-  hm2->kernelTransform(smoothKernelSize, smoothKernelDx, smoothKernelDy, smoothKernelWeight, -1000, 1000);
+  for (TCODHeightMap* map : {hm, hm2}) {
+    TCOD_heightmap_t c_map = {map->w, map->h, map->values};
+    TCOD_heightmap_kernel_transform_out(
+        &c_map, &c_map, smoothKernelSize, smoothKernelDx, smoothKernelDy, smoothKernelWeight, -1000, 1000);
+  }
   hm->normalize();
 #ifndef NDEBUG
   const float t1 = get_time();
@@ -493,21 +488,25 @@ TCODColor WorldGenerator::getMapColor(float h) {
 }
 
 void WorldGenerator::computeSunLight(const float lightDir[3]) {
+  // compute every normal once instead of interpolating the heightmap three times per sample
+  std::vector<float> normals(HM_WIDTH * HM_HEIGHT * 3);
+  const TCOD_heightmap_t c_hm2 = {hm2->w, hm2->h, hm2->values};
+  TCOD_heightmap_get_normals(&c_hm2, normals.data(), sandHeight);
   for (int y = 0; y < HM_HEIGHT; y++) {
     for (int x = 0; x < HM_WIDTH; x++) {
-      worldint[x + y * HM_WIDTH] = getMapIntensity(x + 0.5f, y + 0.5f, lightDir);
+      worldint[x + y * HM_WIDTH] = getMapIntensity(normals.data(), x + 0.5f, y + 0.5f, lightDir);
     }
   }
 }
 
-float WorldGenerator::getMapIntensity(float worldX, float worldY, const float lightDir[3]) {
+float WorldGenerator::getMapIntensity(const float* normals, float worldX, float worldY, const float lightDir[3]) {
   // sun color & direction
   static constexpr TCODColor sunCol(255, 255, 160);
   float normal[3];
   const float wx = CLAMP(0.0f, HM_WIDTH - 1, worldX);
   const float wy = CLAMP(0.0f, HM_HEIGHT - 1, worldY);
   // apply sun light
-  getInterpolatedNormal(wx, wy, normal);
+  TCOD_heightmap_get_interpolated_normal(HM_WIDTH, HM_HEIGHT, normals, wx, wy, normal);
   normal[2] *= 3.0f;
   float intensity = 0.75f - (normal[0] * lightDir[0] + normal[1] * lightDir[1] + normal[2] * lightDir[2]) * 0.75f;
   intensity = CLAMP(0.75f, 1.5f, intensity);
@@ -553,18 +552,21 @@ void WorldGenerator::updateClouds(float elapsedTime) {
         clouds[x - colsToTranslate][y] = clouds[x][y];
       }
     }
-    // compute a new column
-    const float cdx = std::floor(cloudTotalDx);
-    for (int y = 0; y < HM_HEIGHT; ++y) {
-      for (int x = HM_WIDTH - colsToTranslate; x < HM_WIDTH; ++x) {
-        const float f[2] = {
-            6.0f * ((float)(x + cdx) / HM_WIDTH),
-            6.0f * ((float)(y) / HM_HEIGHT),
-        };
-        // clouds[x][y] = 0.5f * (1.0f + 0.8f * noise->getFbmSimplex(f,4.0f));
-        clouds[x][y] = 0.5f * (1.0f + 0.8f * noise->getFbm(f, 4.0f, TCOD_NOISE_SIMPLEX));
-      }
-    }
+    // compute the new columns
+    fillClouds(HM_WIDTH - colsToTranslate, colsToTranslate, std::floor(cloudTotalDx));
+  }
+}
+
+void WorldGenerator::fillClouds(int x0, int width, float noiseDx) {
+  // clouds is indexed [x][y], so the grid moves a whole column for each step along x
+  const int shape[2] = {width, HM_HEIGHT};
+  const size_t strides[2] = {sizeof(clouds[0]), sizeof(clouds[0][0])};
+  const float offset[2] = {x0 + noiseDx, 0.0f};
+  const float scale[2] = {6.0f / HM_WIDTH, 6.0f / HM_HEIGHT};
+  TCOD_noise_fill_grid(
+      noise->get_data(), TCOD_NOISE_SIMPLEX, TCOD_NOISE_MODE_FBM, 4.0f, 2, shape, strides, offset, scale, clouds[x0]);
+  for (int x = x0; x < x0 + width; ++x) {
+    for (int y = 0; y < HM_HEIGHT; ++y) clouds[x][y] = 0.5f * (1.0f + 0.8f * clouds[x][y]);
   }
 }
 
@@ -939,48 +941,10 @@ void WorldGenerator::computePrecipitations() {
 void WorldGenerator::smoothPrecipitations() {
   float t0 = get_time();
 
-  // better quality polishing blur using a 5x5 kernel
-  // faster than TCODHeightmap kernelTransform function
-  TCODHeightMap temp_hm(HM_WIDTH, HM_HEIGHT);
-  temp_hm.copy(precipitation);
-  for (int i = 4; i != 0; --i) {
-    for (int x = 0; x < HM_WIDTH; ++x) {
-      int minx = x - 2;
-      int maxx = x + 2;
-      const int miny = 0;
-      const int maxy = 2;
-      float sum = 0.0f;
-      int count = 0;
-      minx = std::max(0, minx);
-      maxx = std::min(HM_WIDTH - 1, maxx);
-      // compute the kernel sum at x,0
-      for (int iy = miny; iy <= maxy; ++iy) {
-        for (int ix = minx; ix <= maxx; ++ix) {
-          sum += precipitation->getValue(ix, iy);
-          ++count;
-        }
-      }
-      temp_hm.setValue(x, 0, sum / count);
-      for (int y = 1; y < HM_HEIGHT; ++y) {
-        if (y - 2 >= 0) {
-          // remove the top-line sum
-          for (int ix = minx; ix <= maxx; ++ix) {
-            sum -= precipitation->getValue(ix, y - 2);
-            --count;
-          }
-        }
-        if (y + 2 < HM_HEIGHT) {
-          // add the bottom-line sum
-          for (int ix = minx; ix <= maxx; ++ix) {
-            sum += precipitation->getValue(ix, y + 2);
-            ++count;
-          }
-        }
-        temp_hm.setValue(x, y, sum / count);
-      }
-    }
-  }
-  precipitation->copy(&temp_hm);
+  // better quality polishing blur using a 5x5 box kernel, applied as two separable passes
+  static constexpr float BOX_WEIGHT[5] = {1, 1, 1, 1, 1};
+  TCOD_heightmap_t c_precipitation = {precipitation->w, precipitation->h, precipitation->values};
+  TCOD_heightmap_separable_transform(&c_precipitation, &c_precipitation, 2, BOX_WEIGHT, -1000, 1000);
 
   float t1 = get_time();
   DBG(("  Blur... %g\n", t1 - t0));
@@ -129,10 +129,12 @@ class WorldGenerator {
   void buildBaseMap();
   void erodeMap();
   void smoothMap();
+  // fill the cloud columns [x0, x0 + width) with noise, scrolled by noiseDx columns
+  void fillClouds(int x0, int width, float noiseDx);
   // compute the ground color from the heightmap
   TCODColor getMapColor(float h);
-  // get sun light intensity on a point of the map
-  float getMapIntensity(float worldX, float worldY, const float lightDir[3]);
+  // get sun light intensity on a point of the map from the normals of hm2
+  float getMapIntensity(const float* normals, float worldX, float worldY, const float lightDir[3]);
   TCODColor getInterpolatedColor(TCODImage* img, float x, float y);
   float getInterpolatedFloat(const float* arr, float x, float y, int width, int height);
   void generateRivers();
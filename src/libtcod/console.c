@@ -395,15 +395,10 @@ static int channel_overlay(uint8_t dst, uint8_t src) {
   //                        : white - 2*(white-curbk)*(white-oldbk)
   return ((int)src <= 128 ? 2 * (int)src * (int)dst / 255 : 255 - 2 * (255 - (int)src) * (255 - (int)dst) / 255);
 }
-void TCOD_console_set_char_background(TCOD_Console* con, int x, int y, TCOD_color_t col, TCOD_bkgnd_flag_t flag) {
-  con = TCOD_console_validate_(con);
-  if (!TCOD_console_is_index_valid_(con, x, y)) {
-    return;
-  }
-  struct TCOD_ColorRGBA* bg = &con->tiles[y * con->w + x].bg;
-  if (flag == TCOD_BKGND_DEFAULT) {
-    flag = con->bkgnd_flag;
-  }
+/**
+ *  Blend `col` into `bg` using a resolved background flag.
+ */
+static void blend_background_(struct TCOD_ColorRGBA* bg, TCOD_color_t col, TCOD_bkgnd_flag_t flag) {
   uint8_t alpha = (flag >> 8) & 0xFF;
   switch (flag & 0xff) {
     case TCOD_BKGND_SET:
@@ -461,6 +456,87 @@ void TCOD_console_set_char_background(TCOD_Console* con, int x, int y, TCOD_colo
       break;
   }
 }
+void TCOD_console_set_char_background(TCOD_Console* con, int x, int y, TCOD_color_t col, TCOD_bkgnd_flag_t flag) {
+  con = TCOD_console_validate_(con);
+  if (!TCOD_console_is_index_valid_(con, x, y)) {
+    return;
+  }
+  if (flag == TCOD_BKGND_DEFAULT) {
+    flag = con->bkgnd_flag;
+  }
+  blend_background_(&con->tiles[y * con->w + x].bg, col, flag);
+}
+/**
+ *  Blend a run of tiles with a per-channel lambda.
+ */
+static inline void blend_background_row_(
+    struct TCOD_ConsoleTile* __restrict tiles,
+    const struct TCOD_ColorRGB* __restrict colors,
+    int n,
+    int (*lambda)(uint8_t, uint8_t)) {
+  for (int i = 0; i < n; ++i) {
+    struct TCOD_ColorRGBA* bg = &tiles[i].bg;
+    bg->r = clamp_color_(lambda(bg->r, colors[i].r));
+    bg->g = clamp_color_(lambda(bg->g, colors[i].g));
+    bg->b = clamp_color_(lambda(bg->b, colors[i].b));
+  }
+}
+void TCOD_console_blend_background_row_(
+    TCOD_Console* __restrict con, int x, int y, int n, const TCOD_ColorRGB* __restrict colors, TCOD_bkgnd_flag_t flag) {
+  struct TCOD_ConsoleTile* tiles = &con->tiles[y * con->w + x];
+  if (flag == TCOD_BKGND_DEFAULT) {
+    flag = con->bkgnd_flag;
+  }
+  switch (flag & 0xff) {
+    case TCOD_BKGND_NONE:
+      break;
+    case TCOD_BKGND_SET:
+      for (int i = 0; i < n; ++i) {
+        tiles[i].bg.r = colors[i].r;
+        tiles[i].bg.g = colors[i].g;
+        tiles[i].bg.b = colors[i].b;
+      }
+      break;
+    case TCOD_BKGND_MULTIPLY:
+      blend_background_row_(tiles, colors, n, channel_multiply);
+      break;
+    case TCOD_BKGND_LIGHTEN:
+      blend_background_row_(tiles, colors, n, channel_lighten);
+      break;
+    case TCOD_BKGND_DARKEN:
+      blend_background_row_(tiles, colors, n, channel_darken);
+      break;
+    case TCOD_BKGND_SCREEN:
+      blend_background_row_(tiles, colors, n, channel_screen);
+      break;
+    case TCOD_BKGND_ADD:
+      blend_background_row_(tiles, colors, n, channel_add);
+      break;
+    case TCOD_BKGND_BURN:
+      blend_background_row_(tiles, colors, n, channel_burn);
+      break;
+    case TCOD_BKGND_ALPH: {
+      // With an opaque destination TCOD_console_blit_lerp_ reduces to an integer lerp.
+      const int alpha = (flag >> 8) & 0xFF;
+      for (int i = 0; i < n; ++i) {
+        struct TCOD_ColorRGBA* bg = &tiles[i].bg;
+        if (bg->a != 255) {
+          blend_background_(bg, colors[i], flag);
+          continue;
+        }
+        bg->r = (uint8_t)((colors[i].r * alpha + bg->r * (255 - alpha)) / 255);
+        bg->g = (uint8_t)((colors[i].g * alpha + bg->g * (255 - alpha)) / 255);
+        bg->b = (uint8_t)((colors[i].b * alpha + bg->b * (255 - alpha)) / 255);
+      }
+      break;
+    }
+    default:
+      for (int i = 0; i < n; ++i) {
+        blend_background_(&tiles[i].bg, colors[i], flag);
+      }
+      break;
+  }
+}
 void TCOD_console_set_char(TCOD_console_t con, int x, int y, int c) {
   con = TCOD_console_validate_(con);
   if (!TCOD_console_is_index_valid_(con, x, y)) {
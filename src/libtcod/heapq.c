@@ -32,6 +32,7 @@
 #include "heapq.h"
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -39,6 +40,20 @@
 
 #define TCOD_HEAP_DEFAULT_CAPACITY 256
 #define TCOD_HEAP_MAX_NODE_SIZE 256
+#define TCOD_BUCKETQ_DEFAULT_CAPACITY 64
+#define TCOD_BUCKETQ_MAX_BUCKETS (1 << 20)
+/// Heaps are 4-ary: the children of a node are next to each other in memory, and the tree is half as deep.
+#define TCOD_HEAP_ARITY 4
+
+#if defined(_MSC_VER)
+#define TCOD_HEAP_INLINE __forceinline
+#elif defined(__GNUC__)
+#define TCOD_HEAP_INLINE inline __attribute__((always_inline))
+#else
+#define TCOD_HEAP_INLINE inline
+#endif
+/// The size of a node holding a single int, the layout used by indexed heaps and the pathfinders.
+#define TCOD_HEAP_INT_NODE_SIZE (sizeof(int) * 2)
 /***************************************************************************
     @brief Clear a heap and free its data.
 
@@ -48,12 +63,15 @@ void TCOD_heap_uninit(struct TCOD_Heap* heap) {
   if (heap->heap) {
     free(heap->heap);
   }
+  free(heap->positions);
   heap->heap = NULL;
   heap->size = 0;
   heap->capacity = 0;
   heap->node_size = 0;
   heap->data_size = 0;
   heap->data_offset = 0;
+  heap->positions = NULL;
+  heap->position_count = 0;
 }
 /***************************************************************************
     @brief Initialize a heap with the given data_size.
@@ -74,78 +92,124 @@ int TCOD_heap_init(struct TCOD_Heap* heap, size_t data_size) {
   heap->data_size = data_size;
   heap->data_offset = sizeof(int);
   heap->priority_type = -4;  // Signed int type.
+  heap->positions = NULL;
+  heap->position_count = 0;
   return 0;
 }
 /***************************************************************************
-    @brief Clear all elements from this heap.
+    @brief Initialize an indexed heap, which supports decrease-key.
 
-    @param heap A TCOD_Heap pointer.
+    The data of each element is an int index from 0 to `index_count - 1`.  Each index can be in the heap at most once,
+    and the position of every index is tracked so that its priority can be changed in place.
+
+    @param heap A pointer to an existing TCOD_Heap struct.
+    @param index_count The number of distinct indexes which can be pushed.
+    @return int Returns a negative value on error.
  */
-void TCOD_heap_clear(struct TCOD_Heap* heap) { heap->size = 0; }
+int TCOD_heap_init_indexed(struct TCOD_Heap* heap, int index_count) {
+  if (index_count < 0) return TCOD_set_errorvf("Heap index count must not be negative: %i", index_count);
+  const int err = TCOD_heap_init(heap, sizeof(int));
+  if (err < 0) return err;
+  heap->positions = malloc(sizeof(*heap->positions) * (index_count ? index_count : 1));
+  if (!heap->positions) {
+    TCOD_set_errorv("Out of memory allocating heap positions.");
+    return TCOD_E_OUT_OF_MEMORY;
+  }
+  for (int i = 0; i < index_count; ++i) heap->positions[i] = -1;
+  heap->position_count = index_count;
+  return 0;
+}
 /// Return a pointer to the node at index in heap.  This points directly to the priority value.
 /// Used internally.
-static void* TCOD_heap_get_(struct TCOD_Heap* heap, int index) { return (void*)(heap->heap + index * heap->node_size); }
-/// Return a pointer to user data of the node at index in heap.
-/// Used internally.
-static void* TCOD_heap_address_data_(struct TCOD_Heap* heap, int index) {
-  return heap->heap + index * heap->node_size + heap->data_offset;
+static TCOD_HEAP_INLINE void* TCOD_heap_get_(const struct TCOD_Heap* heap, int index) {
+  return (void*)(heap->heap + index * heap->node_size);
 }
-/// Swap two heap elements with each other.
+/// Return the priority of the node at index in heap.
 /// Used internally.
-static void TCOD_heap_swap_(struct TCOD_Heap* heap, int lhs, int rhs) {
-  unsigned char buffer[TCOD_HEAP_MAX_NODE_SIZE];
-  memcpy(buffer, TCOD_heap_get_(heap, lhs), heap->node_size);
-  memcpy(TCOD_heap_get_(heap, lhs), TCOD_heap_get_(heap, rhs), heap->node_size);
-  memcpy(TCOD_heap_get_(heap, rhs), buffer, heap->node_size);
+static TCOD_HEAP_INLINE int TCOD_heap_priority_(const struct TCOD_Heap* heap, int index) {
+  return *(const int*)TCOD_heap_get_(heap, index);
 }
-/// Manually set the priority and data of an existing heap element.
-/// Used internally.
-static void TCOD_heap_set_(struct TCOD_Heap* __restrict heap, int index, int priority, const void* __restrict data) {
-  assert(heap->priority_type == -4);
-  int* node_priority = TCOD_heap_get_(heap, index);
-  void* node_data = TCOD_heap_address_data_(heap, index);
-  *node_priority = priority;
-  memcpy(node_data, data, heap->data_size);
-}
-/// Copy a heap element from the index src to the index dest.
+/// Return the index stored in the user data of `node`, only valid for indexed heaps.
 /// Used internally.
-static void TCOD_heap_copy_(struct TCOD_Heap* heap, int dest, int src) {
-  memcpy(TCOD_heap_get_(heap, dest), TCOD_heap_get_(heap, src), heap->node_size);
+static TCOD_HEAP_INLINE int TCOD_heap_node_index_(const struct TCOD_Heap* heap, const void* node) {
+  return *(const int*)((const unsigned char*)node + heap->data_offset);
 }
-/// Returns true if the priority of the left index is less than the right index.
+/// Write `node` to the heap position `index` and track its new position.
+/// `node_size` is a compile-time constant when possible so that the copy is inlined.
 /// Used internally.
-static bool TCOD_minheap_compare_(struct TCOD_Heap* minheap, int lhs_index, int rhs_index) {
-  assert(minheap->priority_type == -4);
-  const int* lhs_priority = TCOD_heap_get_(minheap, lhs_index);
-  const int* rhs_priority = TCOD_heap_get_(minheap, rhs_index);
-  return *lhs_priority < *rhs_priority;
+static TCOD_HEAP_INLINE void TCOD_heap_place_(
+    struct TCOD_Heap* __restrict heap, int index, const void* __restrict node, size_t node_size) {
+  memcpy(TCOD_heap_get_(heap, index), node, node_size);
+  if (heap->positions) heap->positions[TCOD_heap_node_index_(heap, node)] = index;
 }
-/// Sort a heap element downwards, away from the root.
+/// Move the node at `index` towards the root until the heap is valid.
+/// `node` is the element to place, the heap position at `index` is treated as a hole.
 /// Used internally.
-static void TCOD_TCOD_minheap_heapify_down_(struct TCOD_Heap* minheap, int index) {
-  int candidate = index;
-  const int left = index * 2 + 1;
-  const int right = index * 2 + 2;
-  if (left < minheap->size && TCOD_minheap_compare_(minheap, left, candidate)) {
-    candidate = left;
+static TCOD_HEAP_INLINE void TCOD_minheap_sift_up_(
+    struct TCOD_Heap* __restrict minheap, int index, const void* __restrict node, size_t node_size) {
+  const int priority = *(const int*)node;
+  while (index > 0) {
+    const int parent = (index - 1) / TCOD_HEAP_ARITY;
+    if (TCOD_heap_priority_(minheap, parent) <= priority) break;
+    TCOD_heap_place_(minheap, index, TCOD_heap_get_(minheap, parent), node_size);
+    index = parent;
   }
-  if (right < minheap->size && TCOD_minheap_compare_(minheap, right, candidate)) {
-    candidate = right;
+  TCOD_heap_place_(minheap, index, node, node_size);
+}
+/// Move the node at `index` away from the root until the heap is valid.
+/// `node` is the element to place, the heap position at `index` is treated as a hole.
+/// Used internally.
+static TCOD_HEAP_INLINE void TCOD_minheap_sift_down_(
+    struct TCOD_Heap* __restrict minheap, int index, const void* __restrict node, size_t node_size) {
+  const int priority = *(const int*)node;
+  while (1) {
+    const int first_child = index * TCOD_HEAP_ARITY + 1;
+    if (first_child >= minheap->size) break;
+    const int last_child =
+        first_child + TCOD_HEAP_ARITY < minheap->size ? first_child + TCOD_HEAP_ARITY : minheap->size;
+    int best = first_child;
+    int best_priority = TCOD_heap_priority_(minheap, first_child);
+    for (int child = first_child + 1; child < last_child; ++child) {
+      const int child_priority = TCOD_heap_priority_(minheap, child);
+      if (child_priority < best_priority) {
+        best = child;
+        best_priority = child_priority;
+      }
+    }
+    if (priority <= best_priority) break;
+    TCOD_heap_place_(minheap, index, TCOD_heap_get_(minheap, best), node_size);
+    index = best;
   }
-  if (candidate != index) {
-    TCOD_heap_swap_(minheap, index, candidate);
-    TCOD_TCOD_minheap_heapify_down_(minheap, candidate);
+  TCOD_heap_place_(minheap, index, node, node_size);
+}
+/// Sift a node upwards, dispatching to a version specialized for single int nodes when possible.
+/// Used internally.
+static void TCOD_minheap_sift_up_any_(struct TCOD_Heap* __restrict minheap, int index, const void* __restrict node) {
+  if (minheap->node_size == TCOD_HEAP_INT_NODE_SIZE) {
+    TCOD_minheap_sift_up_(minheap, index, node, TCOD_HEAP_INT_NODE_SIZE);
+  } else {
+    TCOD_minheap_sift_up_(minheap, index, node, minheap->node_size);
   }
 }
-/// Sort a heap element upwards, towards from the root.
+/// Sift a node downwards, dispatching to a version specialized for single int nodes when possible.
 /// Used internally.
-static void TCOD_TCOD_minheap_heapify_up_(struct TCOD_Heap* minheap, int index) {
-  if (index == 0) return;  // No element is higher than the current one.
-  const int parent = (index - 1) >> 1;
-  if (TCOD_minheap_compare_(minheap, index, parent)) {
-    TCOD_heap_swap_(minheap, index, parent);
-    TCOD_TCOD_minheap_heapify_up_(minheap, parent);
+static void TCOD_minheap_sift_down_any_(struct TCOD_Heap* __restrict minheap, int index, const void* __restrict node) {
+  if (minheap->node_size == TCOD_HEAP_INT_NODE_SIZE) {
+    TCOD_minheap_sift_down_(minheap, index, node, TCOD_HEAP_INT_NODE_SIZE);
+  } else {
+    TCOD_minheap_sift_down_(minheap, index, node, minheap->node_size);
+  }
+}
+/***************************************************************************
+    @brief Clear all elements from this heap.
+
+    @param heap A TCOD_Heap pointer.
+ */
+void TCOD_heap_clear(struct TCOD_Heap* heap) {
+  if (heap->positions) {
+    for (int i = 0; i < heap->size; ++i) heap->positions[TCOD_heap_node_index_(heap, TCOD_heap_get_(heap, i))] = -1;
   }
+  heap->size = 0;
 }
 /***************************************************************************
     @brief Sort the heap elements into a valid heap.
@@ -153,8 +217,16 @@ static void TCOD_TCOD_minheap_heapify_up_(struct TCOD_Heap* minheap, int index)
     @param minheap A TCOD_Heap pointer.
  */
 void TCOD_minheap_heapify(struct TCOD_Heap* minheap) {
-  for (int i = minheap->size / 2; i >= 0; --i) {
-    TCOD_TCOD_minheap_heapify_down_(minheap, i);
+  if (minheap->positions) {
+    for (int i = 0; i < minheap->size; ++i) {
+      minheap->positions[TCOD_heap_node_index_(minheap, TCOD_heap_get_(minheap, i))] = i;
+    }
+  }
+  if (minheap->size < 2) return;  // Already a valid heap, and the loop below must not read an empty heap.
+  unsigned char node[TCOD_HEAP_MAX_NODE_SIZE];
+  for (int i = (minheap->size - 2) / TCOD_HEAP_ARITY; i >= 0; --i) {
+    memcpy(node, TCOD_heap_get_(minheap, i), minheap->node_size);
+    TCOD_minheap_sift_down_any_(minheap, i, node);
   }
 }
 /***************************************************************************
@@ -166,31 +238,225 @@ void TCOD_minheap_heapify(struct TCOD_Heap* minheap) {
 void TCOD_minheap_pop(struct TCOD_Heap* __restrict minheap, void* __restrict out) {
   if (minheap->size == 0) return;  // No element to pop.
   if (out) memcpy(out, minheap->heap + minheap->data_offset, minheap->data_size);
-  TCOD_heap_copy_(minheap, 0, minheap->size - 1);
+  if (minheap->positions) minheap->positions[TCOD_heap_node_index_(minheap, minheap->heap)] = -1;
   --minheap->size;
-  TCOD_TCOD_minheap_heapify_down_(minheap, 0);
+  if (minheap->size == 0) return;
+  unsigned char last[TCOD_HEAP_MAX_NODE_SIZE];
+  memcpy(last, TCOD_heap_get_(minheap, minheap->size), minheap->node_size);
+  TCOD_minheap_sift_down_any_(minheap, 0, last);
+}
+/// Grow the heap so that it can hold at least one more element.
+/// Used internally.
+static int TCOD_heap_reserve_one_(struct TCOD_Heap* heap) {
+  if (heap->size < heap->capacity) return TCOD_E_OK;
+  const int new_capacity = (heap->capacity ? heap->capacity * 2 : TCOD_HEAP_DEFAULT_CAPACITY);
+  void* new_heap = realloc(heap->heap, heap->node_size * new_capacity);
+  if (!new_heap) {
+    TCOD_set_errorv("Out of memory while reallocating heap.");
+    return TCOD_E_OUT_OF_MEMORY;
+  }
+  heap->capacity = new_capacity;
+  heap->heap = new_heap;
+  return TCOD_E_OK;
+}
+/// Change the priority of the element at heap position `position` and restore the heap order.
+/// Used internally.
+static void TCOD_minheap_update_(struct TCOD_Heap* minheap, int position, int priority) {
+  unsigned char node[TCOD_HEAP_MAX_NODE_SIZE];
+  memcpy(node, TCOD_heap_get_(minheap, position), minheap->node_size);
+  const int old_priority = *(int*)node;
+  *(int*)node = priority;
+  if (priority < old_priority) {
+    TCOD_minheap_sift_up_any_(minheap, position, node);
+  } else {
+    TCOD_minheap_sift_down_any_(minheap, position, node);
+  }
+}
+/// Return a negative error if `index` can not be used with this indexed heap.
+/// Used internally.
+static int TCOD_heap_check_index_(const struct TCOD_Heap* heap, int index) {
+  if (!heap->positions) return TCOD_set_errorv("Heap was not initialized with TCOD_heap_init_indexed.");
+  if (index < 0 || index >= heap->position_count) return TCOD_set_errorvf("Heap index out of range: %i", index);
+  return TCOD_E_OK;
 }
 /***************************************************************************
     @brief Push an element onto this minumum heap.
 
+    For indexed heaps, pushing an index which is already in the heap changes its priority instead.
+
     @param minheap A TCOD_Heap pointer.
     @param priority The priority of the new element.
     @param data The data to push onto the heap.  Can not be NULL.
     @return Returns a negative error code on failures.
  */
 int TCOD_minheap_push(struct TCOD_Heap* __restrict minheap, int priority, const void* __restrict data) {
-  if (minheap->size == minheap->capacity) {
-    const int new_capacity = (minheap->capacity ? minheap->capacity * 2 : TCOD_HEAP_DEFAULT_CAPACITY);
-    void* new_heap = realloc(minheap->heap, minheap->node_size * new_capacity);
-    if (!new_heap) {
-      TCOD_set_errorv("Out of memory while reallocating heap.");
-      return TCOD_E_OUT_OF_MEMORY;
+  if (minheap->positions) {
+    const int index = *(const int*)data;
+    const int err = TCOD_heap_check_index_(minheap, index);
+    if (err < 0) return err;
+    if (minheap->positions[index] >= 0) {
+      TCOD_minheap_update_(minheap, minheap->positions[index], priority);
+      return TCOD_E_OK;
     }
-    minheap->capacity = new_capacity;
-    minheap->heap = new_heap;
   }
+  const int err = TCOD_heap_reserve_one_(minheap);
+  if (err < 0) return err;
+  unsigned char node[TCOD_HEAP_MAX_NODE_SIZE];
+  *(int*)node = priority;
+  memcpy(node + minheap->data_offset, data, minheap->data_size);
   ++minheap->size;
-  TCOD_heap_set_(minheap, minheap->size - 1, priority, data);
-  TCOD_TCOD_minheap_heapify_up_(minheap, minheap->size - 1);
+  TCOD_minheap_sift_up_any_(minheap, minheap->size - 1, node);
   return TCOD_E_OK;
 }
+/***************************************************************************
+    @brief Return true if `index` is in an indexed heap.
+
+    @param minheap A TCOD_Heap pointer initialized with TCOD_heap_init_indexed.
+    @param index The index to check.
+ */
+bool TCOD_minheap_contains(const struct TCOD_Heap* minheap, int index) {
+  if (!minheap->positions || index < 0 || index >= minheap->position_count) return false;
+  return minheap->positions[index] >= 0;
+}
+/***************************************************************************
+    @brief Push `index` onto an indexed heap, or lower its priority if it is already in the heap.
+
+    This is the decrease-key operation.  It does nothing if `index` already has a priority of `priority` or lower.
+
+    @param minheap A TCOD_Heap pointer initialized with TCOD_heap_init_indexed.
+    @param index The index to push or update.
+    @param priority The new priority of `index`.
+    @return Returns 1 if the heap was changed, 0 if it was not, or a negative error code on failures.
+ */
+int TCOD_minheap_decrease_key(struct TCOD_Heap* minheap, int index, int priority) {
+  const int err = TCOD_heap_check_index_(minheap, index);
+  if (err < 0) return err;
+  const int position = minheap->positions[index];
+  if (position < 0) {
+    const int push_err = TCOD_minheap_push(minheap, priority, &index);
+    return push_err < 0 ? push_err : 1;
+  }
+  if (TCOD_heap_priority_(minheap, position) <= priority) return 0;
+  TCOD_minheap_update_(minheap, position, priority);
+  return 1;
+}
+/***************************************************************************
+    @brief Initialize a bucket queue.
+
+    @param queue A pointer to an existing TCOD_BucketQueue struct.
+    @param max_span The largest expected difference between a pushed priority and the last popped priority.
+    This is the maximum edge cost for Dijkstra.
+    @return int Returns a negative value on error.
+ */
+int TCOD_bucketq_init(struct TCOD_BucketQueue* queue, int max_span) {
+  if (max_span < 0 || max_span >= TCOD_BUCKETQ_MAX_BUCKETS) {
+    return TCOD_set_errorvf("Bucket queue span is out of range: %i", max_span);
+  }
+  int bucket_count = 1;
+  while (bucket_count <= max_span) bucket_count <<= 1;
+  queue->buckets = calloc(bucket_count, sizeof(*queue->buckets));
+  if (!queue->buckets) {
+    TCOD_set_errorv("Out of memory allocating bucket queue.");
+    return TCOD_E_OUT_OF_MEMORY;
+  }
+  queue->bucket_count = bucket_count;
+  queue->cursor = 0;
+  queue->size = 0;
+  queue->bucketed = 0;
+  return TCOD_heap_init(&queue->overflow, sizeof(int));
+}
+/***************************************************************************
+    @brief Free the data of a bucket queue.
+
+    @param queue A pointer to a TCOD_BucketQueue struct, the struct itself is not freed.
+ */
+void TCOD_bucketq_uninit(struct TCOD_BucketQueue* queue) {
+  if (queue->buckets) {
+    for (int i = 0; i < queue->bucket_count; ++i) free(queue->buckets[i].values);
+    free(queue->buckets);
+  }
+  queue->buckets = NULL;
+  queue->bucket_count = 0;
+  queue->size = 0;
+  queue->bucketed = 0;
+  TCOD_heap_uninit(&queue->overflow);
+}
+/***************************************************************************
+    @brief Remove all elements from a bucket queue, keeping its allocations.
+ */
+void TCOD_bucketq_clear(struct TCOD_BucketQueue* queue) {
+  for (int i = 0; i < queue->bucket_count; ++i) queue->buckets[i].size = 0;
+  queue->size = 0;
+  queue->bucketed = 0;
+  TCOD_heap_clear(&queue->overflow);
+}
+/***************************************************************************
+    @brief Push a value onto a bucket queue.
+
+    @param queue A TCOD_BucketQueue pointer.
+    @param priority The priority of the new element.
+    @param value The value to push.
+    @return Returns a negative error code on failures.
+ */
+int TCOD_bucketq_push(struct TCOD_BucketQueue* queue, int priority, int value) {
+  if (queue->bucketed == 0) queue->cursor = priority;  // Move the bucket window to this priority.
+  const int64_t offset = (int64_t)priority - queue->cursor;
+  if (offset < 0 || offset >= queue->bucket_count) {
+    const int err = TCOD_minheap_push(&queue->overflow, priority, &value);
+    if (err < 0) return err;
+    ++queue->size;
+    return TCOD_E_OK;
+  }
+  struct TCOD_BucketQueueBucket* bucket = &queue->buckets[priority & (queue->bucket_count - 1)];
+  if (bucket->size == bucket->capacity) {
+    const int new_capacity = bucket->capacity ? bucket->capacity * 2 : TCOD_BUCKETQ_DEFAULT_CAPACITY;
+    int* new_values = realloc(bucket->values, sizeof(*new_values) * new_capacity);
+    if (!new_values) {
+      TCOD_set_errorv("Out of memory while reallocating bucket queue.");
+      return TCOD_E_OUT_OF_MEMORY;
+    }
+    bucket->capacity = new_capacity;
+    bucket->values = new_values;
+  }
+  bucket->values[bucket->size++] = value;
+  ++queue->bucketed;
+  ++queue->size;
+  return TCOD_E_OK;
+}
+/***************************************************************************
+    @brief Remove the element with the lowest priority from a bucket queue.
+
+    @param queue A TCOD_BucketQueue pointer.
+    @param priority An optional pointer to store the priority of the removed element.
+    @param value An optional pointer to store the value of the removed element.
+    @return Returns a negative error code if the queue is empty.
+ */
+int TCOD_bucketq_pop(struct TCOD_BucketQueue* __restrict queue, int* __restrict priority, int* __restrict value) {
+  if (queue->size == 0) {
+    TCOD_set_errorv("Bucket queue is empty.");
+    return TCOD_E_ERROR;
+  }
+  if (queue->bucketed == 0) {
+    queue->cursor = *(const int*)TCOD_heap_get_(&queue->overflow, 0);
+  }
+  while (true) {
+    if (queue->overflow.size && *(const int*)TCOD_heap_get_(&queue->overflow, 0) <= queue->cursor) {
+      if (priority) *priority = *(const int*)TCOD_heap_get_(&queue->overflow, 0);
+      int overflow_value;
+      TCOD_minheap_pop(&queue->overflow, &overflow_value);
+      if (value) *value = overflow_value;
+      --queue->size;
+      return TCOD_E_OK;
+    }
+    struct TCOD_BucketQueueBucket* bucket = &queue->buckets[queue->cursor & (queue->bucket_count - 1)];
+    if (bucket->size) {
+      if (priority) *priority = queue->cursor;
+      const int bucket_value = bucket->values[--bucket->size];
+      if (value) *value = bucket_value;
+      --queue->bucketed;
+      --queue->size;
+      return TCOD_E_OK;
+    }
+    ++queue->cursor;
+  }
+}
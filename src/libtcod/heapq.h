@@ -37,6 +37,11 @@
 
 #include "config.h"
 
+/**
+    A 4-ary min-heap of nodes holding an int priority followed by user data.
+
+    Heaps from `TCOD_heap_init_indexed` hold int indexes and track their positions, supporting decrease-key.
+ */
 struct TCOD_Heap {
   unsigned char* __restrict heap;
   int size;  // The current number of elements in heap.
@@ -45,6 +50,30 @@ struct TCOD_Heap {
   size_t data_size;  // The size of a nodes user data section in bytes.
   size_t data_offset;  // The offset of the user data section.
   int priority_type;  // Should be -4.
+  int* positions;  // The heap position of each index, or -1.  Only used by heaps from TCOD_heap_init_indexed.
+  int position_count;  // The number of indexes in positions.
+};
+
+/// A single bucket of a TCOD_BucketQueue.
+struct TCOD_BucketQueueBucket {
+  int* values;
+  int size;
+  int capacity;
+};
+/**
+    A monotone bucket queue (Dial's algorithm) holding integer values.
+
+    Push and pop are O(1) when every pushed priority is within `bucket_count` of the last popped priority, which is
+    the case for Dijkstra-like searches whose edge costs are smaller than `bucket_count`.
+    Priorities outside of that window are stored in a regular heap, so the queue stays correct for any priority.
+ */
+struct TCOD_BucketQueue {
+  struct TCOD_BucketQueueBucket* buckets;
+  int bucket_count;  // The number of buckets, always a power of two.
+  int cursor;  // The lowest priority the buckets can hold.
+  int size;  // The total number of elements.
+  int bucketed;  // The number of elements held in the buckets.
+  struct TCOD_Heap overflow;  // Elements outside of the bucket window.
 };
 
 #ifdef __cplusplus
@@ -58,6 +87,16 @@ TCOD_PUBLIC void TCOD_heap_clear(struct TCOD_Heap* heap);
 TCOD_PUBLIC int TCOD_minheap_push(struct TCOD_Heap* __restrict minheap, int priority, const void* __restrict data);
 TCOD_PUBLIC void TCOD_minheap_pop(struct TCOD_Heap* __restrict minheap, void* __restrict out);
 TCOD_PUBLIC void TCOD_minheap_heapify(struct TCOD_Heap* minheap);
+
+TCOD_PUBLIC int TCOD_heap_init_indexed(struct TCOD_Heap* heap, int index_count);
+TCOD_PUBLIC bool TCOD_minheap_contains(const struct TCOD_Heap* minheap, int index);
+TCOD_PUBLIC int TCOD_minheap_decrease_key(struct TCOD_Heap* minheap, int index, int priority);
+
+TCOD_PUBLIC int TCOD_bucketq_init(struct TCOD_BucketQueue* queue, int max_span);
+TCOD_PUBLIC void TCOD_bucketq_uninit(struct TCOD_BucketQueue* queue);
+TCOD_PUBLIC void TCOD_bucketq_clear(struct TCOD_BucketQueue* queue);
+TCOD_PUBLIC int TCOD_bucketq_push(struct TCOD_BucketQueue* queue, int priority, int value);
+TCOD_PUBLIC int TCOD_bucketq_pop(struct TCOD_BucketQueue* __restrict queue, int* __restrict priority, int* __restrict value);
 #ifdef __cplusplus
 }  // extern "C"
 #endif  // __cplusplus
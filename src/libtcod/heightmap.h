@@ -52,6 +52,28 @@ TCODLIB_API float TCOD_heightmap_get_interpolated_value(const TCOD_heightmap_t*
 TCODLIB_API void TCOD_heightmap_set_value(TCOD_heightmap_t* hm, int x, int y, float value);
 TCODLIB_API float TCOD_heightmap_get_slope(const TCOD_heightmap_t* hm, int x, int y);
 TCODLIB_API void TCOD_heightmap_get_normal(const TCOD_heightmap_t* hm, float x, float y, float n[3], float waterLevel);
+/**
+    Write the slope of every cell of `hm` to `hm_out`, which must have the same size and must not be `hm`.
+
+    Each value is the same as `TCOD_heightmap_get_slope` at that cell.  Rows are processed in parallel.
+ */
+TCODLIB_API void TCOD_heightmap_get_slopes(const TCOD_heightmap_t* hm, TCOD_heightmap_t* hm_out);
+/**
+    Write the normal of every cell of `hm` to `normals`, an array of `hm->w * hm->h * 3` floats.
+
+    The normal of the cell `x`,`y` is stored at `normals[(x + y * hm->w) * 3]` and is the same as
+    `TCOD_heightmap_get_normal` at those integer coordinates.  Rows are processed in parallel.
+ */
+TCODLIB_API void TCOD_heightmap_get_normals(const TCOD_heightmap_t* hm, float* normals, float waterLevel);
+/**
+    Return the normal at `x`,`y` interpolated from a `w` by `h` array filled by `TCOD_heightmap_get_normals`.
+
+    The normals of the four nearest cells are bilinearly interpolated and normalized again.  This is much faster than
+    `TCOD_heightmap_get_normal` when many normals are sampled, but between cells the result is a smoothed version of
+    it rather than the same value.
+ */
+TCODLIB_API void TCOD_heightmap_get_interpolated_normal(
+    int w, int h, const float* normals, float x, float y, float n[3]);
 TCODLIB_API int TCOD_heightmap_count_cells(const TCOD_heightmap_t* hm, float min, float max);
 TCODLIB_API bool TCOD_heightmap_has_land_on_border(const TCOD_heightmap_t* hm, float waterLevel);
 TCODLIB_API void TCOD_heightmap_get_minmax(const TCOD_heightmap_t* hm, float* min, float* max);
@@ -61,6 +83,12 @@ TCODLIB_API void TCOD_heightmap_add(TCOD_heightmap_t* hm, float value);
 TCODLIB_API void TCOD_heightmap_scale(TCOD_heightmap_t* hm, float value);
 TCODLIB_API void TCOD_heightmap_clamp(TCOD_heightmap_t* hm, float min, float max);
 TCODLIB_API void TCOD_heightmap_normalize(TCOD_heightmap_t* hm, float min, float max);
+/**
+    Scale, offset, and then clamp every value of `hm` in a single pass.
+
+    This gives the same results as `TCOD_heightmap_scale`, `TCOD_heightmap_add`, and `TCOD_heightmap_clamp` in order.
+ */
+TCODLIB_API void TCOD_heightmap_scale_add_clamp(TCOD_heightmap_t* hm, float scale, float add, float min, float max);
 TCODLIB_API void TCOD_heightmap_clear(TCOD_heightmap_t* hm);
 TCODLIB_API void TCOD_heightmap_lerp_hm(
     const TCOD_heightmap_t* hm1, const TCOD_heightmap_t* hm2, TCOD_heightmap_t* out, float coef);
@@ -74,8 +102,30 @@ TCODLIB_API void TCOD_heightmap_dig_bezier(
     TCOD_heightmap_t* hm, int px[4], int py[4], float startRadius, float startDepth, float endRadius, float endDepth);
 TCODLIB_API void TCOD_heightmap_rain_erosion(
     TCOD_heightmap_t* hm, int nbDrops, float erosionCoef, float sedimentationCoef, TCOD_Random* rnd);
-/* TCODLIB_API void TCOD_heightmap_heat_erosion(TCOD_heightmap_t *hm, int nbPass,float minSlope,float erosionCoef,float
- * sedimentationCoef,TCOD_Random* rnd); */
+/**
+    Simulate rain erosion with multiple threads.
+
+    Drops are split into batches of 256 which each draw from their own random stream derived from `seed`.
+    Batches are simulated 16 at a time against the same heightmap and their changes are then applied in order, so drops
+    of the same round do not see each other's erosion.  The result only depends on the parameters and `seed`, it is
+    the same for any number of threads.
+    Drops also walk without seeing their own erosion.  This is the same walk as `TCOD_heightmap_rain_erosion` only
+    while `erosionCoef` is below 1, larger values lower the cells a drop leaves under it and change its serial path.
+
+    Returns a negative error code if memory runs out, the heightmap then keeps the rounds completed before the error.
+ */
+TCODLIB_API TCOD_Error TCOD_heightmap_rain_erosion_parallel(
+    TCOD_heightmap_t* hm, int nbDrops, float erosionCoef, float sedimentationCoef, uint32_t seed);
+/**
+    Simulate thermal erosion, where material slides down slopes steeper than `minSlope`.
+
+    On each of the `nbPass` passes every cell whose steepest downhill neighbor is lower by more than `minSlope` loses
+    `erosionCoef` times the excess and that neighbor gains `aggregationCoef` times the excess.  All cells of a pass are
+    computed from the heights before that pass, so rows are processed in parallel and the result is the same for any
+    number of threads.
+ */
+TCODLIB_API void TCOD_heightmap_thermal_erosion(
+    TCOD_heightmap_t* hm, int nbPass, float minSlope, float erosionCoef, float aggregationCoef);
 TCODLIB_API void TCOD_heightmap_kernel_transform(
     TCOD_heightmap_t* hm,
     int kernel_size,
@@ -84,6 +134,42 @@ TCODLIB_API void TCOD_heightmap_kernel_transform(
     const float* weight,
     float minLevel,
     float maxLevel);
+/**
+    Apply a kernel transform from `hm` to `hm_out`, which must have the same size.
+
+    Every cell is computed from the original values of `hm`, unlike `TCOD_heightmap_kernel_transform` where cells see
+    the cells already transformed before them.  `hm` and `hm_out` can be the same heightmap.
+    Only cells with a value between `minLevel` and `maxLevel` are changed.
+
+    A kernel covering a whole rectangle of positive weights which are the product of a row and a column, such as a box
+    or Gaussian blur, is applied as a horizontal then a vertical pass.  The result can then differ slightly from a
+    direct 2D convolution because of floating point rounding.
+    Rows are processed in parallel.
+ */
+TCODLIB_API void TCOD_heightmap_kernel_transform_out(
+    const TCOD_heightmap_t* hm,
+    TCOD_heightmap_t* hm_out,
+    int kernel_size,
+    const int* dx,
+    const int* dy,
+    const float* weight,
+    float minLevel,
+    float maxLevel);
+/**
+    Apply a separable kernel from `hm` to `hm_out`, which must have the same size and can be the same heightmap.
+
+    `weight` holds the `radius * 2 + 1` weights of the offsets `-radius` to `radius`, they are used both horizontally
+    and vertically.  Weights of out of bounds cells are left out, the result is always normalized by the sum of the
+    weights which were used.
+    Only cells with a value between `minLevel` and `maxLevel` are changed.
+ */
+TCODLIB_API void TCOD_heightmap_separable_transform(
+    const TCOD_heightmap_t* hm,
+    TCOD_heightmap_t* hm_out,
+    int radius,
+    const float* weight,
+    float minLevel,
+    float maxLevel);
 TCODLIB_API void TCOD_heightmap_add_voronoi(
     TCOD_heightmap_t* hm, int nbPoints, int nbCoef, const float* coef, TCOD_Random* rnd);
 TCODLIB_API void TCOD_heightmap_mid_point_displacement(TCOD_heightmap_t* hm, TCOD_Random* rnd, float roughness);
@@ -109,6 +195,100 @@ TCODLIB_API void TCOD_heightmap_scale_fbm(
     float scale);
 TCOD_DEPRECATED("This function does nothing and will be removed.")
 TCODLIB_API void TCOD_heightmap_islandify(TCOD_heightmap_t* hm, float seaLevel, TCOD_Random* rnd);
+
+/**
+    A recorded sequence of heightmap operations which are run together by `TCOD_heightmap_pipeline_execute`.
+
+    Element-wise operations such as adding, scaling, clamping, hills, and fBm noise are fused into a single pass over
+    the heightmap, each row is run through all of them while it is still in the cache.  Normalizing finds its range in
+    the same pass as the operations before it.  Other operations such as kernel transforms end the pass.
+    The results are the same as calling the matching `TCOD_heightmap_*` functions in order.
+
+    Heightmaps and noise given to a pipeline are not copied, they must outlive it.
+ */
+typedef struct TCOD_HeightmapPipeline TCOD_HeightmapPipeline;
+/**
+    A custom pipeline step, called with the whole heightmap.
+ */
+typedef void (*TCOD_HeightmapPipelineFunc)(TCOD_heightmap_t* hm, void* userdata);
+/**
+    Return a new empty pipeline, or NULL on failure.  It must be deleted with `TCOD_heightmap_pipeline_delete`.
+ */
+TCODLIB_API TCOD_HeightmapPipeline* TCOD_heightmap_pipeline_new(void);
+TCODLIB_API void TCOD_heightmap_pipeline_delete(TCOD_HeightmapPipeline* pipeline);
+/**
+    Record an operation at the end of a pipeline.  These match the `TCOD_heightmap_*` functions of the same name.
+
+    Operations with another heightmap use it as their second operand and write back to the heightmap being processed.
+    They return a negative error code on failure.
+ */
+TCODLIB_API TCOD_Error TCOD_heightmap_pipeline_add(TCOD_HeightmapPipeline* pipeline, float value);
+TCODLIB_API TCOD_Error TCOD_heightmap_pipeline_scale(TCOD_HeightmapPipeline* pipeline, float value);
+TCODLIB_API TCOD_Error TCOD_heightmap_pipeline_clamp(TCOD_HeightmapPipeline* pipeline, float min, float max);
+TCODLIB_API TCOD_Error TCOD_heightmap_pipeline_scale_add_clamp(
+    TCOD_HeightmapPipeline* pipeline, float scale, float add, float min, float max);
+TCODLIB_API TCOD_Error TCOD_heightmap_pipeline_normalize(TCOD_HeightmapPipeline* pipeline, float min, float max);
+TCODLIB_API TCOD_Error TCOD_heightmap_pipeline_lerp_hm(
+    TCOD_HeightmapPipeline* pipeline, const TCOD_heightmap_t* other, float coef);
+TCODLIB_API TCOD_Error TCOD_heightmap_pipeline_add_hm(TCOD_HeightmapPipeline* pipeline, const TCOD_heightmap_t* other);
+TCODLIB_API TCOD_Error TCOD_heightmap_pipeline_multiply_hm(
+    TCOD_HeightmapPipeline* pipeline, const TCOD_heightmap_t* other);
+TCODLIB_API TCOD_Error TCOD_heightmap_pipeline_add_hill(
+    TCOD_HeightmapPipeline* pipeline, float hx, float hy, float h_radius, float h_height);
+TCODLIB_API TCOD_Error TCOD_heightmap_pipeline_dig_hill(
+    TCOD_HeightmapPipeline* pipeline, float hx, float hy, float h_radius, float h_height);
+TCODLIB_API TCOD_Error TCOD_heightmap_pipeline_add_fbm(
+    TCOD_HeightmapPipeline* pipeline,
+    TCOD_noise_t noise,
+    float mul_x,
+    float mul_y,
+    float add_x,
+    float add_y,
+    float octaves,
+    float delta,
+    float scale);
+TCODLIB_API TCOD_Error TCOD_heightmap_pipeline_scale_fbm(
+    TCOD_HeightmapPipeline* pipeline,
+    TCOD_noise_t noise,
+    float mul_x,
+    float mul_y,
+    float add_x,
+    float add_y,
+    float octaves,
+    float delta,
+    float scale);
+/**
+    Record a `TCOD_heightmap_kernel_transform`, the kernel arrays are copied.  This ends the current fused pass.
+ */
+TCODLIB_API TCOD_Error TCOD_heightmap_pipeline_kernel_transform(
+    TCOD_HeightmapPipeline* pipeline,
+    int kernel_size,
+    const int* dx,
+    const int* dy,
+    const float* weight,
+    float minLevel,
+    float maxLevel);
+/**
+    Record a call to `func`, which may do anything to the heightmap.  This ends the current fused pass.
+ */
+TCODLIB_API TCOD_Error TCOD_heightmap_pipeline_call(
+    TCOD_HeightmapPipeline* pipeline, TCOD_HeightmapPipelineFunc func, void* userdata);
+/**
+    Run every operation of a pipeline on `hm`.  A pipeline can be executed any number of times.
+
+    Fused passes split their rows across multiple threads.
+    Returns a negative error code on failure, such as when a heightmap operand is not the same size as `hm`.
+ */
+TCODLIB_API TCOD_Error TCOD_heightmap_pipeline_execute(const TCOD_HeightmapPipeline* pipeline, TCOD_heightmap_t* hm);
+/**
+    Run a pipeline on `hm` as if it were the part of a larger world starting at `origin_x, origin_y`.
+
+    Hills are placed in world coordinates and fBm noise is sampled at world coordinates, with `mul_x` and `mul_y`
+    still divided by the size of `hm`.  Neighboring heightmaps generated this way line up seamlessly.
+    Steps which look at the whole heightmap, such as normalizing or kernel transforms, only see `hm`.
+ */
+TCODLIB_API TCOD_Error TCOD_heightmap_pipeline_execute_at(
+    const TCOD_HeightmapPipeline* pipeline, TCOD_heightmap_t* hm, int origin_x, int origin_y);
 #ifdef __cplusplus
 }
 #endif
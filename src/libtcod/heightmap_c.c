@@ -37,6 +37,7 @@
 
 #include "heightmap.h"
 #include "mersenne.h"
+#include "parallel.h"
 #include "utility.h"
 
 #define GET_VALUE(hm, x, y) (hm)->values[(x) + (y) * (hm)->w]
@@ -58,6 +59,258 @@ static bool is_same_size(const TCOD_heightmap_t* hm1, const TCOD_heightmap_t* hm
   return hm1 && hm2 && hm1->w == hm2->w && hm1->h == hm2->h;
 }
 
+/* Whole-heightmap arithmetic, vectorized when the compiler supports it. */
+
+/// Element-wise heightmap operations handled by `heightmap_map`.
+typedef enum TCOD_HeightmapOp_ {
+  TCOD_HM_OP_ADD,  // a + p[0]
+  TCOD_HM_OP_SCALE,  // a * p[0]
+  TCOD_HM_OP_CLAMP,  // CLAMP(p[0], p[1], a)
+  TCOD_HM_OP_SCALE_ADD_CLAMP,  // CLAMP(p[2], p[3], a * p[0] + p[1])
+  TCOD_HM_OP_NORMALIZE,  // p[0] + (a - p[1]) * p[2]
+  TCOD_HM_OP_LERP_HM,  // LERP(a, b, p[0])
+  TCOD_HM_OP_ADD_HM,  // a + b
+  TCOD_HM_OP_MULTIPLY_HM,  // a * b
+} TCOD_HeightmapOp_;
+
+#if defined(__GNUC__) && (defined(__clang__) || __GNUC__ >= 9)
+/**
+    Heightmap loops are processed `TCOD_HEIGHTMAP_LANES` values at a time using GCC vector extensions.
+
+    As with the noise kernels, each loop is compiled once for the default target and once for AVX2, which is picked at
+    runtime.  The vector code performs the same operations as the scalar code so that the results are the same.
+ */
+#define TCOD_HEIGHTMAP_SIMD 1
+#define TCOD_HEIGHTMAP_LANES 8
+#define TCOD_HEIGHTMAP_INLINE inline __attribute__((always_inline))
+#if defined(__x86_64__) || defined(__i386__)
+#define TCOD_HEIGHTMAP_SIMD_AVX2 1
+#endif
+#if !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+typedef float TCOD_HeightmapVecF_ __attribute__((vector_size(sizeof(float) * TCOD_HEIGHTMAP_LANES)));
+typedef int32_t TCOD_HeightmapVecI_ __attribute__((vector_size(sizeof(int32_t) * TCOD_HEIGHTMAP_LANES)));
+typedef int8_t TCOD_HeightmapVecI8_ __attribute__((vector_size(sizeof(int8_t) * TCOD_HEIGHTMAP_LANES)));
+typedef TCOD_HeightmapVecF_ hm_vf_t;
+typedef TCOD_HeightmapVecI_ hm_vi_t;
+typedef TCOD_HeightmapVecI8_ hm_vi8_t;
+
+static TCOD_HEIGHTMAP_INLINE hm_vf_t hm_vf_load(const float* p) {
+  hm_vf_t out;
+  memcpy(&out, p, sizeof(out));
+  return out;
+}
+static TCOD_HEIGHTMAP_INLINE hm_vf_t hm_vf_splat(float x) { return (hm_vf_t){0} + x; }
+/*
+    Helpers which take vectors are macros.  GCC prints a note about the ABI of 32-byte vector parameters for any such
+    function compiled for the default target, even when it is always inlined, and pragmas do not silence notes.
+ */
+/// Store the vector `v` to `p`, which does not need to be aligned.
+#define HM_VF_STORE(p, v) memcpy((p), (const hm_vf_t[1]){(v)}, sizeof(hm_vf_t))
+/// Return `a` where `mask` is set, otherwise `b`.
+#define HM_VF_SELECT(mask, a, b) ((hm_vf_t)(((mask) & (hm_vi_t)(a)) | (~(mask) & (hm_vi_t)(b))))
+#define HM_VF_CLAMP(low, high, x) HM_VF_SELECT((x) < (low), (low), HM_VF_SELECT((x) > (high), (high), (x)))
+#else
+#define TCOD_HEIGHTMAP_INLINE inline
+#endif  // defined(__GNUC__)
+
+/// Apply an element-wise operation to `n` values, `b` is only used by operations between two heightmaps.
+static TCOD_HEIGHTMAP_INLINE void heightmap_map(
+    TCOD_HeightmapOp_ op, int n, const float* a, const float* b, float* out, const float* __restrict p) {
+  int i = 0;
+#ifdef TCOD_HEIGHTMAP_SIMD
+  const hm_vf_t p0 = hm_vf_splat(p[0]);
+  const hm_vf_t p1 = hm_vf_splat(p[1]);
+  const hm_vf_t p2 = hm_vf_splat(p[2]);
+  const hm_vf_t p3 = hm_vf_splat(p[3]);
+  for (; i + TCOD_HEIGHTMAP_LANES <= n; i += TCOD_HEIGHTMAP_LANES) {
+    const hm_vf_t va = hm_vf_load(&a[i]);
+    hm_vf_t result;
+    switch (op) {
+      case TCOD_HM_OP_ADD:
+        result = va + p0;
+        break;
+      case TCOD_HM_OP_SCALE:
+        result = va * p0;
+        break;
+      case TCOD_HM_OP_CLAMP:
+        result = HM_VF_CLAMP(p0, p1, va);
+        break;
+      case TCOD_HM_OP_SCALE_ADD_CLAMP:
+        result = HM_VF_CLAMP(p2, p3, va * p0 + p1);
+        break;
+      case TCOD_HM_OP_NORMALIZE:
+        result = p0 + (va - p1) * p2;
+        break;
+      case TCOD_HM_OP_LERP_HM:
+        result = va + p0 * (hm_vf_load(&b[i]) - va);
+        break;
+      case TCOD_HM_OP_ADD_HM:
+        result = va + hm_vf_load(&b[i]);
+        break;
+      case TCOD_HM_OP_MULTIPLY_HM:
+      default:
+        result = va * hm_vf_load(&b[i]);
+        break;
+    }
+    HM_VF_STORE(&out[i], result);
+  }
+#endif  // TCOD_HEIGHTMAP_SIMD
+  for (; i < n; ++i) {
+    switch (op) {
+      case TCOD_HM_OP_ADD:
+        out[i] = a[i] + p[0];
+        break;
+      case TCOD_HM_OP_SCALE:
+        out[i] = a[i] * p[0];
+        break;
+      case TCOD_HM_OP_CLAMP:
+        out[i] = CLAMP(p[0], p[1], a[i]);
+        break;
+      case TCOD_HM_OP_SCALE_ADD_CLAMP: {
+        const float value = a[i] * p[0] + p[1];
+        out[i] = CLAMP(p[2], p[3], value);
+      } break;
+      case TCOD_HM_OP_NORMALIZE:
+        out[i] = p[0] + (a[i] - p[1]) * p[2];
+        break;
+      case TCOD_HM_OP_LERP_HM:
+        out[i] = LERP(a[i], b[i], p[0]);
+        break;
+      case TCOD_HM_OP_ADD_HM:
+        out[i] = a[i] + b[i];
+        break;
+      case TCOD_HM_OP_MULTIPLY_HM:
+        out[i] = a[i] * b[i];
+        break;
+    }
+  }
+}
+
+/// Write the smallest and largest of `n > 0` values, these are the same values as the scalar `MIN` and `MAX` loop.
+static TCOD_HEIGHTMAP_INLINE void heightmap_minmax(int n, const float* a, float* min_out, float* max_out) {
+  float min = a[0];
+  float max = a[0];
+  int i = 0;
+#ifdef TCOD_HEIGHTMAP_SIMD
+  if (n >= TCOD_HEIGHTMAP_LANES) {
+    hm_vf_t vmin = hm_vf_load(a);
+    hm_vf_t vmax = vmin;
+    for (i = TCOD_HEIGHTMAP_LANES; i + TCOD_HEIGHTMAP_LANES <= n; i += TCOD_HEIGHTMAP_LANES) {
+      const hm_vf_t value = hm_vf_load(&a[i]);
+      vmin = HM_VF_SELECT(vmin < value, vmin, value);
+      vmax = HM_VF_SELECT(vmax > value, vmax, value);
+    }
+    float lanes_min[TCOD_HEIGHTMAP_LANES];
+    float lanes_max[TCOD_HEIGHTMAP_LANES];
+    HM_VF_STORE(lanes_min, vmin);
+    HM_VF_STORE(lanes_max, vmax);
+    for (int lane = 0; lane < TCOD_HEIGHTMAP_LANES; ++lane) {
+      min = MIN(min, lanes_min[lane]);
+      max = MAX(max, lanes_max[lane]);
+    }
+  }
+#endif  // TCOD_HEIGHTMAP_SIMD
+  for (; i < n; ++i) {
+    min = MIN(min, a[i]);
+    max = MAX(max, a[i]);
+  }
+  *min_out = min;
+  *max_out = max;
+}
+
+/// Return the number of values between `min` and `max` inclusive.
+static TCOD_HEIGHTMAP_INLINE int heightmap_count(int n, const float* a, float min, float max) {
+  int count = 0;
+  int i = 0;
+#ifdef TCOD_HEIGHTMAP_SIMD
+  hm_vi_t counts = {0};
+  for (; i + TCOD_HEIGHTMAP_LANES <= n; i += TCOD_HEIGHTMAP_LANES) {
+    const hm_vf_t value = hm_vf_load(&a[i]);
+    counts -= (value >= min) & (value <= max);  // Comparisons are -1 where true.
+  }
+  for (int lane = 0; lane < TCOD_HEIGHTMAP_LANES; ++lane) count += counts[lane];
+#endif  // TCOD_HEIGHTMAP_SIMD
+  for (; i < n; ++i) {
+    if (a[i] >= min && a[i] <= max) ++count;
+  }
+  return count;
+}
+
+/// Dispatch `heightmap_map` to a loop specialized for `op`.
+static TCOD_HEIGHTMAP_INLINE void heightmap_map_dispatch(
+    TCOD_HeightmapOp_ op, int n, const float* a, const float* b, float* out, const float* __restrict p) {
+  switch (op) {
+#define TCOD_HM_OP_CASE_(OP)           \
+  case OP:                             \
+    heightmap_map(OP, n, a, b, out, p); \
+    return;
+    TCOD_HM_OP_CASE_(TCOD_HM_OP_ADD)
+    TCOD_HM_OP_CASE_(TCOD_HM_OP_SCALE)
+    TCOD_HM_OP_CASE_(TCOD_HM_OP_CLAMP)
+    TCOD_HM_OP_CASE_(TCOD_HM_OP_SCALE_ADD_CLAMP)
+    TCOD_HM_OP_CASE_(TCOD_HM_OP_NORMALIZE)
+    TCOD_HM_OP_CASE_(TCOD_HM_OP_LERP_HM)
+    TCOD_HM_OP_CASE_(TCOD_HM_OP_ADD_HM)
+    TCOD_HM_OP_CASE_(TCOD_HM_OP_MULTIPLY_HM)
+#undef TCOD_HM_OP_CASE_
+  }
+}
+
+static void heightmap_map_default(
+    TCOD_HeightmapOp_ op, int n, const float* a, const float* b, float* out, const float* __restrict p) {
+  heightmap_map_dispatch(op, n, a, b, out, p);
+}
+static void heightmap_minmax_default(int n, const float* a, float* min_out, float* max_out) {
+  heightmap_minmax(n, a, min_out, max_out);
+}
+static int heightmap_count_default(int n, const float* a, float min, float max) {
+  return heightmap_count(n, a, min, max);
+}
+#ifdef TCOD_HEIGHTMAP_SIMD_AVX2
+__attribute__((target("avx2"))) static void heightmap_map_avx2(
+    TCOD_HeightmapOp_ op, int n, const float* a, const float* b, float* out, const float* __restrict p) {
+  heightmap_map_dispatch(op, n, a, b, out, p);
+}
+__attribute__((target("avx2"))) static void heightmap_minmax_avx2(
+    int n, const float* a, float* min_out, float* max_out) {
+  heightmap_minmax(n, a, min_out, max_out);
+}
+__attribute__((target("avx2"))) static int heightmap_count_avx2(int n, const float* a, float min, float max) {
+  return heightmap_count(n, a, min, max);
+}
+#endif  // TCOD_HEIGHTMAP_SIMD_AVX2
+
+/// Apply an element-wise operation to `n` values with the best loop supported by this CPU.
+static void heightmap_map_best(
+    TCOD_HeightmapOp_ op, int n, const float* a, const float* b, float* out, const float* __restrict p) {
+#ifdef TCOD_HEIGHTMAP_SIMD_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    heightmap_map_avx2(op, n, a, b, out, p);
+    return;
+  }
+#endif  // TCOD_HEIGHTMAP_SIMD_AVX2
+  heightmap_map_default(op, n, a, b, out, p);
+}
+
+/// Write the smallest and largest of `n > 0` values with the best loop supported by this CPU.
+static void heightmap_minmax_best(int n, const float* a, float* min_out, float* max_out) {
+#ifdef TCOD_HEIGHTMAP_SIMD_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    heightmap_minmax_avx2(n, a, min_out, max_out);
+    return;
+  }
+#endif  // TCOD_HEIGHTMAP_SIMD_AVX2
+  heightmap_minmax_default(n, a, min_out, max_out);
+}
+
+/// Apply an element-wise operation to every value of `hm` or to every value of a pair of heightmaps.
+static void heightmap_apply(
+    TCOD_HeightmapOp_ op, const TCOD_heightmap_t* a, const TCOD_heightmap_t* b, TCOD_heightmap_t* out, const float* p) {
+  heightmap_map_best(op, a->w * a->h, a->values, b ? b->values : NULL, out->values, p);
+}
+
 TCOD_heightmap_t* TCOD_heightmap_new(int w, int h) {
   TCOD_heightmap_t* hm = malloc(sizeof(*hm));
   hm->values = calloc(sizeof(*hm->values), w * h);
@@ -104,20 +357,14 @@ void TCOD_heightmap_get_minmax(const TCOD_heightmap_t* hm, float* min, float* ma
     *max = 0;
     return;
   }
+  float current_min;
+  float current_max;
+  heightmap_minmax_best(hm->w * hm->h, hm->values, &current_min, &current_max);
   if (min) {
-    *min = hm->values[0];
+    *min = current_min;
   }
   if (max) {
-    *max = hm->values[0];
-  }
-  for (int i = 0; i != hm->h * hm->w; i++) {
-    const float value = hm->values[i];
-    if (min) {
-      *min = MIN(*min, value);
-    }
-    if (max) {
-      *max = MAX(*max, value);
-    }
+    *max = current_max;
   }
 }
 
@@ -135,9 +382,8 @@ void TCOD_heightmap_normalize(TCOD_heightmap_t* hm, float min, float max) {
     }
   } else {
     const float normalize_scale = (max - min) / (current_max - current_min);
-    for (int i = 0; i != hm->w * hm->h; ++i) {
-      hm->values[i] = min + (hm->values[i] - current_min) * normalize_scale;
-    }
+    const float params[4] = {min, current_min, normalize_scale, 0};
+    heightmap_apply(TCOD_HM_OP_NORMALIZE, hm, NULL, hm, params);
   }
 }
 
@@ -197,6 +443,34 @@ void TCOD_heightmap_copy(const TCOD_heightmap_t* hm_source, TCOD_heightmap_t* hm
   memcpy(hm_dest->values, hm_source->values, sizeof(float) * hm_source->w * hm_source->h);
 }
 
+/**
+    Return a new array of the fBm noise sampled by `TCOD_heightmap_add_fbm` and `TCOD_heightmap_scale_fbm`.
+
+    The noise is filled on multiple threads.  Returns NULL if this fails, the caller must then sample the noise itself.
+ */
+static float* heightmap_fbm_grid(
+    const TCOD_heightmap_t* hm,
+    TCOD_noise_t noise,
+    float mul_x,
+    float mul_y,
+    float add_x,
+    float add_y,
+    float octaves) {
+  if (!noise || noise->ndim != 2) return NULL;
+  float* grid = malloc(sizeof(*grid) * hm->w * hm->h);
+  if (!grid) return NULL;
+  const int shape[2] = {hm->w, hm->h};
+  const float offset[2] = {add_x, add_y};
+  const float scale[2] = {mul_x / hm->w, mul_y / hm->h};
+  const TCOD_Error err = TCOD_noise_fill_grid(
+      noise, TCOD_NOISE_DEFAULT, TCOD_NOISE_MODE_FBM, octaves, 2, shape, NULL, offset, scale, grid);
+  if (err < 0) {
+    free(grid);
+    return NULL;
+  }
+  return grid;
+}
+
 void TCOD_heightmap_add_fbm(
     TCOD_heightmap_t* hm,
     TCOD_noise_t noise,
@@ -210,11 +484,17 @@ void TCOD_heightmap_add_fbm(
   if (!hm) {
     return;
   }
+  float* grid = heightmap_fbm_grid(hm, noise, mul_x, mul_y, add_x, add_y, octaves);
+  if (grid) {
+    for (int i = 0; i < hm->w * hm->h; ++i) hm->values[i] += delta + grid[i] * scale;
+    free(grid);
+    return;
+  }
   const float x_coefficient = mul_x / hm->w;
   const float y_coefficient = mul_y / hm->h;
   for (int y = 0; y < hm->h; y++) {
     for (int x = 0; x < hm->w; x++) {
-      float f[2] = {(x + add_x) * x_coefficient, (y + add_y) * y_coefficient};
+      float f[TCOD_NOISE_MAX_DIMENSIONS] = {(x + add_x) * x_coefficient, (y + add_y) * y_coefficient};
       GET_VALUE(hm, x, y) += delta + TCOD_noise_get_fbm(noise, f, octaves) * scale;
     }
   }
@@ -233,11 +513,17 @@ void TCOD_heightmap_scale_fbm(
   if (!hm) {
     return;
   }
+  float* grid = heightmap_fbm_grid(hm, noise, mul_x, mul_y, add_x, add_y, octaves);
+  if (grid) {
+    for (int i = 0; i < hm->w * hm->h; ++i) hm->values[i] *= delta + grid[i] * scale;
+    free(grid);
+    return;
+  }
   const float x_coefficient = mul_x / hm->w;
   const float y_coefficient = mul_y / hm->h;
   for (int y = 0; y < hm->h; y++) {
     for (int x = 0; x < hm->w; x++) {
-      float f[2] = {(x + add_x) * x_coefficient, (y + add_y) * y_coefficient};
+      float f[TCOD_NOISE_MAX_DIMENSIONS] = {(x + add_x) * x_coefficient, (y + add_y) * y_coefficient};
       GET_VALUE(hm, x, y) *= delta + TCOD_noise_get_fbm(noise, f, octaves) * scale;
     }
   }
@@ -351,40 +637,42 @@ void TCOD_heightmap_add(TCOD_heightmap_t* hm, float value) {
   if (!hm) {
     return;
   }
-  for (int i = 0; i < hm->w * hm->h; ++i) {
-    hm->values[i] += value;
-  }
+  const float params[4] = {value, 0, 0, 0};
+  heightmap_apply(TCOD_HM_OP_ADD, hm, NULL, hm, params);
 }
 
 int TCOD_heightmap_count_cells(const TCOD_heightmap_t* hm, float min, float max) {
   if (!hm) {
     return 0;
   }
-  int count = 0;
-  for (int i = 0; i < hm->w * hm->h; ++i) {
-    if (hm->values[i] >= min && hm->values[i] <= max) {
-      ++count;
-    }
-  }
-  return count;
+#ifdef TCOD_HEIGHTMAP_SIMD_AVX2
+  if (__builtin_cpu_supports("avx2")) return heightmap_count_avx2(hm->w * hm->h, hm->values, min, max);
+#endif  // TCOD_HEIGHTMAP_SIMD_AVX2
+  return heightmap_count_default(hm->w * hm->h, hm->values, min, max);
 }
 
 void TCOD_heightmap_scale(TCOD_heightmap_t* hm, float value) {
   if (!hm) {
     return;
   }
-  for (int i = 0; i < hm->w * hm->h; ++i) {
-    hm->values[i] *= value;
-  }
+  const float params[4] = {value, 0, 0, 0};
+  heightmap_apply(TCOD_HM_OP_SCALE, hm, NULL, hm, params);
 }
 
 void TCOD_heightmap_clamp(TCOD_heightmap_t* hm, float min, float max) {
   if (!hm) {
     return;
   }
-  for (int i = 0; i < hm->w * hm->h; ++i) {
-    hm->values[i] = CLAMP(min, max, hm->values[i]);
+  const float params[4] = {min, max, 0, 0};
+  heightmap_apply(TCOD_HM_OP_CLAMP, hm, NULL, hm, params);
+}
+
+void TCOD_heightmap_scale_add_clamp(TCOD_heightmap_t* hm, float scale, float add, float min, float max) {
+  if (!hm) {
+    return;
   }
+  const float params[4] = {scale, add, min, max};
+  heightmap_apply(TCOD_HM_OP_SCALE_ADD_CLAMP, hm, NULL, hm, params);
 }
 
 void TCOD_heightmap_lerp_hm(
@@ -392,27 +680,24 @@ void TCOD_heightmap_lerp_hm(
   if (!is_same_size(hm1, hm2) || !is_same_size(hm1, hm_out)) {
     return;
   }
-  for (int i = 0; i < hm1->w * hm1->h; i++) {
-    hm_out->values[i] = LERP(hm1->values[i], hm2->values[i], coef);
-  }
+  const float params[4] = {coef, 0, 0, 0};
+  heightmap_apply(TCOD_HM_OP_LERP_HM, hm1, hm2, hm_out, params);
 }
 
 void TCOD_heightmap_add_hm(const TCOD_heightmap_t* hm1, const TCOD_heightmap_t* hm2, TCOD_heightmap_t* hm_out) {
   if (!is_same_size(hm1, hm2) || !is_same_size(hm1, hm_out)) {
     return;
   }
-  for (int i = 0; i < hm1->w * hm1->h; i++) {
-    hm_out->values[i] = hm1->values[i] + hm2->values[i];
-  }
+  const float params[4] = {0, 0, 0, 0};
+  heightmap_apply(TCOD_HM_OP_ADD_HM, hm1, hm2, hm_out, params);
 }
 
 void TCOD_heightmap_multiply_hm(const TCOD_heightmap_t* hm1, const TCOD_heightmap_t* hm2, TCOD_heightmap_t* hm_out) {
   if (!is_same_size(hm1, hm2) || !is_same_size(hm1, hm_out)) {
     return;
   }
-  for (int i = 0; i < hm1->w * hm1->h; i++) {
-    hm_out->values[i] = hm1->values[i] * hm2->values[i];
-  }
+  const float params[4] = {0, 0, 0, 0};
+  heightmap_apply(TCOD_HM_OP_MULTIPLY_HM, hm1, hm2, hm_out, params);
 }
 
 float TCOD_heightmap_get_slope(const TCOD_heightmap_t* hm, int x, int y) {
@@ -477,42 +762,157 @@ void TCOD_heightmap_rain_erosion(
   }
 }
 
-#if 0
-static void setMPDHeight(TCOD_heightmap_t *hm, TCOD_Random* rnd,int x,int y, float z, float offset);
-static void setMDPHeightSquare(TCOD_heightmap_t *hm, TCOD_Random* rnd,int x, int y, int initsz, int sz,float offset);
-
-void TCOD_heightmap_heat_erosion(TCOD_heightmap_t *hm, int nbPass,float minSlope,float erosionCoef,float aggregationCoef,TCOD_Random* rnd) {
-	if (!hm) { return; }
-	while ( nbPass-- > 0 ) {
-		for (int y=0; y < hm->h; y++) {
-			for (int x=0; x < hm->w; x++) {
-				static const int dx[8]={-1,0,1,-1,1,-1,0,1};
-				static const int dy[8]={-1,-1,-1,0,0,1,1,1};
-				int next_x=0,next_y=0,i;
-				const float v=GET_VALUE(hm, x, y);
-				/* calculate slope at x,y */
-				float slope=0.0f;
-				for (i=0; i < 8; i++ ) { /* 4 : von neumann neighborhood 8 : moore neighborhood */
-					const int nx=x+dx[i];
-					const int ny=y+dy[i];
-					if (in_bounds(hm, nx, ny)) {
-						const float n_slope=v-GET_VALUE(hm,nx,ny);
-						if ( n_slope > slope ) {
-							slope=n_slope;
-							next_x=nx;
-							next_y=ny;
-						}
-					}
-				}
-				if ( slope > minSlope ) {
-					GET_VALUE(hm,x,y) -= erosionCoef*(slope-minSlope);
-					GET_VALUE(hm,next_x,next_y) += aggregationCoef*(slope-minSlope);
-				}
-			}
-		}
-	}
+/// The number of rain drops which share one random stream in `TCOD_heightmap_rain_erosion_parallel`.
+#define TCOD_EROSION_BATCH_DROPS 256
+/// The number of batches simulated together against the same heightmap before their changes are applied.
+#define TCOD_EROSION_ROUND_BATCHES 16
+
+/// A height change made by a rain drop.
+struct TCOD_ErosionEvent_ {
+  int index;
+  float delta;
+};
+
+/// The height changes made by one batch of rain drops, in the order they were made.
+struct TCOD_ErosionBatch_ {
+  int count;
+  int capacity;
+  struct TCOD_ErosionEvent_* events;
+  bool out_of_memory;
+};
+
+/// The shared parameters of a round of parallel rain erosion.
+struct TCOD_ErosionRound_ {
+  const TCOD_heightmap_t* hm;
+  int first_batch;  // The global index of `batches[0]`.
+  int nbDrops;
+  float erosionCoef;
+  float aggregationCoef;
+  uint32_t seed;
+  struct TCOD_ErosionBatch_* batches;
+};
+
+/// Return the seed of the random stream of a batch, mixed so that neighboring batches are unrelated.
+static uint32_t erosion_batch_seed(uint32_t seed, int batch) {
+  uint32_t x = seed ^ ((uint32_t)batch * 0x9E3779B9u);
+  x ^= x >> 16;
+  x *= 0x85EBCA6Bu;
+  x ^= x >> 13;
+  x *= 0xC2B2AE35u;
+  x ^= x >> 16;
+  return x;
+}
+
+/// Record a height change, returns false if the batch could not grow.
+static bool erosion_push(struct TCOD_ErosionBatch_* batch, int index, float delta) {
+  if (batch->count == batch->capacity) {
+    const int new_capacity = batch->capacity ? batch->capacity * 2 : 1024;
+    struct TCOD_ErosionEvent_* events = realloc(batch->events, sizeof(*events) * new_capacity);
+    if (!events) return false;
+    batch->events = events;
+    batch->capacity = new_capacity;
+  }
+  batch->events[batch->count].index = index;
+  batch->events[batch->count].delta = delta;
+  ++batch->count;
+  return true;
+}
+
+/**
+    Simulate the batches `[begin, end)` of a round, reading the heightmap and recording their changes.
+
+    A batch which runs out of memory stops at once, its changes are discarded and `out_of_memory` is set.
+ */
+static void erosion_round_batches(void* userdata, int begin, int end) {
+  const struct TCOD_ErosionRound_* round = userdata;
+  const TCOD_heightmap_t* hm = round->hm;
+  static const int dx[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+  static const int dy[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+  for (int i = begin; i < end; ++i) {
+    struct TCOD_ErosionBatch_* batch = &round->batches[i];
+    batch->count = 0;
+    const int global_batch = round->first_batch + i;
+    const int drops = MIN(TCOD_EROSION_BATCH_DROPS, round->nbDrops - global_batch * TCOD_EROSION_BATCH_DROPS);
+    TCOD_Random* rnd = TCOD_random_new_from_seed(TCOD_RNG_MT, erosion_batch_seed(round->seed, global_batch));
+    if (!rnd) {
+      batch->out_of_memory = true;
+      continue;
+    }
+    for (int drop = 0; drop < drops && !batch->out_of_memory; ++drop) {
+      int curx = TCOD_random_get_int(rnd, 0, hm->w - 1);
+      int cury = TCOD_random_get_int(rnd, 0, hm->h - 1);
+      float sediment = 0.0f;
+      /*
+          The same walk as `TCOD_heightmap_rain_erosion`, but on the heightmap as it was before this round.  A drop only
+          lowers the cells it leaves, by `erosionCoef` times the drop to the next cell, so those cells stay above it and
+          the walk matches the serial one only while `erosionCoef` is below 1.
+       */
+      do {
+        int next_x = 0, next_y = 0;
+        const float v = GET_VALUE(hm, curx, cury);
+        float slope = -INFINITY;
+        for (int j = 0; j < 8; j++) {
+          const int nx = curx + dx[j];
+          const int ny = cury + dy[j];
+          if (!in_bounds(hm, nx, ny)) continue;
+          const float n_slope = v - GET_VALUE(hm, nx, ny);
+          if (n_slope > slope) {
+            slope = n_slope;
+            next_x = nx;
+            next_y = ny;
+          }
+        }
+        if (slope > 0.0f) {
+          if (!erosion_push(batch, curx + cury * hm->w, -(round->erosionCoef * slope))) {
+            batch->out_of_memory = true;
+            break;
+          }
+          curx = next_x;
+          cury = next_y;
+          sediment += slope;
+        } else {
+          batch->out_of_memory = !erosion_push(batch, curx + cury * hm->w, round->aggregationCoef * sediment);
+          break;
+        }
+      } while (1);
+    }
+    if (batch->out_of_memory) batch->count = 0;
+    TCOD_random_delete(rnd);
+  }
+}
+
+TCOD_Error TCOD_heightmap_rain_erosion_parallel(
+    TCOD_heightmap_t* hm, int nbDrops, float erosionCoef, float aggregationCoef, uint32_t seed) {
+  if (!hm) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  if (nbDrops <= 0 || hm->w <= 0 || hm->h <= 0) return TCOD_E_OK;
+  struct TCOD_ErosionBatch_ batches[TCOD_EROSION_ROUND_BATCHES] = {{0}};
+  struct TCOD_ErosionRound_ round = {hm, 0, nbDrops, erosionCoef, aggregationCoef, seed, batches};
+  const int batch_count = (nbDrops + TCOD_EROSION_BATCH_DROPS - 1) / TCOD_EROSION_BATCH_DROPS;
+  TCOD_Error err = TCOD_E_OK;
+  for (round.first_batch = 0; round.first_batch < batch_count; round.first_batch += TCOD_EROSION_ROUND_BATCHES) {
+    const int round_batches = MIN(TCOD_EROSION_ROUND_BATCHES, batch_count - round.first_batch);
+    TCOD_parallel_for(round_batches, 1, erosion_round_batches, &round);
+    // A failed batch discards the whole round, so the heightmap is left after the last complete round.
+    bool out_of_memory = false;
+    for (int i = 0; i < round_batches; ++i) out_of_memory |= batches[i].out_of_memory;
+    if (out_of_memory) {
+      TCOD_set_errorv("Out of memory.");
+      err = TCOD_E_OUT_OF_MEMORY;
+      break;
+    }
+    // Changes are applied in batch order, so the result does not depend on the number of threads.
+    for (int i = 0; i < round_batches; ++i) {
+      for (int j = 0; j < batches[i].count; ++j) {
+        hm->values[batches[i].events[j].index] += batches[i].events[j].delta;
+      }
+    }
+  }
+  for (int i = 0; i < TCOD_EROSION_ROUND_BATCHES; ++i) free(batches[i].events);
+  return err;
 }
-#endif
 
 void TCOD_heightmap_kernel_transform(
     TCOD_heightmap_t* hm,
@@ -544,45 +944,741 @@ void TCOD_heightmap_kernel_transform(
   }
 }
 
+/* Double-buffered kernel transforms. */
+
+/// The rows processed by one `TCOD_parallel_for` task of a kernel transform.
+#define TCOD_KERNEL_ROW_GRAIN 16
+
+/// The shared parameters of a general double-buffered kernel transform.
+struct TCOD_KernelTransform_ {
+  const float* in;
+  float* out;
+  int w;
+  int h;
+  int kernel_size;
+  const int* dx;
+  const int* dy;
+  const float* weight;
+  float min_level;
+  float max_level;
+  int min_dx, max_dx, min_dy, max_dy;  // The extents of the kernel.
+  float total_weight;  // The sum of every weight, used where the whole kernel is in bounds.
+};
+
+/// The shared parameters of a separable kernel transform, applied as a horizontal then a vertical pass.
+struct TCOD_SeparableTransform_ {
+  const float* in;
+  float* temp;  // The result of the horizontal pass.
+  float* out;
+  int w;
+  int h;
+  int x0, nx;  // The horizontal taps are the offsets `[x0, x0 + nx)`.
+  const float* wx;
+  int y0, ny;  // The vertical taps are the offsets `[y0, y0 + ny)`.
+  const float* wy;
+  float min_level;
+  float max_level;
+};
+
+/// Apply a kernel to one cell, skipping the taps which are out of bounds.
+static TCOD_HEIGHTMAP_INLINE float kernel_cell_checked(const struct TCOD_KernelTransform_* k, int x, int y) {
+  float val = 0.0f;
+  float totalWeight = 0.0f;
+  for (int i = 0; i < k->kernel_size; i++) {
+    const int nx = x + k->dx[i];
+    const int ny = y + k->dy[i];
+    if (nx >= 0 && nx < k->w && ny >= 0 && ny < k->h) {
+      val += k->weight[i] * k->in[nx + ny * k->w];
+      totalWeight += k->weight[i];
+    }
+  }
+  return val / totalWeight;
+}
+
+/// Return the result of a transform at a cell, cells outside of the level range keep their value.
+static TCOD_HEIGHTMAP_INLINE float kernel_level_select(float original, float value, float min_level, float max_level) {
+  return original >= min_level && original <= max_level ? value : original;
+}
+
+/// Transform the rows `[begin, end)` of a general kernel transform.
+static TCOD_HEIGHTMAP_INLINE void kernel_rows(const struct TCOD_KernelTransform_* k, int begin, int end) {
+  const int w = k->w;
+  // Columns `[x_begin, x_end)` of rows where the whole kernel is in bounds need no bounds checks.
+  const int x_begin = MIN(MAX(-k->min_dx, 0), w);
+  const int x_end = MAX(MIN(w - k->max_dx, w), x_begin);
+  for (int y = begin; y < end; ++y) {
+    const float* row_in = &k->in[y * w];
+    float* row_out = &k->out[y * w];
+    const bool interior_row = y + k->min_dy >= 0 && y + k->max_dy < k->h;
+    if (!interior_row) {
+      for (int x = 0; x < w; ++x) {
+        row_out[x] = kernel_level_select(row_in[x], kernel_cell_checked(k, x, y), k->min_level, k->max_level);
+      }
+      continue;
+    }
+    for (int x = 0; x < x_begin; ++x) {
+      row_out[x] = kernel_level_select(row_in[x], kernel_cell_checked(k, x, y), k->min_level, k->max_level);
+    }
+    int x = x_begin;
+#ifdef TCOD_HEIGHTMAP_SIMD
+    for (; x + TCOD_HEIGHTMAP_LANES <= x_end; x += TCOD_HEIGHTMAP_LANES) {
+      hm_vf_t val = hm_vf_splat(0.0f);
+      for (int i = 0; i < k->kernel_size; i++) {
+        val += k->weight[i] * hm_vf_load(&row_in[x + k->dx[i] + k->dy[i] * w]);
+      }
+      const hm_vf_t original = hm_vf_load(&row_in[x]);
+      const hm_vf_t value = val / k->total_weight;
+      HM_VF_STORE(&row_out[x], HM_VF_SELECT((original >= k->min_level) & (original <= k->max_level), value, original));
+    }
+#endif  // TCOD_HEIGHTMAP_SIMD
+    for (; x < x_end; ++x) {
+      float val = 0.0f;
+      for (int i = 0; i < k->kernel_size; i++) val += k->weight[i] * row_in[x + k->dx[i] + k->dy[i] * w];
+      row_out[x] = kernel_level_select(row_in[x], val / k->total_weight, k->min_level, k->max_level);
+    }
+    for (x = x_end; x < w; ++x) {
+      row_out[x] = kernel_level_select(row_in[x], kernel_cell_checked(k, x, y), k->min_level, k->max_level);
+    }
+  }
+}
+
+/// The horizontal pass of a separable transform over the rows `[begin, end)`.
+static TCOD_HEIGHTMAP_INLINE void separable_rows_x(const struct TCOD_SeparableTransform_* s, int begin, int end) {
+  const int w = s->w;
+  const int x_begin = MIN(MAX(-s->x0, 0), w);
+  const int x_end = MAX(MIN(w - (s->x0 + s->nx - 1), w), x_begin);
+  float total = 0.0f;
+  for (int i = 0; i < s->nx; ++i) total += s->wx[i];
+  for (int y = begin; y < end; ++y) {
+    const float* row_in = &s->in[y * w];
+    float* row_out = &s->temp[y * w];
+    int x = 0;
+    for (; x < w; ++x) {
+      if (x == x_begin) {
+        // The interior, where every tap is in bounds.
+#ifdef TCOD_HEIGHTMAP_SIMD
+        for (; x + TCOD_HEIGHTMAP_LANES <= x_end; x += TCOD_HEIGHTMAP_LANES) {
+          hm_vf_t val = hm_vf_splat(0.0f);
+          for (int i = 0; i < s->nx; ++i) val += s->wx[i] * hm_vf_load(&row_in[x + s->x0 + i]);
+          HM_VF_STORE(&row_out[x], val / total);
+        }
+#endif  // TCOD_HEIGHTMAP_SIMD
+        for (; x < x_end; ++x) {
+          float val = 0.0f;
+          for (int i = 0; i < s->nx; ++i) val += s->wx[i] * row_in[x + s->x0 + i];
+          row_out[x] = val / total;
+        }
+        if (x >= w) break;
+      }
+      float val = 0.0f;
+      float border_total = 0.0f;
+      for (int i = 0; i < s->nx; ++i) {
+        const int nx = x + s->x0 + i;
+        if (nx < 0 || nx >= w) continue;
+        val += s->wx[i] * row_in[nx];
+        border_total += s->wx[i];
+      }
+      row_out[x] = val / border_total;
+    }
+  }
+}
+
+/// The vertical pass of a separable transform over the rows `[begin, end)`, which also applies the level range.
+static TCOD_HEIGHTMAP_INLINE void separable_rows_y(const struct TCOD_SeparableTransform_* s, int begin, int end) {
+  const int w = s->w;
+  for (int y = begin; y < end; ++y) {
+    // Every cell of a row has the same vertical taps in bounds.
+    const int first = MAX(0, -(y + s->y0));
+    const int last = MIN(s->ny, s->h - (y + s->y0));
+    float total = 0.0f;
+    for (int j = first; j < last; ++j) total += s->wy[j];
+    const float* row_in = &s->in[y * w];
+    float* row_out = &s->out[y * w];
+    int x = 0;
+#ifdef TCOD_HEIGHTMAP_SIMD
+    for (; x + TCOD_HEIGHTMAP_LANES <= w; x += TCOD_HEIGHTMAP_LANES) {
+      hm_vf_t val = hm_vf_splat(0.0f);
+      for (int j = first; j < last; ++j) val += s->wy[j] * hm_vf_load(&s->temp[(y + s->y0 + j) * w + x]);
+      const hm_vf_t original = hm_vf_load(&row_in[x]);
+      const hm_vf_t value = val / total;
+      HM_VF_STORE(&row_out[x], HM_VF_SELECT((original >= s->min_level) & (original <= s->max_level), value, original));
+    }
+#endif  // TCOD_HEIGHTMAP_SIMD
+    for (; x < w; ++x) {
+      float val = 0.0f;
+      for (int j = first; j < last; ++j) val += s->wy[j] * s->temp[(y + s->y0 + j) * w + x];
+      row_out[x] = kernel_level_select(row_in[x], val / total, s->min_level, s->max_level);
+    }
+  }
+}
+
+/// Define `NAME_parallel`, a `TCOD_ParallelFunc` calling the inlined loop `NAME` compiled for the best target.
+#ifdef TCOD_HEIGHTMAP_SIMD_AVX2
+#define TCOD_HEIGHTMAP_ROWS_(NAME, TYPE)                                                                  \
+  static void NAME##_default(const TYPE* data, int begin, int end) { NAME(data, begin, end); }          \
+  __attribute__((target("avx2"))) static void NAME##_avx2(const TYPE* data, int begin, int end) {       \
+    NAME(data, begin, end);                                                                               \
+  }                                                                                                       \
+  static void NAME##_parallel(void* userdata, int begin, int end) {                                      \
+    if (__builtin_cpu_supports("avx2")) {                                                                 \
+      NAME##_avx2(userdata, begin, end);                                                                  \
+    } else {                                                                                              \
+      NAME##_default(userdata, begin, end);                                                               \
+    }                                                                                                     \
+  }
+#else
+#define TCOD_HEIGHTMAP_ROWS_(NAME, TYPE) \
+  static void NAME##_parallel(void* userdata, int begin, int end) { NAME(userdata, begin, end); }
+#endif  // TCOD_HEIGHTMAP_SIMD_AVX2
+TCOD_HEIGHTMAP_ROWS_(kernel_rows, struct TCOD_KernelTransform_)
+TCOD_HEIGHTMAP_ROWS_(separable_rows_x, struct TCOD_SeparableTransform_)
+TCOD_HEIGHTMAP_ROWS_(separable_rows_y, struct TCOD_SeparableTransform_)
+
+/// Run a separable transform from `in` to `out`, which must not overlap.
+static void heightmap_separable(struct TCOD_SeparableTransform_* s) {
+  s->temp = malloc(sizeof(*s->temp) * s->w * s->h);
+  if (!s->temp) return;
+  TCOD_parallel_for(s->h, TCOD_KERNEL_ROW_GRAIN, separable_rows_x_parallel, s);
+  TCOD_parallel_for(s->h, TCOD_KERNEL_ROW_GRAIN, separable_rows_y_parallel, s);
+  free(s->temp);
+  s->temp = NULL;
+}
+
+/**
+    Split a kernel into horizontal and vertical weights if it is a rectangle of positive weights with a rank of 1.
+
+    `wx` and `wy` must hold `kernel_size` values.  Returns false if the kernel is not separable.
+ */
+static bool kernel_separate(
+    int kernel_size, const int* dx, const int* dy, const float* weight, struct TCOD_SeparableTransform_* s) {
+  int min_dx = dx[0], max_dx = dx[0], min_dy = dy[0], max_dy = dy[0];
+  for (int i = 0; i < kernel_size; ++i) {
+    if (!(weight[i] > 0)) return false;
+    min_dx = MIN(min_dx, dx[i]);
+    max_dx = MAX(max_dx, dx[i]);
+    min_dy = MIN(min_dy, dy[i]);
+    max_dy = MAX(max_dy, dy[i]);
+  }
+  const int nx = max_dx - min_dx + 1;
+  const int ny = max_dy - min_dy + 1;
+  if (nx < 2 || ny < 2 || nx * ny != kernel_size) return false;
+  float* grid = calloc(kernel_size, sizeof(*grid));
+  if (!grid) return false;
+  bool separable = true;
+  for (int i = 0; i < kernel_size && separable; ++i) {
+    float* cell = &grid[(dx[i] - min_dx) + (dy[i] - min_dy) * nx];
+    separable = *cell == 0;  // Each offset must be given once.
+    *cell = weight[i];
+  }
+  // A rank 1 grid is the outer product of its first row and first column.
+  const float corner = grid[0];
+  for (int y = 0; y < ny && separable; ++y) {
+    for (int x = 0; x < nx && separable; ++x) {
+      const float expected = grid[x] * grid[y * nx] / corner;
+      separable = fabsf(grid[x + y * nx] - expected) <= 1e-5f * expected;
+    }
+  }
+  if (separable) {
+    float* wx = (float*)s->wx;
+    float* wy = (float*)s->wy;
+    for (int x = 0; x < nx; ++x) wx[x] = grid[x];
+    for (int y = 0; y < ny; ++y) wy[y] = grid[y * nx] / corner;
+    s->x0 = min_dx;
+    s->nx = nx;
+    s->y0 = min_dy;
+    s->ny = ny;
+  }
+  free(grid);
+  return separable;
+}
+
+void TCOD_heightmap_kernel_transform_out(
+    const TCOD_heightmap_t* hm,
+    TCOD_heightmap_t* hm_out,
+    int kernel_size,
+    const int* dx,
+    const int* dy,
+    const float* weight,
+    float minLevel,
+    float maxLevel) {
+  if (!is_same_size(hm, hm_out) || kernel_size <= 0 || !dx || !dy || !weight) {
+    return;
+  }
+  const int n = hm->w * hm->h;
+  float* in_copy = NULL;
+  const float* in = hm->values;
+  if (hm->values == hm_out->values) {
+    in_copy = malloc(sizeof(*in_copy) * n);
+    if (!in_copy) return;
+    memcpy(in_copy, hm->values, sizeof(*in_copy) * n);
+    in = in_copy;
+  }
+  float* separable_weights = malloc(sizeof(*separable_weights) * kernel_size * 2);
+  struct TCOD_SeparableTransform_ separable = {
+      in, NULL, hm_out->values, hm->w, hm->h, 0, 0, separable_weights, 0, 0, separable_weights + kernel_size,
+      minLevel, maxLevel};
+  if (separable_weights && kernel_separate(kernel_size, dx, dy, weight, &separable)) {
+    heightmap_separable(&separable);
+  } else {
+    struct TCOD_KernelTransform_ k = {
+        in, hm_out->values, hm->w, hm->h, kernel_size, dx, dy, weight, minLevel, maxLevel, dx[0], dx[0], dy[0], dy[0],
+        0.0f};
+    for (int i = 0; i < kernel_size; ++i) {
+      k.min_dx = MIN(k.min_dx, dx[i]);
+      k.max_dx = MAX(k.max_dx, dx[i]);
+      k.min_dy = MIN(k.min_dy, dy[i]);
+      k.max_dy = MAX(k.max_dy, dy[i]);
+      k.total_weight += weight[i];
+    }
+    TCOD_parallel_for(hm->h, TCOD_KERNEL_ROW_GRAIN, kernel_rows_parallel, &k);
+  }
+  free(separable_weights);
+  free(in_copy);
+}
+
+void TCOD_heightmap_separable_transform(
+    const TCOD_heightmap_t* hm,
+    TCOD_heightmap_t* hm_out,
+    int radius,
+    const float* weight,
+    float minLevel,
+    float maxLevel) {
+  if (!is_same_size(hm, hm_out) || radius < 0 || !weight) {
+    return;
+  }
+  float* in_copy = NULL;
+  if (hm->values == hm_out->values) {
+    in_copy = malloc(sizeof(*in_copy) * hm->w * hm->h);
+    if (!in_copy) return;
+    memcpy(in_copy, hm->values, sizeof(*in_copy) * hm->w * hm->h);
+  }
+  struct TCOD_SeparableTransform_ separable = {
+      in_copy ? in_copy : hm->values,
+      NULL,
+      hm_out->values,
+      hm->w,
+      hm->h,
+      -radius,
+      radius * 2 + 1,
+      weight,
+      -radius,
+      radius * 2 + 1,
+      weight,
+      minLevel,
+      maxLevel};
+  heightmap_separable(&separable);
+  free(in_copy);
+}
+
+/* Precomputed slope and normal fields. */
+
+/// The neighbors compared by `TCOD_heightmap_get_slope`, in the same order.
+static const int slope_dx[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+static const int slope_dy[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+
+/// The shared parameters of `TCOD_heightmap_get_slopes` and `TCOD_heightmap_get_normals`.
+struct TCOD_HeightmapField_ {
+  const TCOD_heightmap_t* hm;
+  float* out;
+  float water_level;
+};
+
+/// Compute the slopes of the rows `[begin, end)`, cells away from the border skip the bounds checks.
+static TCOD_HEIGHTMAP_INLINE void slope_rows(const struct TCOD_HeightmapField_* f, int begin, int end) {
+  const TCOD_heightmap_t* hm = f->hm;
+  const int w = hm->w;
+  for (int y = begin; y < end; ++y) {
+    float* row_out = &f->out[y * w];
+    if (y == 0 || y == hm->h - 1 || w < 3) {
+      for (int x = 0; x < w; ++x) row_out[x] = TCOD_heightmap_get_slope(hm, x, y);
+      continue;
+    }
+    const float* row = &hm->values[y * w];
+    row_out[0] = TCOD_heightmap_get_slope(hm, 0, y);
+    int x = 1;
+#ifdef TCOD_HEIGHTMAP_SIMD
+    for (; x + TCOD_HEIGHTMAP_LANES <= w - 1; x += TCOD_HEIGHTMAP_LANES) {
+      const hm_vf_t v = hm_vf_load(&row[x]);
+      hm_vf_t min_dy = hm_vf_splat(0.0f);
+      hm_vf_t max_dy = min_dy;
+      for (int i = 0; i < 8; ++i) {
+        const hm_vf_t n_slope = hm_vf_load(&row[x + slope_dx[i] + slope_dy[i] * w]) - v;
+        min_dy = HM_VF_SELECT(min_dy < n_slope, min_dy, n_slope);
+        max_dy = HM_VF_SELECT(max_dy > n_slope, max_dy, n_slope);
+      }
+      float sums[TCOD_HEIGHTMAP_LANES];
+      HM_VF_STORE(sums, max_dy + min_dy);
+      for (int lane = 0; lane < TCOD_HEIGHTMAP_LANES; ++lane) row_out[x + lane] = (float)atan2(sums[lane], 1.0f);
+    }
+#endif  // TCOD_HEIGHTMAP_SIMD
+    for (; x < w - 1; ++x) {
+      float min_dy = 0.0f, max_dy = 0.0f;
+      for (int i = 0; i < 8; ++i) {
+        const float n_slope = row[x + slope_dx[i] + slope_dy[i] * w] - row[x];
+        min_dy = MIN(min_dy, n_slope);
+        max_dy = MAX(max_dy, n_slope);
+      }
+      row_out[x] = (float)atan2(max_dy + min_dy, 1.0f);
+    }
+    row_out[w - 1] = TCOD_heightmap_get_slope(hm, w - 1, y);
+  }
+}
+
+/// Write the normalized normal of a cell from its height and the heights of its right and bottom neighbors.
+static TCOD_HEIGHTMAP_INLINE void normal_from_heights(float n0, float n1, float* __restrict n) {
+  const float invlen = 1.0f / (float)sqrt(n0 * n0 + n1 * n1 + 16.0f * 16.0f);
+  n[0] = n0 * invlen;
+  n[1] = n1 * invlen;
+  n[2] = 16.0f * invlen;
+}
+
+/**
+    Compute the normals of the rows `[begin, end)`.
+
+    Cells whose right and bottom neighbors are not on the last column or row read the heights directly, the others
+    call `TCOD_heightmap_get_normal` so that the interpolation rounds the same way.
+ */
+static TCOD_HEIGHTMAP_INLINE void normal_rows(const struct TCOD_HeightmapField_* f, int begin, int end) {
+  const TCOD_heightmap_t* hm = f->hm;
+  const int w = hm->w;
+  const float water_level = f->water_level;
+  for (int y = begin; y < end; ++y) {
+    const float* row = &hm->values[y * w];
+    float* row_out = &f->out[y * w * 3];
+    const int x_direct = y < hm->h - 2 ? MAX(w - 2, 0) : 0;
+    int x = 0;
+#ifdef TCOD_HEIGHTMAP_SIMD
+    const hm_vf_t water = hm_vf_splat(water_level);
+    for (; x + TCOD_HEIGHTMAP_LANES <= x_direct; x += TCOD_HEIGHTMAP_LANES) {
+      hm_vf_t h0 = hm_vf_load(&row[x]);
+      hm_vf_t hx = hm_vf_load(&row[x + 1]);
+      hm_vf_t hy = hm_vf_load(&row[x + w]);
+      h0 = HM_VF_SELECT(h0 < water, water, h0);
+      hx = HM_VF_SELECT(hx < water, water, hx);
+      hy = HM_VF_SELECT(hy < water, water, hy);
+      float n0[TCOD_HEIGHTMAP_LANES];
+      float n1[TCOD_HEIGHTMAP_LANES];
+      HM_VF_STORE(n0, 255 * (h0 - hx));
+      HM_VF_STORE(n1, 255 * (h0 - hy));
+      for (int lane = 0; lane < TCOD_HEIGHTMAP_LANES; ++lane) {
+        normal_from_heights(n0[lane], n1[lane], &row_out[(x + lane) * 3]);
+      }
+    }
+#endif  // TCOD_HEIGHTMAP_SIMD
+    for (; x < x_direct; ++x) {
+      const float h0 = row[x] < water_level ? water_level : row[x];
+      const float hx = row[x + 1] < water_level ? water_level : row[x + 1];
+      const float hy = row[x + w] < water_level ? water_level : row[x + w];
+      normal_from_heights(255 * (h0 - hx), 255 * (h0 - hy), &row_out[x * 3]);
+    }
+    for (; x < w; ++x) TCOD_heightmap_get_normal(hm, (float)x, (float)y, &row_out[x * 3], water_level);
+  }
+}
+TCOD_HEIGHTMAP_ROWS_(slope_rows, struct TCOD_HeightmapField_)
+TCOD_HEIGHTMAP_ROWS_(normal_rows, struct TCOD_HeightmapField_)
+
+/* Thermal erosion. */
+
+/**
+    The shared state of a thermal erosion pass.
+
+    Each pass first finds where every cell sheds material from the unchanged heights, then every cell gathers the
+    material sent to it.  Cells only write to themselves in both steps so rows can be processed in any order.
+ */
+struct TCOD_ThermalErosion_ {
+  float* values;
+  float* amount;  // How far the slope of each cell exceeds the minimum slope, or zero.
+  int8_t* target;  // The index of the neighbor receiving material from each cell, or -1.
+  int w;
+  int h;
+  float min_slope;
+  float erosion_coef;
+  float aggregation_coef;
+};
+
+/// Find the steepest downhill neighbor of a cell near the border.
+static TCOD_HEIGHTMAP_INLINE void thermal_shed_checked(const struct TCOD_ThermalErosion_* t, int x, int y) {
+  const float v = t->values[x + y * t->w];
+  float slope = 0.0f;
+  int target = -1;
+  for (int i = 0; i < 8; ++i) {
+    const int nx = x + slope_dx[i];
+    const int ny = y + slope_dy[i];
+    if (nx < 0 || nx >= t->w || ny < 0 || ny >= t->h) continue;
+    const float n_slope = v - t->values[nx + ny * t->w];
+    if (n_slope > slope) {
+      slope = n_slope;
+      target = i;
+    }
+  }
+  const bool erodes = target >= 0 && slope > t->min_slope;
+  t->amount[x + y * t->w] = erodes ? slope - t->min_slope : 0.0f;
+  t->target[x + y * t->w] = (int8_t)(erodes ? target : -1);
+}
+
+/// Find the steepest downhill neighbor of every cell in the rows `[begin, end)`.
+static TCOD_HEIGHTMAP_INLINE void thermal_shed_rows(const struct TCOD_ThermalErosion_* t, int begin, int end) {
+  const int w = t->w;
+  for (int y = begin; y < end; ++y) {
+    if (y == 0 || y == t->h - 1 || w < 3) {
+      for (int x = 0; x < w; ++x) thermal_shed_checked(t, x, y);
+      continue;
+    }
+    const float* row = &t->values[y * w];
+    thermal_shed_checked(t, 0, y);
+    int x = 1;
+#ifdef TCOD_HEIGHTMAP_SIMD
+    const hm_vf_t min_slope = hm_vf_splat(t->min_slope);
+    for (; x + TCOD_HEIGHTMAP_LANES <= w - 1; x += TCOD_HEIGHTMAP_LANES) {
+      const hm_vf_t v = hm_vf_load(&row[x]);
+      hm_vf_t slope = hm_vf_splat(0.0f);
+      hm_vi_t target = (hm_vi_t){0} - 1;
+      for (int i = 0; i < 8; ++i) {
+        const hm_vf_t n_slope = v - hm_vf_load(&row[x + slope_dx[i] + slope_dy[i] * w]);
+        const hm_vi_t steeper = n_slope > slope;
+        slope = HM_VF_SELECT(steeper, n_slope, slope);
+        target = (steeper & i) | (~steeper & target);
+      }
+      const hm_vi_t erodes = (target >= 0) & (slope > min_slope);
+      HM_VF_STORE(&t->amount[x + y * w], HM_VF_SELECT(erodes, slope - min_slope, hm_vf_splat(0.0f)));
+      const hm_vi8_t target_out = __builtin_convertvector(target | ~erodes, hm_vi8_t);
+      memcpy(&t->target[x + y * w], &target_out, sizeof(target_out));
+    }
+#endif  // TCOD_HEIGHTMAP_SIMD
+    for (; x < w - 1; ++x) thermal_shed_checked(t, x, y);
+    thermal_shed_checked(t, w - 1, y);
+  }
+}
+
+/// Return the material a cell receives from its neighbors, each neighbor is added in order.
+static TCOD_HEIGHTMAP_INLINE float thermal_gather_checked(const struct TCOD_ThermalErosion_* t, int x, int y) {
+  float received = 0.0f;
+  for (int i = 0; i < 8; ++i) {
+    const int nx = x + slope_dx[i];
+    const int ny = y + slope_dy[i];
+    if (nx < 0 || nx >= t->w || ny < 0 || ny >= t->h) continue;
+    // Neighbor `i` points back at this cell with the opposite offset, `7 - i`.
+    if (t->target[nx + ny * t->w] == 7 - i) received += t->amount[nx + ny * t->w];
+  }
+  return received;
+}
+
+/// Apply the material shed and received by every cell in the rows `[begin, end)`.
+static TCOD_HEIGHTMAP_INLINE void thermal_gather_rows(const struct TCOD_ThermalErosion_* t, int begin, int end) {
+  const int w = t->w;
+  for (int y = begin; y < end; ++y) {
+    float* row = &t->values[y * w];
+    const float* amount = &t->amount[y * w];
+    const bool interior_row = y > 0 && y < t->h - 1 && w >= 3;
+    int x = 0;
+    if (interior_row) {
+      row[0] = row[0] - t->erosion_coef * amount[0] + t->aggregation_coef * thermal_gather_checked(t, 0, y);
+      x = 1;
+#ifdef TCOD_HEIGHTMAP_SIMD
+      for (; x + TCOD_HEIGHTMAP_LANES <= w - 1; x += TCOD_HEIGHTMAP_LANES) {
+        hm_vf_t received = hm_vf_splat(0.0f);
+        for (int i = 0; i < 8; ++i) {
+          const int offset = x + y * w + slope_dx[i] + slope_dy[i] * w;
+          hm_vi8_t targets;
+          memcpy(&targets, &t->target[offset], sizeof(targets));
+          const hm_vi_t target = __builtin_convertvector(targets, hm_vi_t);
+          received += HM_VF_SELECT(target == 7 - i, hm_vf_load(&t->amount[offset]), hm_vf_splat(0.0f));
+        }
+        const hm_vf_t v = hm_vf_load(&row[x]);
+        HM_VF_STORE(&row[x], v - t->erosion_coef * hm_vf_load(&amount[x]) + t->aggregation_coef * received);
+      }
+#endif  // TCOD_HEIGHTMAP_SIMD
+      for (; x < w - 1; ++x) {
+        row[x] = row[x] - t->erosion_coef * amount[x] + t->aggregation_coef * thermal_gather_checked(t, x, y);
+      }
+    }
+    for (; x < w; ++x) {
+      row[x] = row[x] - t->erosion_coef * amount[x] + t->aggregation_coef * thermal_gather_checked(t, x, y);
+    }
+  }
+}
+TCOD_HEIGHTMAP_ROWS_(thermal_shed_rows, struct TCOD_ThermalErosion_)
+TCOD_HEIGHTMAP_ROWS_(thermal_gather_rows, struct TCOD_ThermalErosion_)
+#undef TCOD_HEIGHTMAP_ROWS_
+
+void TCOD_heightmap_get_slopes(const TCOD_heightmap_t* hm, TCOD_heightmap_t* hm_out) {
+  if (!is_same_size(hm, hm_out) || hm->values == hm_out->values) {
+    return;
+  }
+  struct TCOD_HeightmapField_ field = {.hm = hm, .out = hm_out->values};
+  TCOD_parallel_for(hm->h, TCOD_KERNEL_ROW_GRAIN, slope_rows_parallel, &field);
+}
+
+void TCOD_heightmap_get_normals(const TCOD_heightmap_t* hm, float* normals, float waterLevel) {
+  if (!hm || !normals) {
+    return;
+  }
+  struct TCOD_HeightmapField_ field = {.hm = hm, .out = normals, .water_level = waterLevel};
+  TCOD_parallel_for(hm->h, TCOD_KERNEL_ROW_GRAIN, normal_rows_parallel, &field);
+}
+
+void TCOD_heightmap_get_interpolated_normal(int w, int h, const float* normals, float x, float y, float n[3]) {
+  n[0] = 0.0f;
+  n[1] = 0.0f;
+  n[2] = 1.0f;
+  if (!normals || w < 2 || h < 2) {
+    return;
+  }
+  x = CLAMP(0.0f, w - 1, x);
+  y = CLAMP(0.0f, h - 1, y);
+  float fix;
+  float fiy;
+  float fx = modff(x, &fix);
+  float fy = modff(y, &fiy);
+  int ix = (int)fix;
+  int iy = (int)fiy;
+  if (ix >= w - 1) {
+    ix = w - 2;
+    fx = 1.0f;
+  }
+  if (iy >= h - 1) {
+    iy = h - 2;
+    fy = 1.0f;
+  }
+  const float* c1 = &normals[(ix + iy * w) * 3];
+  const float* c2 = c1 + 3;
+  const float* c3 = c1 + w * 3;
+  const float* c4 = c3 + 3;
+  float length_sq = 0.0f;
+  for (int i = 0; i < 3; ++i) {
+    const float top = LERP(c1[i], c2[i], fx);
+    const float bottom = LERP(c3[i], c4[i], fx);
+    n[i] = LERP(top, bottom, fy);
+    length_sq += n[i] * n[i];
+  }
+  if (fx == 0.0f && fy == 0.0f) return;  // Cell normals are already normalized.
+  if (length_sq > 0.0f) {
+    const float invlen = 1.0f / sqrtf(length_sq);
+    for (int i = 0; i < 3; ++i) n[i] *= invlen;
+  }
+}
+
+void TCOD_heightmap_thermal_erosion(
+    TCOD_heightmap_t* hm, int nbPass, float minSlope, float erosionCoef, float aggregationCoef) {
+  if (!hm || nbPass <= 0) {
+    return;
+  }
+  const int n = hm->w * hm->h;
+  struct TCOD_ThermalErosion_ thermal = {
+      .values = hm->values,
+      .amount = malloc(sizeof(*thermal.amount) * n),
+      .target = malloc(sizeof(*thermal.target) * n),
+      .w = hm->w,
+      .h = hm->h,
+      .min_slope = minSlope,
+      .erosion_coef = erosionCoef,
+      .aggregation_coef = aggregationCoef,
+  };
+  if (thermal.amount && thermal.target) {
+    while (nbPass-- > 0) {
+      TCOD_parallel_for(hm->h, TCOD_KERNEL_ROW_GRAIN, thermal_shed_rows_parallel, &thermal);
+      TCOD_parallel_for(hm->h, TCOD_KERNEL_ROW_GRAIN, thermal_gather_rows_parallel, &thermal);
+    }
+  }
+  free(thermal.target);
+  free(thermal.amount);
+}
+
+/// A Voronoi point along with its squared distance to the current cell.
+struct TCOD_VoronoiCandidate_ {
+  float dist;
+  int index;
+};
+
+/// Insert a point into `best`, kept sorted by distance then by index, holding at most `capacity` points.
+static void voronoi_insert(struct TCOD_VoronoiCandidate_* best, int* count, int capacity, float dist, int index) {
+  if (*count == capacity) {
+    const struct TCOD_VoronoiCandidate_* last = &best[capacity - 1];
+    if (dist > last->dist || (dist == last->dist && index > last->index)) return;
+  } else {
+    ++*count;
+  }
+  int i = *count - 1;
+  for (; i > 0 && (best[i - 1].dist > dist || (best[i - 1].dist == dist && best[i - 1].index > index)); --i) {
+    best[i] = best[i - 1];
+  }
+  best[i].dist = dist;
+  best[i].index = index;
+}
+
 void TCOD_heightmap_add_voronoi(TCOD_heightmap_t* hm, int nbPoints, int nbCoef, const float* coef, TCOD_Random* rnd) {
   if (!hm) {
     return;
   }
   typedef struct {
     int x, y;
-    float dist;
   } point_t;
   if (nbPoints <= 0) return;
+  nbCoef = MAX(MIN(nbCoef, nbPoints), 0);
   point_t* pt = malloc(sizeof(point_t) * nbPoints);
-  nbCoef = MIN(nbCoef, nbPoints);
+  if (!pt) return;
   for (int i = 0; i < nbPoints; i++) {
     pt[i].x = TCOD_random_get_int(rnd, 0, hm->w - 1);
     pt[i].y = TCOD_random_get_int(rnd, 0, hm->h - 1);
   }
-  for (int y = 0; y < hm->h; y++) {
+  /* bucket the points into a grid of square cells, with about one point per cell */
+  const int cell_size = MAX(1, (int)sqrtf((float)hm->w * hm->h / nbPoints));
+  const int grid_w = (hm->w + cell_size - 1) / cell_size;
+  const int grid_h = (hm->h + cell_size - 1) / cell_size;
+  int* cell_start = calloc(grid_w * grid_h + 1, sizeof(*cell_start));
+  int* cell_points = malloc(sizeof(*cell_points) * nbPoints);
+  struct TCOD_VoronoiCandidate_* best = malloc(sizeof(*best) * MAX(nbCoef, 1));
+  if (!cell_start || !cell_points || !best) {
+    free(best);
+    free(cell_points);
+    free(cell_start);
+    free(pt);
+    return;
+  }
+  for (int i = 0; i < nbPoints; i++) ++cell_start[pt[i].x / cell_size + pt[i].y / cell_size * grid_w + 1];
+  for (int i = 0; i < grid_w * grid_h; i++) cell_start[i + 1] += cell_start[i];
+  for (int i = 0; i < nbPoints; i++) {
+    /* points are bucketed in order, so each cell lists its points by increasing index */
+    const int cell = pt[i].x / cell_size + pt[i].y / cell_size * grid_w;
+    cell_points[cell_start[cell]++] = i;
+  }
+  for (int i = grid_w * grid_h; i > 0; i--) cell_start[i] = cell_start[i - 1];
+  cell_start[0] = 0;
+  for (int y = 0; y < hm->h && nbCoef > 0; y++) {
+    const int cy = y / cell_size;
     for (int x = 0; x < hm->w; x++) {
-      /* calculate distance to voronoi points */
-      for (int i = 0; i < nbPoints; i++) {
-        const int dx = pt[i].x - x;
-        const int dy = pt[i].y - y;
-        pt[i].dist = (float)(dx * dx + dy * dy);
-      }
-      for (int i = 0; i < nbCoef; i++) {
-        /* get closest point */
-        float minDist = 1E8f;
-        int idx = -1;
-        for (int j = 0; j < nbPoints; j++) {
-          if (pt[j].dist < minDist) {
-            idx = j;
-            minDist = pt[j].dist;
+      const int cx = x / cell_size;
+      /* search rings of cells around this one until no unvisited point can be closer than the found points */
+      int count = 0;
+      for (int ring = 0; ring <= MAX(grid_w, grid_h); ring++) {
+        const float bound = (float)(ring - 1) * cell_size + 1;
+        if (ring > 0 && (bound * bound >= 1E8f || (count == nbCoef && best[count - 1].dist < bound * bound))) break;
+        for (int gy = MAX(cy - ring, 0); gy <= MIN(cy + ring, grid_h - 1); gy++) {
+          const bool edge_row = gy == cy - ring || gy == cy + ring;
+          for (int gx = MAX(cx - ring, 0); gx <= MIN(cx + ring, grid_w - 1); gx++) {
+            if (!edge_row && gx != cx - ring && gx != cx + ring) {
+              gx = MAX(gx, cx + ring - 1); /* skip the cells of inner rings */
+              continue;
+            }
+            const int cell = gx + gy * grid_w;
+            for (int j = cell_start[cell]; j < cell_start[cell + 1]; j++) {
+              const int idx = cell_points[j];
+              const int dx = pt[idx].x - x;
+              const int dy = pt[idx].y - y;
+              const float dist = (float)(dx * dx + dy * dy);
+              if (dist < 1E8f) voronoi_insert(best, &count, nbCoef, dist, idx);
+            }
           }
         }
-        if (idx == -1) break;
-        GET_VALUE(hm, x, y) += coef[i] * pt[idx].dist;
-        pt[idx].dist = 1E8f;
+      }
+      for (int i = 0; i < count; i++) {
+        GET_VALUE(hm, x, y) += coef[i] * best[i].dist;
       }
     }
   }
+  free(best);
+  free(cell_points);
+  free(cell_start);
   free(pt);
 }
 
@@ -636,6 +1732,460 @@ void TCOD_heightmap_mid_point_displacement(TCOD_heightmap_t* hm, TCOD_Random* rn
   }
 }
 
+/* Fused heightmap pipelines. */
+
+/// The kinds of steps recorded by a `TCOD_HeightmapPipeline`.
+typedef enum TCOD_HeightmapStepType_ {
+  TCOD_HM_STEP_MAP,  // An element-wise `TCOD_HeightmapOp_` with `params` and an optional `other` heightmap.
+  TCOD_HM_STEP_NORMALIZE,  // Normalize to `[params[0], params[1]]`, this must start a fused pass.
+  TCOD_HM_STEP_ADD_HILL,  // params = {hx, hy, h_radius, h_height}
+  TCOD_HM_STEP_DIG_HILL,  // params = {hx, hy, h_radius, h_height}
+  TCOD_HM_STEP_ADD_FBM,  // params = {mul_x, mul_y, add_x, add_y, octaves, delta, scale}
+  TCOD_HM_STEP_SCALE_FBM,  // params = {mul_x, mul_y, add_x, add_y, octaves, delta, scale}
+  TCOD_HM_STEP_KERNEL,  // A kernel transform, ends a fused pass.
+  TCOD_HM_STEP_CALL,  // A user function, ends a fused pass.
+} TCOD_HeightmapStepType_;
+
+/// A recorded pipeline step.
+struct TCOD_HeightmapStep_ {
+  TCOD_HeightmapStepType_ type;
+  TCOD_HeightmapOp_ op;
+  float params[8];
+  const TCOD_heightmap_t* other;
+  TCOD_Noise* noise;
+  int kernel_size;
+  int* kernel;  // The kernel dx and dy arrays followed by its weights, in one allocation.
+  TCOD_HeightmapPipelineFunc func;
+  void* userdata;
+};
+
+struct TCOD_HeightmapPipeline {
+  int count;
+  int capacity;
+  struct TCOD_HeightmapStep_* steps;
+};
+
+/// A fused pass over every row of a heightmap.
+struct TCOD_HeightmapPass_ {
+  TCOD_heightmap_t* hm;
+  const struct TCOD_HeightmapStep_* steps;
+  int count;
+  bool normalize_fill;  // If true the first step fills the heightmap with `normalize[0]`.
+  float normalize[4];  // The `TCOD_HM_OP_NORMALIZE` parameters of a leading normalize step.
+  float* row_min;  // If not NULL, the smallest result of each row is written here.
+  float* row_max;  // If not NULL, the largest result of each row is written here.
+  int origin_x;  // The world position of the heightmap, used by steps with coordinates such as hills and noise.
+  int origin_y;
+};
+
+/// Return true if a step must run on the whole heightmap instead of being fused with its neighbors.
+static bool pipeline_step_is_barrier(const struct TCOD_HeightmapStep_* step) {
+  switch (step->type) {
+    case TCOD_HM_STEP_KERNEL:
+    case TCOD_HM_STEP_CALL:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/// Run a barrier step on the whole heightmap.
+static void pipeline_run_barrier(const struct TCOD_HeightmapStep_* step, TCOD_heightmap_t* hm) {
+  const float* p = step->params;
+  switch (step->type) {
+    case TCOD_HM_STEP_KERNEL: {
+      const int* dx = step->kernel;
+      const int* dy = dx + step->kernel_size;
+      const float* weight = (const float*)(dy + step->kernel_size);
+      TCOD_heightmap_kernel_transform(hm, step->kernel_size, dx, dy, weight, p[0], p[1]);
+    } break;
+    case TCOD_HM_STEP_CALL:
+      step->func(hm, step->userdata);
+      break;
+    default:
+      break;
+  }
+}
+
+/// Apply a hill step to row `y`, with the same arithmetic as `TCOD_heightmap_add_hill` and `TCOD_heightmap_dig_hill`.
+static void pipeline_row_hill(
+    const struct TCOD_HeightmapStep_* step, const struct TCOD_HeightmapPass_* pass, int y, float* row) {
+  const TCOD_heightmap_t* hm = pass->hm;
+  const float hx = step->params[0];
+  const float hy = step->params[1];
+  const float h_radius = step->params[2];
+  const float h_height = step->params[3];
+  // Bounds are in world coordinates, where the heightmap starts at `origin_x, origin_y`.
+  const int world_y = y + pass->origin_y;
+  const int miny = MAX((int)floorf(hy - h_radius), pass->origin_y);
+  const int maxy = (int)MIN(ceilf(hy + h_radius), pass->origin_y + hm->h);
+  if (world_y < miny || world_y >= maxy) return;
+  const float h_radius2 = h_radius * h_radius;
+  const float coef = h_height / h_radius2;
+  const int minx = MAX((int)floorf(hx - h_radius), pass->origin_x);
+  const int maxx = (int)MIN(ceilf(hx + h_radius), pass->origin_x + hm->w);
+  row -= pass->origin_x;
+  if (step->type == TCOD_HM_STEP_ADD_HILL) {
+    const float y_dist = (world_y - hy) * (world_y - hy);
+    for (int x = minx; x < maxx; x++) {
+      const float x_dist = (x - hx) * (x - hx);
+      const float z = h_radius2 - x_dist - y_dist;
+      if (z > 0) row[x] += z * coef;
+    }
+    return;
+  }
+  for (int x = minx; x < maxx; x++) {
+    const float x_dist = (x - hx) * (x - hx);
+    const float y_dist = (world_y - hy) * (world_y - hy);
+    const float dist = x_dist + y_dist;
+    if (dist < h_radius2) {
+      const float z = (h_radius2 - dist) * coef;
+      if (h_height > 0) {
+        if (row[x] < z) row[x] = z;
+      } else {
+        if (row[x] > z) row[x] = z;
+      }
+    }
+  }
+}
+
+/// Apply an fBm step to row `y`, sampling the same points as `heightmap_fbm_grid` does for the whole heightmap.
+static void pipeline_row_fbm(
+    const struct TCOD_HeightmapStep_* step,
+    const struct TCOD_HeightmapPass_* pass,
+    int y,
+    float* row,
+    float* noise_row) {
+  const TCOD_heightmap_t* hm = pass->hm;
+  const float* p = step->params;
+  const float x_coefficient = p[0] / hm->w;
+  const float y_coefficient = p[1] / hm->h;
+  const int world_y = y + pass->origin_y;
+  // A 1D fill of a 2D noise samples the second axis at `offset[1] * scale[1]`.
+  const float offset[2] = {p[2] + pass->origin_x, world_y + p[3]};
+  const float scale[2] = {x_coefficient, y_coefficient};
+  // Grids are only filled from 2D noise, other noise is sampled one point at a time with the same world coordinates.
+  if (!step->noise || step->noise->ndim != 2 || !noise_row ||
+      TCOD_noise_fill_grid(
+          step->noise, TCOD_NOISE_DEFAULT, TCOD_NOISE_MODE_FBM, p[4], 1, &hm->w, NULL, offset, scale, noise_row) < 0) {
+    for (int x = 0; x < hm->w; x++) {
+      float f[TCOD_NOISE_MAX_DIMENSIONS] = {
+          (x + pass->origin_x + p[2]) * x_coefficient, (world_y + p[3]) * y_coefficient};
+      const float value = p[5] + TCOD_noise_get_fbm(step->noise, f, p[4]) * p[6];
+      if (step->type == TCOD_HM_STEP_ADD_FBM) {
+        row[x] += value;
+      } else {
+        row[x] *= value;
+      }
+    }
+    return;
+  }
+  if (step->type == TCOD_HM_STEP_ADD_FBM) {
+    for (int x = 0; x < hm->w; ++x) row[x] += p[5] + noise_row[x] * p[6];
+  } else {
+    for (int x = 0; x < hm->w; ++x) row[x] *= p[5] + noise_row[x] * p[6];
+  }
+}
+
+/// Run the rows `[begin, end)` through every step of a fused pass.
+static void pipeline_pass_rows(void* userdata, int begin, int end) {
+  const struct TCOD_HeightmapPass_* pass = userdata;
+  TCOD_heightmap_t* hm = pass->hm;
+  float* noise_row = malloc(sizeof(*noise_row) * hm->w);  // If NULL then noise is sampled one point at a time.
+  for (int y = begin; y < end; ++y) {
+    float* row = &hm->values[y * hm->w];
+    for (int i = 0; i < pass->count; ++i) {
+      const struct TCOD_HeightmapStep_* step = &pass->steps[i];
+      switch (step->type) {
+        case TCOD_HM_STEP_MAP:
+          heightmap_map_best(
+              step->op, hm->w, row, step->other ? &step->other->values[y * hm->w] : NULL, row, step->params);
+          break;
+        case TCOD_HM_STEP_NORMALIZE:
+          if (pass->normalize_fill) {
+            for (int x = 0; x < hm->w; ++x) row[x] = pass->normalize[0];
+          } else {
+            heightmap_map_best(TCOD_HM_OP_NORMALIZE, hm->w, row, NULL, row, pass->normalize);
+          }
+          break;
+        case TCOD_HM_STEP_ADD_HILL:
+        case TCOD_HM_STEP_DIG_HILL:
+          pipeline_row_hill(step, pass, y, row);
+          break;
+        case TCOD_HM_STEP_ADD_FBM:
+        case TCOD_HM_STEP_SCALE_FBM:
+          pipeline_row_fbm(step, pass, y, row, noise_row);
+          break;
+        default:
+          break;
+      }
+    }
+    if (pass->row_min) heightmap_minmax_best(hm->w, row, &pass->row_min[y], &pass->row_max[y]);
+  }
+  free(noise_row);
+}
+
+TCOD_HeightmapPipeline* TCOD_heightmap_pipeline_new(void) {
+  TCOD_HeightmapPipeline* pipeline = calloc(1, sizeof(*pipeline));
+  if (!pipeline) TCOD_set_errorv("Out of memory.");
+  return pipeline;
+}
+
+void TCOD_heightmap_pipeline_delete(TCOD_HeightmapPipeline* pipeline) {
+  if (!pipeline) return;
+  for (int i = 0; i < pipeline->count; ++i) free(pipeline->steps[i].kernel);
+  free(pipeline->steps);
+  free(pipeline);
+}
+
+/// Append `step` to a pipeline.  Ownership of `step.kernel` is taken even on failure.
+static TCOD_Error pipeline_push(TCOD_HeightmapPipeline* pipeline, struct TCOD_HeightmapStep_ step) {
+  if (!pipeline) {
+    free(step.kernel);
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  if (pipeline->count == pipeline->capacity) {
+    const int new_capacity = pipeline->capacity ? pipeline->capacity * 2 : 16;
+    struct TCOD_HeightmapStep_* new_steps = realloc(pipeline->steps, sizeof(*new_steps) * new_capacity);
+    if (!new_steps) {
+      free(step.kernel);
+      TCOD_set_errorv("Out of memory.");
+      return TCOD_E_OUT_OF_MEMORY;
+    }
+    pipeline->steps = new_steps;
+    pipeline->capacity = new_capacity;
+  }
+  pipeline->steps[pipeline->count++] = step;
+  return TCOD_E_OK;
+}
+
+/// Append an element-wise operation to a pipeline.
+static TCOD_Error pipeline_push_map(
+    TCOD_HeightmapPipeline* pipeline, TCOD_HeightmapOp_ op, const TCOD_heightmap_t* other, const float p[4]) {
+  struct TCOD_HeightmapStep_ step = {
+      .type = TCOD_HM_STEP_MAP, .op = op, .params = {p[0], p[1], p[2], p[3]}, .other = other};
+  return pipeline_push(pipeline, step);
+}
+
+TCOD_Error TCOD_heightmap_pipeline_add(TCOD_HeightmapPipeline* pipeline, float value) {
+  const float params[4] = {value, 0, 0, 0};
+  return pipeline_push_map(pipeline, TCOD_HM_OP_ADD, NULL, params);
+}
+
+TCOD_Error TCOD_heightmap_pipeline_scale(TCOD_HeightmapPipeline* pipeline, float value) {
+  const float params[4] = {value, 0, 0, 0};
+  return pipeline_push_map(pipeline, TCOD_HM_OP_SCALE, NULL, params);
+}
+
+TCOD_Error TCOD_heightmap_pipeline_clamp(TCOD_HeightmapPipeline* pipeline, float min, float max) {
+  const float params[4] = {min, max, 0, 0};
+  return pipeline_push_map(pipeline, TCOD_HM_OP_CLAMP, NULL, params);
+}
+
+TCOD_Error TCOD_heightmap_pipeline_scale_add_clamp(
+    TCOD_HeightmapPipeline* pipeline, float scale, float add, float min, float max) {
+  const float params[4] = {scale, add, min, max};
+  return pipeline_push_map(pipeline, TCOD_HM_OP_SCALE_ADD_CLAMP, NULL, params);
+}
+
+TCOD_Error TCOD_heightmap_pipeline_normalize(TCOD_HeightmapPipeline* pipeline, float min, float max) {
+  struct TCOD_HeightmapStep_ step = {.type = TCOD_HM_STEP_NORMALIZE, .params = {min, max}};
+  return pipeline_push(pipeline, step);
+}
+
+/// Append an element-wise operation between the processed heightmap and `other`.
+static TCOD_Error pipeline_push_map_hm(
+    TCOD_HeightmapPipeline* pipeline, TCOD_HeightmapOp_ op, const TCOD_heightmap_t* other, float coef) {
+  if (!other) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  const float params[4] = {coef, 0, 0, 0};
+  return pipeline_push_map(pipeline, op, other, params);
+}
+
+TCOD_Error TCOD_heightmap_pipeline_lerp_hm(
+    TCOD_HeightmapPipeline* pipeline, const TCOD_heightmap_t* other, float coef) {
+  return pipeline_push_map_hm(pipeline, TCOD_HM_OP_LERP_HM, other, coef);
+}
+
+TCOD_Error TCOD_heightmap_pipeline_add_hm(TCOD_HeightmapPipeline* pipeline, const TCOD_heightmap_t* other) {
+  return pipeline_push_map_hm(pipeline, TCOD_HM_OP_ADD_HM, other, 0);
+}
+
+TCOD_Error TCOD_heightmap_pipeline_multiply_hm(TCOD_HeightmapPipeline* pipeline, const TCOD_heightmap_t* other) {
+  return pipeline_push_map_hm(pipeline, TCOD_HM_OP_MULTIPLY_HM, other, 0);
+}
+
+TCOD_Error TCOD_heightmap_pipeline_add_hill(
+    TCOD_HeightmapPipeline* pipeline, float hx, float hy, float h_radius, float h_height) {
+  struct TCOD_HeightmapStep_ step = {.type = TCOD_HM_STEP_ADD_HILL, .params = {hx, hy, h_radius, h_height}};
+  return pipeline_push(pipeline, step);
+}
+
+TCOD_Error TCOD_heightmap_pipeline_dig_hill(
+    TCOD_HeightmapPipeline* pipeline, float hx, float hy, float h_radius, float h_height) {
+  struct TCOD_HeightmapStep_ step = {.type = TCOD_HM_STEP_DIG_HILL, .params = {hx, hy, h_radius, h_height}};
+  return pipeline_push(pipeline, step);
+}
+
+TCOD_Error TCOD_heightmap_pipeline_add_fbm(
+    TCOD_HeightmapPipeline* pipeline,
+    TCOD_noise_t noise,
+    float mul_x,
+    float mul_y,
+    float add_x,
+    float add_y,
+    float octaves,
+    float delta,
+    float scale) {
+  struct TCOD_HeightmapStep_ step = {
+      .type = TCOD_HM_STEP_ADD_FBM, .params = {mul_x, mul_y, add_x, add_y, octaves, delta, scale}, .noise = noise};
+  return pipeline_push(pipeline, step);
+}
+
+TCOD_Error TCOD_heightmap_pipeline_scale_fbm(
+    TCOD_HeightmapPipeline* pipeline,
+    TCOD_noise_t noise,
+    float mul_x,
+    float mul_y,
+    float add_x,
+    float add_y,
+    float octaves,
+    float delta,
+    float scale) {
+  struct TCOD_HeightmapStep_ step = {
+      .type = TCOD_HM_STEP_SCALE_FBM, .params = {mul_x, mul_y, add_x, add_y, octaves, delta, scale}, .noise = noise};
+  return pipeline_push(pipeline, step);
+}
+
+TCOD_Error TCOD_heightmap_pipeline_kernel_transform(
+    TCOD_HeightmapPipeline* pipeline,
+    int kernel_size,
+    const int* dx,
+    const int* dy,
+    const float* weight,
+    float minLevel,
+    float maxLevel) {
+  if (kernel_size < 0) {
+    TCOD_set_errorvf("kernel_size must not be negative, got %i.", kernel_size);
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  if (kernel_size && (!dx || !dy || !weight)) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  int* kernel = malloc(sizeof(*kernel) * kernel_size * 2 + sizeof(*weight) * kernel_size + 1);
+  if (!kernel) {
+    TCOD_set_errorv("Out of memory.");
+    return TCOD_E_OUT_OF_MEMORY;
+  }
+  if (kernel_size) {
+    memcpy(kernel, dx, sizeof(*kernel) * kernel_size);
+    memcpy(kernel + kernel_size, dy, sizeof(*kernel) * kernel_size);
+    memcpy(kernel + kernel_size * 2, weight, sizeof(*weight) * kernel_size);
+  }
+  struct TCOD_HeightmapStep_ step = {
+      .type = TCOD_HM_STEP_KERNEL, .params = {minLevel, maxLevel}, .kernel_size = kernel_size, .kernel = kernel};
+  return pipeline_push(pipeline, step);
+}
+
+TCOD_Error TCOD_heightmap_pipeline_call(
+    TCOD_HeightmapPipeline* pipeline, TCOD_HeightmapPipelineFunc func, void* userdata) {
+  if (!func) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  struct TCOD_HeightmapStep_ step = {.type = TCOD_HM_STEP_CALL, .func = func, .userdata = userdata};
+  return pipeline_push(pipeline, step);
+}
+
+TCOD_Error TCOD_heightmap_pipeline_execute(const TCOD_HeightmapPipeline* pipeline, TCOD_heightmap_t* hm) {
+  return TCOD_heightmap_pipeline_execute_at(pipeline, hm, 0, 0);
+}
+
+TCOD_Error TCOD_heightmap_pipeline_execute_at(
+    const TCOD_HeightmapPipeline* pipeline, TCOD_heightmap_t* hm, int origin_x, int origin_y) {
+  if (!pipeline || !hm) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  for (int i = 0; i < pipeline->count; ++i) {
+    const TCOD_heightmap_t* other = pipeline->steps[i].other;
+    if (other && !is_same_size(hm, other)) {
+      TCOD_set_errorvf(
+          "Pipeline step %i uses a %ix%i heightmap but is run on a %ix%i heightmap.",
+          i,
+          other->w,
+          other->h,
+          hm->w,
+          hm->h);
+      return TCOD_E_INVALID_ARGUMENT;
+    }
+  }
+  if (hm->w <= 0 || hm->h <= 0) return TCOD_E_OK;
+  float* row_minmax = NULL;  // Per-row ranges of a pass which is followed by a normalize step.
+  bool have_minmax = false;  // True if `current_min` and `current_max` are the range of the current values.
+  float current_min = 0;
+  float current_max = 0;
+  for (int begin = 0; begin < pipeline->count;) {
+    const struct TCOD_HeightmapStep_* first = &pipeline->steps[begin];
+    if (pipeline_step_is_barrier(first)) {
+      pipeline_run_barrier(first, hm);
+      have_minmax = false;
+      ++begin;
+      continue;
+    }
+    int end = begin + 1;
+    while (end < pipeline->count && !pipeline_step_is_barrier(&pipeline->steps[end]) &&
+           pipeline->steps[end].type != TCOD_HM_STEP_NORMALIZE) {
+      ++end;
+    }
+    struct TCOD_HeightmapPass_ pass = {
+        .hm = hm, .steps = first, .count = end - begin, .origin_x = origin_x, .origin_y = origin_y};
+    if (first->type == TCOD_HM_STEP_NORMALIZE) {
+      if (!have_minmax) TCOD_heightmap_get_minmax(hm, &current_min, &current_max);
+      const float min = first->params[0];
+      const float max = first->params[1];
+      pass.normalize_fill = current_max - current_min < FLT_EPSILON;
+      pass.normalize[0] = min;
+      pass.normalize[1] = current_min;
+      pass.normalize[2] = pass.normalize_fill ? 0 : (max - min) / (current_max - current_min);
+    }
+    if (end < pipeline->count && pipeline->steps[end].type == TCOD_HM_STEP_NORMALIZE) {
+      // Find the range of this pass while its rows are still in the cache.
+      if (!row_minmax) row_minmax = malloc(sizeof(*row_minmax) * hm->h * 2);
+      if (row_minmax) {
+        pass.row_min = row_minmax;
+        pass.row_max = row_minmax + hm->h;
+      }
+    }
+    for (int i = begin; i < end; ++i) {
+      const struct TCOD_HeightmapStep_* step = &pipeline->steps[i];
+      if (step->noise && (step->type == TCOD_HM_STEP_ADD_FBM || step->type == TCOD_HM_STEP_SCALE_FBM)) {
+        // Sampled once here so that any lazy initialization of the noise is not done from multiple threads.
+        float f[TCOD_NOISE_MAX_DIMENSIONS] = {0};
+        const float unused = TCOD_noise_get_fbm(step->noise, f, step->params[4]);
+        (void)unused;
+      }
+    }
+    TCOD_parallel_for(hm->h, MAX(1, 16384 / hm->w), pipeline_pass_rows, &pass);
+    have_minmax = pass.row_min != NULL;
+    if (have_minmax) {
+      current_min = pass.row_min[0];
+      current_max = pass.row_max[0];
+      for (int y = 1; y < hm->h; ++y) {
+        current_min = MIN(current_min, pass.row_min[y]);
+        current_max = MAX(current_max, pass.row_max[y]);
+      }
+    }
+    begin = end;
+  }
+  free(row_minmax);
+  return TCOD_E_OK;
+}
+
 /* private stuff */
 static void setMPDHeight(TCOD_heightmap_t* hm, TCOD_Random* rnd, int x, int y, float z, float offset) {
   z += TCOD_random_get_float(rnd, -offset, offset);
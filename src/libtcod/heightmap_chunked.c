@@ -0,0 +1,336 @@
+/* BSD 3-Clause License
+ *
+ * Copyright © 2008-2023, Jice and the libtcod contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "heightmap_chunked.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// A cached tile, tiles are linked from the most to the least recently used.
+struct TCOD_ChunkTile_ {
+  int tile_x;
+  int tile_y;
+  float* values;
+  int prev;  // The more recently used tile, or -1.
+  int next;  // The less recently used tile, or -1.
+};
+
+struct TCOD_ChunkedHeightmap {
+  int tile_width;
+  int tile_height;
+  int max_tiles;
+  TCOD_HeightmapTileFunc generate;
+  void* userdata;
+  int count;  // The number of tiles in use.
+  struct TCOD_ChunkTile_* tiles;  // `max_tiles` tiles, the first `count` are in use.
+  int most_recent;  // The most recently used tile, or -1.
+  int least_recent;  // The least recently used tile, or -1.
+  int table_mask;  // The size of `table` minus one, the size is a power of two.
+  int* table;  // A linear probing hash table of tile indexes, -1 for empty slots.
+  TCOD_heightmap_t view;  // The tile returned by `TCOD_chunked_heightmap_get_tile`.
+};
+
+/// Return `a / b` rounded down, `b` must be positive.
+static int floor_div(int a, int b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+
+/// Return the hash table slot where the search for a tile starts.
+static int chunk_hash(const TCOD_ChunkedHeightmap* chunked, int tile_x, int tile_y) {
+  uint32_t hash = (uint32_t)tile_x * 0x9E3779B1u ^ (uint32_t)tile_y * 0x85EBCA77u;
+  hash ^= hash >> 15;
+  return (int)(hash & (uint32_t)chunked->table_mask);
+}
+
+/// Return the hash table slot of a tile, or of the empty slot where it would go.
+static int chunk_find_slot(const TCOD_ChunkedHeightmap* chunked, int tile_x, int tile_y) {
+  int slot = chunk_hash(chunked, tile_x, tile_y);
+  while (chunked->table[slot] != -1) {
+    const struct TCOD_ChunkTile_* tile = &chunked->tiles[chunked->table[slot]];
+    if (tile->tile_x == tile_x && tile->tile_y == tile_y) break;
+    slot = (slot + 1) & chunked->table_mask;
+  }
+  return slot;
+}
+
+/// Remove the entry at `slot`, shifting back any entries which were displaced past it.
+static void chunk_table_remove(TCOD_ChunkedHeightmap* chunked, int slot) {
+  int empty = slot;
+  chunked->table[empty] = -1;
+  for (int i = (empty + 1) & chunked->table_mask; chunked->table[i] != -1; i = (i + 1) & chunked->table_mask) {
+    const struct TCOD_ChunkTile_* tile = &chunked->tiles[chunked->table[i]];
+    const int home = chunk_hash(chunked, tile->tile_x, tile->tile_y);
+    // The entry can move to the empty slot if its home is not cyclically between the empty slot and itself.
+    const int distance_to_home = (i - home) & chunked->table_mask;
+    const int distance_to_empty = (i - empty) & chunked->table_mask;
+    if (distance_to_home < distance_to_empty) continue;
+    chunked->table[empty] = chunked->table[i];
+    chunked->table[i] = -1;
+    empty = i;
+  }
+}
+
+/// Unlink a tile from the recently used list.
+static void chunk_lru_unlink(TCOD_ChunkedHeightmap* chunked, int index) {
+  struct TCOD_ChunkTile_* tile = &chunked->tiles[index];
+  if (tile->prev != -1) {
+    chunked->tiles[tile->prev].next = tile->next;
+  } else {
+    chunked->most_recent = tile->next;
+  }
+  if (tile->next != -1) {
+    chunked->tiles[tile->next].prev = tile->prev;
+  } else {
+    chunked->least_recent = tile->prev;
+  }
+}
+
+/// Link a tile at the front of the recently used list.
+static void chunk_lru_push_front(TCOD_ChunkedHeightmap* chunked, int index) {
+  struct TCOD_ChunkTile_* tile = &chunked->tiles[index];
+  tile->prev = -1;
+  tile->next = chunked->most_recent;
+  if (chunked->most_recent != -1) chunked->tiles[chunked->most_recent].prev = index;
+  chunked->most_recent = index;
+  if (chunked->least_recent == -1) chunked->least_recent = index;
+}
+
+/// Return an unlinked tile to the unused tiles at the end of the array, keeping its buffer for later.
+static void chunk_release(TCOD_ChunkedHeightmap* chunked, int index) {
+  const int last = --chunked->count;
+  if (index == last) return;
+  // Point everything which referred to the last tile at its new index.
+  chunked->table[chunk_find_slot(chunked, chunked->tiles[last].tile_x, chunked->tiles[last].tile_y)] = index;
+  const struct TCOD_ChunkTile_ released = chunked->tiles[index];
+  chunked->tiles[index] = chunked->tiles[last];
+  chunked->tiles[last] = released;
+  const struct TCOD_ChunkTile_* moved = &chunked->tiles[index];
+  if (moved->prev != -1) {
+    chunked->tiles[moved->prev].next = index;
+  } else {
+    chunked->most_recent = index;
+  }
+  if (moved->next != -1) {
+    chunked->tiles[moved->next].prev = index;
+  } else {
+    chunked->least_recent = index;
+  }
+}
+
+/// Output the cached tile at `tile_x, tile_y`, generating it if needed.  Returns a negative error code on failure.
+static TCOD_Error chunk_get(
+    TCOD_ChunkedHeightmap* chunked, int tile_x, int tile_y, const struct TCOD_ChunkTile_** tile_out) {
+  if (chunked->most_recent != -1) {
+    *tile_out = &chunked->tiles[chunked->most_recent];
+    if ((*tile_out)->tile_x == tile_x && (*tile_out)->tile_y == tile_y) return TCOD_E_OK;
+  }
+  int index = chunked->table[chunk_find_slot(chunked, tile_x, tile_y)];
+  if (index != -1) {
+    chunk_lru_unlink(chunked, index);
+    chunk_lru_push_front(chunked, index);
+    *tile_out = &chunked->tiles[index];
+    return TCOD_E_OK;
+  }
+  if (chunked->count == chunked->max_tiles) {
+    // Discard the least recently used tile.
+    index = chunked->least_recent;
+    const struct TCOD_ChunkTile_* evicted = &chunked->tiles[index];
+    chunk_table_remove(chunked, chunk_find_slot(chunked, evicted->tile_x, evicted->tile_y));
+    chunk_lru_unlink(chunked, index);
+    chunk_release(chunked, index);
+  }
+  index = chunked->count;
+  struct TCOD_ChunkTile_* tile = &chunked->tiles[index];
+  const size_t tile_size = sizeof(*tile->values) * chunked->tile_width * chunked->tile_height;
+  if (!tile->values) tile->values = malloc(tile_size);
+  if (!tile->values) {
+    TCOD_set_errorv("Out of memory.");
+    return TCOD_E_OUT_OF_MEMORY;
+  }
+  memset(tile->values, 0, tile_size);
+  TCOD_heightmap_t heightmap = {chunked->tile_width, chunked->tile_height, tile->values};
+  const TCOD_Error err =
+      chunked->generate(&heightmap, tile_x * chunked->tile_width, tile_y * chunked->tile_height, chunked->userdata);
+  if (err < 0) return err;
+  ++chunked->count;
+  tile->tile_x = tile_x;
+  tile->tile_y = tile_y;
+  chunked->table[chunk_find_slot(chunked, tile_x, tile_y)] = index;
+  chunk_lru_push_front(chunked, index);
+  *tile_out = tile;
+  return TCOD_E_OK;
+}
+
+/// Generate a tile with a pipeline.
+static TCOD_Error chunk_generate_pipeline(TCOD_heightmap_t* tile, int x, int y, void* userdata) {
+  return TCOD_heightmap_pipeline_execute_at(userdata, tile, x, y);
+}
+
+TCOD_ChunkedHeightmap* TCOD_chunked_heightmap_new(
+    int tile_width, int tile_height, int max_tiles, TCOD_HeightmapTileFunc generate, void* userdata) {
+  if (!generate) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return NULL;
+  }
+  if (tile_width <= 0 || tile_height <= 0 || max_tiles <= 0) {
+    TCOD_set_errorvf(
+        "Tile size and count must be positive, got %ix%i and %i tiles.", tile_width, tile_height, max_tiles);
+    return NULL;
+  }
+  TCOD_ChunkedHeightmap* chunked = calloc(1, sizeof(*chunked));
+  if (!chunked) {
+    TCOD_set_errorv("Out of memory.");
+    return NULL;
+  }
+  int table_size = 16;
+  while (table_size < max_tiles * 2) table_size *= 2;
+  *chunked = (TCOD_ChunkedHeightmap){
+      .tile_width = tile_width,
+      .tile_height = tile_height,
+      .max_tiles = max_tiles,
+      .generate = generate,
+      .userdata = userdata,
+      .tiles = calloc(max_tiles, sizeof(*chunked->tiles)),
+      .most_recent = -1,
+      .least_recent = -1,
+      .table_mask = table_size - 1,
+      .table = malloc(sizeof(*chunked->table) * table_size),
+  };
+  if (!chunked->tiles || !chunked->table) {
+    TCOD_chunked_heightmap_delete(chunked);
+    TCOD_set_errorv("Out of memory.");
+    return NULL;
+  }
+  for (int i = 0; i < table_size; ++i) chunked->table[i] = -1;
+  return chunked;
+}
+
+TCOD_ChunkedHeightmap* TCOD_chunked_heightmap_new_pipeline(
+    int tile_width, int tile_height, int max_tiles, const TCOD_HeightmapPipeline* pipeline) {
+  if (!pipeline) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return NULL;
+  }
+  return TCOD_chunked_heightmap_new(
+      tile_width, tile_height, max_tiles, chunk_generate_pipeline, (TCOD_HeightmapPipeline*)pipeline);
+}
+
+void TCOD_chunked_heightmap_delete(TCOD_ChunkedHeightmap* chunked) {
+  if (!chunked) return;
+  if (chunked->tiles) {
+    for (int i = 0; i < chunked->max_tiles; ++i) free(chunked->tiles[i].values);
+  }
+  free(chunked->tiles);
+  free(chunked->table);
+  free(chunked);
+}
+
+const TCOD_heightmap_t* TCOD_chunked_heightmap_get_tile(TCOD_ChunkedHeightmap* chunked, int tile_x, int tile_y) {
+  if (!chunked) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return NULL;
+  }
+  const struct TCOD_ChunkTile_* tile;
+  if (chunk_get(chunked, tile_x, tile_y, &tile) < 0) return NULL;
+  // The view is stored with the chunked heightmap so that the returned pointer stays valid.
+  chunked->view = (TCOD_heightmap_t){chunked->tile_width, chunked->tile_height, tile->values};
+  return &chunked->view;
+}
+
+float TCOD_chunked_heightmap_get_value(TCOD_ChunkedHeightmap* chunked, int x, int y) {
+  if (!chunked) return NAN;
+  const int tile_x = floor_div(x, chunked->tile_width);
+  const int tile_y = floor_div(y, chunked->tile_height);
+  const struct TCOD_ChunkTile_* tile;
+  if (chunk_get(chunked, tile_x, tile_y, &tile) < 0) return NAN;
+  const int local_x = x - tile_x * chunked->tile_width;
+  const int local_y = y - tile_y * chunked->tile_height;
+  return tile->values[local_x + local_y * chunked->tile_width];
+}
+
+float TCOD_chunked_heightmap_get_interpolated_value(TCOD_ChunkedHeightmap* chunked, float x, float y) {
+  const float floor_x = floorf(x);
+  const float floor_y = floorf(y);
+  const float fx = x - floor_x;
+  const float fy = y - floor_y;
+  const int ix = (int)floor_x;
+  const int iy = (int)floor_y;
+  const float c1 = TCOD_chunked_heightmap_get_value(chunked, ix, iy);
+  const float c2 = TCOD_chunked_heightmap_get_value(chunked, ix + 1, iy);
+  const float c3 = TCOD_chunked_heightmap_get_value(chunked, ix, iy + 1);
+  const float c4 = TCOD_chunked_heightmap_get_value(chunked, ix + 1, iy + 1);
+  const float top = c1 + (c2 - c1) * fx;
+  const float bottom = c3 + (c4 - c3) * fx;
+  return top + (bottom - top) * fy;
+}
+
+TCOD_Error TCOD_chunked_heightmap_read(TCOD_ChunkedHeightmap* chunked, int x, int y, TCOD_heightmap_t* out) {
+  if (!chunked || !out) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  // Copy one tile at a time, so that the area can be larger than the cache.
+  for (int tile_y = floor_div(y, chunked->tile_height); tile_y * chunked->tile_height < y + out->h; ++tile_y) {
+    for (int tile_x = floor_div(x, chunked->tile_width); tile_x * chunked->tile_width < x + out->w; ++tile_x) {
+      const struct TCOD_ChunkTile_* tile;
+      const TCOD_Error err = chunk_get(chunked, tile_x, tile_y, &tile);
+      if (err < 0) return err;
+      const int tile_left = tile_x * chunked->tile_width;
+      const int tile_top = tile_y * chunked->tile_height;
+      const int left = tile_left > x ? tile_left : x;
+      const int right = tile_left + chunked->tile_width < x + out->w ? tile_left + chunked->tile_width : x + out->w;
+      const int top = tile_top > y ? tile_top : y;
+      const int bottom = tile_top + chunked->tile_height < y + out->h ? tile_top + chunked->tile_height : y + out->h;
+      for (int row = top; row < bottom; ++row) {
+        memcpy(
+            &out->values[(left - x) + (row - y) * out->w],
+            &tile->values[(left - tile_left) + (row - tile_top) * chunked->tile_width],
+            sizeof(*out->values) * (right - left));
+      }
+    }
+  }
+  return TCOD_E_OK;
+}
+
+TCOD_Error TCOD_chunked_heightmap_prefetch(TCOD_ChunkedHeightmap* chunked, int x, int y, int width, int height) {
+  if (!chunked) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  for (int tile_y = floor_div(y, chunked->tile_height); tile_y * chunked->tile_height < y + height; ++tile_y) {
+    for (int tile_x = floor_div(x, chunked->tile_width); tile_x * chunked->tile_width < x + width; ++tile_x) {
+      const struct TCOD_ChunkTile_* tile;
+      const TCOD_Error err = chunk_get(chunked, tile_x, tile_y, &tile);
+      if (err < 0) return err;
+    }
+  }
+  return TCOD_E_OK;
+}
@@ -0,0 +1,105 @@
+/* BSD 3-Clause License
+ *
+ * Copyright © 2008-2023, Jice and the libtcod contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef TCOD_HEIGHTMAP_CHUNKED_H_
+#define TCOD_HEIGHTMAP_CHUNKED_H_
+
+#include "config.h"
+#include "error.h"
+#include "heightmap.h"
+
+/**
+    An unbounded heightmap made of fixed size tiles which are generated when they are first read.
+
+    At most `max_tiles` tiles are kept, the least recently used tile is discarded to make room for a new one and is
+    generated again if it is needed later.  Memory use follows the area being read instead of the size of the world.
+ */
+typedef struct TCOD_ChunkedHeightmap TCOD_ChunkedHeightmap;
+/**
+    Fill `tile` with the heightmap values of the world starting at `x, y`, the tile starts out filled with zeros.
+
+    A generator must always give the same values for the same tile, since tiles can be discarded and regenerated.
+    Returns a negative error code on failure.
+ */
+typedef TCOD_Error (*TCOD_HeightmapTileFunc)(TCOD_heightmap_t* tile, int x, int y, void* userdata);
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+/**
+    Return a new chunked heightmap which generates its `tile_width` by `tile_height` tiles with `generate`.
+
+    Returns NULL on failure.
+ */
+TCOD_NODISCARD
+TCOD_PUBLIC TCOD_ChunkedHeightmap* TCOD_chunked_heightmap_new(
+    int tile_width, int tile_height, int max_tiles, TCOD_HeightmapTileFunc generate, void* userdata);
+/**
+    Return a new chunked heightmap which generates its tiles with `TCOD_heightmap_pipeline_execute_at`.
+
+    The pipeline is not copied, it must outlive the chunked heightmap.  Returns NULL on failure.
+ */
+TCOD_NODISCARD
+TCOD_PUBLIC TCOD_ChunkedHeightmap* TCOD_chunked_heightmap_new_pipeline(
+    int tile_width, int tile_height, int max_tiles, const TCOD_HeightmapPipeline* pipeline);
+TCOD_PUBLIC void TCOD_chunked_heightmap_delete(TCOD_ChunkedHeightmap* chunked);
+/**
+    Return the tile at the tile coordinates `tile_x, tile_y`, generating it if needed.
+
+    The tile stays valid until another tile is generated.  Returns NULL on failure.
+ */
+TCOD_PUBLIC const TCOD_heightmap_t* TCOD_chunked_heightmap_get_tile(
+    TCOD_ChunkedHeightmap* chunked, int tile_x, int tile_y);
+/**
+    Return the value at `x, y`, which can be anywhere including negative coordinates.  Returns NaN on failure.
+ */
+TCOD_PUBLIC float TCOD_chunked_heightmap_get_value(TCOD_ChunkedHeightmap* chunked, int x, int y);
+/**
+    Return the bilinear interpolation of the values around `x, y`, tile borders are crossed seamlessly.
+ */
+TCOD_PUBLIC float TCOD_chunked_heightmap_get_interpolated_value(TCOD_ChunkedHeightmap* chunked, float x, float y);
+/**
+    Copy the values starting at `x, y` into `out`, which can be any size and span any number of tiles.
+
+    Returns a negative error code on failure.
+ */
+TCOD_PUBLIC TCOD_Error TCOD_chunked_heightmap_read(TCOD_ChunkedHeightmap* chunked, int x, int y, TCOD_heightmap_t* out);
+/**
+    Generate any missing tiles overlapping the `width` by `height` area starting at `x, y`.
+
+    This can be called ahead of time to spread generation over many frames.  Tiles beyond `max_tiles` are discarded
+    as usual, so the area should fit within the cache.  Returns a negative error code on failure.
+ */
+TCOD_PUBLIC TCOD_Error TCOD_chunked_heightmap_prefetch(
+    TCOD_ChunkedHeightmap* chunked, int x, int y, int width, int height);
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+#endif  // TCOD_HEIGHTMAP_CHUNKED_H_
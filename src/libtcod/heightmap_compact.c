@@ -0,0 +1,376 @@
+/* BSD 3-Clause License
+ *
+ * Copyright © 2008-2023, Jice and the libtcod contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "heightmap_compact.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parallel.h"
+#include "utility.h"
+
+/// The largest value stored by a UNORM16 heightmap.
+#define TCOD_UNORM16_MAX 65535
+
+/// The number of values converted by one `TCOD_parallel_for` task.
+#define TCOD_COMPACT_GRAIN 16384
+
+/// Encode a float as a half float, rounding to the nearest even value.
+static uint16_t half_from_float(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+  bits &= 0x7FFFFFFF;
+  if (bits >= 0x7F800000) return sign | (bits > 0x7F800000 ? 0x7E00 : 0x7C00);  // NaN or infinity.
+  if (bits >= 0x477FF000) return sign | 0x7C00;  // Rounds past the largest half float, 65504.
+  if (bits < 0x38800000) {
+    // Zero or subnormal, these are multiples of 2^-24 which `lrintf` rounds to the nearest even.
+    return sign | (uint16_t)lrintf(fabsf(value) * 16777216.0f);
+  }
+  uint32_t half = (bits - 0x38000000) >> 13;  // Rebias the exponent from 127 to 15.
+  const uint32_t remainder = bits & 0x1FFF;
+  if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) ++half;  // A carry correctly bumps the exponent.
+  return sign | (uint16_t)half;
+}
+
+/// Decode a half float.
+static float half_to_float(uint16_t half) {
+  const uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+  const uint32_t exponent = (half >> 10) & 0x1F;
+  const uint32_t mantissa = half & 0x3FF;
+  uint32_t bits;
+  if (exponent == 0) {
+    const float value = (float)mantissa * (1.0f / 16777216.0f);
+    memcpy(&bits, &value, sizeof(bits));
+    bits |= sign;
+  } else if (exponent == 0x1F) {
+    bits = sign | 0x7F800000 | (mantissa << 13);
+  } else {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/// Encode a value for `compact`.
+static uint16_t compact_encode(const TCOD_HeightmapCompact* compact, float value) {
+  if (compact->format == TCOD_HEIGHTMAP_FORMAT_HALF) return half_from_float(value);
+  if (compact->scale == 0) return 0;
+  const float stored = (value - compact->offset) / compact->scale;
+  if (!(stored > 0)) return 0;  // Also catches NaN.
+  if (stored >= TCOD_UNORM16_MAX) return TCOD_UNORM16_MAX;
+  return (uint16_t)(stored + 0.5f);
+}
+
+/// Decode a value from `compact`.
+static float compact_decode(const TCOD_HeightmapCompact* compact, uint16_t stored) {
+  if (compact->format == TCOD_HEIGHTMAP_FORMAT_HALF) return half_to_float(stored);
+  return compact->offset + stored * compact->scale;
+}
+
+/**
+    Widen the range of a UNORM16 heightmap whose range is a single value, so that it also holds `value`.
+
+    Every stored value decodes to `offset` while `scale` is zero, they are re-encoded for the new range.
+ */
+static void compact_unorm16_widen(TCOD_HeightmapCompact* compact, float value) {
+  if (!isfinite(value) || value == compact->offset) return;
+  const float old_value = compact->offset;
+  compact->offset = MIN(old_value, value);
+  compact->scale = (MAX(old_value, value) - compact->offset) / TCOD_UNORM16_MAX;
+  const uint16_t stored = compact_encode(compact, old_value);
+  for (int i = 0; i < compact->w * compact->h; ++i) compact->values[i] = stored;
+}
+
+/// The shared parameters of a parallel conversion between compact and float values.
+struct TCOD_CompactConvert_ {
+  TCOD_HeightmapCompact* compact;
+  float* values;
+  float clamp_min;  // Values are clamped to `[clamp_min, clamp_max]` by `compact_clamp_range`.
+  float clamp_max;
+};
+
+/// Decode the values `[begin, end)`.
+static void compact_decode_range(void* userdata, int begin, int end) {
+  const struct TCOD_CompactConvert_* convert = userdata;
+  const TCOD_HeightmapCompact* compact = convert->compact;
+  if (compact->format == TCOD_HEIGHTMAP_FORMAT_HALF) {
+    for (int i = begin; i < end; ++i) convert->values[i] = half_to_float(compact->values[i]);
+  } else {
+    for (int i = begin; i < end; ++i) convert->values[i] = compact->offset + compact->values[i] * compact->scale;
+  }
+}
+
+/// Encode the values `[begin, end)`.
+static void compact_encode_range(void* userdata, int begin, int end) {
+  const struct TCOD_CompactConvert_* convert = userdata;
+  for (int i = begin; i < end; ++i) {
+    convert->compact->values[i] = compact_encode(convert->compact, convert->values[i]);
+  }
+}
+
+/// Clamp the values `[begin, end)`.
+static void compact_clamp_range(void* userdata, int begin, int end) {
+  const struct TCOD_CompactConvert_* convert = userdata;
+  TCOD_HeightmapCompact* compact = convert->compact;
+  for (int i = begin; i < end; ++i) {
+    const float value = compact_decode(compact, compact->values[i]);
+    if (value < convert->clamp_min || value > convert->clamp_max) {
+      compact->values[i] = compact_encode(compact, CLAMP(convert->clamp_min, convert->clamp_max, value));
+    }
+  }
+}
+
+/// Scale or offset every half float value with `value * mul + add`.
+static void compact_half_affine(TCOD_HeightmapCompact* compact, float mul, float add) {
+  for (int i = 0; i < compact->w * compact->h; ++i) {
+    compact->values[i] = half_from_float(half_to_float(compact->values[i]) * mul + add);
+  }
+}
+
+TCOD_HeightmapCompact* TCOD_heightmap_compact_new(int w, int h, TCOD_HeightmapFormat format, float min, float max) {
+  if (w < 0 || h < 0) {
+    TCOD_set_errorvf("Size must not be negative, got %ix%i.", w, h);
+    return NULL;
+  }
+  if (format != TCOD_HEIGHTMAP_FORMAT_HALF && format != TCOD_HEIGHTMAP_FORMAT_UNORM16) {
+    TCOD_set_errorvf("Unknown heightmap format %i.", (int)format);
+    return NULL;
+  }
+  if (format == TCOD_HEIGHTMAP_FORMAT_UNORM16 && !(min <= max)) {
+    TCOD_set_errorvf("min must not be greater than max, got %f and %f.", min, max);
+    return NULL;
+  }
+  TCOD_HeightmapCompact* compact = malloc(sizeof(*compact));
+  if (!compact) {
+    TCOD_set_errorv("Out of memory.");
+    return NULL;
+  }
+  *compact = (TCOD_HeightmapCompact){w, h, format, 0, 0, malloc(sizeof(*compact->values) * w * h + 1)};
+  if (!compact->values) {
+    free(compact);
+    TCOD_set_errorv("Out of memory.");
+    return NULL;
+  }
+  if (format == TCOD_HEIGHTMAP_FORMAT_UNORM16) {
+    compact->offset = min;
+    compact->scale = (max - min) / TCOD_UNORM16_MAX;
+  }
+  const uint16_t zero = compact_encode(compact, 0.0f);
+  for (int i = 0; i < w * h; ++i) compact->values[i] = zero;
+  return compact;
+}
+
+TCOD_HeightmapCompact* TCOD_heightmap_compact_from_heightmap(const TCOD_heightmap_t* hm, TCOD_HeightmapFormat format) {
+  if (!hm) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return NULL;
+  }
+  float min = 0;
+  float max = 0;
+  if (format == TCOD_HEIGHTMAP_FORMAT_UNORM16) TCOD_heightmap_get_minmax(hm, &min, &max);
+  TCOD_HeightmapCompact* compact = TCOD_heightmap_compact_new(hm->w, hm->h, format, min, max);
+  if (!compact) return NULL;
+  TCOD_heightmap_compact_store(compact, hm);
+  return compact;
+}
+
+void TCOD_heightmap_compact_delete(TCOD_HeightmapCompact* compact) {
+  if (!compact) return;
+  free(compact->values);
+  free(compact);
+}
+
+TCOD_Error TCOD_heightmap_compact_to_heightmap(const TCOD_HeightmapCompact* compact, TCOD_heightmap_t* hm_out) {
+  if (!compact || !hm_out) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  if (compact->w != hm_out->w || compact->h != hm_out->h) {
+    TCOD_set_errorvf(
+        "Heightmaps must be the same size, got %ix%i and %ix%i.", compact->w, compact->h, hm_out->w, hm_out->h);
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  struct TCOD_CompactConvert_ convert = {(TCOD_HeightmapCompact*)compact, hm_out->values, 0, 0};
+  TCOD_parallel_for(compact->w * compact->h, TCOD_COMPACT_GRAIN, compact_decode_range, &convert);
+  return TCOD_E_OK;
+}
+
+TCOD_Error TCOD_heightmap_compact_store(TCOD_HeightmapCompact* compact, const TCOD_heightmap_t* hm) {
+  if (!compact || !hm) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  if (compact->w != hm->w || compact->h != hm->h) {
+    TCOD_set_errorvf("Heightmaps must be the same size, got %ix%i and %ix%i.", compact->w, compact->h, hm->w, hm->h);
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  if (compact->format == TCOD_HEIGHTMAP_FORMAT_UNORM16 && compact->scale == 0 && hm->w * hm->h > 0) {
+    // Every value is replaced, so a single value range is replaced by the range of `hm`.
+    float min;
+    float max;
+    TCOD_heightmap_get_minmax(hm, &min, &max);
+    compact->offset = min;
+    compact->scale = (max - min) / TCOD_UNORM16_MAX;
+  }
+  struct TCOD_CompactConvert_ convert = {compact, hm->values, 0, 0};
+  TCOD_parallel_for(compact->w * compact->h, TCOD_COMPACT_GRAIN, compact_encode_range, &convert);
+  return TCOD_E_OK;
+}
+
+float TCOD_heightmap_compact_get_value(const TCOD_HeightmapCompact* compact, int x, int y) {
+  if (!compact || x < 0 || x >= compact->w || y < 0 || y >= compact->h) return 0.0f;
+  return compact_decode(compact, compact->values[x + y * compact->w]);
+}
+
+float TCOD_heightmap_compact_get_interpolated_value(const TCOD_HeightmapCompact* compact, float x, float y) {
+  if (!compact || compact->w < 2 || compact->h < 2) return 0.0f;
+  x = CLAMP(0.0f, compact->w - 1, x);
+  y = CLAMP(0.0f, compact->h - 1, y);
+  float fix;
+  float fiy;
+  float fx = modff(x, &fix);
+  float fy = modff(y, &fiy);
+  int ix = (int)fix;
+  int iy = (int)fiy;
+  if (ix >= compact->w - 1) {
+    ix = compact->w - 2;
+    fx = 1.0f;
+  }
+  if (iy >= compact->h - 1) {
+    iy = compact->h - 2;
+    fy = 1.0f;
+  }
+  const uint16_t* row = &compact->values[ix + iy * compact->w];
+  const float c1 = compact_decode(compact, row[0]);
+  const float c2 = compact_decode(compact, row[1]);
+  const float c3 = compact_decode(compact, row[compact->w]);
+  const float c4 = compact_decode(compact, row[compact->w + 1]);
+  const float top = LERP(c1, c2, fx);
+  const float bottom = LERP(c3, c4, fx);
+  return LERP(top, bottom, fy);
+}
+
+void TCOD_heightmap_compact_set_value(TCOD_HeightmapCompact* compact, int x, int y, float value) {
+  if (!compact || x < 0 || x >= compact->w || y < 0 || y >= compact->h) return;
+  if (compact->format == TCOD_HEIGHTMAP_FORMAT_UNORM16 && compact->scale == 0) compact_unorm16_widen(compact, value);
+  compact->values[x + y * compact->w] = compact_encode(compact, value);
+}
+
+void TCOD_heightmap_compact_get_minmax(const TCOD_HeightmapCompact* compact, float* min, float* max) {
+  float current_min = 0;
+  float current_max = 0;
+  if (compact && compact->w * compact->h > 0) {
+    if (compact->format == TCOD_HEIGHTMAP_FORMAT_UNORM16) {
+      // Decoding is monotonic, so the range can be found without decoding every value.
+      uint16_t stored_min = compact->values[0];
+      uint16_t stored_max = compact->values[0];
+      for (int i = 1; i < compact->w * compact->h; ++i) {
+        stored_min = MIN(stored_min, compact->values[i]);
+        stored_max = MAX(stored_max, compact->values[i]);
+      }
+      current_min = compact_decode(compact, stored_min);
+      current_max = compact_decode(compact, stored_max);
+      if (current_min > current_max) {  // A negative scale reverses the order.
+        const float swap = current_min;
+        current_min = current_max;
+        current_max = swap;
+      }
+    } else {
+      current_min = current_max = half_to_float(compact->values[0]);
+      for (int i = 1; i < compact->w * compact->h; ++i) {
+        const float value = half_to_float(compact->values[i]);
+        current_min = MIN(current_min, value);
+        current_max = MAX(current_max, value);
+      }
+    }
+  }
+  if (min) *min = current_min;
+  if (max) *max = current_max;
+}
+
+void TCOD_heightmap_compact_add(TCOD_HeightmapCompact* compact, float value) {
+  if (!compact) return;
+  if (compact->format == TCOD_HEIGHTMAP_FORMAT_UNORM16) {
+    compact->offset += value;
+  } else {
+    compact_half_affine(compact, 1.0f, value);
+  }
+}
+
+void TCOD_heightmap_compact_scale(TCOD_HeightmapCompact* compact, float value) {
+  if (!compact) return;
+  if (compact->format == TCOD_HEIGHTMAP_FORMAT_UNORM16) {
+    compact->offset *= value;
+    compact->scale *= value;
+  } else {
+    compact_half_affine(compact, value, 0.0f);
+  }
+}
+
+void TCOD_heightmap_compact_clamp(TCOD_HeightmapCompact* compact, float min, float max) {
+  if (!compact) return;
+  if (compact->format == TCOD_HEIGHTMAP_FORMAT_UNORM16 && compact->scale == 0) {
+    compact->offset = CLAMP(min, max, compact->offset);  // Every value is `offset`.
+    return;
+  }
+  struct TCOD_CompactConvert_ convert = {compact, NULL, min, max};
+  TCOD_parallel_for(compact->w * compact->h, TCOD_COMPACT_GRAIN, compact_clamp_range, &convert);
+}
+
+void TCOD_heightmap_compact_normalize(TCOD_HeightmapCompact* compact, float min, float max) {
+  if (!compact) return;
+  float current_min;
+  float current_max;
+  TCOD_heightmap_compact_get_minmax(compact, &current_min, &current_max);
+  if (current_max - current_min < FLT_EPSILON) {
+    if (compact->format == TCOD_HEIGHTMAP_FORMAT_UNORM16) {
+      compact->offset = min;
+      compact->scale = 0;
+      memset(compact->values, 0, sizeof(*compact->values) * compact->w * compact->h);
+    } else {
+      const uint16_t stored = half_from_float(min);
+      for (int i = 0; i < compact->w * compact->h; ++i) compact->values[i] = stored;
+    }
+    return;
+  }
+  const float normalize_scale = (max - min) / (current_max - current_min);
+  if (compact->format == TCOD_HEIGHTMAP_FORMAT_UNORM16) {
+    // `offset + stored * scale` maps to `min + (offset + stored * scale - current_min) * normalize_scale`.
+    compact->offset = min + (compact->offset - current_min) * normalize_scale;
+    compact->scale *= normalize_scale;
+  } else {
+    compact_half_affine(compact, normalize_scale, min - current_min * normalize_scale);
+  }
+}
@@ -0,0 +1,120 @@
+/* BSD 3-Clause License
+ *
+ * Copyright © 2008-2023, Jice and the libtcod contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef TCOD_HEIGHTMAP_COMPACT_H_
+#define TCOD_HEIGHTMAP_COMPACT_H_
+
+#include <stdint.h>
+
+#include "config.h"
+#include "error.h"
+#include "heightmap.h"
+
+/**
+    The 16-bit encodings supported by TCOD_HeightmapCompact.
+ */
+typedef enum TCOD_HeightmapFormat {
+  /// IEEE 754 half precision floats, with 11 bits of precision relative to each value and a range of +-65504.
+  TCOD_HEIGHTMAP_FORMAT_HALF = 1,
+  /// Unsigned integers mapped linearly to `offset + stored * scale`, with 65536 evenly spaced values.
+  TCOD_HEIGHTMAP_FORMAT_UNORM16 = 2,
+} TCOD_HeightmapFormat;
+
+/**
+    A heightmap storing each value in 16 bits, which is half of the memory used by TCOD_heightmap_t.
+
+    Values are converted to and from floats when they are read or written.  Writing a value rounds it to the nearest
+    value the format can hold, UNORM16 heightmaps also clamp it to their range.
+
+    A UNORM16 range can shrink to a single value with a `scale` of zero, such as after normalizing a flat heightmap or
+    scaling by zero.  Writing a different value then widens the range to hold it, and storing a whole heightmap uses
+    the range of that heightmap.
+ */
+typedef struct TCOD_HeightmapCompact {
+  int w;
+  int h;
+  TCOD_HeightmapFormat format;
+  float scale;  // The distance between UNORM16 values.  Unused by half floats.
+  float offset;  // The value of a stored zero for UNORM16.  Unused by half floats.
+  uint16_t* values;  // `w * h` encoded values in row-major order.
+} TCOD_HeightmapCompact;
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+/**
+    Return a new compact heightmap with every value set to zero, or to the closest value to zero it can hold.
+
+    UNORM16 heightmaps hold values between `min` and `max`, which are ignored by other formats.
+    Returns NULL on failure.
+ */
+TCOD_NODISCARD
+TCOD_PUBLIC TCOD_HeightmapCompact* TCOD_heightmap_compact_new(
+    int w, int h, TCOD_HeightmapFormat format, float min, float max);
+/**
+    Return a new compact copy of `hm`.  A UNORM16 copy uses the range of `hm`.  Returns NULL on failure.
+ */
+TCOD_NODISCARD
+TCOD_PUBLIC TCOD_HeightmapCompact* TCOD_heightmap_compact_from_heightmap(
+    const TCOD_heightmap_t* hm, TCOD_HeightmapFormat format);
+TCOD_PUBLIC void TCOD_heightmap_compact_delete(TCOD_HeightmapCompact* compact);
+/**
+    Decode every value of `compact` into `hm_out`, which must be the same size.
+
+    Returns a negative error code on failure.
+ */
+TCOD_PUBLIC TCOD_Error TCOD_heightmap_compact_to_heightmap(
+    const TCOD_HeightmapCompact* compact, TCOD_heightmap_t* hm_out);
+/**
+    Encode every value of `hm` into `compact`, which must be the same size.
+
+    UNORM16 values are clamped to the current range of `compact`, a single value range is replaced by the range of
+    `hm`.  Returns a negative error code on failure.
+ */
+TCOD_PUBLIC TCOD_Error TCOD_heightmap_compact_store(TCOD_HeightmapCompact* compact, const TCOD_heightmap_t* hm);
+TCOD_PUBLIC float TCOD_heightmap_compact_get_value(const TCOD_HeightmapCompact* compact, int x, int y);
+TCOD_PUBLIC float TCOD_heightmap_compact_get_interpolated_value(
+    const TCOD_HeightmapCompact* compact, float x, float y);
+TCOD_PUBLIC void TCOD_heightmap_compact_set_value(TCOD_HeightmapCompact* compact, int x, int y, float value);
+TCOD_PUBLIC void TCOD_heightmap_compact_get_minmax(const TCOD_HeightmapCompact* compact, float* min, float* max);
+/**
+    Whole-heightmap operations matching the TCOD_heightmap_t functions of the same name.
+
+    On UNORM16 heightmaps `add`, `scale`, and `normalize` only change `offset` and `scale`, so they do not lose any
+    precision and do not touch the stored values other than to find their range.
+ */
+TCOD_PUBLIC void TCOD_heightmap_compact_add(TCOD_HeightmapCompact* compact, float value);
+TCOD_PUBLIC void TCOD_heightmap_compact_scale(TCOD_HeightmapCompact* compact, float value);
+TCOD_PUBLIC void TCOD_heightmap_compact_clamp(TCOD_HeightmapCompact* compact, float min, float max);
+TCOD_PUBLIC void TCOD_heightmap_compact_normalize(TCOD_HeightmapCompact* compact, float min, float max);
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+#endif  // TCOD_HEIGHTMAP_COMPACT_H_
@@ -0,0 +1,471 @@
+/* BSD 3-Clause License
+ *
+ * Copyright © 2008-2023, Jice and the libtcod contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "heightmap_hydrology.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "heapq.h"
+#include "parallel.h"
+#include "utility.h"
+
+/// The rows processed by one `TCOD_parallel_for` task of `TCOD_heightmap_flow_directions`.
+#define TCOD_FLOW_ROW_GRAIN 16
+
+static const int flow_dx[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+static const int flow_dy[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+
+/// Return an int which sorts the same way as `value`, for any value other than NaN.
+static int flow_priority(float value) {
+  int32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits < 0 ? bits ^ 0x7FFFFFFF : bits;
+}
+
+/// Return the level of a cell spilling into a cell at `level`.
+static float flow_spill_level(float level, float epsilon) {
+  if (!(epsilon > 0)) return level;
+  const float raised = level + epsilon;
+  return raised > level ? raised : nextafterf(level, INFINITY);
+}
+
+/// One bucket of a `TCOD_FlowQueue_`, holding the indexes of cells in no particular order.
+struct TCOD_FlowBucket_ {
+  int* cells;
+  int size;
+  int capacity;
+};
+/**
+    A monotone bucket queue of cells, sorted by their level.
+
+    Cells are put into buckets over the range of levels of the heightmap and only the bucket being popped from is kept
+    in a heap, so cells still leave in the exact order of their levels while the heap stays small enough to be cheap.
+    A priority-flood never pushes a cell below the level being popped, so buckets behind the current one stay empty.
+
+    Nearly every cell waiting in a bucket has had all of its neighbors closed by the time the flood reaches its level,
+    those are dropped when their bucket comes up instead of going through the heap for nothing.
+ */
+struct TCOD_FlowQueue_ {
+  const float* values;  // The levels of the cells, these must not change while a cell is queued.
+  const bool* closed;  // The cells which the flood has reached.
+  int width;
+  int height;
+  struct TCOD_FlowBucket_* buckets;
+  int bucket_count;
+  int current;  // The bucket being popped from, its cells are in `heap` instead.
+  float min_level;
+  float scale;  // The number of buckets per unit of level.
+  int size;
+  struct TCOD_Heap heap;
+};
+
+/// Return true if the cell at `index` has a neighbor which is not closed.
+static bool flow_has_open_neighbor(const struct TCOD_FlowQueue_* queue, int index) {
+  const int x = index % queue->width;
+  const int y = index / queue->width;
+  for (int i = 0; i < 8; ++i) {
+    const int nx = x + flow_dx[i];
+    const int ny = y + flow_dy[i];
+    if (nx < 0 || nx >= queue->width || ny < 0 || ny >= queue->height) continue;
+    if (!queue->closed[nx + ny * queue->width]) return true;
+  }
+  return false;
+}
+
+/// Set up a queue for the cells of `hm`, returns a negative error code on failure.
+static TCOD_Error flow_queue_init(struct TCOD_FlowQueue_* queue, const TCOD_heightmap_t* hm, const bool* closed) {
+  float min_level = INFINITY;
+  float max_level = -INFINITY;
+  for (int i = 0; i < hm->w * hm->h; ++i) {
+    if (hm->values[i] < min_level) min_level = hm->values[i];
+    if (hm->values[i] > max_level) max_level = hm->values[i];
+  }
+  // Around a thousand cells per bucket keeps the heap small without spreading pushes over too much memory.
+  const int bucket_count = MAX(1, MIN(hm->w * hm->h / 1024, 16384));
+  *queue = (struct TCOD_FlowQueue_){
+      .values = hm->values,
+      .closed = closed,
+      .width = hm->w,
+      .height = hm->h,
+      .buckets = calloc(bucket_count, sizeof(*queue->buckets)),
+      .bucket_count = bucket_count,
+      .min_level = min_level,
+      .scale = max_level > min_level ? bucket_count / (max_level - min_level) : 0.0f,
+  };
+  if (TCOD_heap_init(&queue->heap, sizeof(int)) < 0 || !queue->buckets) {
+    TCOD_set_errorv("Out of memory.");
+    return TCOD_E_OUT_OF_MEMORY;
+  }
+  return TCOD_E_OK;
+}
+
+static void flow_queue_uninit(struct TCOD_FlowQueue_* queue) {
+  if (queue->buckets) {
+    for (int i = 0; i < queue->bucket_count; ++i) free(queue->buckets[i].cells);
+  }
+  free(queue->buckets);
+  queue->buckets = NULL;
+  TCOD_heap_uninit(&queue->heap);
+}
+
+/// Push the cell at `index`, returns a negative error code on failure.
+static TCOD_Error flow_queue_push(struct TCOD_FlowQueue_* queue, int index) {
+  // Rounding keeps this in order with the levels, and anything which is not a number goes to the current bucket.
+  const float offset = (queue->values[index] - queue->min_level) * queue->scale;
+  const int bucket_index = offset >= queue->bucket_count - 1 ? queue->bucket_count - 1 : offset >= 0 ? (int)offset : 0;
+  if (bucket_index <= queue->current) {
+    const TCOD_Error err = (TCOD_Error)TCOD_minheap_push(&queue->heap, flow_priority(queue->values[index]), &index);
+    if (err == TCOD_E_OK) ++queue->size;
+    return err;
+  }
+  struct TCOD_FlowBucket_* bucket = &queue->buckets[bucket_index];
+  if (bucket->size == bucket->capacity) {
+    const int new_capacity = bucket->capacity ? bucket->capacity * 2 : 64;
+    int* new_cells = realloc(bucket->cells, sizeof(*new_cells) * new_capacity);
+    if (!new_cells) {
+      TCOD_set_errorv("Out of memory.");
+      return TCOD_E_OUT_OF_MEMORY;
+    }
+    bucket->cells = new_cells;
+    bucket->capacity = new_capacity;
+  }
+  bucket->cells[bucket->size++] = index;
+  ++queue->size;
+  return TCOD_E_OK;
+}
+
+/// Pop the cell with the lowest level into `index`.
+/// Returns 1 if a cell was popped, 0 if no cell with open neighbors is left, or a negative error code on failure.
+static int flow_queue_pop(struct TCOD_FlowQueue_* queue, int* index) {
+  while (!queue->heap.size) {
+    if (!queue->size) return 0;
+    const struct TCOD_FlowBucket_* bucket = &queue->buckets[++queue->current];
+    for (int i = 0; i < bucket->size; ++i) {
+      const int cell = bucket->cells[i];
+      if (!flow_has_open_neighbor(queue, cell)) {
+        --queue->size;  // Neighbors are never reopened, so this cell would have nothing left to do.
+        continue;
+      }
+      const int err = TCOD_minheap_push(&queue->heap, flow_priority(queue->values[cell]), &cell);
+      if (err < 0) return err;
+    }
+  }
+  TCOD_minheap_pop(&queue->heap, index);
+  --queue->size;
+  return 1;
+}
+
+/**
+    Fill depressions with a priority-flood from the border.
+
+    Cells at or below the cell being processed are raised to its level and queued in the order they were found.
+    Cells above it keep their value and are traced in the order they were found as well, they only go through the
+    priority queue when one of their unvisited neighbors is not above them.  This halves the queue operations on
+    smooth terrain, and the priority queue only sorts the cells of one bucket of levels at a time.
+ */
+TCOD_Error TCOD_heightmap_fill_depressions(TCOD_heightmap_t* hm, float epsilon) {
+  if (!hm) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  const int w = hm->w;
+  const int h = hm->h;
+  float* values = hm->values;
+  bool* closed = calloc((size_t)w * h, sizeof(*closed));
+  int* raised = malloc(sizeof(*raised) * w * h);
+  int* traced = malloc(sizeof(*traced) * w * h);
+  struct TCOD_FlowQueue_ open;
+  TCOD_Error err = flow_queue_init(&open, hm, closed);
+  if (err == TCOD_E_OK && (!closed || !raised || !traced)) {
+    TCOD_set_errorv("Out of memory.");
+    err = TCOD_E_OUT_OF_MEMORY;
+  }
+  // The flood starts from every cell on the border, rows between the first and last only have their ends visited.
+  for (int y = 0; y < h && err == TCOD_E_OK; ++y) {
+    for (int x = 0; x < w && err == TCOD_E_OK; x += (y == 0 || y == h - 1 || x == w - 1) ? 1 : w - 1) {
+      const int index = x + y * w;
+      closed[index] = true;
+      err = flow_queue_push(&open, index);
+    }
+  }
+  // The border is closed from the start, so only cells from the priority queue can have neighbors off of the map.
+  const int offsets[8] = {-w - 1, -w, -w + 1, -1, 1, w - 1, w, w + 1};
+  // Both lists are emptied often, so they start over from the beginning each time to stay in the cache.
+  int raised_begin = 0;
+  int raised_end = 0;
+  int traced_begin = 0;
+  int traced_end = 0;
+  while (err == TCOD_E_OK) {
+    int index;
+    bool on_border = false;
+    const bool is_traced = traced_begin < traced_end;
+    if (is_traced) {
+      index = traced[traced_begin++];
+      if (traced_begin == traced_end) traced_begin = traced_end = 0;
+    } else if (raised_begin < raised_end) {
+      index = raised[raised_begin++];
+      if (raised_begin == raised_end) raised_begin = raised_end = 0;
+    } else {
+      const int popped = flow_queue_pop(&open, &index);
+      if (popped <= 0) {
+        err = (TCOD_Error)popped;
+        break;
+      }
+      on_border = index < w || index >= w * (h - 1) || index % w == 0 || index % w == w - 1;
+    }
+    const float level = values[index];
+    const float spill_level = flow_spill_level(level, epsilon);
+    bool spills = false;  // True if a traced cell has neighbors left for when it comes out of the queue.
+    for (int i = 0; i < 8; ++i) {
+      if (on_border) {
+        const int nx = index % w + flow_dx[i];
+        const int ny = index / w + flow_dy[i];
+        if (nx < 0 || nx >= w || ny < 0 || ny >= h) continue;
+      }
+      const int neighbor = index + offsets[i];
+      if (closed[neighbor]) continue;
+      if (values[neighbor] > level) {
+        closed[neighbor] = true;
+        traced[traced_end++] = neighbor;
+      } else if (is_traced) {
+        spills = true;
+      } else {
+        closed[neighbor] = true;
+        values[neighbor] = spill_level;
+        raised[raised_end++] = neighbor;
+      }
+    }
+    if (spills) err = flow_queue_push(&open, index);
+  }
+  flow_queue_uninit(&open);
+  free(traced);
+  free(raised);
+  free(closed);
+  return err;
+}
+
+/// The shared parameters of `TCOD_heightmap_flow_directions`.
+struct TCOD_FlowDirections_ {
+  const TCOD_heightmap_t* hm;
+  int8_t* directions;
+};
+
+/// Return the direction of the steepest downhill neighbor of the cell at `x`,`y`.
+static int8_t flow_cell_direction(const TCOD_heightmap_t* hm, int x, int y) {
+  const float value = hm->values[x + y * hm->w];
+  float steepest = 0.0f;
+  int8_t direction = TCOD_HEIGHTMAP_FLOW_NONE;
+  for (int8_t i = 0; i < 8; ++i) {
+    const int nx = x + flow_dx[i];
+    const int ny = y + flow_dy[i];
+    if (nx < 0 || nx >= hm->w || ny < 0 || ny >= hm->h) continue;
+    float drop = value - hm->values[nx + ny * hm->w];
+    if (flow_dx[i] && flow_dy[i]) drop *= 0.70710678f;
+    if (drop > steepest) {
+      steepest = drop;
+      direction = i;
+    }
+  }
+  return direction;
+}
+
+#if defined(__GNUC__) && (defined(__clang__) || __GNUC__ >= 9)
+/**
+    Cells away from the border are processed `TCOD_FLOW_LANES` at a time using GCC vector extensions.
+
+    The neighbors are compared in the same order and with the same operations as `flow_cell_direction`, so the
+    directions are the same.  Branching on every comparison is what made the scalar loop slow.
+ */
+#define TCOD_FLOW_SIMD 1
+#define TCOD_FLOW_LANES 4
+typedef float TCOD_FlowVecF_ __attribute__((vector_size(sizeof(float) * TCOD_FLOW_LANES)));
+typedef int32_t TCOD_FlowVecI_ __attribute__((vector_size(sizeof(int32_t) * TCOD_FLOW_LANES)));
+
+static inline TCOD_FlowVecF_ flow_vf_load(const float* p) {
+  TCOD_FlowVecF_ out;
+  memcpy(&out, p, sizeof(out));
+  return out;
+}
+
+/// Find the directions of `TCOD_FLOW_LANES` cells starting at `x` on the row `y`, which must not touch the border.
+static inline void flow_direction_lanes(const TCOD_heightmap_t* hm, int x, int y, int8_t* out) {
+  const float* row = &hm->values[x + y * hm->w];
+  const TCOD_FlowVecF_ value = flow_vf_load(row);
+  TCOD_FlowVecF_ steepest = {0};
+  TCOD_FlowVecI_ direction = (TCOD_FlowVecI_){0} + TCOD_HEIGHTMAP_FLOW_NONE;
+  for (int i = 0; i < 8; ++i) {
+    TCOD_FlowVecF_ drop = value - flow_vf_load(row + flow_dx[i] + flow_dy[i] * hm->w);
+    if (flow_dx[i] && flow_dy[i]) drop *= 0.70710678f;
+    const TCOD_FlowVecI_ steeper = drop > steepest;
+    steepest = (TCOD_FlowVecF_)((steeper & (TCOD_FlowVecI_)drop) | (~steeper & (TCOD_FlowVecI_)steepest));
+    direction = (steeper & i) | (~steeper & direction);
+  }
+  for (int lane = 0; lane < TCOD_FLOW_LANES; ++lane) out[lane] = (int8_t)direction[lane];
+}
+#endif  // defined(__GNUC__)
+
+/// Find the steepest downhill neighbor of every cell in the rows `[begin, end)`.
+static void flow_direction_rows(void* userdata, int begin, int end) {
+  const struct TCOD_FlowDirections_* flow = userdata;
+  const int w = flow->hm->w;
+  for (int y = begin; y < end; ++y) {
+    int8_t* row = &flow->directions[y * w];
+    int x = 0;
+#ifdef TCOD_FLOW_SIMD
+    if (y > 0 && y < flow->hm->h - 1) {
+      row[x] = flow_cell_direction(flow->hm, x, y);
+      for (x = 1; x + TCOD_FLOW_LANES < w; x += TCOD_FLOW_LANES) flow_direction_lanes(flow->hm, x, y, &row[x]);
+    }
+#endif  // TCOD_FLOW_SIMD
+    for (; x < w; ++x) row[x] = flow_cell_direction(flow->hm, x, y);
+  }
+}
+
+TCOD_Error TCOD_heightmap_flow_directions(const TCOD_heightmap_t* hm, int8_t* directions) {
+  if (!hm || !directions) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  struct TCOD_FlowDirections_ flow = {.hm = hm, .directions = directions};
+  TCOD_parallel_for(hm->h, TCOD_FLOW_ROW_GRAIN, flow_direction_rows, &flow);
+  return TCOD_E_OK;
+}
+
+/// Return true if the cell at `x`,`y` drains in `direction` into another cell of the map.
+static bool flow_drains(int w, int h, int x, int y, int8_t direction) {
+  if (direction < 0 || direction >= 8) return false;
+  const int nx = x + flow_dx[direction];
+  const int ny = y + flow_dy[direction];
+  return nx >= 0 && nx < w && ny >= 0 && ny < h;
+}
+
+TCOD_Error TCOD_heightmap_flow_accumulation(
+    const int8_t* directions, const TCOD_heightmap_t* weights, TCOD_heightmap_t* accumulation) {
+  if (!directions || !accumulation) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  const int w = accumulation->w;
+  const int h = accumulation->h;
+  if (weights && (weights->w != w || weights->h != h)) {
+    TCOD_set_errorvf(
+        "Weights must be the same size as the accumulation (%ix%i != %ix%i).", weights->w, weights->h, w, h);
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  // The low bits count the inflows of a cell, at most 8.  Walks only step from cells which are not outlets.
+  enum { OUTLET = 0x40, VISITED = 0x80 };
+  uint8_t* inflow = calloc((size_t)w * h, sizeof(*inflow));
+  if (!inflow) {
+    TCOD_set_errorv("Out of memory.");
+    return TCOD_E_OUT_OF_MEMORY;
+  }
+  const int offsets[8] = {-w - 1, -w, -w + 1, -1, 1, w - 1, w, w + 1};
+  float* values = accumulation->values;
+  if (!weights) {
+    for (int i = 0; i < w * h; ++i) values[i] = 1.0f;
+  } else if (weights->values != values) {
+    memcpy(values, weights->values, sizeof(*values) * w * h);
+  }
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      const int index = x + y * w;
+      if (flow_drains(w, h, x, y, directions[index])) {
+        ++inflow[index + offsets[directions[index]]];
+      } else {
+        inflow[index] |= OUTLET;
+      }
+    }
+  }
+  /*
+      Each cell without inflow starts a walk downstream, passing its total on to every cell it reaches.  A walk stops
+      at cells which still expect flow from other cells, the last of those walks to arrive carries on from there.
+
+      Rivers are long, so nearly all of the time goes into these walks.  Each step lands on new cache lines of all
+      three arrays whenever the flow runs across rows, which makes this bound by memory rather than by instructions.
+   */
+  for (int i = 0; i < w * h; ++i) {
+    if (inflow[i] & ~OUTLET) continue;
+    for (int cell = i; !(inflow[cell] & OUTLET);) {
+      inflow[cell] = VISITED;
+      const int next = cell + offsets[directions[cell]];
+      values[next] += values[cell];
+      if (--inflow[next] & ~OUTLET) break;
+      cell = next;
+    }
+  }
+  free(inflow);
+  return TCOD_E_OK;
+}
+
+int TCOD_heightmap_watersheds(int w, int h, const int8_t* directions, int* labels) {
+  if (!directions || !labels) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  if (w < 0 || h < 0) {
+    TCOD_set_errorvf("Invalid map size %ix%i.", w, h);
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  int* path = malloc(sizeof(*path) * w * h);
+  if (!path) {
+    TCOD_set_errorv("Out of memory.");
+    return TCOD_E_OUT_OF_MEMORY;
+  }
+  enum { UNLABELED = -2, ON_PATH = -3 };  // Cells on a cycle or draining into one end up as -1.
+  const int offsets[8] = {-w - 1, -w, -w + 1, -1, 1, w - 1, w, w + 1};
+  int count = 0;
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      labels[x + y * w] = flow_drains(w, h, x, y, directions[x + y * w]) ? UNLABELED : count++;
+    }
+  }
+  /*
+      Walk downstream from each unlabeled cell until a labeled cell, then give its label to every cell on the way.
+      Cells on the current walk are marked so that reaching one of them again ends the walk on a cycle, this way every
+      cell is only walked over once.  Only cells which drain into the map are unlabeled, so steps need no bounds checks.
+   */
+  for (int i = 0; i < w * h; ++i) {
+    int length = 0;
+    int cell = i;
+    while (labels[cell] == UNLABELED) {
+      labels[cell] = ON_PATH;
+      path[length++] = cell;
+      cell += offsets[directions[cell]];
+    }
+    const int label = labels[cell] == ON_PATH ? -1 : labels[cell];
+    while (length) labels[path[--length]] = label;
+  }
+  free(path);
+  return count;
+}
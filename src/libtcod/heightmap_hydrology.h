@@ -0,0 +1,97 @@
+/* BSD 3-Clause License
+ *
+ * Copyright © 2008-2023, Jice and the libtcod contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef TCOD_HEIGHTMAP_HYDROLOGY_H_
+#define TCOD_HEIGHTMAP_HYDROLOGY_H_
+
+#include <stdint.h>
+
+#include "config.h"
+#include "error.h"
+#include "heightmap.h"
+
+/**
+    Flow directions are the index of the neighbor a cell drains into, or -1 for cells which drain off of the map.
+
+    The neighbors are ordered as the offsets `dx = {-1, 0, 1, -1, 1, -1, 0, 1}` and `dy = {-1, -1, -1, 0, 0, 1, 1, 1}`,
+    so the direction opposite to `i` is `7 - i`.
+ */
+#define TCOD_HEIGHTMAP_FLOW_NONE -1
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+/**
+    Fill every depression of `hm` so that water can flow from any cell to the border of the map.
+
+    Uses a priority-flood from the border in O(n log n).  Cells which could not drain are raised to the level where
+    they spill over.  When `epsilon` is zero these cells form flat lakes.  When `epsilon` is positive each raised cell
+    is also at least `epsilon` above the cell it spills into, or the next representable float if `epsilon` is too
+    small to change it, so every cell away from the border has a lower neighbor.
+    Returns a negative error code on failure.
+
+    On a 4096x4096 fBm heightmap running on one core, filling takes about 0.5 seconds, flow directions 0.1 seconds,
+    flow accumulation 0.35 seconds and watersheds 0.25 seconds.  Per cell this is about twice the cost at 2048x2048:
+    the 100 MB of arrays no longer fit in the cache and rivers cross rows at nearly every step, so the priority-flood
+    and the downstream walks are bound by memory rather than by instructions.
+ */
+TCOD_PUBLIC TCOD_Error TCOD_heightmap_fill_depressions(TCOD_heightmap_t* hm, float epsilon);
+/**
+    Write the D8 flow direction of every cell of `hm` to `directions`, an array of `hm->w * hm->h` values.
+
+    Each cell drains to the neighbor with the steepest drop, where diagonal drops are divided by the square root of 2.
+    Cells without a lower neighbor get `TCOD_HEIGHTMAP_FLOW_NONE`.  Run `TCOD_heightmap_fill_depressions` with a
+    positive `epsilon` first so that only cells on the border are left without a direction.
+    Rows are processed in parallel.  Returns a negative error code on failure.
+ */
+TCOD_PUBLIC TCOD_Error TCOD_heightmap_flow_directions(const TCOD_heightmap_t* hm, int8_t* directions);
+/**
+    Accumulate the flow through every cell given the `directions` of a heightmap the same size as `accumulation`.
+
+    Each cell contributes its value in `weights` to itself and to every cell downstream, or 1 if `weights` is NULL.
+    Rivers are the cells whose accumulation is above a threshold.  This takes O(n) time.
+    Directions must not form cycles, which is the case for those from `TCOD_heightmap_flow_directions`.
+    Returns a negative error code on failure.
+ */
+TCOD_PUBLIC TCOD_Error TCOD_heightmap_flow_accumulation(
+    const int8_t* directions, const TCOD_heightmap_t* weights, TCOD_heightmap_t* accumulation);
+/**
+    Label every cell of a `w` by `h` map with the watershed it drains into, given its flow `directions`.
+
+    Cells without a direction or whose direction leaves the map are outlets, each outlet starts a watershed numbered
+    from zero in row-major order.  Every cell is labeled with the watershed of the outlet it drains into, this takes
+    O(n) time even when directions form cycles.  Cells on a cycle of directions, or draining into one, are labeled -1.
+    Returns the number of watersheds, or a negative error code on failure.
+ */
+TCOD_PUBLIC int TCOD_heightmap_watersheds(int w, int h, const int8_t* directions, int* labels);
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+#endif  // TCOD_HEIGHTMAP_HYDROLOGY_H_
@@ -46,6 +46,8 @@ struct TCOD_mipmap_ {
   float fwidth, fheight;
   TCOD_ColorRGB* __restrict buf;
   bool dirty;
+  /// When `dirty` is set, only the texels `[dirty_x0, dirty_x1)` by `[dirty_y0, dirty_y1)` are out of date.
+  int dirty_x0, dirty_y0, dirty_x1, dirty_y1;
 };
 
 typedef struct TCOD_Image {
@@ -40,18 +40,56 @@
 #include "console.h"
 #include "image.h"
 #include "libtcod_int.h"
+#include "parallel.h"
 #include "portability.h"
 #include "utility.h"
 
-static void TCOD_image_invalidate_mipmaps(TCOD_Image* image) {
-  if (!image) {
+/// Column count of the strips used by the scaled and rotated TCOD_image_blit path.
+#define TCOD_IMAGE_BLIT_STRIP 256
+
+/// Column count of the strips accumulated by TCOD_image_generate_mip_rows.
+#define TCOD_IMAGE_MIP_STRIP 256
+
+/**
+    Mark the level 0 pixels `[x0, x1)` by `[y0, y1)` as changed.
+
+    Each mipmap level grows its dirty rectangle to cover the texels built from these pixels.
+ */
+static void TCOD_image_invalidate_mipmaps_rect(TCOD_Image* image, int x0, int y0, int x1, int y1) {
+  if (!image || x0 >= x1 || y0 >= y1) {
     return;
   }
   for (int i = 1; i < image->nb_mipmaps; ++i) {
-    image->mipmaps[i].dirty = true;
+    struct TCOD_mipmap_* mip = &image->mipmaps[i];
+    const int mip_x0 = x0 >> i;
+    const int mip_y0 = y0 >> i;
+    const int mip_x1 = MIN(((x1 - 1) >> i) + 1, mip->width);
+    const int mip_y1 = MIN(((y1 - 1) >> i) + 1, mip->height);
+    if (mip_x0 >= mip_x1 || mip_y0 >= mip_y1) {
+      continue;  // These pixels are past the last texel of this level.
+    }
+    if (mip->dirty) {
+      mip->dirty_x0 = MIN(mip->dirty_x0, mip_x0);
+      mip->dirty_y0 = MIN(mip->dirty_y0, mip_y0);
+      mip->dirty_x1 = MAX(mip->dirty_x1, mip_x1);
+      mip->dirty_y1 = MAX(mip->dirty_y1, mip_y1);
+    } else {
+      mip->dirty = true;
+      mip->dirty_x0 = mip_x0;
+      mip->dirty_y0 = mip_y0;
+      mip->dirty_x1 = mip_x1;
+      mip->dirty_y1 = mip_y1;
+    }
   }
 }
 
+static void TCOD_image_invalidate_mipmaps(TCOD_Image* image) {
+  if (!image) {
+    return;
+  }
+  TCOD_image_invalidate_mipmaps_rect(image, 0, 0, image->mipmaps[0].width, image->mipmaps[0].height);
+}
+
 /**
     Return true if `x` and `y` are in the bounds of `image`.
  */
@@ -72,6 +110,71 @@ static int TCOD_image_get_mipmap_levels(int width, int height) {
   return nb_mipmap;
 }
 
+/**
+    The parameters of a TCOD_image_generate_mip call.
+ */
+struct TCOD_ImageMip_ {
+  const struct TCOD_mipmap_* orig;
+  struct TCOD_mipmap_* cur;
+  int mip;  // Level of `cur`, each texel averages `1 << mip` by `1 << mip` pixels of `orig`.
+  int x0;  // Columns `[x0, x1)` of `cur` to rebuild.
+  int x1;
+  int y0;  // First row of `cur` to rebuild.
+};
+
+/// Rebuild the rows `[begin, end)` after `y0` of a mipmap level.  Rows are independent, so bands run on any thread.
+static void TCOD_image_generate_mip_rows(void* __restrict userdata, int begin, int end) {
+  const struct TCOD_ImageMip_* job = userdata;
+  const struct TCOD_mipmap_* orig = job->orig;
+  struct TCOD_mipmap_* cur = job->cur;
+  const int mip = job->mip;
+  const int size = 1 << mip;
+  // Texels average a power of 4 pixels, so the division by the pixel count is a shift.
+  const int count_shift = mip * 2;
+  for (int y = job->y0 + begin; y < job->y0 + end; ++y) {
+    TCOD_ColorRGB* __restrict out = &cur->buf[y * cur->width];
+    if (mip == 1) {  // The common 2x2 box filter.
+      const TCOD_ColorRGB* __restrict top = &orig->buf[(y * 2) * orig->width];
+      const TCOD_ColorRGB* __restrict bottom = top + orig->width;
+      for (int x = job->x0; x < job->x1; ++x) {
+        out[x] = (TCOD_ColorRGB){
+            (uint8_t)((top[x * 2].r + top[x * 2 + 1].r + bottom[x * 2].r + bottom[x * 2 + 1].r) >> 2),
+            (uint8_t)((top[x * 2].g + top[x * 2 + 1].g + bottom[x * 2].g + bottom[x * 2 + 1].g) >> 2),
+            (uint8_t)((top[x * 2].b + top[x * 2 + 1].b + bottom[x * 2].b + bottom[x * 2 + 1].b) >> 2),
+        };
+      }
+      continue;
+    }
+    // Larger boxes are summed one source row at a time into per-texel accumulators.
+    uint32_t sum[TCOD_IMAGE_MIP_STRIP][3];
+    for (int strip_x = job->x0; strip_x < job->x1; strip_x += TCOD_IMAGE_MIP_STRIP) {
+      const int strip_w = MIN(job->x1 - strip_x, TCOD_IMAGE_MIP_STRIP);
+      memset(sum, 0, sizeof(sum[0]) * strip_w);
+      for (int sy = y << mip; sy < (y + 1) << mip; ++sy) {
+        const TCOD_ColorRGB* __restrict src = &orig->buf[sy * orig->width + (strip_x << mip)];
+        for (int i = 0; i < strip_w; ++i) {
+          for (int sx = 0; sx < size; ++sx) {
+            sum[i][0] += src[sx].r;
+            sum[i][1] += src[sx].g;
+            sum[i][2] += src[sx].b;
+          }
+          src += size;
+        }
+      }
+      for (int i = 0; i < strip_w; ++i) {
+        out[strip_x + i] = (TCOD_ColorRGB){
+            (uint8_t)(sum[i][0] >> count_shift),
+            (uint8_t)(sum[i][1] >> count_shift),
+            (uint8_t)(sum[i][2] >> count_shift),
+        };
+      }
+    }
+  }
+}
+
+/**
+    Bring mipmap level `mip` up to date, only rebuilding its dirty rectangle.
+ */
 static void TCOD_image_generate_mip(TCOD_Image* image, int mip) {
   if (!image) {
     return;
@@ -80,30 +183,28 @@ static void TCOD_image_generate_mip(TCOD_Image* image, int mip) {
   struct TCOD_mipmap_* cur = &image->mipmaps[mip];
   if (!cur->buf) {
     cur->buf = malloc(sizeof(*cur->buf) * cur->width * cur->height);
-  }
-  cur->dirty = false;
-  for (int x = 0; x < cur->width; ++x) {
-    for (int y = 0; y < cur->height; ++y) {
-      int r = 0;
-      int g = 0;
-      int b = 0;
-      int count = 0;
-      for (int sx = x << mip; sx < (x + 1) << mip; ++sx) {
-        for (int sy = y << mip; sy < (y + 1) << mip; ++sy) {
-          int offset = sx + sy * orig->width;
-          ++count;
-          r += orig->buf[offset].r;
-          g += orig->buf[offset].g;
-          b += orig->buf[offset].b;
-        }
-      }
-      cur->buf[x + y * cur->width] = (struct TCOD_ColorRGB){
-          (uint8_t)(r / count),
-          (uint8_t)(g / count),
-          (uint8_t)(b / count),
-      };
+    if (!cur->buf) {
+      return;
     }
+    cur->dirty_x0 = cur->dirty_y0 = 0;
+    cur->dirty_x1 = cur->width;
+    cur->dirty_y1 = cur->height;
+  } else if (!cur->dirty) {
+    return;
   }
+  cur->dirty = false;
+  struct TCOD_ImageMip_ job = {
+      .orig = orig,
+      .cur = cur,
+      .mip = mip,
+      .x0 = cur->dirty_x0,
+      .x1 = cur->dirty_x1,
+      .y0 = cur->dirty_y0,
+  };
+  const int rows = cur->dirty_y1 - cur->dirty_y0;
+  // Aim for at least 64K source pixels per band.
+  const int row_pixels = MAX(1, (job.x1 - job.x0) << (mip * 2));
+  TCOD_parallel_for(rows, MAX(1, 65536 / row_pixels), TCOD_image_generate_mip_rows, &job);
 }
 
 void TCOD_image_clear(TCOD_Image* image, TCOD_color_t color) {
@@ -196,6 +297,9 @@ TCOD_color_t TCOD_image_get_mipmap_pixel(TCOD_Image* image, float x0, float y0,
   int texel_y = (int)(y0 * (image->mipmaps[mip].height) / image->mipmaps[0].fheight);
   if (image->mipmaps[mip].buf == NULL || image->mipmaps[mip].dirty) {
     TCOD_image_generate_mip(image, mip);
+    if (image->mipmaps[mip].buf == NULL) {
+      return (TCOD_ColorRGB){0, 0, 0};  // Out of memory.
+    }
   }
   if (texel_x < 0 || texel_y < 0 || texel_x >= image->mipmaps[mip].width || texel_y >= image->mipmaps[mip].height) {
     return (TCOD_ColorRGB){0, 0, 0};
@@ -209,7 +313,7 @@ void TCOD_image_put_pixel(TCOD_Image* image, int x, int y, TCOD_color_t col) {
   }
   if (TCOD_image_in_bounds(image, x, y)) {
     image->mipmaps[0].buf[x + y * image->mipmaps[0].width] = col;
-    TCOD_image_invalidate_mipmaps(image);
+    TCOD_image_invalidate_mipmaps_rect(image, x, y, x + 1, y + 1);
   }
 }
 
@@ -251,6 +355,31 @@ bool TCOD_image_is_pixel_transparent(const TCOD_Image* image, int x, int y) {
   return false;
 }
 
+/**
+    Blend a clipped row of image pixels onto `console`, skipping pixels matching `key_color`.
+ */
+static void TCOD_image_blit_row_(
+    TCOD_Console* console,
+    int x,
+    int y,
+    int n,
+    const TCOD_ColorRGB* src,
+    const TCOD_ColorRGB* key_color,
+    TCOD_bkgnd_flag_t bkgnd_flag) {
+  if (!key_color) {
+    TCOD_console_blend_background_row_(console, x, y, n, src, bkgnd_flag);
+    return;
+  }
+  int run_start = 0;
+  for (int i = 0; i < n; ++i) {
+    if (src[i].r == key_color->r && src[i].g == key_color->g && src[i].b == key_color->b) {
+      TCOD_console_blend_background_row_(console, x + run_start, y, i - run_start, src + run_start, bkgnd_flag);
+      run_start = i + 1;
+    }
+  }
+  TCOD_console_blend_background_row_(console, x + run_start, y, n - run_start, src + run_start, bkgnd_flag);
+}
+
 void TCOD_image_blit(
     TCOD_Image* image,
     TCOD_Console* console,
@@ -290,14 +419,10 @@ void TCOD_image_blit(
     if (iy < 0) {
       offset_y = -iy;
     }
-    for (int cx = min_x; cx < max_x; ++cx) {
-      for (int cy = min_y; cy < max_y; ++cy) {
-        TCOD_color_t col = TCOD_image_get_pixel(image, cx - min_x + offset_x, cy - min_y + offset_y);
-        if (!image->has_key_color || image->key_color.r != col.r || image->key_color.g != col.g ||
-            image->key_color.b != col.b) {
-          TCOD_console_set_char_background(console, cx, cy, col, bkgnd_flag);
-        }
-      }
+    const struct TCOD_ColorRGB* key_color = image->has_key_color ? &image->key_color : NULL;
+    for (int cy = min_y; cy < max_y && min_x < max_x; ++cy) {
+      const TCOD_ColorRGB* src = &image->mipmaps[0].buf[(cy - min_y + offset_y) * width + offset_x];
+      TCOD_image_blit_row_(console, min_x, cy, max_x - min_x, src, key_color, bkgnd_flag);
     }
   } else {
     float iw = width / 2 * scale_x;
@@ -332,19 +457,40 @@ void TCOD_image_blit(
     int max_y = MIN(ry + rh, TCOD_console_get_height(console));
     float inv_scale_x = 1.0f / scale_x;
     float inv_scale_y = 1.0f / scale_y;
-    for (int cx = min_x; cx < max_x; ++cx) {
+    const bool use_mipmap = scale_x < 1.0f || scale_y < 1.0f;
+    // Sampling coordinates are built from per-column and per-row terms, added in the same order as
+    // `(iw + (cx - x) * new_xx + (cy - y) * (-new_yx)) * inv_scale_x` so every cell samples the same texel.
+    float col_x[TCOD_IMAGE_BLIT_STRIP];
+    float col_y[TCOD_IMAGE_BLIT_STRIP];
+    TCOD_ColorRGB colors[TCOD_IMAGE_BLIT_STRIP];
+    for (int strip_x = min_x; strip_x < max_x; strip_x += TCOD_IMAGE_BLIT_STRIP) {
+      const int strip_w = MIN(max_x - strip_x, TCOD_IMAGE_BLIT_STRIP);
+      for (int i = 0; i < strip_w; ++i) {
+        col_x[i] = (strip_x + i - x) * new_xx;
+        col_y[i] = (strip_x + i - x) * new_xy;
+      }
       for (int cy = min_y; cy < max_y; ++cy) {
-        /* map the console pixel to the image world */
-        float ix = (iw + (cx - x) * new_xx + (cy - y) * (-new_yx)) * inv_scale_x;
-        float iy = (ih + (cx - x) * new_xy - (cy - y) * new_yy) * inv_scale_y;
-        TCOD_color_t col = TCOD_image_get_pixel(image, (int)ix, (int)iy);
-        if (!image->has_key_color || image->key_color.r != col.r || image->key_color.g != col.g ||
-            image->key_color.b != col.b) {
-          if (scale_x < 1.0f || scale_y < 1.0f) {
+        const float row_x = (cy - y) * (-new_yx);
+        const float row_y = (cy - y) * new_yy;
+        int run_start = 0;  // Opaque cells are collected into runs and flushed at each transparent cell.
+        for (int i = 0; i < strip_w; ++i) {
+          const float ix = (iw + col_x[i] + row_x) * inv_scale_x;
+          const float iy = (ih + col_y[i] - row_y) * inv_scale_y;
+          TCOD_color_t col = TCOD_image_get_pixel(image, (int)ix, (int)iy);
+          if (image->has_key_color && image->key_color.r == col.r && image->key_color.g == col.g &&
+              image->key_color.b == col.b) {
+            TCOD_console_blend_background_row_(
+                console, strip_x + run_start, cy, i - run_start, colors + run_start, bkgnd_flag);
+            run_start = i + 1;
+            continue;
+          }
+          if (use_mipmap) {
             col = TCOD_image_get_mipmap_pixel(image, ix, iy, ix + 1.0f, iy + 1.0f);
           }
-          TCOD_console_set_char_background(console, cx, cy, col, bkgnd_flag);
+          colors[i] = col;
         }
+        TCOD_console_blend_background_row_(
+            console, strip_x + run_start, cy, strip_w - run_start, colors + run_start, bkgnd_flag);
       }
     }
   }
@@ -709,6 +855,37 @@ static int rgb_squared_distance(const TCOD_ColorRGB* c1, const TCOD_ColorRGB* c2
   return dr * dr + dg * dg + db * db;
 }
 
+// The same as TCOD_color_lerp, inlined for generate_quadrant_graphic.
+static inline TCOD_ColorRGB quadrant_lerp(TCOD_ColorRGB c1, TCOD_ColorRGB c2, float coef) {
+  return (TCOD_ColorRGB){
+      (uint8_t)(c1.r + (c2.r - c1.r) * coef),
+      (uint8_t)(c1.g + (c2.g - c1.g) * coef),
+      (uint8_t)(c1.b + (c2.b - c1.b) * coef),
+  };
+}
+
+// Pack a color into an integer so that quadrant colors are compared in one operation.
+static inline uint32_t quadrant_key(TCOD_ColorRGB c) {
+  return (uint32_t)c.r | (uint32_t)c.g << 8 | (uint32_t)c.b << 16;
+}
+
+// Return a quadrant tile from its codepoint and {bg color, fg color} palette.
+static inline TCOD_ConsoleTile quadrant_tile(int codepoint, const TCOD_ColorRGB palette[2]) {
+  if (codepoint >= 0) {
+    return (TCOD_ConsoleTile){
+        .ch = codepoint,
+        .fg = (TCOD_ColorRGBA){palette[1].r, palette[1].g, palette[1].b, 255},
+        .bg = (TCOD_ColorRGBA){palette[0].r, palette[0].g, palette[0].b, 255},
+    };
+  } else {  // A negative codepoint means we invert the bg/fg colors.
+    return (TCOD_ConsoleTile){
+        .ch = -codepoint,
+        .fg = (TCOD_ColorRGBA){palette[0].r, palette[0].g, palette[0].b, 255},
+        .bg = (TCOD_ColorRGBA){palette[1].r, palette[1].g, palette[1].b, 255},
+    };
+  }
+}
+
 // Return a new tile graphic from 4 quadrant colors.
 static TCOD_ConsoleTile generate_quadrant_graphic(const TCOD_ColorRGB desired[4]) {
   // adapted from Jeff Lait's code posted on r.g.r.d
@@ -718,9 +895,8 @@ static TCOD_ConsoleTile generate_quadrant_graphic(const TCOD_ColorRGB desired[4]
       X 1
       2 4
    */
-  int quadrant_mask = 0;
   // Maps a mask of quadrants to a codepoint.  A negative codepoint means to swap the fg/bg values.
-  static int quadrant_to_codepoint[8] = {
+  static const int quadrant_to_codepoint[8] = {
       0,
       0x259D,  // Quadrant upper right.
       0x2597,  // Quadrant lower left.
@@ -730,30 +906,35 @@ static TCOD_ConsoleTile generate_quadrant_graphic(const TCOD_ColorRGB desired[4]
       -0x2580,  // Upper half block.
       -0x2598  // Quadrant upper left.
   };
-  int quadrant_index;  // The active color quadrant being checked.
-  // Ignore all quadrants matching the first color.
-  for (quadrant_index = 1; quadrant_index < 4; ++quadrant_index) {
-    if (!TCOD_color_equals(desired[quadrant_index], desired[0])) {
-      break;  // Found a second color, will continue to check for colors from this index.
-    }
-  }
-  if (quadrant_index == 4) {  // This tile is a solid color.
+  const uint32_t key[4] = {
+      quadrant_key(desired[0]), quadrant_key(desired[1]), quadrant_key(desired[2]), quadrant_key(desired[3])};
+  // The pattern of quadrants which differ from the first color.
+  const int differs = (key[1] != key[0]) | (key[2] != key[0]) << 1 | (key[3] != key[0]) << 2;
+  if (!differs) {  // This tile is a solid color.
     return (TCOD_ConsoleTile){
         .ch = ' ',
         .fg = {desired[0].r, desired[0].g, desired[0].b, 255},
         .bg = {desired[0].r, desired[0].g, desired[0].b, 255},
     };
   }
+  // The first quadrant with a second color.
+  int quadrant_index = (differs & 1) ? 1 : (differs & 2) ? 2 : 3;
   TCOD_ColorRGB palette[2] = {desired[0], desired[quadrant_index]};  // The current color palette: {bg color, fg color}.
+  uint32_t palette_key[2] = {key[0], key[quadrant_index]};
+  // The pattern of quadrants matching the second color.
+  int quadrant_mask = (key[1] == palette_key[1]) | (key[2] == palette_key[1]) << 1 | (key[3] == palette_key[1]) << 2;
+  if ((differs & ~quadrant_mask) == 0) {
+    // Only two colors, the pattern is the glyph.  The merges below are only needed for a third color.
+    return quadrant_tile(quadrant_to_codepoint[quadrant_mask], palette);
+  }
   int weight[2] = {quadrant_index, 1};  // Number of quadrants that each pallette color is assigned, respectively.
-  quadrant_mask |= 1 << (quadrant_index - 1);
+  quadrant_mask = 1 << (quadrant_index - 1);
   /* remaining colours */
-  ++quadrant_index;
-  while (quadrant_index < 4) {
-    if (TCOD_color_equals(desired[quadrant_index], palette[0])) {
+  for (++quadrant_index; quadrant_index < 4; ++quadrant_index) {
+    if (key[quadrant_index] == palette_key[0]) {
       // Assign to the background color.
       ++weight[0];
-    } else if (TCOD_color_equals(desired[quadrant_index], palette[1])) {
+    } else if (key[quadrant_index] == palette_key[1]) {
       // Assign to the foreground color.
       quadrant_mask |= 1 << (quadrant_index - 1);
       ++weight[1];
@@ -762,47 +943,77 @@ static TCOD_ConsoleTile generate_quadrant_graphic(const TCOD_ColorRGB desired[4]
       const int dist_0_q = rgb_squared_distance(&desired[quadrant_index], &palette[0]);
       const int dist_1_q = rgb_squared_distance(&desired[quadrant_index], &palette[1]);
       const int dist_0_1 = rgb_squared_distance(&palette[0], &palette[1]);
-      if (dist_0_q < dist_1_q) {
-        if (dist_0_q <= dist_0_1) {
-          // Merge 0 and quadrant_index.
-          palette[0] = TCOD_color_lerp(desired[quadrant_index], palette[0], weight[0] / (1.0f + weight[0]));
-          ++weight[0];
-        } else {
-          // Merge 0 and 1.
-          palette[0] = TCOD_color_lerp(palette[0], palette[1], (float)weight[1] / (weight[0] + weight[1]));
-          ++weight[0];
-          palette[1] = desired[quadrant_index];
-          quadrant_mask = 1 << (quadrant_index - 1);
-        }
+      if (dist_0_q < dist_1_q && dist_0_q <= dist_0_1) {
+        // Merge 0 and quadrant_index.
+        palette[0] = quadrant_lerp(desired[quadrant_index], palette[0], weight[0] / (1.0f + weight[0]));
+        ++weight[0];
+      } else if (dist_0_q >= dist_1_q && dist_1_q <= dist_0_1) {
+        // Merge 1 and quadrant_index.
+        palette[1] = quadrant_lerp(desired[quadrant_index], palette[1], weight[1] / (1.0f + weight[1]));
+        ++weight[1];
+        quadrant_mask |= 1 << (quadrant_index - 1);
       } else {
-        if (dist_1_q <= dist_0_1) {
-          // Merge 1 and quadrant_index.
-          palette[1] = TCOD_color_lerp(desired[quadrant_index], palette[1], weight[1] / (1.0f + weight[1]));
-          ++weight[1];
-          quadrant_mask |= 1 << (quadrant_index - 1);
-        } else {
-          // Merge 0 and 1.
-          palette[0] = TCOD_color_lerp(palette[0], palette[1], (float)weight[1] / (weight[0] + weight[1]));
-          ++weight[0];
-          palette[1] = desired[quadrant_index];
-          quadrant_mask = 1 << (quadrant_index - 1);
-        }
+        // Merge 0 and 1.
+        palette[0] = quadrant_lerp(palette[0], palette[1], (float)weight[1] / (weight[0] + weight[1]));
+        ++weight[0];
+        palette[1] = desired[quadrant_index];
+        quadrant_mask = 1 << (quadrant_index - 1);
       }
+      palette_key[0] = quadrant_key(palette[0]);
+      palette_key[1] = quadrant_key(palette[1]);
     }
-    ++quadrant_index;
   }
-  if (quadrant_to_codepoint[quadrant_mask] >= 0) {
-    return (TCOD_ConsoleTile){
-        .ch = quadrant_to_codepoint[quadrant_mask],
-        .fg = (TCOD_ColorRGBA){palette[1].r, palette[1].g, palette[1].b, 255},
-        .bg = (TCOD_ColorRGBA){palette[0].r, palette[0].g, palette[0].b, 255},
-    };
-  } else {  // A negative codepoint means we invert the bg/fg colors.
-    return (TCOD_ConsoleTile){
-        .ch = -quadrant_to_codepoint[quadrant_mask],
-        .fg = (TCOD_ColorRGBA){palette[0].r, palette[0].g, palette[0].b, 255},
-        .bg = (TCOD_ColorRGBA){palette[1].r, palette[1].g, palette[1].b, 255},
-    };
+  return quadrant_tile(quadrant_to_codepoint[quadrant_mask], palette);
+}
+
+/**
+    The shared parameters of a TCOD_image_blit_2x call, in console cells which are already clipped.
+ */
+struct TCOD_ImageBlit2x_ {
+  const TCOD_Image* image;
+  TCOD_Console* console;
+  int dest_x;  // Console position of the `src_x`,`src_y` pixel.
+  int dest_y;
+  int src_x;
+  int src_y;
+  int max_x;  // Exclusive end of the blitted image pixels.
+  int max_y;
+  int begin_x;  // Blitted console columns.
+  int end_x;
+  int begin_y;  // First blitted console row.
+};
+
+/// Render the console rows `[begin, end)` after `begin_y`.  Rows are independent, so bands can run on any thread.
+static void TCOD_image_blit_2x_rows(void* __restrict userdata, int begin, int end) {
+  const struct TCOD_ImageBlit2x_* blit = userdata;
+  const TCOD_Image* image = blit->image;
+  const int img_width = image->mipmaps[0].width;
+  for (int console_y = blit->begin_y + begin; console_y < blit->begin_y + end; ++console_y) {
+    const int img_y = blit->src_y + (console_y - blit->dest_y) * 2;
+    const TCOD_ColorRGB* top = &image->mipmaps[0].buf[img_y * img_width];
+    const TCOD_ColorRGB* bottom = img_y < blit->max_y - 1 ? top + img_width : NULL;
+    TCOD_ConsoleTile* tiles = &blit->console->tiles[console_y * blit->console->w];
+    for (int console_x = blit->begin_x; console_x < blit->end_x; ++console_x) {
+      const int img_x = blit->src_x + (console_x - blit->dest_x) * 2;
+      const bool has_right = img_x < blit->max_x - 1;
+      const TCOD_ColorRGB console_back = {tiles[console_x].bg.r, tiles[console_x].bg.g, tiles[console_x].bg.b};
+      /* get the 2x2 super pixel colors from the image */
+      TCOD_ColorRGB grid[4] = {
+          top[img_x],
+          has_right ? top[img_x + 1] : console_back,
+          bottom ? bottom[img_x] : console_back,
+          bottom && has_right ? bottom[img_x + 1] : console_back,
+      };
+      if (image->has_key_color) {
+        for (int i = 0; i < 4; ++i) {
+          if (TCOD_color_equals(grid[i], image->key_color)) {
+            grid[i] = console_back;
+          }
+        }
+      }
+      /* analyze color, posterize, get pattern */
+      tiles[console_x] = generate_quadrant_graphic(grid);
+    }
   }
 }
 
@@ -839,46 +1050,22 @@ void TCOD_image_blit_2x(
   TCOD_IFNOT(dest_x + max_x / 2 >= 0 && dest_y + max_y / 2 >= 0 && dest_x < console->w && dest_y < console->h) {
     return;
   }
-  max_x += src_x;
-  max_y += src_y;
-
-  for (int img_x = src_x; img_x < max_x; img_x += 2) {
-    for (int img_y = src_y; img_y < max_y; img_y += 2) {
-      TCOD_ColorRGB grid[4];
-      /* get the 2x2 super pixel colors from the image */
-      const int console_x = dest_x + (img_x - src_x) / 2;
-      const int console_y = dest_y + (img_y - src_y) / 2;
-      TCOD_ColorRGB consoleBack = TCOD_console_get_char_background(console, console_x, console_y);
-      grid[0] = TCOD_image_get_pixel(image, img_x, img_y);
-      if (image->has_key_color && TCOD_color_equals(grid[0], image->key_color)) {
-        grid[0] = consoleBack;
-      }
-      if (img_x < max_x - 1) {
-        grid[1] = TCOD_image_get_pixel(image, img_x + 1, img_y);
-        if (image->has_key_color && TCOD_color_equals(grid[1], image->key_color)) {
-          grid[1] = consoleBack;
-        }
-      } else {
-        grid[1] = consoleBack;
-      }
-      if (img_y < max_y - 1) {
-        grid[2] = TCOD_image_get_pixel(image, img_x, img_y + 1);
-        if (image->has_key_color && TCOD_color_equals(grid[2], image->key_color)) {
-          grid[2] = consoleBack;
-        }
-      } else {
-        grid[2] = consoleBack;
-      }
-      if (img_x < max_x - 1 && img_y < max_y - 1) {
-        grid[3] = TCOD_image_get_pixel(image, img_x + 1, img_y + 1);
-        if (image->has_key_color && TCOD_color_equals(grid[3], image->key_color)) {
-          grid[3] = consoleBack;
-        }
-      } else {
-        grid[3] = consoleBack;
-      }
-      /* analyze color, posterize, get pattern */
-      console->tiles[console_y * console->w + console_x] = generate_quadrant_graphic(grid);
-    }
-  }
+  struct TCOD_ImageBlit2x_ blit = {
+      .image = image,
+      .console = console,
+      .dest_x = dest_x,
+      .dest_y = dest_y,
+      .src_x = src_x,
+      .src_y = src_y,
+      .max_x = src_x + max_x,
+      .max_y = src_y + max_y,
+      // Each console cell covers 2x2 pixels, the last one may be partial.
+      .begin_x = MAX(dest_x, 0),
+      .end_x = MIN(dest_x + (max_x + 1) / 2, console->w),
+      .begin_y = MAX(dest_y, 0),
+  };
+  const int end_y = MIN(dest_y + (max_y + 1) / 2, console->h);
+  if (blit.begin_x >= blit.end_x || blit.begin_y >= end_y) return;
+  const int grain = MAX(1, 4096 / (blit.end_x - blit.begin_x));
+  TCOD_parallel_for(end_y - blit.begin_y, grain, TCOD_image_blit_2x_rows, &blit);
 }
@@ -47,6 +47,9 @@
 #include "fov.h"
 #include "globals.h"
 #include "heightmap.h"
+#include "heightmap_chunked.h"
+#include "heightmap_compact.h"
+#include "heightmap_hydrology.h"
 #include "image.h"
 #include "lex.h"
 #include "list.h"
@@ -55,6 +58,8 @@
 #include "mouse.h"
 #include "namegen.h"
 #include "noise.h"
+#include "noise_texture.h"
+#include "parallel.h"
 #include "parser.h"
 #include "path.h"
 #include "pathfinder.h"
@@ -520,6 +520,14 @@ static inline TCOD_Console* TCOD_console_validate_(const TCOD_Console* console)
 static inline bool TCOD_console_is_index_valid_(const TCOD_Console* console, int x, int y) {
   return console && 0 <= x && x < console->w && 0 <= y && y < console->h;
 }
+/**
+ *  Blend `n` background colors into the row of tiles starting at `x`,`y`.
+ *
+ *  The run must already be clipped to the console.  This is the bulk form of
+ *  TCOD_console_set_char_background with the flag dispatch hoisted out of the loop.
+ */
+void TCOD_console_blend_background_row_(
+    TCOD_Console* __restrict con, int x, int y, int n, const TCOD_ColorRGB* __restrict colors, TCOD_bkgnd_flag_t flag);
 TCOD_event_t TCOD_sys_handle_mouse_event(const union SDL_Event* ev, TCOD_mouse_t* mouse);
 TCOD_event_t TCOD_sys_handle_key_event(const union SDL_Event* ev, TCOD_key_t* key);
 #ifdef __cplusplus
@@ -32,7 +32,11 @@
 #ifndef _TCOD_PERLIN_H
 #define _TCOD_PERLIN_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "config.h"
+#include "error.h"
 #include "mersenne_types.h"
 #include "noise_defaults.h"
 
@@ -40,9 +44,26 @@ typedef enum {
   TCOD_NOISE_PERLIN = 1,
   TCOD_NOISE_SIMPLEX = 2,
   TCOD_NOISE_WAVELET = 4,
+  /**
+      Worley (cellular) noise from the distance to the nearest feature point of a jittered grid.
+
+      Each unit cell holds one feature point.  Distances are returned as `distance * 2 - 1`, clamped to -1 and 1.
+   */
+  TCOD_NOISE_WORLEY_F1 = 8,
+  TCOD_NOISE_WORLEY_F2 = 16,  // Worley noise from the distance to the second nearest feature point.
+  TCOD_NOISE_WORLEY_F2_F1 = 32,  // Worley noise from the difference of the nearest two distances.
   TCOD_NOISE_DEFAULT = 0
 } TCOD_noise_type_t;
 
+/**
+    How the octaves of a noise generator are combined.
+ */
+typedef enum TCOD_NoiseMode {
+  TCOD_NOISE_MODE_PLAIN = 0,  // A single sample of noise, octaves are ignored.
+  TCOD_NOISE_MODE_FBM = 1,  // Fractional Brownian motion, as with `TCOD_noise_get_fbm`.
+  TCOD_NOISE_MODE_TURBULENCE = 2,  // Turbulence, as with `TCOD_noise_get_turbulence`.
+} TCOD_NoiseMode;
+
 typedef struct TCOD_Noise {
   int ndim;
   /** Randomized map of indexes into buffer */
@@ -57,8 +78,14 @@ typedef struct TCOD_Noise {
   TCOD_Random* rand;
   /* noise type */
   TCOD_noise_type_t noise_type;
+  /** The shared tile `waveletTileData` points into, or NULL if the tile belongs to this object. */
+  struct TCOD_NoiseWaveletTile* wavelet_tile;
 } TCOD_Noise;
 typedef TCOD_Noise* TCOD_noise_t;
+/**
+    A reference counted wavelet noise tile which can be shared by many noise objects.
+ */
+typedef struct TCOD_NoiseWaveletTile TCOD_NoiseWaveletTile;
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -156,6 +183,120 @@ TCOD_PUBLIC void TCOD_noise_get_turbulence_vectorized(
     float* __restrict z,
     float* __restrict w,
     float* __restrict out);
+/**
+    Return a new reference to the wavelet tile generated from `seed`.
+
+    Wavelet noise samples from a large tile which is normally built by each noise object on its first wavelet sample.
+    Tiles from this function are built once per seed and shared until every reference is released.
+
+    If `cache_path` is not NULL then the tile is memory-mapped from that file when it holds a tile of the same seed,
+    otherwise the tile is built and then written to that file.  Failing to write the cache is not an error.
+
+    Tiles are not thread-safe, get and release them from one thread.
+    Returns NULL on failure.
+ */
+TCOD_NODISCARD
+TCOD_PUBLIC TCOD_NoiseWaveletTile* TCOD_noise_wavelet_tile_get(uint32_t seed, const char* cache_path);
+/**
+    Release a reference from `TCOD_noise_wavelet_tile_get`.  The tile is freed once it is no longer used.
+ */
+TCOD_PUBLIC void TCOD_noise_wavelet_tile_release(TCOD_NoiseWaveletTile* tile);
+/**
+    Make `noise` use a shared wavelet tile, `noise` takes its own reference to `tile`.
+
+    Passing NULL returns `noise` to building its own tile from its random generator.
+ */
+TCOD_PUBLIC TCOD_Error TCOD_noise_set_wavelet_tile(TCOD_Noise* __restrict noise, TCOD_NoiseWaveletTile* tile);
+/**
+    Return Perlin or simplex noise along with its partial derivatives.
+
+    The value is the same as `TCOD_noise_get_ex`.  `gradient` receives one derivative for each noise dimension, it can
+    be NULL.  Derivatives are zero where the noise is clamped.
+
+    Only 1 to 3 dimensional Perlin and simplex noise are supported, other noise returns NaN.
+ */
+TCOD_NODISCARD
+TCOD_PUBLIC float TCOD_noise_get_with_gradient(
+    TCOD_Noise* __restrict noise, const float* __restrict f, TCOD_noise_type_t type, float* __restrict gradient);
+/**
+    Return fractional Brownian motion noise along with its partial derivatives.
+
+    The value is the same as `TCOD_noise_get_fbm_ex`, the other parameters are the same as
+    `TCOD_noise_get_with_gradient`.
+ */
+TCOD_NODISCARD
+TCOD_PUBLIC float TCOD_noise_get_fbm_with_gradient(
+    TCOD_Noise* __restrict noise,
+    const float* __restrict f,
+    float octaves,
+    TCOD_noise_type_t type,
+    float* __restrict gradient);
+/**
+    Generate noise with its derivatives as a vectorized operation.
+
+    `x[n]`, `y[n]`, `z[n]` are the input coordinates, unused axes can be NULL.
+    `out[n]` receives the noise values and `dx[n]`, `dy[n]`, `dz[n]` receive the derivatives along each axis.
+    Any of the output arrays can be NULL if they are not needed.
+
+    2D and 3D noise is evaluated several points at a time with SIMD kernels, using AVX2 when the CPU supports it.
+    Results are the same as `TCOD_noise_get_with_gradient`, whose remaining parameters are also the same.
+ */
+TCOD_PUBLIC void TCOD_noise_get_with_gradient_vectorized(
+    TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    int n,
+    const float* __restrict x,
+    const float* __restrict y,
+    const float* __restrict z,
+    float* __restrict out,
+    float* __restrict dx,
+    float* __restrict dy,
+    float* __restrict dz);
+/**
+    Generate fractional Brownian motion noise with its derivatives as a vectorized operation.
+
+    The parameters are the same as `TCOD_noise_get_with_gradient_vectorized`.
+ */
+TCOD_PUBLIC void TCOD_noise_get_fbm_with_gradient_vectorized(
+    TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    float octaves,
+    int n,
+    const float* __restrict x,
+    const float* __restrict y,
+    const float* __restrict z,
+    float* __restrict out,
+    float* __restrict dx,
+    float* __restrict dy,
+    float* __restrict dz);
+/**
+    Fill a strided grid of floats with noise, splitting its rows across multiple threads.
+
+    `ndim` is the number of grid axes, between 1 and the dimensions of `noise`.
+    Grid axis `i` is noise axis `i`, so for a 2D grid `shape[0]` is the width and `shape[1]` is the height.
+
+    The noise is sampled at `(index[i] + offset[i]) * scale[i]` on each axis, noise axes beyond `ndim` use an index
+    of zero.  `offset` and `scale` have one value for each noise dimension, they default to zero and one when NULL.
+
+    `strides` is the distance in bytes between grid elements along each axis.  When NULL the grid is contiguous
+    with the first axis varying the fastest, which is the layout of `TCOD_heightmap_t`.
+
+    `type`, `mode`, and `octaves` select the noise function as with the vectorized functions.
+    Results do not depend on the number of threads used.
+
+    Returns a negative error code on failure.
+ */
+TCOD_PUBLIC TCOD_Error TCOD_noise_fill_grid(
+    TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    TCOD_NoiseMode mode,
+    float octaves,
+    int ndim,
+    const int* __restrict shape,
+    const size_t* __restrict strides,
+    const float* __restrict offset,
+    const float* __restrict scale,
+    float* __restrict out);
 #ifdef __cplusplus
 }
 #endif
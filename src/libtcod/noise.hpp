@@ -334,6 +334,18 @@ float TCOD_noise_get_turbulence_ex(TCOD_noise_t noise, float *f, float octaves,
 		float getTurbulence(float *f, float octaves, TCOD_noise_type_t type = TCOD_NOISE_DEFAULT);
 		float getTurbulence(const float *f, float octaves, TCOD_noise_type_t type = TCOD_NOISE_DEFAULT);
 
+    /**
+        Return this objects `TCOD_Noise*` pointer, for the C functions such as `TCOD_noise_fill_grid`.
+     */
+		TCOD_Noise* get_data() noexcept
+		{
+			return data;
+		}
+		const TCOD_Noise* get_data() const noexcept
+		{
+			return data;
+		}
+
 	protected :
 		friend class TCODLIB_API TCODHeightMap;
 		TCOD_noise_t data;
@@ -31,11 +31,25 @@
  */
 #include <float.h>
 #include <math.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define NOMINMAX 1
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // _WIN32
 
 #include "error.h"
 #include "mersenne.h"
 #include "noise.h"
+#include "parallel.h"
 #include "utility.h"
 
 #define WAVELET_TILE_SIZE 32
@@ -723,13 +737,20 @@ static void TCOD_noise_wavelet_upsample(const float* __restrict from, float* __r
   }
 }
 
-static void TCOD_noise_wavelet_init(TCOD_Noise* __restrict data) {
+/// Build a new wavelet tile from `rand`, returns NULL if out of memory.
+static float* TCOD_noise_wavelet_build(TCOD_Random* __restrict rand) {
   static const int sz = WAVELET_TILE_SIZE * WAVELET_TILE_SIZE * WAVELET_TILE_SIZE * sizeof(float);
   float* temp1 = malloc(sz);
   float* temp2 = malloc(sz);
   float* noise = malloc(sz);
+  if (!temp1 || !temp2 || !noise) {
+    free(temp1);
+    free(temp2);
+    free(noise);
+    return NULL;
+  }
   for (int i = 0; i < WAVELET_TILE_SIZE * WAVELET_TILE_SIZE * WAVELET_TILE_SIZE; ++i) {
-    noise[i] = TCOD_random_get_float(data->rand, -1.0f, 1.0f);
+    noise[i] = TCOD_random_get_float(rand, -1.0f, 1.0f);
   }
   for (int iy = 0; iy < WAVELET_TILE_SIZE; ++iy) {
     for (int iz = 0; iz < WAVELET_TILE_SIZE; ++iz) {
@@ -769,9 +790,193 @@ static void TCOD_noise_wavelet_init(TCOD_Noise* __restrict data) {
   for (int i = 0; i < WAVELET_TILE_SIZE * WAVELET_TILE_SIZE * WAVELET_TILE_SIZE; ++i) {
     noise[i] += temp1[i];
   }
-  data->waveletTileData = noise;
   free(temp1);
   free(temp2);
+  return noise;
+}
+
+static void TCOD_noise_wavelet_init(TCOD_Noise* __restrict data) {
+  data->waveletTileData = TCOD_noise_wavelet_build(data->rand);
+}
+
+/**
+    A wavelet tile shared between noise objects.
+
+    Tiles are kept in a list so that each seed is only built once.
+ */
+struct TCOD_NoiseWaveletTile {
+  int refcount;
+  uint32_t seed;
+  float* data;  // The tile values, either allocated or pointing into `mapping`.
+  void* mapping;  // A memory-mapped cache file, or NULL.
+  size_t mapping_size;
+  struct TCOD_NoiseWaveletTile* next;
+};
+
+static struct TCOD_NoiseWaveletTile* TCOD_noise_wavelet_tiles_ = NULL;
+
+/// The header of a wavelet cache file, followed by the tile values in native byte order.
+struct TCOD_NoiseWaveletFileHeader_ {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;  // TCOD_NOISE_WAVELET_BYTE_ORDER_ as written by this machine.
+  uint32_t tile_size;
+  uint32_t seed;
+};
+
+static const char TCOD_NOISE_WAVELET_MAGIC_[8] = "TCODWAVE";
+#define TCOD_NOISE_WAVELET_FILE_VERSION_ 1
+#define TCOD_NOISE_WAVELET_BYTE_ORDER_ 0x01020304u
+#define TCOD_NOISE_WAVELET_FILE_SIZE_ \
+  (sizeof(struct TCOD_NoiseWaveletFileHeader_) + \
+   sizeof(float) * WAVELET_TILE_SIZE * WAVELET_TILE_SIZE * WAVELET_TILE_SIZE)
+
+/// Unmap a file mapped by `TCOD_noise_wavelet_map`.
+static void TCOD_noise_wavelet_unmap(void* mapping, size_t size) {
+#ifdef _WIN32
+  (void)size;
+  UnmapViewOfFile(mapping);
+#else
+  munmap(mapping, size);
+#endif  // _WIN32
+}
+
+/// Map the file at `path` into read-only memory, returns NULL if this fails.
+static void* TCOD_noise_wavelet_map(const char* path, size_t* size_out) {
+  void* mapping = NULL;
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) return NULL;
+  LARGE_INTEGER size;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    HANDLE file_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (file_mapping) {
+      mapping = MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(file_mapping);  // The view keeps the mapping alive.
+      *size_out = (size_t)size.QuadPart;
+    }
+  }
+  CloseHandle(file);
+#else
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) mapping = NULL;
+    *size_out = (size_t)info.st_size;
+  }
+  close(fd);
+#endif  // _WIN32
+  return mapping;
+}
+
+/// Use a cache file for `tile` if it exists and matches its seed, returns true on success.
+static bool TCOD_noise_wavelet_tile_load(struct TCOD_NoiseWaveletTile* __restrict tile, const char* path) {
+  size_t size = 0;
+  void* mapping = TCOD_noise_wavelet_map(path, &size);
+  if (!mapping) return false;
+  struct TCOD_NoiseWaveletFileHeader_ header;
+  if (size == TCOD_NOISE_WAVELET_FILE_SIZE_) memcpy(&header, mapping, sizeof(header));
+  if (size != TCOD_NOISE_WAVELET_FILE_SIZE_ || memcmp(header.magic, TCOD_NOISE_WAVELET_MAGIC_, sizeof(header.magic)) ||
+      header.version != TCOD_NOISE_WAVELET_FILE_VERSION_ || header.byte_order != TCOD_NOISE_WAVELET_BYTE_ORDER_ ||
+      header.tile_size != WAVELET_TILE_SIZE || header.seed != tile->seed) {
+    TCOD_noise_wavelet_unmap(mapping, size);
+    return false;
+  }
+  tile->mapping = mapping;
+  tile->mapping_size = size;
+  tile->data = (float*)((unsigned char*)mapping + sizeof(header));
+  return true;
+}
+
+/// Write `tile` to a cache file at `path`, returns true on success.
+static bool TCOD_noise_wavelet_tile_save(const struct TCOD_NoiseWaveletTile* __restrict tile, const char* path) {
+  struct TCOD_NoiseWaveletFileHeader_ header = {
+      {0},
+      TCOD_NOISE_WAVELET_FILE_VERSION_,
+      TCOD_NOISE_WAVELET_BYTE_ORDER_,
+      WAVELET_TILE_SIZE,
+      tile->seed,
+  };
+  memcpy(header.magic, TCOD_NOISE_WAVELET_MAGIC_, sizeof(header.magic));
+  FILE* file = fopen(path, "wb");
+  if (!file) return false;
+  const size_t count = WAVELET_TILE_SIZE * WAVELET_TILE_SIZE * WAVELET_TILE_SIZE;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  ok = ok && fwrite(tile->data, sizeof(*tile->data), count, file) == count;
+  ok = (fclose(file) == 0) && ok;
+  if (!ok) remove(path);  // Don't leave a truncated cache behind.
+  return ok;
+}
+
+TCOD_NoiseWaveletTile* TCOD_noise_wavelet_tile_get(uint32_t seed, const char* cache_path) {
+  for (struct TCOD_NoiseWaveletTile* it = TCOD_noise_wavelet_tiles_; it; it = it->next) {
+    if (it->seed == seed) {
+      ++it->refcount;
+      return it;
+    }
+  }
+  struct TCOD_NoiseWaveletTile* tile = calloc(1, sizeof(*tile));
+  if (!tile) {
+    TCOD_set_errorv("Out of memory.");
+    return NULL;
+  }
+  tile->refcount = 1;
+  tile->seed = seed;
+  if (!cache_path || !TCOD_noise_wavelet_tile_load(tile, cache_path)) {
+    TCOD_Random* rand = TCOD_random_new_from_seed(TCOD_RNG_MT, seed);
+    tile->data = rand ? TCOD_noise_wavelet_build(rand) : NULL;
+    TCOD_random_delete(rand);
+    if (!tile->data) {
+      free(tile);
+      TCOD_set_errorv("Out of memory.");
+      return NULL;
+    }
+    if (cache_path) TCOD_noise_wavelet_tile_save(tile, cache_path);  // A cache which can't be written is ignored.
+  }
+  tile->next = TCOD_noise_wavelet_tiles_;
+  TCOD_noise_wavelet_tiles_ = tile;
+  return tile;
+}
+
+void TCOD_noise_wavelet_tile_release(TCOD_NoiseWaveletTile* tile) {
+  if (!tile || --tile->refcount > 0) return;
+  for (struct TCOD_NoiseWaveletTile** it = &TCOD_noise_wavelet_tiles_; *it; it = &(*it)->next) {
+    if (*it == tile) {
+      *it = tile->next;
+      break;
+    }
+  }
+  if (tile->mapping) {
+    TCOD_noise_wavelet_unmap(tile->mapping, tile->mapping_size);
+  } else {
+    free(tile->data);
+  }
+  free(tile);
+}
+
+/// Release the wavelet tile of `noise`, whether it is shared or its own.
+static void TCOD_noise_wavelet_clear(TCOD_Noise* __restrict noise) {
+  if (noise->wavelet_tile) {
+    TCOD_noise_wavelet_tile_release(noise->wavelet_tile);
+  } else {
+    free(noise->waveletTileData);
+  }
+  noise->wavelet_tile = NULL;
+  noise->waveletTileData = NULL;
+}
+
+TCOD_Error TCOD_noise_set_wavelet_tile(TCOD_Noise* __restrict noise, TCOD_NoiseWaveletTile* tile) {
+  if (!noise) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  if (tile) ++tile->refcount;  // Taken first in case `tile` is already used by `noise`.
+  TCOD_noise_wavelet_clear(noise);
+  noise->wavelet_tile = tile;
+  noise->waveletTileData = tile ? tile->data : NULL;
+  return TCOD_E_OK;
 }
 
 static float TCOD_noise_wavelet(TCOD_Noise* __restrict data, const float* __restrict f) {
@@ -821,6 +1026,102 @@ static float TCOD_noise_turbulence_wavelet(TCOD_Noise* __restrict noise, const f
   return TCOD_noise_turbulence_int(noise, f, octaves, TCOD_noise_wavelet);
 }
 
+/* Worley noise, the distances to the nearest feature points of a jittered grid. */
+
+/// Write the feature point of a lattice cell to `point`, each cell has one point jittered within it.
+static void TCOD_noise_worley_feature(const TCOD_Noise* __restrict data, const int* cell, float* __restrict point) {
+  int hash = 0;
+  for (int i = data->ndim - 1; i >= 0; --i) hash = data->map[(cell[i] + hash) & 0xFF];
+  for (int i = 0; i < data->ndim; ++i) {
+    const int high = data->map[(hash + 2 * i + 1) & 0xFF];
+    const int low = data->map[(hash + 2 * i + 2) & 0xFF];
+    point[i] = cell[i] + (high * 256 + low + 0.5f) * (1.0f / 65536.0f);
+  }
+}
+
+/// Return the distances to the nearest and second nearest feature points around `f`.
+static void TCOD_noise_worley_distances(
+    const TCOD_Noise* __restrict data, const float* __restrict f, float* __restrict f1, float* __restrict f2) {
+  int base[TCOD_NOISE_MAX_DIMENSIONS] = {0, 0, 0, 0};
+  float edge = 1.0f;  // The distance from `f` to the nearest face of its own cell.
+  for (int i = 0; i < data->ndim; ++i) {
+    base[i] = (int)floorf(f[i]);
+    const float fraction = f[i] - base[i];
+    edge = fminf(edge, fminf(fraction, 1.0f - fraction));
+  }
+  // Feature points can be anywhere in their cell, so cells are searched in growing shells around the sample.
+  // Every cell outside of a shell of `radius` is at least `radius + edge` away, once the second nearest point is
+  // closer than that the search is exact.  The 3^ndim cells of the first shell are usually enough.
+  float nearest = FLT_MAX;
+  float second = FLT_MAX;
+  for (int radius = 1;; ++radius) {
+    const int span = radius * 2 + 1;
+    int cells = 1;
+    for (int i = 0; i < data->ndim; ++i) cells *= span;
+    for (int neighbor = 0; neighbor < cells; ++neighbor) {
+      int cell[TCOD_NOISE_MAX_DIMENSIONS];
+      bool on_shell = radius == 1;
+      for (int i = 0, rest = neighbor; i < data->ndim; ++i, rest /= span) {
+        const int offset = rest % span - radius;
+        on_shell |= offset == -radius || offset == radius;
+        cell[i] = base[i] + offset;
+      }
+      if (!on_shell) continue;  // Already checked by a smaller shell.
+      float point[TCOD_NOISE_MAX_DIMENSIONS];
+      TCOD_noise_worley_feature(data, cell, point);
+      float distance = 0;
+      for (int i = 0; i < data->ndim; ++i) distance += (point[i] - f[i]) * (point[i] - f[i]);
+      if (distance < nearest) {
+        second = nearest;
+        nearest = distance;
+      } else if (distance < second) {
+        second = distance;
+      }
+    }
+    const float bound = radius + edge;
+    if (second <= bound * bound) break;
+  }
+  *f1 = sqrtf(nearest);
+  *f2 = sqrtf(second);
+}
+
+static float TCOD_noise_worley(TCOD_Noise* __restrict data, const float* __restrict f, TCOD_noise_type_t type) {
+  if (data->ndim <= 0 || data->ndim > TCOD_NOISE_MAX_DIMENSIONS) {
+    return NAN; /* not supported */
+  }
+  float f1;
+  float f2;
+  TCOD_noise_worley_distances(data, f, &f1, &f2);
+  const float distance = type == TCOD_NOISE_WORLEY_F1 ? f1 : type == TCOD_NOISE_WORLEY_F2 ? f2 : f2 - f1;
+  return clamp_signed_f(distance * 2.0f - 1.0f);
+}
+
+static float TCOD_noise_worley_f1(TCOD_Noise* __restrict data, const float* __restrict f) {
+  return TCOD_noise_worley(data, f, TCOD_NOISE_WORLEY_F1);
+}
+
+static float TCOD_noise_worley_f2(TCOD_Noise* __restrict data, const float* __restrict f) {
+  return TCOD_noise_worley(data, f, TCOD_NOISE_WORLEY_F2);
+}
+
+static float TCOD_noise_worley_f2_f1(TCOD_Noise* __restrict data, const float* __restrict f) {
+  return TCOD_noise_worley(data, f, TCOD_NOISE_WORLEY_F2_F1);
+}
+
+/// Return the Worley noise function for `type`, or NULL if `type` is not Worley noise.
+static TCOD_noise_func_t TCOD_noise_worley_func(TCOD_noise_type_t type) {
+  switch (type) {
+    case TCOD_NOISE_WORLEY_F1:
+      return TCOD_noise_worley_f1;
+    case TCOD_NOISE_WORLEY_F2:
+      return TCOD_noise_worley_f2;
+    case TCOD_NOISE_WORLEY_F2_F1:
+      return TCOD_noise_worley_f2_f1;
+    default:
+      return NULL;
+  }
+}
+
 void TCOD_noise_set_type(TCOD_Noise* __restrict noise, TCOD_noise_type_t type) { noise->noise_type = type; }
 
 float TCOD_noise_get_ex(TCOD_Noise* __restrict noise, const float* __restrict f, TCOD_noise_type_t type) {
@@ -832,6 +1133,10 @@ float TCOD_noise_get_ex(TCOD_Noise* __restrict noise, const float* __restrict f,
       return TCOD_noise_simplex(noise, f);
     case (TCOD_NOISE_WAVELET):
       return TCOD_noise_wavelet(noise, f);
+    case TCOD_NOISE_WORLEY_F1:
+    case TCOD_NOISE_WORLEY_F2:
+    case TCOD_NOISE_WORLEY_F2_F1:
+      return TCOD_noise_worley(noise, f, type ? type : noise->noise_type);
     default:
       return NAN;
   }
@@ -847,6 +1152,10 @@ float TCOD_noise_get_fbm_ex(
       return TCOD_noise_fbm_simplex(noise, f, octaves);
     case (TCOD_NOISE_WAVELET):
       return TCOD_noise_fbm_wavelet(noise, f, octaves);
+    case TCOD_NOISE_WORLEY_F1:
+    case TCOD_NOISE_WORLEY_F2:
+    case TCOD_NOISE_WORLEY_F2_F1:
+      return TCOD_noise_fbm_int(noise, f, octaves, TCOD_noise_worley_func(type ? type : noise->noise_type));
     default:
       return NAN;
   }
@@ -862,6 +1171,10 @@ float TCOD_noise_get_turbulence_ex(
       return TCOD_noise_turbulence_simplex(noise, f, octaves);
     case (TCOD_NOISE_WAVELET):
       return TCOD_noise_turbulence_wavelet(noise, f, octaves);
+    case TCOD_NOISE_WORLEY_F1:
+    case TCOD_NOISE_WORLEY_F2:
+    case TCOD_NOISE_WORLEY_F2_F1:
+      return TCOD_noise_turbulence_int(noise, f, octaves, TCOD_noise_worley_func(type ? type : noise->noise_type));
     default:
       return NAN;
   }
@@ -880,12 +1193,1176 @@ float TCOD_noise_get_turbulence(TCOD_Noise* __restrict noise, const float* __res
 }
 
 void TCOD_noise_delete(TCOD_Noise* __restrict noise) {
-  if (noise && noise->waveletTileData) {
-    free(noise->waveletTileData);
-  }
+  if (noise) TCOD_noise_wavelet_clear(noise);
   free(noise);
 }
 
+/* Noise with analytic gradients. */
+
+/// A noise value with its partial derivatives.
+struct TCOD_NoiseDual_ {
+  float value;
+  float d[3];
+};
+
+/// `LERP` of two duals along `axis`, where `dw` is the derivative of `w` along that axis.
+static struct TCOD_NoiseDual_ dual_lerp(
+    struct TCOD_NoiseDual_ a, struct TCOD_NoiseDual_ b, float w, float dw, int axis) {
+  struct TCOD_NoiseDual_ out;
+  out.value = LERP(a.value, b.value, w);
+  for (int i = 0; i < 3; ++i) out.d[i] = LERP(a.d[i], b.d[i], w);
+  out.d[axis] += dw * (b.value - a.value);
+  return out;
+}
+
+/// The same as `TCOD_noise_perlin` for 1 to 3 dimensions, also returning the unclamped derivatives.
+static struct TCOD_NoiseDual_ perlin_dual(const TCOD_Noise* __restrict data, const float* __restrict f) {
+  const int ndim = data->ndim;
+  int n[3];
+  float r[3];
+  float w[3];
+  float dw[3];
+  for (int i = 0; i < ndim; ++i) {
+    n[i] = FLOOR(f[i]);
+    r[i] = f[i] - n[i];
+    w[i] = CUBIC(r[i]);
+    dw[i] = 6 * r[i] * (1 - r[i]);
+  }
+  // Evaluate every corner as `lattice` does, bit `i` of a corner is set for the far side of axis `i`.
+  struct TCOD_NoiseDual_ corners[8];
+  for (int corner = 0; corner < (1 << ndim); ++corner) {
+    int index = 0;
+    for (int i = 0; i < ndim; ++i) index = data->map[(index + n[i] + ((corner >> i) & 1)) & 0xFF];
+    struct TCOD_NoiseDual_* it = &corners[corner];
+    it->value = 0;
+    for (int i = 0; i < 3; ++i) it->d[i] = 0;
+    for (int i = 0; i < ndim; ++i) {
+      it->value += data->buffer[index][i] * ((corner >> i) & 1 ? r[i] - 1 : r[i]);
+      it->d[i] = data->buffer[index][i];
+    }
+  }
+  // Interpolate one axis at a time, in the same order as `TCOD_noise_perlin`.
+  for (int axis = 0; axis < ndim; ++axis) {
+    for (int corner = 0; corner < (1 << (ndim - axis - 1)); ++corner) {
+      corners[corner] = dual_lerp(corners[corner * 2], corners[corner * 2 + 1], w[axis], dw[axis], axis);
+    }
+  }
+  return corners[0];
+}
+
+/**
+    Add the contribution of a simplex corner at offset `x` with gradient hash `hash`.
+
+    `radius` is the squared radius of the corner and `scale` is applied to its derivatives.
+    The value is accumulated in the same order as `TCOD_noise_simplex`.
+ */
+static float simplex_corner_dual(int ndim, int hash, const float* __restrict x, float radius, float* __restrict d) {
+  float t = radius;
+  for (int i = 0; i < ndim; ++i) t -= x[i] * x[i];
+  if (ndim > 1 && t < 0.0f) return 0.0f;
+  float g[3] = {0, 0, 0};
+  float n = 0;
+  switch (ndim) {
+    case 1:
+      TCOD_NOISE_SIMPLEX_GRADIENT_1D(n, hash, x[0]);
+      g[0] = (hash & 8) ? -1.0f - (hash & 7) : 1.0f + (hash & 7);
+      break;
+    case 2:
+      TCOD_NOISE_SIMPLEX_GRADIENT_2D(n, hash, x[0], x[1]);
+      g[hash < 4 ? 0 : 1] = (hash & 1) ? -1.0f : 1.0f;
+      g[hash < 4 ? 1 : 0] = (hash & 2) ? -2.0f : 2.0f;
+      break;
+    case 3:
+      TCOD_NOISE_SIMPLEX_GRADIENT_3D(n, hash, x[0], x[1], x[2]);
+      g[hash < 8 ? 0 : 1] += (hash & 1) ? -1.0f : 1.0f;
+      g[hash < 4 ? 1 : (hash == 12 || hash == 14 ? 0 : 2)] += (hash & 2) ? -1.0f : 1.0f;
+      break;
+  }
+  // n * t^4, its derivative is g * t^4 - 8 * x * n * t^3.
+  const float t2 = t * t;
+  for (int i = 0; i < ndim; ++i) d[i] += g[i] * t2 * t2 - 8.0f * x[i] * n * t2 * t;
+  return n * (t2 * t2);
+}
+
+/// The hash of the 3D simplex corner at `offset` from `cell`.
+static int simplex_hash3(const TCOD_Noise* __restrict data, const int* cell, const int* offset) {
+  const int ii = absmod(cell[0], 256);
+  const int jj = absmod(cell[1], 256);
+  const int kk = absmod(cell[2], 256);
+  return data->map[(ii + offset[0] + data->map[(jj + offset[1] + data->map[(kk + offset[2]) & 0xFF]) & 0xFF]) & 0xFF];
+}
+
+/// The same as `TCOD_noise_simplex` for 1 to 3 dimensions, also returning the unclamped derivatives.
+static struct TCOD_NoiseDual_ simplex_dual(const TCOD_Noise* __restrict data, const float* __restrict f) {
+  struct TCOD_NoiseDual_ out = {0, {0, 0, 0}};
+  switch (data->ndim) {
+    case 1: {
+      const int i0 = (int)FLOOR(f[0] * SIMPLEX_SCALE);
+      const float x0[1] = {f[0] * SIMPLEX_SCALE - i0};
+      const float x1[1] = {x0[0] - 1.0f};
+      const float n0 = simplex_corner_dual(1, data->map[i0 & 0xFF], x0, 1.0f, out.d);
+      const float n1 = simplex_corner_dual(1, data->map[(i0 + 1) & 0xFF], x1, 1.0f, out.d);
+      out.value = 0.25f * (n0 + n1);
+      out.d[0] *= 0.25f * SIMPLEX_SCALE;
+      return out;
+    }
+    case 2: {
+      static const float F2 = 0.366025403f;  // 0.5f * (sqrtf(3.0f)-1.0f);
+      static const float G2 = 0.211324865f;  // (3.0f - sqrtf(3.0f))/6.0f;
+      const float s = (f[0] + f[1]) * F2 * SIMPLEX_SCALE;
+      const int i = FLOOR(f[0] * SIMPLEX_SCALE + s);
+      const int j = FLOOR(f[1] * SIMPLEX_SCALE + s);
+      const float t = (i + j) * G2;
+      const float x0[2] = {f[0] * SIMPLEX_SCALE - (i - t), f[1] * SIMPLEX_SCALE - (j - t)};
+      const int i1 = x0[0] > x0[1] ? 1 : 0;
+      const int j1 = 1 - i1;
+      const float x1[2] = {x0[0] - i1 + G2, x0[1] - j1 + G2};
+      const float x2[2] = {x0[0] - 1.0f + 2.0f * G2, x0[1] - 1.0f + 2.0f * G2};
+      const int ii = absmod(i, 256);
+      const int jj = absmod(j, 256);
+      const float n0 = simplex_corner_dual(2, data->map[(ii + data->map[jj]) & 0xFF], x0, 0.5f, out.d);
+      const float n1 =
+          simplex_corner_dual(2, data->map[(ii + i1 + data->map[(jj + j1) & 0xFF]) & 0xFF], x1, 0.5f, out.d);
+      const float n2 = simplex_corner_dual(2, data->map[(ii + 1 + data->map[(jj + 1) & 0xFF]) & 0xFF], x2, 0.5f, out.d);
+      out.value = 40.0f * (n0 + n1 + n2);
+      for (int axis = 0; axis < 2; ++axis) out.d[axis] *= 40.0f * SIMPLEX_SCALE;
+      return out;
+    }
+    case 3: {
+      static const float F3 = 0.333333333f;
+      static const float G3 = 0.166666667f;
+      const float s = (f[0] + f[1] + f[2]) * F3 * SIMPLEX_SCALE;
+      const int i = FLOOR(f[0] * SIMPLEX_SCALE + s);
+      const int j = FLOOR(f[1] * SIMPLEX_SCALE + s);
+      const int k = FLOOR(f[2] * SIMPLEX_SCALE + s);
+      const float t = (float)(i + j + k) * G3;
+      const float x0[3] = {
+          f[0] * SIMPLEX_SCALE - (i - t), f[1] * SIMPLEX_SCALE - (j - t), f[2] * SIMPLEX_SCALE - (k - t)};
+      // The simplex traversal order, the same branches as `TCOD_noise_simplex`.
+      int o1[3];
+      int o2[3];
+      if (x0[0] >= x0[1]) {
+        if (x0[1] >= x0[2]) {
+          memcpy(o1, (int[3]){1, 0, 0}, sizeof(o1));
+          memcpy(o2, (int[3]){1, 1, 0}, sizeof(o2));
+        } else if (x0[0] >= x0[2]) {
+          memcpy(o1, (int[3]){1, 0, 0}, sizeof(o1));
+          memcpy(o2, (int[3]){1, 0, 1}, sizeof(o2));
+        } else {
+          memcpy(o1, (int[3]){0, 0, 1}, sizeof(o1));
+          memcpy(o2, (int[3]){1, 0, 1}, sizeof(o2));
+        }
+      } else {
+        if (x0[1] < x0[2]) {
+          memcpy(o1, (int[3]){0, 0, 1}, sizeof(o1));
+          memcpy(o2, (int[3]){0, 1, 1}, sizeof(o2));
+        } else if (x0[0] < x0[2]) {
+          memcpy(o1, (int[3]){0, 1, 0}, sizeof(o1));
+          memcpy(o2, (int[3]){0, 1, 1}, sizeof(o2));
+        } else {
+          memcpy(o1, (int[3]){0, 1, 0}, sizeof(o1));
+          memcpy(o2, (int[3]){1, 1, 0}, sizeof(o2));
+        }
+      }
+      float x1[3];
+      float x2[3];
+      float x3[3];
+      for (int axis = 0; axis < 3; ++axis) {
+        x1[axis] = x0[axis] - o1[axis] + G3;
+        x2[axis] = x0[axis] - o2[axis] + 2.0f * G3;
+        x3[axis] = x0[axis] - 1.0f + 3.0f * G3;
+      }
+      const int cell[3] = {i, j, k};
+      const int o0[3] = {0, 0, 0};
+      const int o3[3] = {1, 1, 1};
+      const float n0 = simplex_corner_dual(3, simplex_hash3(data, cell, o0), x0, 0.6f, out.d);
+      const float n1 = simplex_corner_dual(3, simplex_hash3(data, cell, o1), x1, 0.6f, out.d);
+      const float n2 = simplex_corner_dual(3, simplex_hash3(data, cell, o2), x2, 0.6f, out.d);
+      const float n3 = simplex_corner_dual(3, simplex_hash3(data, cell, o3), x3, 0.6f, out.d);
+      out.value = 32.0f * (n0 + n1 + n2 + n3);
+      for (int axis = 0; axis < 3; ++axis) out.d[axis] *= 32.0f * SIMPLEX_SCALE;
+      return out;
+    }
+    default:
+      out.value = NAN;
+      return out;
+  }
+}
+
+/// Return true if analytic gradients are supported for this noise type and dimension.
+static bool noise_dual_supported(const TCOD_Noise* __restrict noise, TCOD_noise_type_t type) {
+  if (noise->ndim < 1 || noise->ndim > 3) return false;
+  switch (type ? type : noise->noise_type) {
+    case TCOD_NOISE_PERLIN:
+    case TCOD_NOISE_DEFAULT:
+    case TCOD_NOISE_SIMPLEX:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/// Evaluate the clamped noise of `type` with its derivatives, which are zero where the value is clamped.
+static struct TCOD_NoiseDual_ noise_dual(
+    const TCOD_Noise* __restrict noise, const float* __restrict f, TCOD_noise_type_t type) {
+  struct TCOD_NoiseDual_ out =
+      (type ? type : noise->noise_type) == TCOD_NOISE_PERLIN ? perlin_dual(noise, f) : simplex_dual(noise, f);
+  const float value = clamp_signed_f(out.value);
+  if (value != out.value) {
+    out.value = value;
+    for (int i = 0; i < 3; ++i) out.d[i] = 0;
+  }
+  return out;
+}
+
+/// Write the first `ndim` derivatives of `dual` to `gradient` if it is not NULL, then return its value.
+static float dual_output(struct TCOD_NoiseDual_ dual, int ndim, float* __restrict gradient) {
+  for (int i = 0; gradient && i < ndim; ++i) gradient[i] = dual.d[i];
+  return dual.value;
+}
+
+float TCOD_noise_get_with_gradient(
+    TCOD_Noise* __restrict noise, const float* __restrict f, TCOD_noise_type_t type, float* __restrict gradient) {
+  const struct TCOD_NoiseDual_ unsupported = {NAN, {NAN, NAN, NAN}};
+  if (!noise_dual_supported(noise, type)) return dual_output(unsupported, noise->ndim, gradient);
+  return dual_output(noise_dual(noise, f, type), noise->ndim, gradient);
+}
+
+float TCOD_noise_get_fbm_with_gradient(
+    TCOD_Noise* __restrict noise,
+    const float* __restrict f,
+    float octaves,
+    TCOD_noise_type_t type,
+    float* __restrict gradient) {
+  const struct TCOD_NoiseDual_ unsupported = {NAN, {NAN, NAN, NAN}};
+  if (!noise_dual_supported(noise, type)) return dual_output(unsupported, noise->ndim, gradient);
+  // The same loop as `TCOD_noise_fbm_int`, the derivatives of each octave are also scaled by its frequency.
+  float tf[3] = {0, 0, 0};
+  for (int i = 0; i < noise->ndim; ++i) tf[i] = f[i];
+  struct TCOD_NoiseDual_ sum = {0, {0, 0, 0}};
+  float frequency = 1.0f;
+  int i;
+  for (i = 0; i < (int)octaves; ++i) {
+    const struct TCOD_NoiseDual_ octave = noise_dual(noise, tf, type);
+    sum.value += octave.value * noise->exponent[i];
+    for (int j = 0; j < 3; ++j) sum.d[j] += octave.d[j] * frequency * noise->exponent[i];
+    for (int j = 0; j < noise->ndim; ++j) tf[j] *= noise->lacunarity;
+    frequency *= noise->lacunarity;
+  }
+  octaves -= (int)octaves;
+  if (octaves > DELTA) {
+    const struct TCOD_NoiseDual_ octave = noise_dual(noise, tf, type);
+    sum.value += octaves * octave.value * noise->exponent[i];
+    for (int j = 0; j < 3; ++j) sum.d[j] += octaves * octave.d[j] * frequency * noise->exponent[i];
+  }
+  const float value = clamp_signed_f(sum.value);
+  if (value != sum.value) {
+    sum.value = value;
+    for (int j = 0; j < 3; ++j) sum.d[j] = 0;
+  }
+  return dual_output(sum, noise->ndim, gradient);
+}
+
+/* SIMD kernels for batches of Perlin and simplex noise. */
+
+/**
+    The corners of the last lattice cell sampled by a SIMD kernel.
+
+    Neighboring points of a grid row are usually in the same lattice cell.  When every lane of a vector is in the
+    cached cell its corners are reused instead of hashing and gathering them again for each lane.
+    Bit `i` of a corner index is set for the far side of axis `i`.
+ */
+struct TCOD_NoiseCell_ {
+  bool valid;
+  int n[3];  // The lattice coordinates of the cell.
+  float gradients[8][3];  // Perlin corner gradients.
+  int hashes[8];  // Simplex corner hashes.
+};
+
+#if defined(__GNUC__) && (defined(__clang__) || __GNUC__ >= 9)
+/**
+    Noise batches are evaluated in blocks of `TCOD_NOISE_LANES` points using GCC vector extensions.
+
+    The kernels are written once as always inlined functions and are instantiated in one function compiled for the
+    default target (SSE2 on x86-64) and one compiled for AVX2, which is picked at runtime when the CPU supports it.
+    They follow the operation order of the scalar functions so that their results are the same.
+ */
+#define TCOD_NOISE_SIMD 1
+#define TCOD_NOISE_LANES 4
+#define TCOD_NOISE_INLINE inline __attribute__((always_inline))
+#if defined(__x86_64__) || defined(__i386__)
+#define TCOD_NOISE_SIMD_AVX2 1
+#endif
+#if !defined(__clang__)
+// Vectors are only passed between inlined functions.  GCC reports this at the end of the file so it can not be popped.
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+typedef float TCOD_NoiseVecF_ __attribute__((vector_size(sizeof(float) * TCOD_NOISE_LANES)));
+typedef int32_t TCOD_NoiseVecI_ __attribute__((vector_size(sizeof(int32_t) * TCOD_NOISE_LANES)));
+typedef TCOD_NoiseVecF_ vf_t;
+typedef TCOD_NoiseVecI_ vi_t;
+
+/// Return a vector with every lane set to `x`.
+static TCOD_NOISE_INLINE vf_t vf_splat(float x) { return (vf_t){0} + x; }
+/// Return `a` where `mask` is set, otherwise `b`.
+static TCOD_NOISE_INLINE vf_t vf_select(vi_t mask, vf_t a, vf_t b) {
+  return (vf_t)((mask & (vi_t)a) | (~mask & (vi_t)b));
+}
+static TCOD_NOISE_INLINE vi_t vi_select(vi_t mask, vi_t a, vi_t b) { return (mask & a) | (~mask & b); }
+static TCOD_NOISE_INLINE vf_t vf_from_int(vi_t v) { return __builtin_convertvector(v, vf_t); }
+/// The vector version of the FLOOR macro, including its rounding of non-positive integers.
+static TCOD_NOISE_INLINE vi_t vi_floor(vf_t a) { return __builtin_convertvector(a, vi_t) - 1 - (a > 0); }
+static TCOD_NOISE_INLINE vf_t vf_abs(vf_t a) { return vf_select(a < 0, -a, a); }
+static TCOD_NOISE_INLINE vf_t vf_lerp(vf_t a, vf_t b, vf_t x) { return a + x * (b - a); }
+static TCOD_NOISE_INLINE vf_t vf_cubic(vf_t a) { return a * a * (3.0f - 2.0f * a); }
+/// The vector version of `clamp_signed_f`.
+static TCOD_NOISE_INLINE vf_t vf_clamp_signed(vf_t value) {
+  const float LOW = -1.0f + FLT_EPSILON;
+  const float HIGH = 1.0f - FLT_EPSILON;
+  return vf_select(value < LOW, vf_splat(LOW), vf_select(value > HIGH, vf_splat(HIGH), value));
+}
+/// Look up `map[index & 0xFF]` for each lane.
+static TCOD_NOISE_INLINE vi_t vi_map(const TCOD_Noise* __restrict noise, vi_t index) {
+  int32_t lanes[TCOD_NOISE_LANES];
+  memcpy(lanes, &index, sizeof(lanes));
+  for (int i = 0; i < TCOD_NOISE_LANES; ++i) lanes[i] = noise->map[lanes[i] & 0xFF];
+  vi_t out;
+  memcpy(&out, lanes, sizeof(lanes));
+  return out;
+}
+/// Look up `buffer[index][axis]` for each lane.
+static TCOD_NOISE_INLINE vf_t vf_gradient(const TCOD_Noise* __restrict noise, vi_t index, int axis) {
+  int32_t lanes[TCOD_NOISE_LANES];
+  memcpy(lanes, &index, sizeof(lanes));
+  float values[TCOD_NOISE_LANES];
+  for (int i = 0; i < TCOD_NOISE_LANES; ++i) values[i] = noise->buffer[lanes[i]][axis];
+  vf_t out;
+  memcpy(&out, values, sizeof(values));
+  return out;
+}
+/**
+    The vector version of `lattice`, `partial` is the hash of every axis except the last one.
+
+    The hash chains of neighboring lattice points are shared, this gives the same indexes as hashing each point.
+ */
+static TCOD_NOISE_INLINE vf_t vf_lattice2(const TCOD_Noise* __restrict noise, vi_t partial, vf_t fx, vi_t iy, vf_t fy) {
+  const vi_t index = vi_map(noise, partial + iy);
+  vf_t value = vf_splat(0);
+  value += vf_gradient(noise, index, 0) * fx;
+  value += vf_gradient(noise, index, 1) * fy;
+  return value;
+}
+static TCOD_NOISE_INLINE vf_t vf_lattice3(
+    const TCOD_Noise* __restrict noise, vi_t partial, vf_t fx, vf_t fy, vi_t iz, vf_t fz) {
+  const vi_t index = vi_map(noise, partial + iz);
+  vf_t value = vf_splat(0);
+  value += vf_gradient(noise, index, 0) * fx;
+  value += vf_gradient(noise, index, 1) * fy;
+  value += vf_gradient(noise, index, 2) * fz;
+  return value;
+}
+/**
+    Return true if every lane of `n` is in the same lattice cell, which is written to `first`.
+
+    `cached` is set to true if this cell is already loaded in `cell`.
+ */
+static TCOD_NOISE_INLINE bool vi_shared_cell(
+    const struct TCOD_NoiseCell_* cell, const vi_t* n, int ndim, int* __restrict first, bool* __restrict cached) {
+  for (int axis = 0; axis < 3; ++axis) first[axis] = axis < ndim ? n[axis][0] : 0;
+  for (int axis = 0; axis < ndim; ++axis) {
+    for (int i = 1; i < TCOD_NOISE_LANES; ++i) {
+      if (n[axis][i] != first[axis]) return false;
+    }
+  }
+  *cached = cell->valid && cell->n[0] == first[0] && cell->n[1] == first[1] && cell->n[2] == first[2];
+  return true;
+}
+/// Return true if every lane of `n` is in the same lattice cell, loading its Perlin gradients into `cell` if needed.
+static TCOD_NOISE_INLINE bool vf_perlin_cell(
+    const TCOD_Noise* __restrict noise, struct TCOD_NoiseCell_* __restrict cell, const vi_t* n, int ndim) {
+  int first[3];
+  bool cached;
+  if (!vi_shared_cell(cell, n, ndim, first, &cached)) return false;
+  if (cached) return true;
+  for (int corner = 0; corner < (1 << ndim); ++corner) {
+    int index = 0;
+    for (int axis = 0; axis < ndim; ++axis) index = noise->map[(index + first[axis] + ((corner >> axis) & 1)) & 0xFF];
+    for (int axis = 0; axis < ndim; ++axis) cell->gradients[corner][axis] = noise->buffer[index][axis];
+  }
+  cell->valid = true;
+  memcpy(cell->n, first, sizeof(first));
+  return true;
+}
+/// Return true if every lane of `n` is in the same lattice cell, loading its simplex hashes into `cell` if needed.
+static TCOD_NOISE_INLINE bool vi_simplex_cell(
+    const TCOD_Noise* __restrict noise, struct TCOD_NoiseCell_* __restrict cell, const vi_t* n, int ndim) {
+  int first[3];
+  bool cached;
+  if (!vi_shared_cell(cell, n, ndim, first, &cached)) return false;
+  if (cached) return true;
+  for (int corner = 0; corner < (1 << ndim); ++corner) {
+    int hash = 0;
+    for (int axis = ndim - 1; axis >= 0; --axis) {
+      hash = noise->map[(first[axis] + ((corner >> axis) & 1) + hash) & 0xFF];
+    }
+    cell->hashes[corner] = hash;
+  }
+  cell->valid = true;
+  memcpy(cell->n, first, sizeof(first));
+  return true;
+}
+/// Look up the simplex hash of each lane from the corners of a cached cell.
+static TCOD_NOISE_INLINE vi_t vi_cell_hash(const struct TCOD_NoiseCell_* __restrict cell, vi_t corner) {
+  vi_t out;
+  for (int i = 0; i < TCOD_NOISE_LANES; ++i) out[i] = cell->hashes[corner[i]];
+  return out;
+}
+/// The vector version of `lattice` using a gradient from a cached cell.
+static TCOD_NOISE_INLINE vf_t vf_lattice_cached(const float* __restrict gradient, int ndim, vf_t fx, vf_t fy, vf_t fz) {
+  vf_t value = vf_splat(0);
+  value += vf_splat(gradient[0]) * fx;
+  value += vf_splat(gradient[1]) * fy;
+  if (ndim == 3) value += vf_splat(gradient[2]) * fz;
+  return value;
+}
+/// Perlin noise for a vector of points which are all in the lattice cell of `cell`.
+static TCOD_NOISE_INLINE vf_t vf_perlin_cached(
+    const struct TCOD_NoiseCell_* __restrict cell, int ndim, const vf_t* r, const vf_t* w) {
+  const float(*g)[3] = cell->gradients;
+  const vf_t r0b = r[0] - 1.0f;
+  const vf_t r1b = r[1] - 1.0f;
+  const vf_t r2b = r[2] - 1.0f;
+  const vf_t value_near = vf_lerp(
+      vf_lerp(vf_lattice_cached(g[0], ndim, r[0], r[1], r[2]), vf_lattice_cached(g[1], ndim, r0b, r[1], r[2]), w[0]),
+      vf_lerp(vf_lattice_cached(g[2], ndim, r[0], r1b, r[2]), vf_lattice_cached(g[3], ndim, r0b, r1b, r[2]), w[0]),
+      w[1]);
+  if (ndim == 2) return vf_clamp_signed(value_near);
+  const vf_t value_far = vf_lerp(
+      vf_lerp(vf_lattice_cached(g[4], ndim, r[0], r[1], r2b), vf_lattice_cached(g[5], ndim, r0b, r[1], r2b), w[0]),
+      vf_lerp(vf_lattice_cached(g[6], ndim, r[0], r1b, r2b), vf_lattice_cached(g[7], ndim, r0b, r1b, r2b), w[0]),
+      w[1]);
+  return vf_clamp_signed(vf_lerp(value_near, value_far, w[2]));
+}
+/// The vector version of `TCOD_noise_perlin` for 2D noise.  `cell` is an optional cache for grid rows.
+static TCOD_NOISE_INLINE vf_t vf_perlin2(
+    const TCOD_Noise* __restrict noise, const vf_t* __restrict f, struct TCOD_NoiseCell_* __restrict cell) {
+  const vi_t n[2] = {vi_floor(f[0]), vi_floor(f[1])};
+  const vf_t r[3] = {f[0] - vf_from_int(n[0]), f[1] - vf_from_int(n[1]), vf_splat(0)};
+  const vf_t w[3] = {vf_cubic(r[0]), vf_cubic(r[1]), vf_splat(0)};
+  if (cell && vf_perlin_cell(noise, cell, n, 2)) return vf_perlin_cached(cell, 2, r, w);
+  const vi_t h0 = vi_map(noise, n[0]);
+  const vi_t h1 = vi_map(noise, n[0] + 1);
+  const vf_t r0b = r[0] - 1.0f;
+  const vf_t r1b = r[1] - 1.0f;
+  const vf_t value = vf_lerp(
+      vf_lerp(vf_lattice2(noise, h0, r[0], n[1], r[1]), vf_lattice2(noise, h1, r0b, n[1], r[1]), w[0]),
+      vf_lerp(vf_lattice2(noise, h0, r[0], n[1] + 1, r1b), vf_lattice2(noise, h1, r0b, n[1] + 1, r1b), w[0]),
+      w[1]);
+  return vf_clamp_signed(value);
+}
+/// The vector version of `TCOD_noise_perlin` for 3D noise.  `cell` is an optional cache for grid rows.
+static TCOD_NOISE_INLINE vf_t vf_perlin3(
+    const TCOD_Noise* __restrict noise, const vf_t* __restrict f, struct TCOD_NoiseCell_* __restrict cell) {
+  vi_t n[3];
+  vf_t r[3];
+  vf_t w[3];
+  for (int i = 0; i < 3; ++i) {
+    n[i] = vi_floor(f[i]);
+    r[i] = f[i] - vf_from_int(n[i]);
+    w[i] = vf_cubic(r[i]);
+  }
+  if (cell && vf_perlin_cell(noise, cell, n, 3)) return vf_perlin_cached(cell, 3, r, w);
+  const vi_t n2b = n[2] + 1;
+  const vf_t r0b = r[0] - 1.0f;
+  const vf_t r1b = r[1] - 1.0f;
+  const vf_t r2b = r[2] - 1.0f;
+  const vi_t h0 = vi_map(noise, n[0]);
+  const vi_t h1 = vi_map(noise, n[0] + 1);
+  const vi_t h00 = vi_map(noise, h0 + n[1]);
+  const vi_t h10 = vi_map(noise, h1 + n[1]);
+  const vi_t h01 = vi_map(noise, h0 + n[1] + 1);
+  const vi_t h11 = vi_map(noise, h1 + n[1] + 1);
+  const vf_t value = vf_lerp(
+      vf_lerp(
+          vf_lerp(
+              vf_lattice3(noise, h00, r[0], r[1], n[2], r[2]), vf_lattice3(noise, h10, r0b, r[1], n[2], r[2]), w[0]),
+          vf_lerp(vf_lattice3(noise, h01, r[0], r1b, n[2], r[2]), vf_lattice3(noise, h11, r0b, r1b, n[2], r[2]), w[0]),
+          w[1]),
+      vf_lerp(
+          vf_lerp(vf_lattice3(noise, h00, r[0], r[1], n2b, r2b), vf_lattice3(noise, h10, r0b, r[1], n2b, r2b), w[0]),
+          vf_lerp(vf_lattice3(noise, h01, r[0], r1b, n2b, r2b), vf_lattice3(noise, h11, r0b, r1b, n2b, r2b), w[0]),
+          w[1]),
+      w[2]);
+  return vf_clamp_signed(value);
+}
+/// The contribution of one simplex corner in 2D, `hash` is already looked up.
+static TCOD_NOISE_INLINE vf_t vf_simplex2_corner(vi_t hash, vf_t x, vf_t y) {
+  vf_t t = 0.5f - x * x - y * y;
+  const vi_t in_range = t >= 0.0f;
+  const vi_t h = hash & 0x7;
+  const vi_t swap = h >= 4;
+  const vf_t u = vf_select(swap, y, x);
+  const vf_t v = vf_select(swap, 2.0f * x, 2.0f * y);
+  vf_t n = vf_select((h & 1) != 0, -u, u) + vf_select((h & 2) != 0, -v, v);
+  t *= t;
+  n *= t * t;
+  return vf_select(in_range, n, vf_splat(0));
+}
+/// The vector version of `TCOD_noise_simplex` for 2D noise.  `cell` is an optional cache for grid rows.
+static TCOD_NOISE_INLINE vf_t vf_simplex2(
+    const TCOD_Noise* __restrict noise, const vf_t* __restrict f, struct TCOD_NoiseCell_* __restrict cell) {
+  static const float F2 = 0.366025403f;  // 0.5f * (sqrtf(3.0f)-1.0f);
+  static const float G2 = 0.211324865f;  // (3.0f - sqrtf(3.0f))/6.0f;
+  const vf_t s = (f[0] + f[1]) * F2 * SIMPLEX_SCALE;
+  const vf_t xs = f[0] * SIMPLEX_SCALE + s;
+  const vf_t ys = f[1] * SIMPLEX_SCALE + s;
+  const vi_t i = vi_floor(xs);
+  const vi_t j = vi_floor(ys);
+  const vf_t t = vf_from_int(i + j) * G2;
+  const vf_t xo = vf_from_int(i) - t;
+  const vf_t yo = vf_from_int(j) - t;
+  const vf_t x0 = f[0] * SIMPLEX_SCALE - xo;
+  const vf_t y0 = f[1] * SIMPLEX_SCALE - yo;
+  const vi_t ii = i & 0xFF;
+  const vi_t jj = j & 0xFF;
+  const vi_t i1 = -(x0 > y0);
+  const vi_t j1 = 1 - i1;
+  const vf_t x1 = x0 - vf_from_int(i1) + G2;
+  const vf_t y1 = y0 - vf_from_int(j1) + G2;
+  const vf_t x2 = x0 - 1.0f + 2.0f * G2;
+  const vf_t y2 = y0 - 1.0f + 2.0f * G2;
+  vi_t hash[3];
+  const vi_t ij[2] = {i, j};
+  if (cell && vi_simplex_cell(noise, cell, ij, 2)) {
+    hash[0] = (vi_t){0} + cell->hashes[0];
+    hash[1] = vi_select(i1 != 0, (vi_t){0} + cell->hashes[1], (vi_t){0} + cell->hashes[2]);
+    hash[2] = (vi_t){0} + cell->hashes[3];
+  } else {
+    hash[0] = vi_map(noise, ii + vi_map(noise, jj));
+    hash[1] = vi_map(noise, ii + i1 + vi_map(noise, jj + j1));
+    hash[2] = vi_map(noise, ii + 1 + vi_map(noise, jj + 1));
+  }
+  // Corners are always computed and then masked, the scalar version skips them instead.
+  const vf_t n0 = vf_simplex2_corner(hash[0], x0, y0);
+  const vf_t n1 = vf_simplex2_corner(hash[1], x1, y1);
+  const vf_t n2 = vf_simplex2_corner(hash[2], x2, y2);
+  return vf_clamp_signed(40.0f * (n0 + n1 + n2));
+}
+/// The contribution of one simplex corner in 3D, `hash` is already looked up.
+static TCOD_NOISE_INLINE vf_t vf_simplex3_corner(vi_t hash, vf_t x, vf_t y, vf_t z) {
+  vf_t t = 0.6f - x * x - y * y - z * z;
+  const vi_t in_range = t >= 0.0f;
+  const vi_t h = hash & 0xF;
+  const vf_t u = vf_select(h < 8, x, y);
+  const vf_t v = vf_select(h < 4, y, vf_select((h == 12) | (h == 14), x, z));
+  vf_t n = vf_select((h & 1) != 0, -u, u) + vf_select((h & 2) != 0, -v, v);
+  t *= t;
+  n *= t * t;
+  return vf_select(in_range, n, vf_splat(0));
+}
+/// The vector version of `TCOD_noise_simplex` for 3D noise.  `cell` is an optional cache for grid rows.
+static TCOD_NOISE_INLINE vf_t vf_simplex3(
+    const TCOD_Noise* __restrict noise, const vf_t* __restrict f, struct TCOD_NoiseCell_* __restrict cell) {
+  static const float F3 = 0.333333333f;
+  static const float G3 = 0.166666667f;
+  const vf_t s = (f[0] + f[1] + f[2]) * F3 * SIMPLEX_SCALE;
+  const vf_t xs = f[0] * SIMPLEX_SCALE + s;
+  const vf_t ys = f[1] * SIMPLEX_SCALE + s;
+  const vf_t zs = f[2] * SIMPLEX_SCALE + s;
+  const vi_t i = vi_floor(xs);
+  const vi_t j = vi_floor(ys);
+  const vi_t k = vi_floor(zs);
+  const vf_t t = vf_from_int(i + j + k) * G3;
+  const vf_t x0 = f[0] * SIMPLEX_SCALE - (vf_from_int(i) - t);
+  const vf_t y0 = f[1] * SIMPLEX_SCALE - (vf_from_int(j) - t);
+  const vf_t z0 = f[2] * SIMPLEX_SCALE - (vf_from_int(k) - t);
+  // The simplex traversal order as masks, see the branches of the scalar version.
+  const vi_t a = x0 >= y0;
+  const vi_t b = y0 >= z0;
+  const vi_t c = x0 >= z0;
+  const vi_t i1 = -(a & (b | c));
+  const vi_t j1 = -(~a & b);
+  const vi_t k1 = -vi_select(a, ~b & ~c, ~b);
+  const vi_t i2 = -(a | (b & c));
+  const vi_t j2 = -(~a | b);
+  const vi_t k2 = -vi_select(a, ~b, ~(b & c));
+  const vf_t x1 = x0 - vf_from_int(i1) + G3;
+  const vf_t y1 = y0 - vf_from_int(j1) + G3;
+  const vf_t z1 = z0 - vf_from_int(k1) + G3;
+  const vf_t x2 = x0 - vf_from_int(i2) + 2.0f * G3;
+  const vf_t y2 = y0 - vf_from_int(j2) + 2.0f * G3;
+  const vf_t z2 = z0 - vf_from_int(k2) + 2.0f * G3;
+  const vf_t x3 = x0 - 1.0f + 3.0f * G3;
+  const vf_t y3 = y0 - 1.0f + 3.0f * G3;
+  const vf_t z3 = z0 - 1.0f + 3.0f * G3;
+  vi_t hash[4];
+  const vi_t ijk[3] = {i, j, k};
+  if (cell && vi_simplex_cell(noise, cell, ijk, 3)) {
+    hash[0] = (vi_t){0} + cell->hashes[0];
+    hash[1] = vi_cell_hash(cell, i1 | (j1 << 1) | (k1 << 2));
+    hash[2] = vi_cell_hash(cell, i2 | (j2 << 1) | (k2 << 2));
+    hash[3] = (vi_t){0} + cell->hashes[7];
+  } else {
+    const vi_t ii = i & 0xFF;
+    const vi_t jj = j & 0xFF;
+    const vi_t kk = k & 0xFF;
+    hash[0] = vi_map(noise, ii + vi_map(noise, jj + vi_map(noise, kk)));
+    hash[1] = vi_map(noise, ii + i1 + vi_map(noise, jj + j1 + vi_map(noise, kk + k1)));
+    hash[2] = vi_map(noise, ii + i2 + vi_map(noise, jj + j2 + vi_map(noise, kk + k2)));
+    hash[3] = vi_map(noise, ii + 1 + vi_map(noise, jj + 1 + vi_map(noise, kk + 1)));
+  }
+  const vf_t n0 = vf_simplex3_corner(hash[0], x0, y0, z0);
+  const vf_t n1 = vf_simplex3_corner(hash[1], x1, y1, z1);
+  const vf_t n2 = vf_simplex3_corner(hash[2], x2, y2, z2);
+  const vf_t n3 = vf_simplex3_corner(hash[3], x3, y3, z3);
+  return vf_clamp_signed(32.0f * (n0 + n1 + n2 + n3));
+}
+/// Evaluate one noise function of `type` and `ndim` dimensions.  Both are compile-time constants.
+static TCOD_NOISE_INLINE vf_t vf_noise(
+    const TCOD_Noise* __restrict noise,
+    const vf_t* __restrict f,
+    TCOD_noise_type_t type,
+    int ndim,
+    struct TCOD_NoiseCell_* __restrict cell) {
+  if (type == TCOD_NOISE_PERLIN) return ndim == 2 ? vf_perlin2(noise, f, cell) : vf_perlin3(noise, f, cell);
+  return ndim == 2 ? vf_simplex2(noise, f, cell) : vf_simplex3(noise, f, cell);
+}
+/// The vector version of `TCOD_noise_fbm_int` and `TCOD_noise_turbulence_int`.  `cells` has one cell per octave.
+static TCOD_NOISE_INLINE vf_t vf_noise_mode(
+    const TCOD_Noise* __restrict noise,
+    const vf_t* __restrict f,
+    float octaves,
+    TCOD_noise_type_t type,
+    int ndim,
+    TCOD_NoiseMode mode,
+    struct TCOD_NoiseCell_* __restrict cells) {
+  if (mode == TCOD_NOISE_MODE_PLAIN) return vf_noise(noise, f, type, ndim, cells);
+  vf_t tf[3] = {f[0], f[1], ndim >= 3 ? f[2] : vf_splat(0)};
+  vf_t value = vf_splat(0);
+  int i;
+  for (i = 0; i < (int)octaves; ++i) {
+    const vf_t noise_value = vf_noise(noise, tf, type, ndim, cells ? &cells[i] : NULL);
+    value += (mode == TCOD_NOISE_MODE_TURBULENCE ? vf_abs(noise_value) : noise_value) * noise->exponent[i];
+    for (int j = 0; j < ndim; ++j) tf[j] *= noise->lacunarity;
+  }
+  octaves -= (int)octaves;
+  if (octaves > DELTA) {
+    const vf_t noise_value = vf_noise(noise, tf, type, ndim, cells ? &cells[i] : NULL);
+    value += octaves * (mode == TCOD_NOISE_MODE_TURBULENCE ? vf_abs(noise_value) : noise_value) * noise->exponent[i];
+  }
+  return vf_clamp_signed(value);
+}
+/// Evaluate `n` points in blocks of TCOD_NOISE_LANES.  Missing input arrays are treated as zeros.
+static TCOD_NOISE_INLINE void noise_simd_batch(
+    const TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    int ndim,
+    TCOD_NoiseMode mode,
+    float octaves,
+    int n,
+    const float* const* __restrict inputs,
+    struct TCOD_NoiseCell_* __restrict cells,
+    float* __restrict out) {
+  for (int begin = 0; begin < n; begin += TCOD_NOISE_LANES) {
+    const int count = n - begin < TCOD_NOISE_LANES ? n - begin : TCOD_NOISE_LANES;
+    vf_t f[3];
+    for (int axis = 0; axis < ndim; ++axis) {
+      f[axis] = vf_splat(0);
+      if (!inputs[axis]) continue;
+      for (int i = 0; i < count; ++i) f[axis][i] = inputs[axis][begin + i];
+    }
+    const vf_t value = vf_noise_mode(noise, f, octaves, type, ndim, mode, cells);
+    for (int i = 0; i < count; ++i) out[begin + i] = value[i];
+  }
+}
+/// Dispatch a noise batch to a kernel specialized for its type, dimensions, and mode.
+static TCOD_NOISE_INLINE void noise_simd_dispatch(
+    const TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    TCOD_NoiseMode mode,
+    float octaves,
+    int n,
+    const float* const* __restrict inputs,
+    struct TCOD_NoiseCell_* __restrict cells,
+    float* __restrict out) {
+#define TCOD_NOISE_SIMD_CASE_(TYPE, NDIM, MODE)                                \
+  if (type == TYPE && noise->ndim == NDIM && mode == MODE) {                   \
+    noise_simd_batch(noise, TYPE, NDIM, MODE, octaves, n, inputs, cells, out); \
+    return;                                                                    \
+  }
+#define TCOD_NOISE_SIMD_MODES_(TYPE, NDIM)                  \
+  TCOD_NOISE_SIMD_CASE_(TYPE, NDIM, TCOD_NOISE_MODE_PLAIN) \
+  TCOD_NOISE_SIMD_CASE_(TYPE, NDIM, TCOD_NOISE_MODE_FBM)   \
+  TCOD_NOISE_SIMD_CASE_(TYPE, NDIM, TCOD_NOISE_MODE_TURBULENCE)
+  TCOD_NOISE_SIMD_MODES_(TCOD_NOISE_PERLIN, 2)
+  TCOD_NOISE_SIMD_MODES_(TCOD_NOISE_PERLIN, 3)
+  TCOD_NOISE_SIMD_MODES_(TCOD_NOISE_SIMPLEX, 2)
+  TCOD_NOISE_SIMD_MODES_(TCOD_NOISE_SIMPLEX, 3)
+#undef TCOD_NOISE_SIMD_MODES_
+#undef TCOD_NOISE_SIMD_CASE_
+}
+static void noise_simd_default(
+    const TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    TCOD_NoiseMode mode,
+    float octaves,
+    int n,
+    const float* const* __restrict inputs,
+    struct TCOD_NoiseCell_* __restrict cells,
+    float* __restrict out) {
+  noise_simd_dispatch(noise, type, mode, octaves, n, inputs, cells, out);
+}
+#ifdef TCOD_NOISE_SIMD_AVX2
+__attribute__((target("avx2"))) static void noise_simd_avx2(
+    const TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    TCOD_NoiseMode mode,
+    float octaves,
+    int n,
+    const float* const* __restrict inputs,
+    struct TCOD_NoiseCell_* __restrict cells,
+    float* __restrict out) {
+  noise_simd_dispatch(noise, type, mode, octaves, n, inputs, cells, out);
+}
+#endif  // TCOD_NOISE_SIMD_AVX2
+/// A vector of noise values with their partial derivatives, the vector version of `TCOD_NoiseDual_`.
+struct TCOD_NoiseVecDual_ {
+  vf_t value;
+  vf_t d[3];
+};
+/// The vector version of `dual_lerp`.
+static TCOD_NOISE_INLINE struct TCOD_NoiseVecDual_ vf_dual_lerp(
+    struct TCOD_NoiseVecDual_ a, struct TCOD_NoiseVecDual_ b, vf_t w, vf_t dw, int axis) {
+  struct TCOD_NoiseVecDual_ out;
+  out.value = vf_lerp(a.value, b.value, w);
+  for (int i = 0; i < 3; ++i) out.d[i] = vf_lerp(a.d[i], b.d[i], w);
+  out.d[axis] += dw * (b.value - a.value);
+  return out;
+}
+/// The vector version of `perlin_dual` for 2D and 3D noise.
+static TCOD_NOISE_INLINE struct TCOD_NoiseVecDual_ vf_perlin_dual(
+    const TCOD_Noise* __restrict noise, const vf_t* __restrict f, int ndim) {
+  vi_t n[3];
+  vf_t r[3];
+  vf_t w[3];
+  vf_t dw[3];
+  for (int i = 0; i < ndim; ++i) {
+    n[i] = vi_floor(f[i]);
+    r[i] = f[i] - vf_from_int(n[i]);
+    w[i] = vf_cubic(r[i]);
+    dw[i] = 6.0f * r[i] * (1.0f - r[i]);
+  }
+  struct TCOD_NoiseVecDual_ corners[8];
+  for (int corner = 0; corner < (1 << ndim); ++corner) {
+    vi_t index = (vi_t){0};
+    for (int i = 0; i < ndim; ++i) index = vi_map(noise, index + n[i] + ((corner >> i) & 1));
+    struct TCOD_NoiseVecDual_* it = &corners[corner];
+    it->value = vf_splat(0);
+    for (int i = 0; i < 3; ++i) it->d[i] = vf_splat(0);
+    for (int i = 0; i < ndim; ++i) {
+      it->d[i] = vf_gradient(noise, index, i);
+      it->value += it->d[i] * ((corner >> i) & 1 ? r[i] - 1.0f : r[i]);
+    }
+  }
+  for (int axis = 0; axis < ndim; ++axis) {
+    for (int corner = 0; corner < (1 << (ndim - axis - 1)); ++corner) {
+      corners[corner] = vf_dual_lerp(corners[corner * 2], corners[corner * 2 + 1], w[axis], dw[axis], axis);
+    }
+  }
+  return corners[0];
+}
+/// The vector version of `simplex_corner_dual` for 2D, `hash` is already looked up.
+static TCOD_NOISE_INLINE vf_t vf_simplex2_corner_dual(vi_t hash, vf_t x, vf_t y, vf_t* __restrict d) {
+  const vf_t t = 0.5f - x * x - y * y;
+  const vi_t in_range = t >= 0.0f;
+  const vi_t h = hash & 0x7;
+  const vi_t swap = h >= 4;
+  const vf_t u = vf_select(swap, y, x);
+  const vf_t v = vf_select(swap, 2.0f * x, 2.0f * y);
+  const vf_t n = vf_select((h & 1) != 0, -u, u) + vf_select((h & 2) != 0, -v, v);
+  const vf_t gu = vf_select((h & 1) != 0, vf_splat(-1.0f), vf_splat(1.0f));
+  const vf_t gv = vf_select((h & 2) != 0, vf_splat(-2.0f), vf_splat(2.0f));
+  const vf_t g[2] = {vf_select(swap, gv, gu), vf_select(swap, gu, gv)};
+  const vf_t xs[2] = {x, y};
+  const vf_t t2 = t * t;
+  for (int i = 0; i < 2; ++i) {
+    d[i] += vf_select(in_range, g[i] * t2 * t2 - 8.0f * xs[i] * n * t2 * t, vf_splat(0));
+  }
+  return vf_select(in_range, n * (t2 * t2), vf_splat(0));
+}
+/// The vector version of `simplex_corner_dual` for 3D, `hash` is already looked up.
+static TCOD_NOISE_INLINE vf_t vf_simplex3_corner_dual(vi_t hash, vf_t x, vf_t y, vf_t z, vf_t* __restrict d) {
+  const vf_t t = 0.6f - x * x - y * y - z * z;
+  const vi_t in_range = t >= 0.0f;
+  const vi_t h = hash & 0xF;
+  const vi_t u_is_x = h < 8;
+  const vi_t v_is_y = h < 4;
+  const vi_t v_is_x = (h == 12) | (h == 14);
+  const vf_t u = vf_select(u_is_x, x, y);
+  const vf_t v = vf_select(v_is_y, y, vf_select(v_is_x, x, z));
+  const vf_t n = vf_select((h & 1) != 0, -u, u) + vf_select((h & 2) != 0, -v, v);
+  const vf_t zero = vf_splat(0);
+  const vf_t gu = vf_select((h & 1) != 0, vf_splat(-1.0f), vf_splat(1.0f));
+  const vf_t gv = vf_select((h & 2) != 0, vf_splat(-1.0f), vf_splat(1.0f));
+  // `u` and `v` are always different axes, so each axis takes at most one of the gradients.
+  const vf_t g[3] = {
+      vf_select(u_is_x, gu, vf_select(v_is_x, gv, zero)),
+      vf_select(u_is_x, vf_select(v_is_y, gv, zero), gu),
+      vf_select(v_is_y | v_is_x, zero, gv),
+  };
+  const vf_t xs[3] = {x, y, z};
+  const vf_t t2 = t * t;
+  for (int i = 0; i < 3; ++i) {
+    d[i] += vf_select(in_range, g[i] * t2 * t2 - 8.0f * xs[i] * n * t2 * t, zero);
+  }
+  return vf_select(in_range, n * (t2 * t2), zero);
+}
+/// The vector version of `simplex_dual` for 2D noise.
+static TCOD_NOISE_INLINE struct TCOD_NoiseVecDual_ vf_simplex2_dual(
+    const TCOD_Noise* __restrict noise, const vf_t* __restrict f) {
+  static const float F2 = 0.366025403f;  // 0.5f * (sqrtf(3.0f)-1.0f);
+  static const float G2 = 0.211324865f;  // (3.0f - sqrtf(3.0f))/6.0f;
+  const vf_t s = (f[0] + f[1]) * F2 * SIMPLEX_SCALE;
+  const vi_t i = vi_floor(f[0] * SIMPLEX_SCALE + s);
+  const vi_t j = vi_floor(f[1] * SIMPLEX_SCALE + s);
+  const vf_t t = vf_from_int(i + j) * G2;
+  const vf_t x0 = f[0] * SIMPLEX_SCALE - (vf_from_int(i) - t);
+  const vf_t y0 = f[1] * SIMPLEX_SCALE - (vf_from_int(j) - t);
+  const vi_t i1 = -(x0 > y0);
+  const vi_t j1 = 1 - i1;
+  const vf_t x1 = x0 - vf_from_int(i1) + G2;
+  const vf_t y1 = y0 - vf_from_int(j1) + G2;
+  const vf_t x2 = x0 - 1.0f + 2.0f * G2;
+  const vf_t y2 = y0 - 1.0f + 2.0f * G2;
+  const vi_t ii = i & 0xFF;
+  const vi_t jj = j & 0xFF;
+  struct TCOD_NoiseVecDual_ out = {vf_splat(0), {vf_splat(0), vf_splat(0), vf_splat(0)}};
+  const vf_t n0 = vf_simplex2_corner_dual(vi_map(noise, ii + vi_map(noise, jj)), x0, y0, out.d);
+  const vf_t n1 = vf_simplex2_corner_dual(vi_map(noise, ii + i1 + vi_map(noise, jj + j1)), x1, y1, out.d);
+  const vf_t n2 = vf_simplex2_corner_dual(vi_map(noise, ii + 1 + vi_map(noise, jj + 1)), x2, y2, out.d);
+  out.value = 40.0f * (n0 + n1 + n2);
+  for (int axis = 0; axis < 2; ++axis) out.d[axis] *= 40.0f * SIMPLEX_SCALE;
+  return out;
+}
+/// The vector version of `simplex_dual` for 3D noise.
+static TCOD_NOISE_INLINE struct TCOD_NoiseVecDual_ vf_simplex3_dual(
+    const TCOD_Noise* __restrict noise, const vf_t* __restrict f) {
+  static const float F3 = 0.333333333f;
+  static const float G3 = 0.166666667f;
+  const vf_t s = (f[0] + f[1] + f[2]) * F3 * SIMPLEX_SCALE;
+  const vi_t i = vi_floor(f[0] * SIMPLEX_SCALE + s);
+  const vi_t j = vi_floor(f[1] * SIMPLEX_SCALE + s);
+  const vi_t k = vi_floor(f[2] * SIMPLEX_SCALE + s);
+  const vf_t t = vf_from_int(i + j + k) * G3;
+  const vf_t x0 = f[0] * SIMPLEX_SCALE - (vf_from_int(i) - t);
+  const vf_t y0 = f[1] * SIMPLEX_SCALE - (vf_from_int(j) - t);
+  const vf_t z0 = f[2] * SIMPLEX_SCALE - (vf_from_int(k) - t);
+  // The same traversal order masks as `vf_simplex3`.
+  const vi_t a = x0 >= y0;
+  const vi_t b = y0 >= z0;
+  const vi_t c = x0 >= z0;
+  const vi_t i1 = -(a & (b | c));
+  const vi_t j1 = -(~a & b);
+  const vi_t k1 = -vi_select(a, ~b & ~c, ~b);
+  const vi_t i2 = -(a | (b & c));
+  const vi_t j2 = -(~a | b);
+  const vi_t k2 = -vi_select(a, ~b, ~(b & c));
+  const vi_t ii = i & 0xFF;
+  const vi_t jj = j & 0xFF;
+  const vi_t kk = k & 0xFF;
+  struct TCOD_NoiseVecDual_ out = {vf_splat(0), {vf_splat(0), vf_splat(0), vf_splat(0)}};
+  const vf_t n0 = vf_simplex3_corner_dual(
+      vi_map(noise, ii + vi_map(noise, jj + vi_map(noise, kk))), x0, y0, z0, out.d);
+  const vf_t n1 = vf_simplex3_corner_dual(
+      vi_map(noise, ii + i1 + vi_map(noise, jj + j1 + vi_map(noise, kk + k1))),
+      x0 - vf_from_int(i1) + G3,
+      y0 - vf_from_int(j1) + G3,
+      z0 - vf_from_int(k1) + G3,
+      out.d);
+  const vf_t n2 = vf_simplex3_corner_dual(
+      vi_map(noise, ii + i2 + vi_map(noise, jj + j2 + vi_map(noise, kk + k2))),
+      x0 - vf_from_int(i2) + 2.0f * G3,
+      y0 - vf_from_int(j2) + 2.0f * G3,
+      z0 - vf_from_int(k2) + 2.0f * G3,
+      out.d);
+  const vf_t n3 = vf_simplex3_corner_dual(
+      vi_map(noise, ii + 1 + vi_map(noise, jj + 1 + vi_map(noise, kk + 1))),
+      x0 - 1.0f + 3.0f * G3,
+      y0 - 1.0f + 3.0f * G3,
+      z0 - 1.0f + 3.0f * G3,
+      out.d);
+  out.value = 32.0f * (n0 + n1 + n2 + n3);
+  for (int axis = 0; axis < 3; ++axis) out.d[axis] *= 32.0f * SIMPLEX_SCALE;
+  return out;
+}
+/// The vector version of `noise_dual`.  `type` and `ndim` are compile-time constants.
+static TCOD_NOISE_INLINE struct TCOD_NoiseVecDual_ vf_noise_dual(
+    const TCOD_Noise* __restrict noise, const vf_t* __restrict f, TCOD_noise_type_t type, int ndim) {
+  struct TCOD_NoiseVecDual_ out;
+  if (type == TCOD_NOISE_PERLIN) {
+    out = vf_perlin_dual(noise, f, ndim);
+  } else {
+    out = ndim == 2 ? vf_simplex2_dual(noise, f) : vf_simplex3_dual(noise, f);
+  }
+  const vf_t value = vf_clamp_signed(out.value);
+  const vi_t clamped = value != out.value;
+  out.value = value;
+  for (int i = 0; i < 3; ++i) out.d[i] = vf_select(clamped, vf_splat(0), out.d[i]);
+  return out;
+}
+/// The vector version of `TCOD_noise_get_fbm_with_gradient`, or of `noise_dual` when `mode` is plain.
+static TCOD_NOISE_INLINE struct TCOD_NoiseVecDual_ vf_noise_dual_mode(
+    const TCOD_Noise* __restrict noise,
+    const vf_t* __restrict f,
+    float octaves,
+    TCOD_noise_type_t type,
+    int ndim,
+    TCOD_NoiseMode mode) {
+  if (mode == TCOD_NOISE_MODE_PLAIN) return vf_noise_dual(noise, f, type, ndim);
+  vf_t tf[3] = {f[0], f[1], ndim >= 3 ? f[2] : vf_splat(0)};
+  struct TCOD_NoiseVecDual_ sum = {vf_splat(0), {vf_splat(0), vf_splat(0), vf_splat(0)}};
+  float frequency = 1.0f;
+  int i;
+  for (i = 0; i < (int)octaves; ++i) {
+    const struct TCOD_NoiseVecDual_ octave = vf_noise_dual(noise, tf, type, ndim);
+    sum.value += octave.value * noise->exponent[i];
+    for (int j = 0; j < 3; ++j) sum.d[j] += octave.d[j] * frequency * noise->exponent[i];
+    for (int j = 0; j < ndim; ++j) tf[j] *= noise->lacunarity;
+    frequency *= noise->lacunarity;
+  }
+  octaves -= (int)octaves;
+  if (octaves > DELTA) {
+    const struct TCOD_NoiseVecDual_ octave = vf_noise_dual(noise, tf, type, ndim);
+    sum.value += octaves * octave.value * noise->exponent[i];
+    for (int j = 0; j < 3; ++j) sum.d[j] += octaves * octave.d[j] * frequency * noise->exponent[i];
+  }
+  const vf_t value = vf_clamp_signed(sum.value);
+  const vi_t clamped = value != sum.value;
+  sum.value = value;
+  for (int j = 0; j < 3; ++j) sum.d[j] = vf_select(clamped, vf_splat(0), sum.d[j]);
+  return sum;
+}
+/**
+    Evaluate `n` points with their derivatives in blocks of TCOD_NOISE_LANES.
+
+    `outputs` are the value array followed by one derivative array per axis, any of them can be NULL.
+    Missing input arrays are treated as zeros.
+ */
+static TCOD_NOISE_INLINE void noise_dual_simd_batch(
+    const TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    int ndim,
+    TCOD_NoiseMode mode,
+    float octaves,
+    int n,
+    const float* const* __restrict inputs,
+    float* const* __restrict outputs) {
+  for (int begin = 0; begin < n; begin += TCOD_NOISE_LANES) {
+    const int count = n - begin < TCOD_NOISE_LANES ? n - begin : TCOD_NOISE_LANES;
+    vf_t f[3];
+    for (int axis = 0; axis < ndim; ++axis) {
+      f[axis] = vf_splat(0);
+      if (!inputs[axis]) continue;
+      for (int i = 0; i < count; ++i) f[axis][i] = inputs[axis][begin + i];
+    }
+    const struct TCOD_NoiseVecDual_ dual = vf_noise_dual_mode(noise, f, octaves, type, ndim, mode);
+    for (int i = 0; outputs[0] && i < count; ++i) outputs[0][begin + i] = dual.value[i];
+    for (int axis = 0; axis < 3; ++axis) {
+      float* __restrict derivatives = outputs[1 + axis];
+      for (int i = 0; derivatives && i < count; ++i) derivatives[begin + i] = axis < ndim ? dual.d[axis][i] : 0;
+    }
+  }
+}
+/// Dispatch a batch of noise with derivatives to a kernel specialized for its type, dimensions, and mode.
+static TCOD_NOISE_INLINE void noise_dual_simd_dispatch(
+    const TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    TCOD_NoiseMode mode,
+    float octaves,
+    int n,
+    const float* const* __restrict inputs,
+    float* const* __restrict outputs) {
+#define TCOD_NOISE_SIMD_CASE_(TYPE, NDIM, MODE)                                  \
+  if (type == TYPE && noise->ndim == NDIM && mode == MODE) {                     \
+    noise_dual_simd_batch(noise, TYPE, NDIM, MODE, octaves, n, inputs, outputs); \
+    return;                                                                      \
+  }
+#define TCOD_NOISE_SIMD_MODES_(TYPE, NDIM)                  \
+  TCOD_NOISE_SIMD_CASE_(TYPE, NDIM, TCOD_NOISE_MODE_PLAIN) \
+  TCOD_NOISE_SIMD_CASE_(TYPE, NDIM, TCOD_NOISE_MODE_FBM)
+  TCOD_NOISE_SIMD_MODES_(TCOD_NOISE_PERLIN, 2)
+  TCOD_NOISE_SIMD_MODES_(TCOD_NOISE_PERLIN, 3)
+  TCOD_NOISE_SIMD_MODES_(TCOD_NOISE_SIMPLEX, 2)
+  TCOD_NOISE_SIMD_MODES_(TCOD_NOISE_SIMPLEX, 3)
+#undef TCOD_NOISE_SIMD_MODES_
+#undef TCOD_NOISE_SIMD_CASE_
+}
+static void noise_dual_simd_default(
+    const TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    TCOD_NoiseMode mode,
+    float octaves,
+    int n,
+    const float* const* __restrict inputs,
+    float* const* __restrict outputs) {
+  noise_dual_simd_dispatch(noise, type, mode, octaves, n, inputs, outputs);
+}
+#ifdef TCOD_NOISE_SIMD_AVX2
+__attribute__((target("avx2"))) static void noise_dual_simd_avx2(
+    const TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    TCOD_NoiseMode mode,
+    float octaves,
+    int n,
+    const float* const* __restrict inputs,
+    float* const* __restrict outputs) {
+  noise_dual_simd_dispatch(noise, type, mode, octaves, n, inputs, outputs);
+}
+#endif  // TCOD_NOISE_SIMD_AVX2
+#endif  // defined(__GNUC__)
+
+/**
+    Try to evaluate a batch of noise with the SIMD kernels.
+
+    `cells` is an optional array of `TCOD_NOISE_MAX_OCTAVES` cached Perlin cells, used when points come from the rows
+    of a grid.  The cells must start invalid and can be reused by the following batches of the same noise and mode.
+
+    Returns false if the SIMD kernels do not support this type of noise, the caller must then use the scalar version.
+ */
+static bool TCOD_noise_simd_batch_(
+    const TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    TCOD_NoiseMode mode,
+    float octaves,
+    int n,
+    const float* __restrict x,
+    const float* __restrict y,
+    const float* __restrict z,
+    struct TCOD_NoiseCell_* __restrict cells,
+    float* __restrict out) {
+#ifdef TCOD_NOISE_SIMD
+  if (!type) type = noise->noise_type;
+  if (type == TCOD_NOISE_DEFAULT) type = TCOD_NOISE_SIMPLEX;
+  if (type != TCOD_NOISE_PERLIN && type != TCOD_NOISE_SIMPLEX) return false;
+  if (noise->ndim != 2 && noise->ndim != 3) return false;
+  const float* inputs[3] = {x, y, z};
+#ifdef TCOD_NOISE_SIMD_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    noise_simd_avx2(noise, type, mode, octaves, n, inputs, cells, out);
+    return true;
+  }
+#endif  // TCOD_NOISE_SIMD_AVX2
+  noise_simd_default(noise, type, mode, octaves, n, inputs, cells, out);
+  return true;
+#else
+  (void)noise;
+  (void)type;
+  (void)mode;
+  (void)octaves;
+  (void)n;
+  (void)x;
+  (void)y;
+  (void)z;
+  (void)cells;
+  (void)out;
+  return false;
+#endif  // TCOD_NOISE_SIMD
+}
+
+/**
+    Try to evaluate a batch of noise with derivatives with the SIMD kernels.
+
+    `mode` is either plain or fBm.  `outputs` are the value array followed by the `dx`, `dy`, and `dz` arrays.
+
+    Returns false if the SIMD kernels do not support this type of noise, the caller must then use the scalar version.
+ */
+static bool TCOD_noise_dual_simd_batch_(
+    const TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    TCOD_NoiseMode mode,
+    float octaves,
+    int n,
+    const float* __restrict x,
+    const float* __restrict y,
+    const float* __restrict z,
+    float* const* __restrict outputs) {
+#ifdef TCOD_NOISE_SIMD
+  if (!type) type = noise->noise_type;
+  if (type == TCOD_NOISE_DEFAULT) type = TCOD_NOISE_SIMPLEX;
+  if (type != TCOD_NOISE_PERLIN && type != TCOD_NOISE_SIMPLEX) return false;
+  if (noise->ndim != 2 && noise->ndim != 3) return false;
+  const float* inputs[3] = {x, y, z};
+#ifdef TCOD_NOISE_SIMD_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    noise_dual_simd_avx2(noise, type, mode, octaves, n, inputs, outputs);
+    return true;
+  }
+#endif  // TCOD_NOISE_SIMD_AVX2
+  noise_dual_simd_default(noise, type, mode, octaves, n, inputs, outputs);
+  return true;
+#else
+  (void)noise;
+  (void)type;
+  (void)mode;
+  (void)octaves;
+  (void)n;
+  (void)x;
+  (void)y;
+  (void)z;
+  (void)outputs;
+  return false;
+#endif  // TCOD_NOISE_SIMD
+}
+
+void TCOD_noise_get_with_gradient_vectorized(
+    TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    int n,
+    const float* __restrict x,
+    const float* __restrict y,
+    const float* __restrict z,
+    float* __restrict out,
+    float* __restrict dx,
+    float* __restrict dy,
+    float* __restrict dz) {
+  float* const outputs[4] = {out, dx, dy, dz};
+  if (TCOD_noise_dual_simd_batch_(noise, type, TCOD_NOISE_MODE_PLAIN, 0, n, x, y, z, outputs)) return;
+  for (int i = 0; i < n; ++i) {
+    const float point[3] = {x ? x[i] : 0, y ? y[i] : 0, z ? z[i] : 0};
+    float gradient[3] = {0, 0, 0};
+    const float value = TCOD_noise_get_with_gradient(noise, point, type, gradient);
+    if (out) out[i] = value;
+    if (dx) dx[i] = gradient[0];
+    if (dy) dy[i] = gradient[1];
+    if (dz) dz[i] = gradient[2];
+  }
+}
+
+void TCOD_noise_get_fbm_with_gradient_vectorized(
+    TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    float octaves,
+    int n,
+    const float* __restrict x,
+    const float* __restrict y,
+    const float* __restrict z,
+    float* __restrict out,
+    float* __restrict dx,
+    float* __restrict dy,
+    float* __restrict dz) {
+  float* const outputs[4] = {out, dx, dy, dz};
+  if (TCOD_noise_dual_simd_batch_(noise, type, TCOD_NOISE_MODE_FBM, octaves, n, x, y, z, outputs)) return;
+  for (int i = 0; i < n; ++i) {
+    const float point[3] = {x ? x[i] : 0, y ? y[i] : 0, z ? z[i] : 0};
+    float gradient[3] = {0, 0, 0};
+    const float value = TCOD_noise_get_fbm_with_gradient(noise, point, octaves, type, gradient);
+    if (out) out[i] = value;
+    if (dx) dx[i] = gradient[0];
+    if (dy) dy[i] = gradient[1];
+    if (dz) dz[i] = gradient[2];
+  }
+}
+
 void TCOD_noise_get_vectorized(
     TCOD_Noise* __restrict noise,
     TCOD_noise_type_t type,
@@ -895,6 +2372,7 @@ void TCOD_noise_get_vectorized(
     float* __restrict z,
     float* __restrict w,
     float* __restrict out) {
+  if (TCOD_noise_simd_batch_(noise, type, TCOD_NOISE_MODE_PLAIN, 0, n, x, y, z, NULL, out)) return;
   for (int i = 0; i < n; ++i) {
     const float point[4] = {
         x ? x[i] : 0,
@@ -913,6 +2391,11 @@ void TCOD_noise_get_vectorized(
       case (TCOD_NOISE_WAVELET):
         out[i] = TCOD_noise_wavelet(noise, point);
         break;
+      case TCOD_NOISE_WORLEY_F1:
+      case TCOD_NOISE_WORLEY_F2:
+      case TCOD_NOISE_WORLEY_F2_F1:
+        out[i] = TCOD_noise_worley(noise, point, type ? type : noise->noise_type);
+        break;
       default:
         out[i] = NAN;
         break;
@@ -930,6 +2413,7 @@ void TCOD_noise_get_fbm_vectorized(
     float* __restrict z,
     float* __restrict w,
     float* __restrict out) {
+  if (TCOD_noise_simd_batch_(noise, type, TCOD_NOISE_MODE_FBM, octaves, n, x, y, z, NULL, out)) return;
   for (int i = 0; i < n; ++i) {
     const float point[4] = {
         x ? x[i] : 0,
@@ -948,6 +2432,11 @@ void TCOD_noise_get_fbm_vectorized(
       case (TCOD_NOISE_WAVELET):
         out[i] = TCOD_noise_fbm_wavelet(noise, point, octaves);
         break;
+      case TCOD_NOISE_WORLEY_F1:
+      case TCOD_NOISE_WORLEY_F2:
+      case TCOD_NOISE_WORLEY_F2_F1:
+        out[i] = TCOD_noise_get_fbm_ex(noise, point, octaves, type);
+        break;
       default:
         out[i] = NAN;
         break;
@@ -965,6 +2454,7 @@ void TCOD_noise_get_turbulence_vectorized(
     float* __restrict z,
     float* __restrict w,
     float* __restrict out) {
+  if (TCOD_noise_simd_batch_(noise, type, TCOD_NOISE_MODE_TURBULENCE, octaves, n, x, y, z, NULL, out)) return;
   for (int i = 0; i < n; ++i) {
     const float point[4] = {
         x ? x[i] : 0,
@@ -983,9 +2473,132 @@ void TCOD_noise_get_turbulence_vectorized(
       case (TCOD_NOISE_WAVELET):
         out[i] = TCOD_noise_turbulence_wavelet(noise, point, octaves);
         break;
+      case TCOD_NOISE_WORLEY_F1:
+      case TCOD_NOISE_WORLEY_F2:
+      case TCOD_NOISE_WORLEY_F2_F1:
+        out[i] = TCOD_noise_get_turbulence_ex(noise, point, octaves, type);
+        break;
       default:
         out[i] = NAN;
         break;
     }
   }
 }
+
+/// The number of points evaluated at once by `TCOD_noise_fill_grid`.
+#define TCOD_NOISE_FILL_BLOCK 256
+
+/// The shared parameters of a `TCOD_noise_fill_grid` call.
+struct TCOD_NoiseFill_ {
+  TCOD_Noise* noise;
+  TCOD_noise_type_t type;
+  TCOD_NoiseMode mode;
+  float octaves;
+  int ndim;
+  int shape[TCOD_NOISE_MAX_DIMENSIONS];
+  size_t strides[TCOD_NOISE_MAX_DIMENSIONS];
+  float offset[TCOD_NOISE_MAX_DIMENSIONS];
+  float scale[TCOD_NOISE_MAX_DIMENSIONS];
+  unsigned char* out;
+};
+
+/// Fill the rows `[begin, end)` of a grid, rows are every index of the axes after the first one.
+static void TCOD_noise_fill_rows_(void* userdata, int begin, int end) {
+  const struct TCOD_NoiseFill_* fill = userdata;
+  float coords[TCOD_NOISE_MAX_DIMENSIONS][TCOD_NOISE_FILL_BLOCK];
+  float values[TCOD_NOISE_FILL_BLOCK];
+  struct TCOD_NoiseCell_ cells[TCOD_NOISE_MAX_OCTAVES];
+  for (int i = 0; i < TCOD_NOISE_MAX_OCTAVES; ++i) cells[i].valid = false;
+  const bool contiguous = fill->strides[0] == sizeof(float);
+  for (int row = begin; row < end; ++row) {
+    // Unravel the row into the indexes of the other axes.
+    int index[TCOD_NOISE_MAX_DIMENSIONS] = {0, 0, 0, 0};
+    unsigned char* row_out = fill->out;
+    for (int axis = 1, remaining = row; axis < fill->ndim; ++axis) {
+      index[axis] = remaining % fill->shape[axis];
+      remaining /= fill->shape[axis];
+      row_out += index[axis] * fill->strides[axis];
+    }
+    for (int x = 0; x < fill->shape[0]; x += TCOD_NOISE_FILL_BLOCK) {
+      const int n = fill->shape[0] - x < TCOD_NOISE_FILL_BLOCK ? fill->shape[0] - x : TCOD_NOISE_FILL_BLOCK;
+      for (int i = 0; i < n; ++i) coords[0][i] = (x + i + fill->offset[0]) * fill->scale[0];
+      for (int axis = 1; axis < fill->noise->ndim; ++axis) {
+        const float coord = (index[axis] + fill->offset[axis]) * fill->scale[axis];
+        for (int i = 0; i < n; ++i) coords[axis][i] = coord;
+      }
+      float* out = contiguous ? (float*)(row_out + x * sizeof(float)) : values;
+      if (!TCOD_noise_simd_batch_(
+              fill->noise, fill->type, fill->mode, fill->octaves, n, coords[0], coords[1], coords[2], cells, out)) {
+        switch (fill->mode) {
+          case TCOD_NOISE_MODE_PLAIN:
+          default:
+            TCOD_noise_get_vectorized(fill->noise, fill->type, n, coords[0], coords[1], coords[2], coords[3], out);
+            break;
+          case TCOD_NOISE_MODE_FBM:
+            TCOD_noise_get_fbm_vectorized(
+                fill->noise, fill->type, fill->octaves, n, coords[0], coords[1], coords[2], coords[3], out);
+            break;
+          case TCOD_NOISE_MODE_TURBULENCE:
+            TCOD_noise_get_turbulence_vectorized(
+                fill->noise, fill->type, fill->octaves, n, coords[0], coords[1], coords[2], coords[3], out);
+            break;
+        }
+      }
+      if (contiguous) continue;
+      for (int i = 0; i < n; ++i) memcpy(row_out + (x + i) * fill->strides[0], &values[i], sizeof(float));
+    }
+  }
+}
+
+TCOD_Error TCOD_noise_fill_grid(
+    TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    TCOD_NoiseMode mode,
+    float octaves,
+    int ndim,
+    const int* __restrict shape,
+    const size_t* __restrict strides,
+    const float* __restrict offset,
+    const float* __restrict scale,
+    float* __restrict out) {
+  if (!noise || !shape) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  if (ndim < 1 || ndim > noise->ndim) {
+    TCOD_set_errorvf("ndim must be between 1 and %i, got %i.", noise->ndim, ndim);
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  if (mode != TCOD_NOISE_MODE_PLAIN && !(octaves >= 0 && octaves <= TCOD_NOISE_MAX_OCTAVES - 1)) {
+    TCOD_set_errorvf("octaves must be between 0 and %i, got %f.", TCOD_NOISE_MAX_OCTAVES - 1, octaves);
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  struct TCOD_NoiseFill_ fill = {noise, type, mode, octaves, ndim, {0}, {0}, {0}, {0}, (unsigned char*)out};
+  int row_count = 1;
+  for (int axis = 0; axis < noise->ndim; ++axis) {
+    if (axis < ndim) {
+      if (shape[axis] < 0) {
+        TCOD_set_errorvf("shape[%i] must not be negative, got %i.", axis, shape[axis]);
+        return TCOD_E_INVALID_ARGUMENT;
+      }
+      fill.shape[axis] = shape[axis];
+      fill.strides[axis] = strides ? strides[axis] : (axis ? fill.strides[axis - 1] * shape[axis - 1] : sizeof(float));
+      if (axis) row_count *= shape[axis];
+    }
+    fill.offset[axis] = offset ? offset[axis] : 0.0f;
+    fill.scale[axis] = scale ? scale[axis] : 1.0f;
+  }
+  if (fill.shape[0] == 0 || row_count == 0) return TCOD_E_OK;
+  if (!out) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  if ((type ? type : noise->noise_type) == TCOD_NOISE_WAVELET && !noise->waveletTileData && noise->ndim <= 3) {
+    TCOD_noise_wavelet_init(noise);  // Initialized here since it can not be done from multiple threads.
+  }
+  // Blocks of at least this many points are given to each thread.
+  const int grain_points = 16384;
+  const int grain = fill.shape[0] >= grain_points ? 1 : grain_points / fill.shape[0];
+  TCOD_parallel_for(row_count, grain, TCOD_noise_fill_rows_, &fill);
+  return TCOD_E_OK;
+}
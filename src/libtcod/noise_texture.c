@@ -0,0 +1,250 @@
+/* BSD 3-Clause License
+ *
+ * Copyright © 2008-2023, Jice and the libtcod contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "noise_texture.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif  // M_PI
+
+/// Bake 4D noise by sampling around a torus, each texture axis follows its own circle.
+static TCOD_Error noise_texture_bake_torus(
+    TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    TCOD_NoiseMode mode,
+    float octaves,
+    float scale,
+    TCOD_NoiseTexture* __restrict texture) {
+  const int width = texture->width;
+  const int height = texture->height;
+  float* coords = malloc(sizeof(*coords) * width * 4);
+  if (!coords) {
+    TCOD_set_errorv("Out of memory.");
+    return TCOD_E_OUT_OF_MEMORY;
+  }
+  float* x = coords;
+  float* y = coords + width;
+  float* z = coords + width * 2;
+  float* w = coords + width * 3;
+  // The circumference of each circle is the period of the texture along that axis.
+  const float radius_x = width * scale / (float)(2 * M_PI);
+  const float radius_y = height * scale / (float)(2 * M_PI);
+  for (int i = 0; i < width; ++i) {
+    const float angle = (float)(2 * M_PI) * i / width;
+    x[i] = cosf(angle) * radius_x;
+    y[i] = sinf(angle) * radius_x;
+  }
+  for (int j = 0; j < height; ++j) {
+    const float angle = (float)(2 * M_PI) * j / height;
+    for (int i = 0; i < width; ++i) {
+      z[i] = cosf(angle) * radius_y;
+      w[i] = sinf(angle) * radius_y;
+    }
+    float* out = &texture->values[j * width];
+    switch (mode) {
+      case TCOD_NOISE_MODE_PLAIN:
+        TCOD_noise_get_vectorized(noise, type, width, x, y, z, w, out);
+        break;
+      case TCOD_NOISE_MODE_FBM:
+        TCOD_noise_get_fbm_vectorized(noise, type, octaves, width, x, y, z, w, out);
+        break;
+      case TCOD_NOISE_MODE_TURBULENCE:
+        TCOD_noise_get_turbulence_vectorized(noise, type, octaves, width, x, y, z, w, out);
+        break;
+    }
+  }
+  free(coords);
+  return TCOD_E_OK;
+}
+
+/// Bake 2D or 3D noise by cross-fading a grid of twice the texture size, so that each edge meets its opposite side.
+static TCOD_Error noise_texture_bake_blend(
+    TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    TCOD_NoiseMode mode,
+    float octaves,
+    float scale,
+    TCOD_NoiseTexture* __restrict texture) {
+  const int width = texture->width;
+  const int height = texture->height;
+  const int shape[2] = {width * 2, height * 2};
+  const float offset[2] = {(float)-width, (float)-height};
+  const float scales[2] = {scale, scale};
+  float* grid = malloc(sizeof(*grid) * shape[0] * shape[1]);
+  if (!grid) {
+    TCOD_set_errorv("Out of memory.");
+    return TCOD_E_OUT_OF_MEMORY;
+  }
+  const TCOD_Error err = TCOD_noise_fill_grid(noise, type, mode, octaves, 2, shape, NULL, offset, scales, grid);
+  if (err < 0) {
+    free(grid);
+    return err;
+  }
+  // `grid` holds the noise from -width to width and from -height to height.
+  for (int y = 0; y < height; ++y) {
+    const float wy = (float)y / height;
+    const float* row_near = &grid[(y + height) * shape[0]];  // The noise at `y`.
+    const float* row_far = &grid[y * shape[0]];  // The noise at `y - height`.
+    float* out = &texture->values[y * width];
+    for (int x = 0; x < width; ++x) {
+      const float wx = (float)x / width;
+      const float near = row_near[x + width] + (row_near[x] - row_near[x + width]) * wx;
+      const float far = row_far[x + width] + (row_far[x] - row_far[x + width]) * wx;
+      out[x] = near + (far - near) * wy;
+    }
+  }
+  free(grid);
+  return TCOD_E_OK;
+}
+
+TCOD_NoiseTexture* TCOD_noise_texture_new(
+    TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    TCOD_NoiseMode mode,
+    float octaves,
+    int width,
+    int height,
+    float scale) {
+  if (!noise) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return NULL;
+  }
+  if (width <= 0 || height <= 0) {
+    TCOD_set_errorvf("Texture size must be positive, got %ix%i.", width, height);
+    return NULL;
+  }
+  if (noise->ndim < 2) {
+    TCOD_set_errorv("Noise textures need noise of at least 2 dimensions.");
+    return NULL;
+  }
+  if (mode != TCOD_NOISE_MODE_PLAIN && mode != TCOD_NOISE_MODE_FBM && mode != TCOD_NOISE_MODE_TURBULENCE) {
+    TCOD_set_errorvf("Invalid noise mode %i.", (int)mode);
+    return NULL;
+  }
+  TCOD_NoiseTexture* texture = calloc(1, sizeof(*texture));
+  if (!texture) {
+    TCOD_set_errorv("Out of memory.");
+    return NULL;
+  }
+  texture->width = width;
+  texture->height = height;
+  texture->values = malloc(sizeof(*texture->values) * width * height);
+  if (!texture->values) {
+    TCOD_set_errorv("Out of memory.");
+    TCOD_noise_texture_delete(texture);
+    return NULL;
+  }
+  const TCOD_Error err = noise->ndim >= 4 ? noise_texture_bake_torus(noise, type, mode, octaves, scale, texture)
+                                          : noise_texture_bake_blend(noise, type, mode, octaves, scale, texture);
+  if (err < 0) {
+    TCOD_noise_texture_delete(texture);
+    return NULL;
+  }
+  return texture;
+}
+
+void TCOD_noise_texture_delete(TCOD_NoiseTexture* texture) {
+  if (!texture) return;
+  free(texture->values);
+  free(texture);
+}
+
+/// Wrap `i` into `[0, n)`.
+static inline int noise_texture_wrap(int i, int n) {
+  i %= n;
+  return i < 0 ? i + n : i;
+}
+
+/// Return the bilinear sample of `texture`.
+static inline float noise_texture_bilinear(const TCOD_NoiseTexture* __restrict texture, float u, float v) {
+  const float floor_u = floorf(u);
+  const float floor_v = floorf(v);
+  const float fx = u - floor_u;
+  const float fy = v - floor_v;
+  const int x0 = noise_texture_wrap((int)floor_u, texture->width);
+  const int y0 = noise_texture_wrap((int)floor_v, texture->height);
+  const int x1 = x0 + 1 == texture->width ? 0 : x0 + 1;
+  const int y1 = y0 + 1 == texture->height ? 0 : y0 + 1;
+  const float* row0 = &texture->values[y0 * texture->width];
+  const float* row1 = &texture->values[y1 * texture->width];
+  const float top = row0[x0] + (row0[x1] - row0[x0]) * fx;
+  const float bottom = row1[x0] + (row1[x1] - row1[x0]) * fx;
+  return top + (bottom - top) * fy;
+}
+
+/// Write the Catmull-Rom weights of the four texels around a fraction `t` to `w`.
+static inline void noise_texture_cubic_weights(float t, float* __restrict w) {
+  w[0] = ((-t + 2.0f) * t - 1.0f) * t * 0.5f;
+  w[1] = ((3.0f * t - 5.0f) * t * t + 2.0f) * 0.5f;
+  w[2] = ((-3.0f * t + 4.0f) * t + 1.0f) * t * 0.5f;
+  w[3] = (t - 1.0f) * t * t * 0.5f;
+}
+
+/// Return the bicubic sample of `texture`.
+static float noise_texture_bicubic(const TCOD_NoiseTexture* __restrict texture, float u, float v) {
+  const float floor_u = floorf(u);
+  const float floor_v = floorf(v);
+  float wx[4];
+  float wy[4];
+  noise_texture_cubic_weights(u - floor_u, wx);
+  noise_texture_cubic_weights(v - floor_v, wy);
+  int xs[4];
+  for (int i = 0; i < 4; ++i) xs[i] = noise_texture_wrap((int)floor_u + i - 1, texture->width);
+  float result = 0;
+  for (int j = 0; j < 4; ++j) {
+    const float* row = &texture->values[noise_texture_wrap((int)floor_v + j - 1, texture->height) * texture->width];
+    result += wy[j] * (wx[0] * row[xs[0]] + wx[1] * row[xs[1]] + wx[2] * row[xs[2]] + wx[3] * row[xs[3]]);
+  }
+  return result;
+}
+
+float TCOD_noise_texture_sample(
+    const TCOD_NoiseTexture* __restrict texture, float u, float v, TCOD_NoiseTextureFilter filter) {
+  if (filter == TCOD_NOISE_TEXTURE_BICUBIC) return noise_texture_bicubic(texture, u, v);
+  return noise_texture_bilinear(texture, u, v);
+}
+
+void TCOD_noise_texture_sample_vectorized(
+    const TCOD_NoiseTexture* __restrict texture,
+    TCOD_NoiseTextureFilter filter,
+    int n,
+    const float* __restrict u,
+    const float* __restrict v,
+    float* __restrict out) {
+  if (filter == TCOD_NOISE_TEXTURE_BICUBIC) {
+    for (int i = 0; i < n; ++i) out[i] = noise_texture_bicubic(texture, u[i], v[i]);
+  } else {
+    for (int i = 0; i < n; ++i) out[i] = noise_texture_bilinear(texture, u[i], v[i]);
+  }
+}
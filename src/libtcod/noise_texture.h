@@ -0,0 +1,106 @@
+/* BSD 3-Clause License
+ *
+ * Copyright © 2008-2023, Jice and the libtcod contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef TCOD_NOISE_TEXTURE_H_
+#define TCOD_NOISE_TEXTURE_H_
+
+#include "config.h"
+#include "error.h"
+#include "noise.h"
+
+/**
+    A periodic table of noise values which tiles seamlessly in both directions.
+
+    Baking a texture evaluates the noise once, samples are then interpolated from the table.
+ */
+typedef struct TCOD_NoiseTexture {
+  int width;  // The period of the texture along the x axis, in texels.
+  int height;  // The period of the texture along the y axis, in texels.
+  float* values;  // `width * height` values in row-major order.
+} TCOD_NoiseTexture;
+
+/**
+    Interpolation used when sampling a TCOD_NoiseTexture.
+ */
+typedef enum TCOD_NoiseTextureFilter {
+  TCOD_NOISE_TEXTURE_BILINEAR = 0,  // Linear interpolation of the nearest 2x2 texels.
+  TCOD_NOISE_TEXTURE_BICUBIC = 1,  // Catmull-Rom interpolation of the nearest 4x4 texels.
+} TCOD_NoiseTextureFilter;
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+/**
+    Bake a `width` by `height` periodic noise texture.
+
+    `type`, `mode`, and `octaves` are the same as `TCOD_noise_fill_grid`.  `scale` is the noise distance between
+    neighboring texels.
+
+    4D noise is sampled around a torus, which tiles without any distortion.
+    2D and 3D noise is cross-faded with copies of itself shifted by one period, this lowers the contrast toward the
+    middle of the texture.
+
+    Returns NULL on failure.
+ */
+TCOD_NODISCARD
+TCOD_PUBLIC TCOD_NoiseTexture* TCOD_noise_texture_new(
+    TCOD_Noise* __restrict noise,
+    TCOD_noise_type_t type,
+    TCOD_NoiseMode mode,
+    float octaves,
+    int width,
+    int height,
+    float scale);
+/**
+    Delete a texture from `TCOD_noise_texture_new`.
+ */
+TCOD_PUBLIC void TCOD_noise_texture_delete(TCOD_NoiseTexture* texture);
+/**
+    Sample a texture at the texel coordinates `u`, `v`, which wrap around the texture period.
+
+    Texel `x, y` is sampled exactly at `u = x, v = y`.
+ */
+TCOD_NODISCARD
+TCOD_PUBLIC float TCOD_noise_texture_sample(
+    const TCOD_NoiseTexture* __restrict texture, float u, float v, TCOD_NoiseTextureFilter filter);
+/**
+    Sample a texture at `n` coordinates `u[n]`, `v[n]`, writing the results to `out[n]`.
+ */
+TCOD_PUBLIC void TCOD_noise_texture_sample_vectorized(
+    const TCOD_NoiseTexture* __restrict texture,
+    TCOD_NoiseTextureFilter filter,
+    int n,
+    const float* __restrict u,
+    const float* __restrict v,
+    float* __restrict out);
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+#endif  // TCOD_NOISE_TEXTURE_H_
@@ -0,0 +1,145 @@
+/* BSD 3-Clause License
+ *
+ * Copyright © 2008-2023, Jice and the libtcod contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "parallel.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifndef TCOD_NO_THREADS
+#ifdef _WIN32
+#define NOMINMAX 1
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif  // _WIN32
+#endif  // TCOD_NO_THREADS
+
+/// The upper limit of threads started by a single loop.
+#define TCOD_PARALLEL_MAX_THREADS 64
+
+static int TCOD_parallel_max_threads_ = 0;
+
+void TCOD_parallel_set_max_threads(int max_threads) { TCOD_parallel_max_threads_ = max_threads > 0 ? max_threads : 0; }
+
+/// Return the number of online CPU cores.
+static int TCOD_parallel_core_count(void) {
+#if defined(TCOD_NO_THREADS)
+  return 1;
+#elif defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+  const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores > 0 ? (int)cores : 1;
+#else
+  return 1;
+#endif
+}
+
+int TCOD_parallel_get_max_threads(void) {
+  int threads = TCOD_parallel_max_threads_ ? TCOD_parallel_max_threads_ : TCOD_parallel_core_count();
+#ifdef TCOD_NO_THREADS
+  threads = 1;
+#endif  // TCOD_NO_THREADS
+  if (threads > TCOD_PARALLEL_MAX_THREADS) threads = TCOD_PARALLEL_MAX_THREADS;
+  return threads;
+}
+
+/// One block of a parallel loop.
+struct TCOD_ParallelTask {
+  TCOD_ParallelFunc func;
+  void* userdata;
+  int begin;
+  int end;
+};
+
+#ifndef TCOD_NO_THREADS
+#ifdef _WIN32
+static DWORD WINAPI TCOD_parallel_worker(LPVOID arg) {
+  const struct TCOD_ParallelTask* task = arg;
+  task->func(task->userdata, task->begin, task->end);
+  return 0;
+}
+#else
+static void* TCOD_parallel_worker(void* arg) {
+  const struct TCOD_ParallelTask* task = arg;
+  task->func(task->userdata, task->begin, task->end);
+  return NULL;
+}
+#endif  // _WIN32
+#endif  // TCOD_NO_THREADS
+
+void TCOD_parallel_for(int count, int grain, TCOD_ParallelFunc func, void* userdata) {
+  if (count <= 0) return;
+  if (grain < 1) grain = 1;
+  int block_count = TCOD_parallel_get_max_threads();
+  if (block_count > (count + grain - 1) / grain) block_count = (count + grain - 1) / grain;
+  if (block_count <= 1) {
+    func(userdata, 0, count);
+    return;
+  }
+#ifdef TCOD_NO_THREADS
+  func(userdata, 0, count);
+#else
+  struct TCOD_ParallelTask tasks[TCOD_PARALLEL_MAX_THREADS];
+  for (int i = 0; i < block_count; ++i) {
+    tasks[i] = (struct TCOD_ParallelTask){
+        func, userdata, (int)((long long)count * i / block_count), (int)((long long)count * (i + 1) / block_count)};
+  }
+#ifdef _WIN32
+  HANDLE threads[TCOD_PARALLEL_MAX_THREADS];
+  for (int i = 1; i < block_count; ++i) {
+    threads[i] = CreateThread(NULL, 0, TCOD_parallel_worker, &tasks[i], 0, NULL);
+    if (!threads[i]) TCOD_parallel_worker(&tasks[i]);  // Run this block here if the thread could not be started.
+  }
+  TCOD_parallel_worker(&tasks[0]);
+  for (int i = 1; i < block_count; ++i) {
+    if (!threads[i]) continue;
+    WaitForSingleObject(threads[i], INFINITE);
+    CloseHandle(threads[i]);
+  }
+#else
+  pthread_t threads[TCOD_PARALLEL_MAX_THREADS];
+  bool started[TCOD_PARALLEL_MAX_THREADS];
+  for (int i = 1; i < block_count; ++i) {
+    started[i] = pthread_create(&threads[i], NULL, TCOD_parallel_worker, &tasks[i]) == 0;
+    if (!started[i]) TCOD_parallel_worker(&tasks[i]);  // Run this block here if the thread could not be started.
+  }
+  TCOD_parallel_worker(&tasks[0]);
+  for (int i = 1; i < block_count; ++i) {
+    if (started[i]) pthread_join(threads[i], NULL);
+  }
+#endif  // _WIN32
+#endif  // TCOD_NO_THREADS
+}
@@ -0,0 +1,67 @@
+/* BSD 3-Clause License
+ *
+ * Copyright © 2008-2023, Jice and the libtcod contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef TCOD_PARALLEL_H_
+#define TCOD_PARALLEL_H_
+
+#include "config.h"
+
+/**
+    A function which processes the items `[begin, end)` of a parallel loop.
+ */
+typedef void (*TCOD_ParallelFunc)(void* userdata, int begin, int end);
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+/**
+    Call `func` over the items `[0, count)` split into contiguous blocks which are run on multiple threads.
+
+    `grain` is the smallest number of items worth giving to a thread, this should be large enough to hide the cost of
+    starting a thread.  The calling thread processes the first block and returns once every block is done.
+
+    Blocks only depend on `count`, `grain`, and the thread limit, so `func` must not depend on which thread runs it.
+    Without thread support this calls `func` once with the whole range.
+ */
+TCOD_PUBLIC void TCOD_parallel_for(int count, int grain, TCOD_ParallelFunc func, void* userdata);
+/**
+    Set the maximum number of threads used by `TCOD_parallel_for` and by the functions built on it.
+
+    The default of zero uses one thread per CPU core.  Setting this to 1 runs everything on the calling thread.
+ */
+TCOD_PUBLIC void TCOD_parallel_set_max_threads(int max_threads);
+/**
+    Return the number of threads `TCOD_parallel_for` will use at most.
+ */
+TCOD_PUBLIC int TCOD_parallel_get_max_threads(void);
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+#endif  // TCOD_PARALLEL_H_
@@ -31,43 +31,66 @@
  */
 #include "pathfinder.h"
 
+#include <limits.h>
 #include <stdlib.h>
 
-static void* array_index(const struct TCOD_ArrayData* arr, const int* index) {
-  unsigned char* ptr = arr->data;
-  for (int i = 0; i < arr->ndim; ++i) {
-    ptr += arr->strides[i] * index[i];
-  }
-  return (void*)ptr;
-}
+#include "error.h"
+
+#if defined(_MSC_VER)
+#define TCOD_PF_INLINE __forceinline
+#elif defined(__GNUC__)
+#define TCOD_PF_INLINE inline __attribute__((always_inline))
+#else
+#define TCOD_PF_INLINE inline
+#endif
+
+/// Graphs with edge costs up to this value use a bucket queue instead of a heap.
+#define TCOD_PF_BUCKET_MAX_SPAN 1024
 
-static int array_get(const struct TCOD_ArrayData* arr, const int* index) {
-  void* ptr = array_index(arr, index);
-  switch (arr->int_type) {
+/// A graph edge compiled into offsets relative to its origin node.
+struct TCOD_PfEdge_ {
+  int node_delta;  // Offset to the destination node index.
+  ptrdiff_t distance_delta;  // Byte offset into the distance array.
+  const unsigned char* cost_data;  // The cost array of this edge, already offset to the destination of node zero.
+  ptrdiff_t traversal_delta;  // Byte offset into the traversal array.
+  int cost;  // Multiplier applied to the cost of the destination.
+  int offset[TCOD_PATHFINDER_MAX_DIMENSIONS];  // Per-axis offset, only used to bounds check border nodes.
+};
+/// The edges of a graph along with the region where edges can skip bounds checks.
+struct TCOD_PfEdges_ {
+  int count;
+  struct TCOD_PfEdge_ edges[TCOD_PATHFINDER_MAX_EDGES];
+  int interior_min[TCOD_PATHFINDER_MAX_DIMENSIONS];  // Inclusive.
+  int interior_max[TCOD_PATHFINDER_MAX_DIMENSIONS];  // Exclusive.
+};
+
+/// Load an integer of `int_type` from `ptr`.  Unsigned 64-bit values are saturated to INT64_MAX.
+/// `int_type` is meant to be a compile-time constant so that this switch is folded away.
+static TCOD_PF_INLINE int64_t pf_load(const unsigned char* ptr, int int_type) {
+  switch (int_type) {
     case 1:
-      return *(uint8_t*)ptr;
+      return *(const uint8_t*)ptr;
     case 2:
-      return *(uint16_t*)ptr;
+      return *(const uint16_t*)ptr;
     case 4:
-      return *(uint32_t*)ptr;
+      return *(const uint32_t*)ptr;
     case 8:
-      return *(uint64_t*)ptr;
+      return *(const uint64_t*)ptr > (uint64_t)INT64_MAX ? INT64_MAX : (int64_t) * (const uint64_t*)ptr;
     case -1:
-      return *(int8_t*)ptr;
+      return *(const int8_t*)ptr;
     case -2:
-      return *(int16_t*)ptr;
+      return *(const int16_t*)ptr;
     case -4:
-      return *(int32_t*)ptr;
+      return *(const int32_t*)ptr;
     case -8:
-      return *(int64_t*)ptr;
+      return *(const int64_t*)ptr;
     default:
       return 0;
   }
 }
-
-static void array_set(const struct TCOD_ArrayData* arr, const int* index, int value) {
-  void* ptr = array_index(arr, index);
-  switch (arr->int_type) {
+/// Store `value` as an integer of `int_type` to `ptr`.
+static TCOD_PF_INLINE void pf_store(unsigned char* ptr, int int_type, int64_t value) {
+  switch (int_type) {
     case 1:
       *(uint8_t*)ptr = (uint8_t)value;
       return;
@@ -90,142 +113,468 @@ static void array_set(const struct TCOD_ArrayData* arr, const int* index, int va
       *(int32_t*)ptr = (int32_t)value;
       return;
     case -8:
-      *(int64_t*)ptr = (int64_t)value;
+      *(int64_t*)ptr = value;
       return;
     default:
       return;
   }
 }
-
-static bool array_is_max(const struct TCOD_ArrayData* arr, const int* index) {
-  void* ptr = array_index(arr, index);
-  switch (arr->int_type) {
+/// Return the maximum value of `int_type` as loaded by `pf_load`.  This value marks unreached nodes.
+static TCOD_PF_INLINE int64_t pf_type_max(int int_type) {
+  switch (int_type) {
     case 1:
-      return *(uint8_t*)ptr == 0xff;
+      return UINT8_MAX;
     case 2:
-      return *(uint16_t*)ptr == 0xffff;
+      return UINT16_MAX;
     case 4:
-      return *(uint32_t*)ptr == 0xffffffff;
-    case 8:
-      return *(uint64_t*)ptr == 0xffffffffffffffff;
+      return UINT32_MAX;
     case -1:
-      return *(int8_t*)ptr == 0x7f;
+      return INT8_MAX;
     case -2:
-      return *(int16_t*)ptr == 0x7fff;
+      return INT16_MAX;
     case -4:
-      return *(int32_t*)ptr == 0x7fffffff;
+      return INT32_MAX;
+    case 8:
     case -8:
-      return *(int64_t*)ptr == 0x7fffffffffffffff;
     default:
-      return 0;
+      return INT64_MAX;
   }
 }
-
-typedef void (*ArrayTraverseFunc)(void* userdata, const int* index);
-
-static void array_recursion(
-    struct TCOD_ArrayData* arr, ArrayTraverseFunc callback, void* userdata, int* index, int cursor) {
-  for (index[cursor] = 0; (size_t)index[cursor] < arr->shape[cursor]; ++index[cursor]) {
-    if (cursor + 1 == arr->ndim) {
-      callback(userdata, index);
-    } else {
-      array_recursion(arr, callback, userdata, index, cursor + 1);
-    }
+/// Return the number of nodes in the frontier of this pathfinder.
+static TCOD_PF_INLINE int pf_queue_size(const struct TCOD_Pathfinder* path) {
+  return path->use_buckets ? path->buckets.size : path->heap.size;
+}
+/// Push a node onto the frontier of this pathfinder.
+static TCOD_PF_INLINE void pf_queue_push(struct TCOD_Pathfinder* path, int priority, int node) {
+  if (path->use_buckets) {
+    TCOD_bucketq_push(&path->buckets, priority, node);
+  } else {
+    TCOD_minheap_push(&path->heap, priority, &node);
   }
 }
-
-static void array_traverse(struct TCOD_ArrayData* arr, ArrayTraverseFunc callback, void* userdata) {
-  int index[TCOD_PATHFINDER_MAX_DIMENSIONS + 1];
-  array_recursion(arr, callback, userdata, index, 0);
+/// Pop the lowest priority node from the frontier of this pathfinder.  The frontier must not be empty.
+static TCOD_PF_INLINE void pf_queue_pop(struct TCOD_Pathfinder* __restrict path, int* __restrict priority, int* node) {
+  if (path->use_buckets) {
+    TCOD_bucketq_pop(&path->buckets, priority, node);
+  } else {
+    *priority = *(const int*)path->heap.heap;
+    TCOD_minheap_pop(&path->heap, node);
+  }
 }
 
-static bool TCOD_pf_in_bounds(const struct TCOD_Pathfinder* path, const int* index) {
-  for (int i = 0; i < path->ndim; ++i) {
-    if (0 < index[i] || (size_t)index[i] >= path->shape[i]) {
-      return false;
-    }
+/// Return true if `edge` leads to a node inside of the pathfinder bounds.
+static bool pf_edge_in_bounds(const struct TCOD_Pathfinder* path, const int* coord, const struct TCOD_PfEdge_* edge) {
+  for (int axis = 0; axis < path->ndim; ++axis) {
+    const int dest = coord[axis] + edge->offset[axis];
+    if (dest < 0 || (size_t)dest >= path->shape[axis]) return false;
   }
   return true;
 }
-
-static void TCOD_pf_add_edge(struct TCOD_Pathfinder* path, const int* origin, const int* dest, int cost) {
-  if (!TCOD_pf_in_bounds(path, dest)) {
-    return;
+/// Return the heuristic distance from `coord` to a single goal.  Computed in 64 bits so that it can not overflow.
+static int64_t pf_heuristic_to(const struct TCOD_Pathfinder* __restrict path, const int* coord, const int* goal) {
+  int64_t sum = 0;
+  int64_t longest = 0;
+  int64_t diagonal_span = 0;
+  for (int axis = 0; axis < path->ndim; ++axis) {
+    const int distance = abs(coord[axis] - goal[axis]);
+    sum += distance;
+    if (distance > longest) longest = distance;
   }
-  int total_dist = array_get(&path->distance, origin) + cost;
-  if (array_get(&path->distance, dest) >= total_dist) {
-    return;
+  switch (path->heuristic.type) {
+    case TCOD_PF_HEURISTIC_MANHATTAN:
+      return (int64_t)path->heuristic.cardinal * sum;
+    case TCOD_PF_HEURISTIC_CHEBYSHEV:
+      return (int64_t)path->heuristic.cardinal * longest;
+    case TCOD_PF_HEURISTIC_DIAGONAL:
+    default:
+      if (path->ndim < 2) return (int64_t)path->heuristic.cardinal * sum;
+      diagonal_span = abs(coord[0] - goal[0]);
+      if (abs(coord[1] - goal[1]) < diagonal_span) diagonal_span = abs(coord[1] - goal[1]);
+      return (int64_t)path->heuristic.diagonal * diagonal_span +
+             (int64_t)path->heuristic.cardinal * (sum - 2 * diagonal_span);
+  }
+}
+/// Return the heuristic distance from `coord` to the nearest goal.
+static int64_t pf_heuristic(const struct TCOD_Pathfinder* __restrict path, const int* coord) {
+  int64_t best = INT64_MAX;
+  for (int i = 0; i < path->goal_count; ++i) {
+    const int64_t estimate = pf_heuristic_to(path, coord, &path->goals[i * path->ndim]);
+    if (estimate < best) best = estimate;
+  }
+  return best;
+}
+/// Return the index of the goal at `node`, or -1 if `node` is not a goal.
+static int pf_goal_index(const struct TCOD_Pathfinder* path, int node) {
+  for (int i = 0; i < path->goal_count; ++i) {
+    if (path->goal_nodes[i] == node) return i;
+  }
+  return -1;
+}
+/// Write the coordinates of `origin` to a node of the traversal array.  Only called when a node is improved.
+static void pf_store_traversal(
+    const struct TCOD_Pathfinder* __restrict path, unsigned char* __restrict ptr, const int* __restrict origin) {
+  const ptrdiff_t axis_stride = (ptrdiff_t)path->traversal.strides[path->ndim];
+  for (int axis = 0; axis < path->ndim; ++axis) {
+    pf_store(ptr + axis * axis_stride, path->traversal.int_type, origin[axis]);
   }
-  array_set(&path->distance, dest, total_dist);
-  TCOD_minheap_push(&path->heap, total_dist, dest);
-  if (path->traversal.data) {
-    int travel_index[TCOD_PATHFINDER_MAX_DIMENSIONS + 1];
-    for (int i = 0; i < path->ndim; ++i) {
-      travel_index[i] = origin[i];
+}
+/**
+    The Dijkstra relaxation loop.  Processes up to `max_steps` nodes, or all nodes if `max_steps` is negative.
+    When the pathfinder has goals this becomes A*, and the loop stops when a goal is popped.
+
+    Returns the index of the goal reached, or -1.
+
+    This must be inlined with constant integer types: the distance and cost accesses then compile into plain typed
+    loads and stores, with no type switches or indirect calls left in the loop.
+ */
+static TCOD_PF_INLINE int pf_kernel(
+    struct TCOD_Pathfinder* __restrict path,
+    const struct TCOD_PfEdges_* __restrict edges,
+    int max_steps,
+    const int dist_type,
+    const int cost_type) {
+  const int ndim = path->ndim;
+  unsigned char* const dist_data = path->distance.data;
+  unsigned char* const trav_data = path->traversal.data;
+  const int64_t dist_limit = pf_type_max(dist_type);
+  const bool has_goals = path->goal_count > 0;
+  while (pf_queue_size(path) && max_steps--) {
+    int priority;
+    int node;
+    pf_queue_pop(path, &priority, &node);
+    int coord[TCOD_PATHFINDER_MAX_DIMENSIONS];
+    ptrdiff_t dist_offset = 0;
+    ptrdiff_t cost_offset = 0;
+    ptrdiff_t trav_offset = 0;
+    bool interior = true;
+    int remainder = node;
+    for (int axis = ndim - 1; axis >= 0; --axis) {
+      const int axis_size = (int)path->shape[axis];
+      coord[axis] = remainder % axis_size;
+      remainder /= axis_size;
+      dist_offset += coord[axis] * (ptrdiff_t)path->distance.strides[axis];
+      cost_offset += coord[axis] * (ptrdiff_t)path->graph.cost.strides[axis];
+      if (trav_data) trav_offset += coord[axis] * (ptrdiff_t)path->traversal.strides[axis];
+      interior &= edges->interior_min[axis] <= coord[axis] && coord[axis] < edges->interior_max[axis];
     }
-    for (int i = 0; i < path->ndim; ++i) {
-      travel_index[path->ndim] = i;
-      array_set(&path->traversal, travel_index, dest[i]);
+    const int64_t origin_dist = pf_load(dist_data + dist_offset, dist_type);
+    const int64_t origin_heuristic = has_goals ? pf_heuristic(path, coord) : 0;
+    if (priority > origin_dist + origin_heuristic) continue;  // This node was already reached by a shorter path.
+    const int goal_index = has_goals ? pf_goal_index(path, node) : -1;
+    for (int i = 0; i < edges->count; ++i) {
+      const struct TCOD_PfEdge_* edge = &edges->edges[i];
+      if (!interior && !pf_edge_in_bounds(path, coord, edge)) continue;
+      const int64_t cost = pf_load(edge->cost_data + cost_offset, cost_type);
+      if (cost <= 0) continue;  // Impassable.
+      const int64_t total_dist = origin_dist + cost * edge->cost;
+      if (total_dist >= dist_limit) continue;
+      unsigned char* const dest_dist = dist_data + dist_offset + edge->distance_delta;
+      if (pf_load(dest_dist, dist_type) <= total_dist) continue;
+      int64_t priority_dist = total_dist;
+      if (has_goals) {
+        int dest_coord[TCOD_PATHFINDER_MAX_DIMENSIONS];
+        for (int axis = 0; axis < ndim; ++axis) dest_coord[axis] = coord[axis] + edge->offset[axis];
+        priority_dist += pf_heuristic(path, dest_coord);
+      }
+      // Frontier priorities are ints, nodes which can not be ordered correctly are left unreached.
+      if (priority_dist > INT_MAX) continue;
+      pf_store(dest_dist, dist_type, total_dist);
+      pf_queue_push(path, (int)priority_dist, node + edge->node_delta);
+      if (trav_data) pf_store_traversal(path, trav_data + trav_offset + edge->traversal_delta, coord);
     }
+    if (goal_index >= 0) return goal_index;
   }
+  return -1;
 }
+/// A kernel specialized for a specific combination of array types.
+typedef int (*TCOD_PfKernelFunc_)(struct TCOD_Pathfinder* path, const struct TCOD_PfEdges_* edges, int max_steps);
 
-static void TCOD_pf_basic2d_edges(struct TCOD_Pathfinder* path, const int* origin) {
+/// Call `X(name, int_type, ...)` for every integer type supported by the pathfinder.
+/// Types are in the same order as `pf_type_index`.
+#define TCOD_PF_INT_TYPES(X, ...) \
+  X(u8, 1, __VA_ARGS__)           \
+  X(u16, 2, __VA_ARGS__)          \
+  X(u32, 4, __VA_ARGS__)          \
+  X(u64, 8, __VA_ARGS__)          \
+  X(i8, -1, __VA_ARGS__)          \
+  X(i16, -2, __VA_ARGS__)         \
+  X(i32, -4, __VA_ARGS__)         \
+  X(i64, -8, __VA_ARGS__)
+/// Same as TCOD_PF_INT_TYPES, needed because a macro can not be expanded inside of itself.
+#define TCOD_PF_INT_TYPES_INNER(X, ...) \
+  X(u8, 1, __VA_ARGS__)                 \
+  X(u16, 2, __VA_ARGS__)                \
+  X(u32, 4, __VA_ARGS__)                \
+  X(u64, 8, __VA_ARGS__)                \
+  X(i8, -1, __VA_ARGS__)                \
+  X(i16, -2, __VA_ARGS__)               \
+  X(i32, -4, __VA_ARGS__)               \
+  X(i64, -8, __VA_ARGS__)
+#define TCOD_PF_DEFINE_KERNEL_(COST_NAME, COST_TYPE, DIST_NAME, DIST_TYPE)              \
+  static int pf_kernel_##DIST_NAME##_##COST_NAME(                                      \
+      struct TCOD_Pathfinder* path, const struct TCOD_PfEdges_* edges, int max_steps) { \
+    return pf_kernel(path, edges, max_steps, DIST_TYPE, COST_TYPE);                            \
+  }
+#define TCOD_PF_DEFINE_KERNELS_FOR_DIST_(DIST_NAME, DIST_TYPE, UNUSED)  \
+  TCOD_PF_INT_TYPES_INNER(TCOD_PF_DEFINE_KERNEL_, DIST_NAME, DIST_TYPE)
+TCOD_PF_INT_TYPES(TCOD_PF_DEFINE_KERNELS_FOR_DIST_, ~)
+
+#define TCOD_PF_KERNEL_ENTRY_(COST_NAME, COST_TYPE, DIST_NAME, DIST_TYPE) pf_kernel_##DIST_NAME##_##COST_NAME,
+#define TCOD_PF_KERNEL_ENTRIES_FOR_DIST_(DIST_NAME, DIST_TYPE, UNUSED)    \
+  {TCOD_PF_INT_TYPES_INNER(TCOD_PF_KERNEL_ENTRY_, DIST_NAME, DIST_TYPE)},
+/// Kernels indexed by `[distance type][cost type]`.
+static const TCOD_PfKernelFunc_ pf_kernels[8][8] = {TCOD_PF_INT_TYPES(TCOD_PF_KERNEL_ENTRIES_FOR_DIST_, ~)};
+
+/// Return the index of `int_type` in TCOD_PF_INT_TYPES, or -1 if the type is not supported.
+static int pf_type_index(int int_type) {
+  switch (int_type) {
+    case 1:
+      return 0;
+    case 2:
+      return 1;
+    case 4:
+      return 2;
+    case 8:
+      return 3;
+    case -1:
+      return 4;
+    case -2:
+      return 5;
+    case -4:
+      return 6;
+    case -8:
+      return 7;
+    default:
+      return -1;
+  }
+}
+/// Add an edge to `edges` which moves by `offset` with the given cost multiplier.
+/// `cost_data` is the cost array of this edge, which shares the strides of the graph cost array.
+static void pf_edges_add(
+    struct TCOD_PfEdges_* __restrict edges,
+    const struct TCOD_Pathfinder* __restrict path,
+    const int* __restrict offset,
+    int cost,
+    const unsigned char* cost_data) {
+  struct TCOD_PfEdge_* edge = &edges->edges[edges->count++];
+  int node_stride = 1;
+  ptrdiff_t cost_delta = 0;
+  edge->node_delta = 0;
+  edge->distance_delta = 0;
+  edge->traversal_delta = 0;
+  edge->cost = cost;
+  for (int axis = path->ndim - 1; axis >= 0; --axis) {
+    edge->offset[axis] = offset[axis];
+    edge->node_delta += offset[axis] * node_stride;
+    node_stride *= (int)path->shape[axis];
+    edge->distance_delta += offset[axis] * (ptrdiff_t)path->distance.strides[axis];
+    cost_delta += offset[axis] * (ptrdiff_t)path->graph.cost.strides[axis];
+    if (path->traversal.data) edge->traversal_delta += offset[axis] * (ptrdiff_t)path->traversal.strides[axis];
+    if (-offset[axis] > edges->interior_min[axis]) edges->interior_min[axis] = -offset[axis];
+    if ((int)path->shape[axis] - offset[axis] < edges->interior_max[axis]) {
+      edges->interior_max[axis] = (int)path->shape[axis] - offset[axis];
+    }
+  }
+  edge->cost_data = cost_data + cost_delta;
+}
+/// Clear `edges` so that every node of the pathfinder is in the interior.
+static void pf_edges_clear(const struct TCOD_Pathfinder* path, struct TCOD_PfEdges_* edges) {
+  edges->count = 0;
+  for (int axis = 0; axis < path->ndim; ++axis) {
+    edges->interior_min[axis] = 0;
+    edges->interior_max[axis] = (int)path->shape[axis];
+  }
+}
+/// Compile the cardinal and diagonal moves of the basic 2D graph.  These moves are on the first two axes.
+static void pf_compile_basic2d_edges(const struct TCOD_Pathfinder* path, struct TCOD_PfEdges_* edges) {
+  pf_edges_clear(path, edges);
+  static const int CARDINALS[4][2] = {{-1, 0}, {0, -1}, {0, 1}, {1, 0}};
+  static const int DIAGONALS[4][2] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+  int offset[TCOD_PATHFINDER_MAX_DIMENSIONS] = {0};
   if (path->graph.cardinal > 0) {
-    const int dest[] = {
-        origin[0] - 1,
-        origin[1],
-        origin[0],
-        origin[1] - 1,
-        origin[0],
-        origin[1] + 1,
-        origin[0] + 1,
-        origin[1],
-    };
-    for (size_t i = 0; i < sizeof(dest) / sizeof(dest[0]); i += 2) {
-      TCOD_pf_add_edge(path, origin, &dest[i], path->graph.cardinal);
+    for (int i = 0; i < 4; ++i) {
+      if (path->ndim < 2 && CARDINALS[i][1]) continue;
+      offset[0] = CARDINALS[i][0];
+      if (path->ndim >= 2) offset[1] = CARDINALS[i][1];
+      pf_edges_add(edges, path, offset, path->graph.cardinal, path->graph.cost.data);
     }
   }
-  if (path->graph.diagonal > 0) {
-    const int dest[] = {
-        origin[0] - 1,
-        origin[1] - 1,
-        origin[0] - 1,
-        origin[1] + 1,
-        origin[0] + 1,
-        origin[1] - 1,
-        origin[0] + 1,
-        origin[1] + 1,
-    };
-    for (size_t i = 0; i < sizeof(dest) / sizeof(dest[0]); i += 2) {
-      TCOD_pf_add_edge(path, origin, &dest[i], path->graph.diagonal);
+  if (path->graph.diagonal > 0 && path->ndim >= 2) {
+    for (int i = 0; i < 4; ++i) {
+      offset[0] = DIAGONALS[i][0];
+      offset[1] = DIAGONALS[i][1];
+      pf_edges_add(edges, path, offset, path->graph.diagonal, path->graph.cost.data);
     }
   }
 }
-
-int TCOD_pf_compute_step(struct TCOD_Pathfinder* path) {
+/// Compile the edge table given to `TCOD_pf_set_graph_pointer`.
+static void pf_compile_custom_edges(const struct TCOD_Pathfinder* path, struct TCOD_PfEdges_* edges) {
+  pf_edges_clear(path, edges);
+  for (int i = 0; i < path->edge_count; ++i) {
+    const struct TCOD_PathfinderEdge* edge = &path->edges[i];
+    if (edge->cost <= 0) continue;
+    pf_edges_add(
+        edges, path, edge->offset, edge->cost, edge->cost_data ? edge->cost_data : path->graph.cost.data);
+  }
+}
+/// Run the kernel matching the types of this pathfinder for up to `max_steps` nodes.
+static int pf_run(struct TCOD_Pathfinder* path, int max_steps) {
   if (!path) {
-    return -1;
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  if (!path->distance.data || !path->graph.cost.data) {
+    TCOD_set_errorv("The distance and graph arrays must be set before computing.");
+    return TCOD_E_ERROR;
+  }
+  const int dist_index = pf_type_index(path->distance.int_type);
+  const int cost_index = pf_type_index(path->graph.cost.int_type);
+  if (dist_index < 0 || cost_index < 0 || (path->traversal.data && pf_type_index(path->traversal.int_type) < 0)) {
+    TCOD_set_errorv("Unsupported array type.");
+    return TCOD_E_INVALID_ARGUMENT;
   }
-  if (path->heap.size == 0) {
+  struct TCOD_PfEdges_ edges;
+  if (path->edge_count) {
+    pf_compile_custom_edges(path, &edges);
+  } else {
+    pf_compile_basic2d_edges(path, &edges);
+  }
+  path->goal_reached = pf_kernels[dist_index][cost_index](path, &edges, max_steps);
+  return path->goal_reached >= 0 ? 1 : 0;
+}
+
+/// Advance `coord` and its byte `offset` to the next index of `arr` in C order.  Returns false after the last index.
+static TCOD_PF_INLINE bool pf_array_next(const struct TCOD_ArrayData* arr, int* coord, ptrdiff_t* offset) {
+  for (int axis = arr->ndim - 1; axis >= 0; --axis) {
+    *offset += (ptrdiff_t)arr->strides[axis];
+    if ((size_t)++coord[axis] < arr->shape[axis]) return true;
+    *offset -= (ptrdiff_t)arr->strides[axis] * coord[axis];
+    coord[axis] = 0;
+  }
+  return false;
+}
+/// Return true if `arr` has no elements.
+static bool pf_array_is_empty(const struct TCOD_ArrayData* arr) {
+  for (int axis = 0; axis < arr->ndim; ++axis) {
+    if (arr->shape[axis] == 0) return true;
+  }
+  return false;
+}
+/// Push every reached node of the distance array onto the frontier.
+static TCOD_PF_INLINE void pf_recompile_kernel(struct TCOD_Pathfinder* path, const int dist_type) {
+  const int64_t unreached = pf_type_max(dist_type);
+  int coord[TCOD_PATHFINDER_MAX_DIMENSIONS] = {0};
+  ptrdiff_t offset = 0;
+  int node = 0;
+  if (pf_array_is_empty(&path->distance)) return;
+  do {
+    const int64_t dist = pf_load(path->distance.data + offset, dist_type);
+    if (dist != unreached) {
+      const int64_t priority = dist + (path->goal_count ? pf_heuristic(path, coord) : 0);
+      // Nodes past the int priority range can not reach anything the compute loop would accept.
+      if (priority <= INT_MAX) pf_queue_push(path, (int)priority, node);
+    }
+    ++node;
+  } while (pf_array_next(&path->distance, coord, &offset));
+}
+/// Return the largest value in a cost array.
+static TCOD_PF_INLINE int64_t pf_max_cost_kernel(const struct TCOD_ArrayData* cost, const int cost_type) {
+  int64_t max_cost = 0;
+  int coord[TCOD_PATHFINDER_MAX_DIMENSIONS] = {0};
+  ptrdiff_t offset = 0;
+  if (pf_array_is_empty(cost)) return 0;
+  do {
+    const int64_t value = pf_load(cost->data + offset, cost_type);
+    if (value > max_cost) max_cost = value;
+  } while (pf_array_next(cost, coord, &offset));
+  return max_cost;
+}
+typedef void (*TCOD_PfRecompileFunc_)(struct TCOD_Pathfinder* path);
+typedef int64_t (*TCOD_PfMaxCostFunc_)(const struct TCOD_ArrayData* cost);
+#define TCOD_PF_DEFINE_ARRAY_FUNCS_(NAME, INT_TYPE, UNUSED)                                                           \
+  static void pf_recompile_##NAME(struct TCOD_Pathfinder* path) { pf_recompile_kernel(path, INT_TYPE); }              \
+  static int64_t pf_max_cost_##NAME(const struct TCOD_ArrayData* cost) { return pf_max_cost_kernel(cost, INT_TYPE); }
+TCOD_PF_INT_TYPES(TCOD_PF_DEFINE_ARRAY_FUNCS_, ~)
+#define TCOD_PF_RECOMPILE_ENTRY_(NAME, INT_TYPE, UNUSED) pf_recompile_##NAME,
+#define TCOD_PF_MAX_COST_ENTRY_(NAME, INT_TYPE, UNUSED) pf_max_cost_##NAME,
+/// Recompile functions indexed by distance type.
+static const TCOD_PfRecompileFunc_ pf_recompile_funcs[8] = {TCOD_PF_INT_TYPES(TCOD_PF_RECOMPILE_ENTRY_, ~)};
+/// Max cost functions indexed by cost type.
+static const TCOD_PfMaxCostFunc_ pf_max_cost_funcs[8] = {TCOD_PF_INT_TYPES(TCOD_PF_MAX_COST_ENTRY_, ~)};
+
+/// Return the largest edge cost of the graph, or -1 if it can not be known.
+static int64_t pf_max_edge_cost(const struct TCOD_Pathfinder* path) {
+  const int cost_index = pf_type_index(path->graph.cost.int_type);
+  if (!path->graph.cost.data || cost_index < 0) return -1;
+  const TCOD_PfMaxCostFunc_ max_cost_func = pf_max_cost_funcs[cost_index];
+  if (!path->edge_count) {
+    int max_multiplier = 0;
+    if (path->graph.cardinal > max_multiplier) max_multiplier = path->graph.cardinal;
+    if (path->graph.diagonal > max_multiplier) max_multiplier = path->graph.diagonal;
+    const int64_t max_cost = max_cost_func(&path->graph.cost);
+    if (max_cost > INT_MAX / (max_multiplier ? max_multiplier : 1)) return -1;
+    return max_cost * max_multiplier;
+  }
+  // Custom edges can each have their own cost array, scan every array once.
+  int64_t max_edge_cost = 0;
+  for (int i = 0; i < path->edge_count; ++i) {
+    const unsigned char* cost_data = path->edges[i].cost_data ? path->edges[i].cost_data : path->graph.cost.data;
+    int max_multiplier = 0;
+    bool scanned = false;
+    for (int j = 0; j < path->edge_count; ++j) {
+      const unsigned char* other = path->edges[j].cost_data ? path->edges[j].cost_data : path->graph.cost.data;
+      if (other != cost_data) continue;
+      if (j < i) scanned = true;
+      if (path->edges[j].cost > max_multiplier) max_multiplier = path->edges[j].cost;
+    }
+    if (scanned || max_multiplier <= 0) continue;
+    struct TCOD_ArrayData cost = path->graph.cost;
+    cost.data = (unsigned char*)cost_data;
+    const int64_t max_cost = max_cost_func(&cost);
+    if (max_cost > INT_MAX / max_multiplier) return -1;
+    if (max_cost * max_multiplier > max_edge_cost) max_edge_cost = max_cost * max_multiplier;
+  }
+  return max_edge_cost;
+}
+/// Clear the frontier, switching to a bucket queue if edges costs are no more than `max_edge_cost`.
+static int pf_reset_frontier(struct TCOD_Pathfinder* path, int64_t max_edge_cost) {
+  TCOD_heap_clear(&path->heap);
+  path->use_buckets = 0 <= max_edge_cost && max_edge_cost <= TCOD_PF_BUCKET_MAX_SPAN;
+  if (!path->use_buckets) return 0;
+  if (path->buckets.bucket_count > max_edge_cost) {
+    TCOD_bucketq_clear(&path->buckets);
     return 0;
   }
-  int current_pos[TCOD_PATHFINDER_MAX_DIMENSIONS];
-  TCOD_minheap_pop(&path->heap, current_pos);
-  TCOD_pf_basic2d_edges(path, current_pos);
-  return 0;
+  TCOD_bucketq_uninit(&path->buckets);
+  const int err = TCOD_bucketq_init(&path->buckets, (int)max_edge_cost);
+  if (err < 0) path->use_buckets = false;
+  return err;
 }
 
+int TCOD_pf_compute_step(struct TCOD_Pathfinder* path) { return pf_run(path, 1); }
+
 struct TCOD_Pathfinder* TCOD_pf_new(int ndim, const size_t* shape) {
+  if (ndim <= 0 || TCOD_PATHFINDER_MAX_DIMENSIONS < ndim) {
+    TCOD_set_errorvf("Can not make a pathfinder with %i dimensions.", ndim);
+    return NULL;
+  }
+  size_t total_nodes = 1;
+  for (int i = 0; i < ndim; ++i) total_nodes *= shape[i];
+  if (total_nodes > INT_MAX) {
+    TCOD_set_errorv("Pathfinder shape is too large.");
+    return NULL;
+  }
   struct TCOD_Pathfinder* path = calloc(sizeof(struct TCOD_Pathfinder), 1);
   if (!path) {
+    TCOD_set_errorv("Out of memory allocating pathfinder.");
     return NULL;
   }
   path->ndim = (int8_t)ndim;
   for (int i = 0; i < ndim; ++i) {
     path->shape[i] = shape[i];
   }
-  TCOD_heap_init(&path->heap, sizeof(int) * (size_t)path->ndim);
+  TCOD_heap_init(&path->heap, sizeof(int));
+  path->goal_reached = -1;
   return path;
 }
 
@@ -234,6 +583,10 @@ void TCOD_pf_delete(struct TCOD_Pathfinder* path) {
     return;
   }
   TCOD_heap_uninit(&path->heap);
+  TCOD_bucketq_uninit(&path->buckets);
+  free(path->goals);
+  free(path->goal_nodes);
+  free(path->edges);
   free(path);
 }
 
@@ -264,6 +617,50 @@ void TCOD_pf_set_graph2d_pointer(
   }
   path->graph.cardinal = cardinal;
   path->graph.diagonal = diagonal;
+  free(path->edges);
+  path->edges = NULL;
+  path->edge_count = 0;
+}
+
+int TCOD_pf_set_graph_pointer(
+    struct TCOD_Pathfinder* path,
+    void* data,
+    int int_type,
+    const size_t* strides,
+    int edge_count,
+    const struct TCOD_PathfinderEdge* edges) {
+  if (!path || !strides || (edge_count && !edges)) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  if (edge_count <= 0 || TCOD_PATHFINDER_MAX_EDGES < edge_count) {
+    TCOD_set_errorvf("Graph must have between 1 and %i edges, got %i.", TCOD_PATHFINDER_MAX_EDGES, edge_count);
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  for (int i = 0; i < edge_count; ++i) {
+    bool is_zero = true;
+    for (int axis = 0; axis < path->ndim; ++axis) {
+      if (edges[i].offset[axis]) is_zero = false;
+      if (abs(edges[i].offset[axis]) >= (int)path->shape[axis] && path->shape[axis] > 0) {
+        TCOD_set_errorvf("Edge %i is larger than the pathfinder shape.", i);
+        return TCOD_E_INVALID_ARGUMENT;
+      }
+    }
+    if (is_zero) {
+      TCOD_set_errorvf("Edge %i does not move to another node.", i);
+      return TCOD_E_INVALID_ARGUMENT;
+    }
+  }
+  struct TCOD_PathfinderEdge* new_edges = malloc(sizeof(*new_edges) * edge_count);
+  if (!new_edges) {
+    TCOD_set_errorv("Out of memory allocating pathfinder edges.");
+    return TCOD_E_OUT_OF_MEMORY;
+  }
+  for (int i = 0; i < edge_count; ++i) new_edges[i] = edges[i];
+  TCOD_pf_set_graph2d_pointer(path, data, int_type, strides, 0, 0);
+  path->edges = new_edges;
+  path->edge_count = edge_count;
+  return TCOD_E_OK;
 }
 
 void TCOD_pf_set_traversal_pointer(struct TCOD_Pathfinder* path, void* data, int int_type, const size_t* strides) {
@@ -278,34 +675,166 @@ void TCOD_pf_set_traversal_pointer(struct TCOD_Pathfinder* path, void* data, int
     if (i == path->ndim) {
       path->traversal.shape[i] = path->ndim;
     } else {
-      path->traversal.shape[i] = strides[i];
+      path->traversal.shape[i] = path->shape[i];
     }
   }
 }
 
-void TCOD_pf_recompile_cb(void* userdata, const int* index) {
-  struct TCOD_Pathfinder* path = (struct TCOD_Pathfinder*)userdata;
-  if (array_is_max(&path->distance, index)) {
-    return;
+int TCOD_pf_set_goals(
+    struct TCOD_Pathfinder* path, int goal_count, const int* goals, const struct TCOD_PathfinderHeuristic* heuristic) {
+  if (!path) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  if (goal_count < 0 || (goal_count && !goals)) {
+    TCOD_set_errorv("Invalid goal list.");
+    return TCOD_E_INVALID_ARGUMENT;
   }
-  TCOD_minheap_push(&path->heap, array_get(&path->distance, index), index);
+  for (int i = 0; i < goal_count * path->ndim; ++i) {
+    if (goals[i] < 0 || (size_t)goals[i] >= path->shape[i % path->ndim]) {
+      TCOD_set_errorvf("Goal %i is out of bounds.", i / path->ndim);
+      return TCOD_E_INVALID_ARGUMENT;
+    }
+  }
+  int* new_goals = goal_count ? malloc(sizeof(*new_goals) * goal_count * path->ndim) : NULL;
+  int* new_goal_nodes = goal_count ? malloc(sizeof(*new_goal_nodes) * goal_count) : NULL;
+  if (goal_count && (!new_goals || !new_goal_nodes)) {
+    free(new_goals);
+    free(new_goal_nodes);
+    TCOD_set_errorv("Out of memory allocating pathfinder goals.");
+    return TCOD_E_OUT_OF_MEMORY;
+  }
+  for (int i = 0; i < goal_count; ++i) {
+    new_goal_nodes[i] = 0;
+    for (int axis = 0; axis < path->ndim; ++axis) {
+      new_goals[i * path->ndim + axis] = goals[i * path->ndim + axis];
+      new_goal_nodes[i] = new_goal_nodes[i] * (int)path->shape[axis] + goals[i * path->ndim + axis];
+    }
+  }
+  free(path->goals);
+  free(path->goal_nodes);
+  path->goal_count = goal_count;
+  path->goals = new_goals;
+  path->goal_nodes = new_goal_nodes;
+  path->heuristic = heuristic ? *heuristic : (struct TCOD_PathfinderHeuristic){TCOD_PF_HEURISTIC_MANHATTAN, 0, 0};
+  path->goal_reached = -1;
+  return TCOD_E_OK;
 }
 
 int TCOD_pf_recompile(struct TCOD_Pathfinder* path) {
   if (!path) {
-    return -1;
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
   }
-  TCOD_heap_clear(&path->heap);
-  array_traverse(&path->distance, &TCOD_pf_recompile_cb, path);
+  const int dist_index = pf_type_index(path->distance.int_type);
+  if (!path->distance.data || dist_index < 0) {
+    TCOD_set_errorv("The distance array must be set to a supported type.");
+    return TCOD_E_ERROR;
+  }
+  int64_t max_span = pf_max_edge_cost(path);
+  if (path->goal_count && max_span > 0) max_span *= 2;  // The heuristic can add up to one more edge to each push.
+  const int err = pf_reset_frontier(path, max_span);
+  if (err < 0) return err;
+  pf_recompile_funcs[dist_index](path);
   return 0;
 }
 
-int TCOD_pf_compute(struct TCOD_Pathfinder* path) {
+int TCOD_pf_compute(struct TCOD_Pathfinder* path) { return pf_run(path, -1); }
+
+/// Return the flat node index of `coord`, or -1 if `coord` is out of bounds.
+static int pf_node_index(const struct TCOD_Pathfinder* path, const int* coord) {
+  int node = 0;
+  for (int axis = 0; axis < path->ndim; ++axis) {
+    if (coord[axis] < 0 || (size_t)coord[axis] >= path->shape[axis]) return -1;
+    node = node * (int)path->shape[axis] + coord[axis];
+  }
+  return node;
+}
+/// Walk the traversal array from `start`, see TCOD_pf_extract_path.  Arguments must already be checked.
+static int pf_extract_path(const struct TCOD_Pathfinder* path, const int* start, int* out_indices, int max_len) {
+  const int dist_type = path->distance.int_type;
+  const int trav_type = path->traversal.int_type;
+  const ptrdiff_t axis_stride = (ptrdiff_t)path->traversal.strides[path->ndim];
+  int coord[TCOD_PATHFINDER_MAX_DIMENSIONS];
+  int node = pf_node_index(path, start);
+  if (node < 0) {
+    TCOD_set_errorv("Start position is out of bounds.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  for (int axis = 0; axis < path->ndim; ++axis) coord[axis] = start[axis];
+  ptrdiff_t dist_offset = 0;
+  for (int axis = 0; axis < path->ndim; ++axis) dist_offset += coord[axis] * (ptrdiff_t)path->distance.strides[axis];
+  if (pf_load(path->distance.data + dist_offset, dist_type) == pf_type_max(dist_type)) return 0;  // Unreachable.
+  size_t total_nodes = 1;
+  for (int axis = 0; axis < path->ndim; ++axis) total_nodes *= path->shape[axis];
+  int length = 0;
+  while (1) {
+    if (length < max_len) out_indices[length] = node;
+    if ((size_t)++length > total_nodes) {
+      TCOD_set_errorv("Traversal array has a cycle, it must be initialized so that origins point to themselves.");
+      return TCOD_E_ERROR;
+    }
+    ptrdiff_t trav_offset = 0;
+    for (int axis = 0; axis < path->ndim; ++axis) trav_offset += coord[axis] * (ptrdiff_t)path->traversal.strides[axis];
+    int parent[TCOD_PATHFINDER_MAX_DIMENSIONS];
+    for (int axis = 0; axis < path->ndim; ++axis) {
+      parent[axis] = (int)pf_load(path->traversal.data + trav_offset + axis * axis_stride, trav_type);
+    }
+    const int parent_node = pf_node_index(path, parent);
+    if (parent_node < 0) {
+      TCOD_set_errorv("Traversal array points out of bounds.");
+      return TCOD_E_ERROR;
+    }
+    if (parent_node == node) return length;  // Reached an origin.
+    node = parent_node;
+    for (int axis = 0; axis < path->ndim; ++axis) coord[axis] = parent[axis];
+  }
+}
+/// Check that `path` has the arrays needed to extract paths.
+static int pf_check_extract(const struct TCOD_Pathfinder* path) {
   if (!path) {
-    return -1;
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
   }
-  while (path->heap.size) {
-    TCOD_pf_compute_step(path);
+  if (!path->distance.data || !path->traversal.data) {
+    TCOD_set_errorv("The distance and traversal arrays must be set to extract a path.");
+    return TCOD_E_ERROR;
   }
-  return 0;
+  if (pf_type_index(path->distance.int_type) < 0 || pf_type_index(path->traversal.int_type) < 0) {
+    TCOD_set_errorv("Unsupported array type.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  return TCOD_E_OK;
+}
+
+int TCOD_pf_extract_path(const struct TCOD_Pathfinder* path, const int* start, int* out_indices, int max_len) {
+  const int err = pf_check_extract(path);
+  if (err < 0) return err;
+  if (!start || (max_len > 0 && !out_indices)) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  return pf_extract_path(path, start, out_indices, max_len);
+}
+
+int TCOD_pf_extract_paths(
+    const struct TCOD_Pathfinder* path,
+    int count,
+    const int* starts,
+    int* out_indices,
+    int max_len,
+    int* out_lengths) {
+  const int err = pf_check_extract(path);
+  if (err < 0) return err;
+  if (count < 0 || (count && (!starts || !out_lengths || (max_len > 0 && !out_indices)))) {
+    TCOD_set_errorv("Pointer argument must not be NULL.");
+    return TCOD_E_INVALID_ARGUMENT;
+  }
+  for (int i = 0; i < count; ++i) {
+    const int length =
+        pf_extract_path(path, &starts[i * path->ndim], max_len > 0 ? &out_indices[(size_t)i * max_len] : NULL, max_len);
+    if (length < 0) return length;
+    out_lengths[i] = length;
+  }
+  return TCOD_E_OK;
 }
@@ -40,6 +40,8 @@
 #include "portability.h"
 
 #define TCOD_PATHFINDER_MAX_DIMENSIONS 4
+/// The maximum number of edges in the edge table of a custom graph.
+#define TCOD_PATHFINDER_MAX_EDGES 64
 
 struct TCOD_ArrayData {
   int8_t ndim;
@@ -55,6 +57,54 @@ struct TCOD_BasicGraph2D {
   int diagonal;
 };
 
+/**
+    An edge of a custom graph, applied to every node of the pathfinder.
+
+    Edges which would leave the pathfinder bounds are skipped.
+ */
+struct TCOD_PathfinderEdge {
+  int offset[TCOD_PATHFINDER_MAX_DIMENSIONS];  // The offset to the destination node, one value for each axis.
+  int cost;  // Multiplier for the cost of the destination node.  Edges with a cost of zero or less are ignored.
+  /**
+      An optional cost array used by this edge instead of the graph cost array.
+      This array must have the same type and strides as the graph cost array.
+
+      This can be used for conditional edges, such as stairs which only exist where their cost array is non-zero.
+   */
+  const void* cost_data;
+};
+
+/**
+    Heuristics used to direct a TCOD_Pathfinder towards its goals.
+ */
+typedef enum TCOD_PathfinderHeuristicType {
+  /// `cardinal` times the sum of the distance along every axis.
+  TCOD_PF_HEURISTIC_MANHATTAN,
+  /// `cardinal` times the largest distance along any axis.
+  TCOD_PF_HEURISTIC_CHEBYSHEV,
+  /// Diagonal moves cost `diagonal` on the first two axes, other moves cost `cardinal`.
+  TCOD_PF_HEURISTIC_DIAGONAL,
+} TCOD_PathfinderHeuristicType;
+
+/**
+    A heuristic estimating the remaining distance to a goal.
+
+    This must never overestimate the true distance or the paths found will not be the shortest.
+    It should also be consistent: moving along any edge must not lower the estimate by more than the cost of that edge.
+    With an inconsistent heuristic nodes can be expanded more than once and frontier pushes can fall outside of the
+    bucket queue window, so paths are still the shortest but are found slower.
+
+    Each heuristic is a distance, so it is consistent when its estimate for the offset of every edge is no more than
+    the edge multiplier, since node costs are at least 1.  For graphs whose edges move a single step along each axis
+    this means `cardinal` and `diagonal` are no more than the cardinal and diagonal multipliers.  Custom edges which
+    move further, such as knight moves, are estimated over their whole offset and must be checked separately.
+ */
+struct TCOD_PathfinderHeuristic {
+  TCOD_PathfinderHeuristicType type;
+  int cardinal;
+  int diagonal;
+};
+
 struct TCOD_Pathfinder {
   int8_t ndim;
   size_t shape[TCOD_PATHFINDER_MAX_DIMENSIONS];
@@ -65,6 +115,15 @@ struct TCOD_Pathfinder {
   struct TCOD_BasicGraph2D graph;
   struct TCOD_ArrayData traversal;
   struct TCOD_Heap heap;
+  bool use_buckets;  // If true then `buckets` is used as the frontier instead of `heap`.
+  struct TCOD_BucketQueue buckets;
+  int goal_count;  // The number of goals, if zero then the whole graph is computed.
+  int* goals;  // The coordinates of each goal, `goal_count * ndim` values.
+  int* goal_nodes;  // The flat node index of each goal.
+  struct TCOD_PathfinderHeuristic heuristic;
+  int goal_reached;  // The index of the goal reached by the last compute call, or -1.
+  int edge_count;  // The number of custom edges, if zero then the basic 2D graph is used.
+  struct TCOD_PathfinderEdge* edges;  // The edge table of a custom graph.
 };
 
 TCODLIB_CAPI struct TCOD_Pathfinder* TCOD_pf_new(int ndim, const size_t* shape);
@@ -72,13 +131,89 @@ TCODLIB_CAPI void TCOD_pf_delete(struct TCOD_Pathfinder* path);
 
 TCODLIB_CAPI void TCOD_pf_set_distance_pointer(
     struct TCOD_Pathfinder* path, void* data, int int_type, const size_t* strides);
+/**
+    Set the cost array of a basic graph with cardinal and diagonal moves along the first two axes.
+
+    The cost of moving onto a node is its cost value multiplied by `cardinal` or `diagonal`.
+    Nodes with a cost of zero or less are impassable, as are moves with a non-positive multiplier.
+    This removes any edge table set by `TCOD_pf_set_graph_pointer`.
+ */
 TCODLIB_CAPI void TCOD_pf_set_graph2d_pointer(
     struct TCOD_Pathfinder* path, void* data, int int_type, const size_t* strides, int cardinal, int diagonal);
+/**
+    Set the cost array of a custom graph made from an edge table.  Any number of dimensions is supported.
+
+    Each edge moves from a node to the node at its offset, for example a 3D graph with stairs can use the 2D cardinal
+    edges `{0, -1, 0}`, `{0, 1, 0}`, `{0, 0, -1}`, `{0, 0, 1}` along with edges `{-1, 0, 0}` and `{1, 0, 0}` given
+    their own stair cost arrays.  Hexagonal grids in axial coordinates and knight moves can be made the same way.
+
+    The edges are copied and this replaces any basic graph set by `TCOD_pf_set_graph2d_pointer`.
+    Returns a negative error code on failure.
+ */
+TCODLIB_CAPI int TCOD_pf_set_graph_pointer(
+    struct TCOD_Pathfinder* path,
+    void* data,
+    int int_type,
+    const size_t* strides,
+    int edge_count,
+    const struct TCOD_PathfinderEdge* edges);
 TCODLIB_CAPI void TCOD_pf_set_traversal_pointer(
     struct TCOD_Pathfinder* path, void* data, int int_type, const size_t* strides);
 
+/**
+    Set the goals of a pathfinder, turning it into a goal-directed A* search.
+
+    `goals` is an array of `goal_count * ndim` coordinates.  Passing a `goal_count` of zero removes all goals.
+    `heuristic` must be admissible and should be consistent for the graph, see `TCOD_PathfinderHeuristic`.
+    It can be NULL to search without a heuristic.
+
+    Goals must be set before calling `TCOD_pf_recompile`.  Computing then stops as soon as any goal is reached.
+    Returns a negative error code on failure.
+ */
+TCODLIB_CAPI int TCOD_pf_set_goals(
+    struct TCOD_Pathfinder* path, int goal_count, const int* goals, const struct TCOD_PathfinderHeuristic* heuristic);
+
 TCODLIB_CAPI int TCOD_pf_recompile(struct TCOD_Pathfinder* path);
+/**
+    Compute the pathfinder until its frontier is empty or until a goal is reached.
+
+    Nodes are ordered by int priorities, so nodes whose distance would be more than `INT_MAX` are left unreached, even
+    with 32 or 64-bit distance arrays.
+
+    Returns 1 if a goal was reached, its index is then stored in `path->goal_reached`.
+    Returns 0 if the frontier was exhausted, or a negative error code on failure.
+ */
 TCODLIB_CAPI int TCOD_pf_compute(struct TCOD_Pathfinder* path);
+/**
+    Process a single node of the pathfinder.  Returns the same values as `TCOD_pf_compute`.
+ */
 TCODLIB_CAPI int TCOD_pf_compute_step(struct TCOD_Pathfinder* path);
+/**
+    Extract a path from the traversal array of a computed pathfinder without allocating memory.
+
+    `start` is the `ndim` coordinates of the node to walk from.
+    The path is written to `out_indices` as flat node indices in C order, starting with `start` itself and ending
+    with the origin it leads to.  Origins are nodes whose traversal points to themselves, so the traversal array must
+    be initialized this way before computing.  At most `max_len` indices are written.
+
+    Returns the full length of the path, which may be larger than `max_len`, or 0 if `start` was never reached.
+    Returns a negative error code on failure.
+ */
+TCODLIB_CAPI int TCOD_pf_extract_path(
+    const struct TCOD_Pathfinder* path, const int* start, int* out_indices, int max_len);
+/**
+    Extract the paths of many starting nodes which share the same traversal array.
+
+    `starts` is an array of `count * ndim` coordinates.  Each path is written to its own block of `max_len` indices
+    in `out_indices` and its full length, as returned by `TCOD_pf_extract_path`, is written to `out_lengths`.
+    Returns a negative error code on failure.
+ */
+TCODLIB_CAPI int TCOD_pf_extract_paths(
+    const struct TCOD_Pathfinder* path,
+    int count,
+    const int* starts,
+    int* out_indices,
+    int max_len,
+    int* out_lengths);
 
 #endif  // TCOD_PATHFINDER_H
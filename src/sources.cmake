@@ -61,6 +61,12 @@ target_sources(${PROJECT_NAME} PRIVATE
     libtcod/heightmap.h
     libtcod/heightmap.hpp
     libtcod/heightmap_c.c
+    libtcod/heightmap_chunked.c
+    libtcod/heightmap_chunked.h
+    libtcod/heightmap_compact.c
+    libtcod/heightmap_compact.h
+    libtcod/heightmap_hydrology.c
+    libtcod/heightmap_hydrology.h
     libtcod/image.cpp
     libtcod/image.h
     libtcod/image.hpp
@@ -96,6 +102,10 @@ target_sources(${PROJECT_NAME} PRIVATE
     libtcod/noise.hpp
     libtcod/noise_c.c
     libtcod/noise_defaults.h
+    libtcod/noise_texture.c
+    libtcod/noise_texture.h
+    libtcod/parallel.c
+    libtcod/parallel.h
     libtcod/parser.cpp
     libtcod/parser.h
     libtcod/parser.hpp
@@ -224,6 +234,9 @@ install(FILES
     libtcod/heapq.h
     libtcod/heightmap.h
     libtcod/heightmap.hpp
+    libtcod/heightmap_chunked.h
+    libtcod/heightmap_compact.h
+    libtcod/heightmap_hydrology.h
     libtcod/image.h
     libtcod/image.hpp
     libtcod/lex.h
@@ -246,6 +259,8 @@ install(FILES
     libtcod/noise.h
     libtcod/noise.hpp
     libtcod/noise_defaults.h
+    libtcod/noise_texture.h
+    libtcod/parallel.h
     libtcod/parser.h
     libtcod/parser.hpp
     libtcod/path.h
@@ -367,6 +382,12 @@ source_group(libtcod FILES
     libtcod/heightmap.h
     libtcod/heightmap.hpp
     libtcod/heightmap_c.c
+    libtcod/heightmap_chunked.c
+    libtcod/heightmap_chunked.h
+    libtcod/heightmap_compact.c
+    libtcod/heightmap_compact.h
+    libtcod/heightmap_hydrology.c
+    libtcod/heightmap_hydrology.h
     libtcod/image.cpp
     libtcod/image.h
     libtcod/image.hpp
@@ -402,6 +423,10 @@ source_group(libtcod FILES
     libtcod/noise.hpp
     libtcod/noise_c.c
     libtcod/noise_defaults.h
+    libtcod/noise_texture.c
+    libtcod/noise_texture.h
+    libtcod/parallel.c
+    libtcod/parallel.h
     libtcod/parser.cpp
     libtcod/parser.h
     libtcod/parser.hpp
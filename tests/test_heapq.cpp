@@ -0,0 +1,189 @@
+#include <libtcod/heapq.h>
+
+#include <algorithm>
+#include <catch2/catch_all.hpp>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+/// Return `count` pseudo-random priorities.
+std::vector<int> random_priorities(int count, int max_priority, uint32_t seed = 0) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> dist(0, max_priority);
+  std::vector<int> priorities(count);
+  for (auto& it : priorities) it = dist(rng);
+  return priorities;
+}
+/// Push every priority onto a new heap and pop them all, returning the sum of popped values.
+int64_t heap_push_pop(const std::vector<int>& priorities) {
+  struct TCOD_Heap heap;
+  TCOD_heap_init(&heap, sizeof(int));
+  for (int i = 0; i < static_cast<int>(priorities.size()); ++i) TCOD_minheap_push(&heap, priorities.at(i), &i);
+  int64_t total = 0;
+  while (heap.size) {
+    int out;
+    TCOD_minheap_pop(&heap, &out);
+    total += out;
+  }
+  TCOD_heap_uninit(&heap);
+  return total;
+}
+}  // namespace
+
+TEST_CASE("TCOD_Heap sorts priorities") {
+  const auto priorities = random_priorities(5000, 1000);
+  for (size_t data_size : {sizeof(int), sizeof(int) * 3}) {
+    struct TCOD_Heap heap;
+    REQUIRE(TCOD_heap_init(&heap, data_size) == 0);
+    for (int i = 0; i < static_cast<int>(priorities.size()); ++i) {
+      const int data[3] = {i, i * 2, i * 3};
+      REQUIRE(TCOD_minheap_push(&heap, priorities.at(i), data) == 0);
+    }
+    std::vector<int> popped;
+    while (heap.size) {
+      const int priority = *reinterpret_cast<const int*>(heap.heap);
+      int data[3] = {};
+      TCOD_minheap_pop(&heap, data);
+      REQUIRE(priorities.at(data[0]) == priority);
+      if (data_size > sizeof(int)) REQUIRE(data[2] == data[0] * 3);
+      popped.push_back(priority);
+    }
+    REQUIRE(std::is_sorted(popped.begin(), popped.end()));
+    REQUIRE(popped.size() == priorities.size());
+    TCOD_heap_uninit(&heap);
+  }
+}
+
+TEST_CASE("TCOD_Heap heapify") {
+  const auto priorities = random_priorities(1000, 100);
+  struct TCOD_Heap heap;
+  REQUIRE(TCOD_heap_init_indexed(&heap, static_cast<int>(priorities.size())) == 0);
+  for (int i = 0; i < static_cast<int>(priorities.size()); ++i) REQUIRE(TCOD_minheap_push(&heap, 0, &i) == 0);
+  for (int i = 0; i < heap.size; ++i) {  // Scramble the priorities in-place.
+    auto* node = reinterpret_cast<int*>(heap.heap + i * heap.node_size);
+    node[0] = priorities.at(node[1]);
+  }
+  TCOD_minheap_heapify(&heap);
+  REQUIRE(TCOD_minheap_decrease_key(&heap, 500, -1) == 1);
+  int out = -1;
+  TCOD_minheap_pop(&heap, &out);
+  REQUIRE(out == 500);
+  int last_priority = -1;
+  while (heap.size) {
+    const int priority = *reinterpret_cast<const int*>(heap.heap);
+    REQUIRE(last_priority <= priority);
+    TCOD_minheap_pop(&heap, &out);
+    REQUIRE(priorities.at(out) == priority);
+    last_priority = priority;
+  }
+  TCOD_heap_uninit(&heap);
+}
+
+TEST_CASE("TCOD_Heap heapify empty heaps") {
+  struct TCOD_Heap heap;
+  REQUIRE(TCOD_heap_init(&heap, sizeof(int)) == 0);
+  TCOD_minheap_heapify(&heap);  // Must not read the unallocated heap.
+  REQUIRE(heap.size == 0);
+  TCOD_heap_uninit(&heap);
+
+  REQUIRE(TCOD_heap_init_indexed(&heap, 4) == 0);
+  for (int i = 0; i < 3; ++i) REQUIRE(TCOD_minheap_push(&heap, 3 - i, &i) == 0);
+  while (heap.size) TCOD_minheap_pop(&heap, nullptr);
+  TCOD_minheap_heapify(&heap);
+  REQUIRE(heap.size == 0);
+  for (int i = 0; i < 4; ++i) REQUIRE(!TCOD_minheap_contains(&heap, i));
+  const int index = 1;
+  REQUIRE(TCOD_minheap_push(&heap, 5, &index) == 0);
+  TCOD_minheap_heapify(&heap);
+  REQUIRE(TCOD_minheap_contains(&heap, index));
+  REQUIRE(!TCOD_minheap_contains(&heap, 2));
+  TCOD_heap_uninit(&heap);
+}
+
+TEST_CASE("TCOD_Heap decrease-key") {
+  constexpr int COUNT = 2000;
+  const auto priorities = random_priorities(COUNT * 4, 100000, 1);
+  struct TCOD_Heap heap;
+  REQUIRE(TCOD_heap_init_indexed(&heap, COUNT) == 0);
+  std::vector<int> expected(COUNT, INT32_MAX);
+  for (int i = 0; i < static_cast<int>(priorities.size()); ++i) {
+    const int index = i % COUNT;
+    const int result = TCOD_minheap_decrease_key(&heap, index, priorities.at(i));
+    REQUIRE(result == (priorities.at(i) < expected.at(index) ? 1 : 0));
+    expected.at(index) = std::min(expected.at(index), priorities.at(i));
+  }
+  REQUIRE(heap.size == COUNT);
+  REQUIRE(TCOD_minheap_contains(&heap, 0));
+  REQUIRE(!TCOD_minheap_contains(&heap, COUNT));
+  REQUIRE(TCOD_minheap_decrease_key(&heap, COUNT, 0) < 0);
+  int last_priority = -1;
+  while (heap.size) {
+    const int priority = *reinterpret_cast<const int*>(heap.heap);
+    int index;
+    TCOD_minheap_pop(&heap, &index);
+    REQUIRE(!TCOD_minheap_contains(&heap, index));
+    REQUIRE(expected.at(index) == priority);
+    REQUIRE(last_priority <= priority);
+    last_priority = priority;
+  }
+  const int index = 7;
+  REQUIRE(TCOD_minheap_push(&heap, 10, &index) == 0);
+  REQUIRE(TCOD_minheap_push(&heap, 20, &index) == 0);  // Pushing an existing index changes its priority.
+  REQUIRE(heap.size == 1);
+  REQUIRE(*reinterpret_cast<const int*>(heap.heap) == 20);
+  TCOD_heap_clear(&heap);
+  REQUIRE(!TCOD_minheap_contains(&heap, index));
+  TCOD_heap_uninit(&heap);
+}
+
+TEST_CASE("TCOD_Heap benchmarks", "[.benchmark]") {
+  const auto priorities = random_priorities(100000, 1000000);
+  BENCHMARK("TCOD_Heap push/pop 100000") { return heap_push_pop(priorities); };
+  BENCHMARK("std::priority_queue push/pop 100000") {
+    std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<>> queue;
+    for (int i = 0; i < static_cast<int>(priorities.size()); ++i) queue.emplace(priorities.at(i), i);
+    int64_t total = 0;
+    while (!queue.empty()) {
+      total += queue.top().second;
+      queue.pop();
+    }
+    return total;
+  };
+  // Dijkstra-like usage: each index is pushed several times with a falling priority.
+  constexpr int INDEXES = 25000;
+  BENCHMARK("TCOD_Heap duplicate pushes 25000x4") {
+    struct TCOD_Heap heap;
+    TCOD_heap_init(&heap, sizeof(int));
+    for (int i = 0; i < static_cast<int>(priorities.size()); ++i) {
+      const int index = i % INDEXES;
+      TCOD_minheap_push(&heap, priorities.at(i) - i, &index);
+    }
+    int64_t total = 0;
+    while (heap.size) {
+      int out;
+      TCOD_minheap_pop(&heap, &out);
+      total += out;
+    }
+    TCOD_heap_uninit(&heap);
+    return total;
+  };
+  BENCHMARK("TCOD_Heap decrease-key 25000x4") {
+    struct TCOD_Heap heap;
+    TCOD_heap_init_indexed(&heap, INDEXES);
+    for (int i = 0; i < static_cast<int>(priorities.size()); ++i) {
+      TCOD_minheap_decrease_key(&heap, i % INDEXES, priorities.at(i) - i);
+    }
+    int64_t total = 0;
+    while (heap.size) {
+      int out;
+      TCOD_minheap_pop(&heap, &out);
+      total += out;
+    }
+    TCOD_heap_uninit(&heap);
+    return total;
+  };
+}
@@ -0,0 +1,940 @@
+#include <libtcod/heightmap.h>
+#include <libtcod/heightmap_chunked.h>
+#include <libtcod/heightmap_compact.h>
+#include <libtcod/heightmap_hydrology.h>
+#include <libtcod/mersenne.h>
+#include <libtcod/noise.h>
+#include <libtcod/parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <catch2/catch_all.hpp>
+#include <vector>
+
+/// The brute force Voronoi algorithm, comparing every cell with every point.
+static std::vector<float> reference_voronoi(
+    int width, int height, int points, int coef_count, const float* coef, uint32_t seed) {
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, seed);
+  std::vector<std::pair<int, int>> pt;
+  for (int i = 0; i < points; ++i) {
+    const int x = TCOD_random_get_int(rng, 0, width - 1);
+    const int y = TCOD_random_get_int(rng, 0, height - 1);
+    pt.emplace_back(x, y);
+  }
+  TCOD_random_delete(rng);
+  coef_count = std::min(coef_count, points);
+  std::vector<float> out(width * height);
+  std::vector<std::pair<float, int>> dist(points);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      for (int i = 0; i < points; ++i) {
+        const int dx = pt[i].first - x;
+        const int dy = pt[i].second - y;
+        dist[i] = {static_cast<float>(dx * dx + dy * dy), i};
+      }
+      std::sort(dist.begin(), dist.end());
+      for (int i = 0; i < coef_count; ++i) out[x + y * width] += coef[i] * dist[i].first;
+    }
+  }
+  return out;
+}
+
+TEST_CASE("Heightmap Voronoi matches brute force") {
+  const float coef[] = {-1.0f, 0.5f, 0.25f, 0.125f};
+  struct Case {
+    int width, height, points, coef_count;
+  };
+  const Case cases[] = {
+      {1, 1, 1, 1}, {17, 5, 3, 2}, {64, 48, 40, 3}, {100, 30, 500, 4}, {33, 33, 2, 4}, {50, 50, 10, 0}};
+  for (const Case& it : cases) {
+    INFO(it.width << "x" << it.height << " points=" << it.points << " coef=" << it.coef_count);
+    TCOD_heightmap_t* heightmap = TCOD_heightmap_new(it.width, it.height);
+    TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 42);
+    TCOD_heightmap_add_voronoi(heightmap, it.points, it.coef_count, coef, rng);
+    TCOD_random_delete(rng);
+    const std::vector<float> expected = reference_voronoi(it.width, it.height, it.points, it.coef_count, coef, 42);
+    REQUIRE(std::vector<float>(heightmap->values, heightmap->values + it.width * it.height) == expected);
+    TCOD_heightmap_delete(heightmap);
+  }
+}
+
+TEST_CASE("Heightmap Voronoi benchmark", "[.benchmark]") {
+  const float coef[] = {-1.0f, 1.0f};
+  TCOD_heightmap_t* heightmap = TCOD_heightmap_new(512, 512);
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  BENCHMARK("TCOD_heightmap_add_voronoi 512x512 2000 points") {
+    TCOD_heightmap_add_voronoi(heightmap, 2000, 2, coef, rng);
+    return heightmap->values[0];
+  };
+  TCOD_random_delete(rng);
+  TCOD_heightmap_delete(heightmap);
+}
+
+/// Return a heightmap filled with random values, with a size which is not a multiple of any vector width.
+static TCOD_heightmap_t* random_heightmap(int width, int height, uint32_t seed) {
+  TCOD_heightmap_t* heightmap = TCOD_heightmap_new(width, height);
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, seed);
+  for (int i = 0; i < width * height; ++i) heightmap->values[i] = TCOD_random_get_float(rng, -10.0f, 10.0f);
+  TCOD_random_delete(rng);
+  return heightmap;
+}
+
+static std::vector<float> heightmap_values(const TCOD_heightmap_t* heightmap) {
+  return std::vector<float>(heightmap->values, heightmap->values + heightmap->w * heightmap->h);
+}
+
+TEST_CASE("Heightmap arithmetic matches scalar loops") {
+  const int width = 37;
+  const int height = 29;
+  TCOD_heightmap_t* hm1 = random_heightmap(width, height, 1);
+  TCOD_heightmap_t* hm2 = random_heightmap(width, height, 2);
+  TCOD_heightmap_t* out = TCOD_heightmap_new(width, height);
+  const std::vector<float> a = heightmap_values(hm1);
+  const std::vector<float> b = heightmap_values(hm2);
+  const size_t n = a.size();
+  std::vector<float> expected(n);
+
+  TCOD_heightmap_lerp_hm(hm1, hm2, out, 0.3f);
+  for (size_t i = 0; i < n; ++i) expected[i] = a[i] + 0.3f * (b[i] - a[i]);
+  REQUIRE(heightmap_values(out) == expected);
+  TCOD_heightmap_add_hm(hm1, hm2, out);
+  for (size_t i = 0; i < n; ++i) expected[i] = a[i] + b[i];
+  REQUIRE(heightmap_values(out) == expected);
+  TCOD_heightmap_multiply_hm(hm1, hm2, out);
+  for (size_t i = 0; i < n; ++i) expected[i] = a[i] * b[i];
+  REQUIRE(heightmap_values(out) == expected);
+
+  float min = 0;
+  float max = 0;
+  TCOD_heightmap_get_minmax(hm1, &min, &max);
+  REQUIRE(min == *std::min_element(a.begin(), a.end()));
+  REQUIRE(max == *std::max_element(a.begin(), a.end()));
+  REQUIRE(
+      TCOD_heightmap_count_cells(hm1, -2.5f, 4.0f) ==
+      std::count_if(a.begin(), a.end(), [](float v) { return v >= -2.5f && v <= 4.0f; }));
+
+  TCOD_heightmap_copy(hm1, out);
+  TCOD_heightmap_scale(out, 1.7f);
+  TCOD_heightmap_add(out, -0.4f);
+  TCOD_heightmap_clamp(out, -5.0f, 6.0f);
+  for (size_t i = 0; i < n; ++i) {
+    const float value = a[i] * 1.7f + -0.4f;
+    expected[i] = value < -5.0f ? -5.0f : (value > 6.0f ? 6.0f : value);
+  }
+  REQUIRE(heightmap_values(out) == expected);
+  TCOD_heightmap_copy(hm1, out);
+  TCOD_heightmap_scale_add_clamp(out, 1.7f, -0.4f, -5.0f, 6.0f);
+  REQUIRE(heightmap_values(out) == expected);
+
+  TCOD_heightmap_copy(hm1, out);
+  TCOD_heightmap_normalize(out, 0.0f, 1.0f);
+  const float scale = 1.0f / (max - min);
+  for (size_t i = 0; i < n; ++i) expected[i] = 0.0f + (a[i] - min) * scale;
+  REQUIRE(heightmap_values(out) == expected);
+
+  TCOD_heightmap_delete(out);
+  TCOD_heightmap_delete(hm2);
+  TCOD_heightmap_delete(hm1);
+}
+
+TEST_CASE("Heightmap arithmetic benchmark", "[.benchmark]") {
+  TCOD_heightmap_t* hm1 = random_heightmap(1024, 1024, 1);
+  TCOD_heightmap_t* hm2 = random_heightmap(1024, 1024, 2);
+  BENCHMARK("TCOD_heightmap_get_minmax 1024x1024") {
+    float min;
+    float max;
+    TCOD_heightmap_get_minmax(hm1, &min, &max);
+    return min + max;
+  };
+  BENCHMARK("TCOD_heightmap_count_cells 1024x1024") { return TCOD_heightmap_count_cells(hm1, -1.0f, 1.0f); };
+  BENCHMARK("TCOD_heightmap_lerp_hm 1024x1024") {
+    TCOD_heightmap_lerp_hm(hm1, hm2, hm2, 0.5f);
+    return hm2->values[0];
+  };
+  BENCHMARK("TCOD_heightmap_scale_add_clamp 1024x1024") {
+    TCOD_heightmap_scale_add_clamp(hm1, 1.0f, 0.0f, -5.0f, 5.0f);
+    return hm1->values[0];
+  };
+  TCOD_heightmap_delete(hm2);
+  TCOD_heightmap_delete(hm1);
+}
+
+/// Return a heightmap with fBm hills, so that rain drops have somewhere to flow.
+static TCOD_heightmap_t* hilly_heightmap(int width, int height) {
+  TCOD_heightmap_t* heightmap = TCOD_heightmap_new(width, height);
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  TCOD_Noise* noise = TCOD_noise_new(2, TCOD_NOISE_DEFAULT_HURST, TCOD_NOISE_DEFAULT_LACUNARITY, rng);
+  TCOD_heightmap_add_fbm(heightmap, noise, 4.0f, 4.0f, 0.0f, 0.0f, 4.0f, 0.5f, 1.0f);
+  TCOD_noise_delete(noise);
+  TCOD_random_delete(rng);
+  return heightmap;
+}
+
+TEST_CASE("Heightmap parallel rain erosion is deterministic") {
+  const int max_threads = TCOD_parallel_get_max_threads();
+  std::vector<float> results[3];
+  const int thread_counts[3] = {1, 4, 1};
+  for (int i = 0; i < 3; ++i) {
+    TCOD_parallel_set_max_threads(thread_counts[i]);
+    TCOD_heightmap_t* heightmap = hilly_heightmap(97, 61);
+    REQUIRE(TCOD_heightmap_rain_erosion_parallel(heightmap, 10000, 0.05f, 0.05f, i < 2 ? 42 : 43) == TCOD_E_OK);
+    results[i] = heightmap_values(heightmap);
+    TCOD_heightmap_delete(heightmap);
+  }
+  TCOD_parallel_set_max_threads(max_threads);
+  REQUIRE(results[0] == results[1]);
+  REQUIRE(results[0] != results[2]);
+  TCOD_heightmap_t* heightmap = hilly_heightmap(97, 61);
+  const std::vector<float> original = heightmap_values(heightmap);
+  REQUIRE(results[0] != original);
+  REQUIRE(TCOD_heightmap_rain_erosion_parallel(heightmap, 0, 0.05f, 0.05f, 42) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_rain_erosion_parallel(NULL, 100, 0.05f, 0.05f, 42) == TCOD_E_INVALID_ARGUMENT);
+  REQUIRE(heightmap_values(heightmap) == original);
+  TCOD_heightmap_delete(heightmap);
+}
+
+TEST_CASE("Heightmap rain erosion benchmark", "[.benchmark]") {
+  TCOD_heightmap_t* heightmap = hilly_heightmap(512, 512);
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  BENCHMARK("TCOD_heightmap_rain_erosion 512x512 100000 drops") {
+    TCOD_heightmap_rain_erosion(heightmap, 100000, 0.01f, 0.01f, rng);
+    return heightmap->values[0];
+  };
+  BENCHMARK("TCOD_heightmap_rain_erosion_parallel 512x512 100000 drops") {
+    TCOD_heightmap_rain_erosion_parallel(heightmap, 100000, 0.01f, 0.01f, 0);
+    return heightmap->values[0];
+  };
+  TCOD_random_delete(rng);
+  TCOD_heightmap_delete(heightmap);
+}
+
+/// A double-buffered kernel transform checking the bounds of every tap.
+static std::vector<float> reference_kernel_transform(
+    const TCOD_heightmap_t* heightmap,
+    int kernel_size,
+    const int* dx,
+    const int* dy,
+    const float* weight,
+    float min_level,
+    float max_level) {
+  std::vector<float> result = heightmap_values(heightmap);
+  for (int y = 0; y < heightmap->h; ++y) {
+    for (int x = 0; x < heightmap->w; ++x) {
+      const float original = heightmap->values[x + y * heightmap->w];
+      if (original < min_level || original > max_level) continue;
+      float value = 0.0f;
+      float total_weight = 0.0f;
+      for (int i = 0; i < kernel_size; ++i) {
+        const int nx = x + dx[i];
+        const int ny = y + dy[i];
+        if (nx < 0 || nx >= heightmap->w || ny < 0 || ny >= heightmap->h) continue;
+        value += weight[i] * heightmap->values[nx + ny * heightmap->w];
+        total_weight += weight[i];
+      }
+      result[x + y * heightmap->w] = value / total_weight;
+    }
+  }
+  return result;
+}
+
+TEST_CASE("Heightmap kernel transforms") {
+  static constexpr int SHARPEN_DX[] = {-1, 0, 1, -1, 0, 1, -1, 0, 1, 2};
+  static constexpr int SHARPEN_DY[] = {-1, -1, -1, 0, 0, 0, 1, 1, 1, 0};
+  static constexpr float SHARPEN_WEIGHT[] = {-1.0f, -1.0f, -1.0f, -1.0f, 12.0f, -1.0f, -1.0f, -1.0f, -1.0f, 0.5f};
+  const int max_threads = TCOD_parallel_get_max_threads();
+  for (const int width : {1, 7, 37}) {
+    TCOD_heightmap_t* heightmap = random_heightmap(width, 23, 3);
+    TCOD_heightmap_t* out = TCOD_heightmap_new(width, 23);
+    SECTION("A general kernel matches the scalar reference exactly") {
+      const std::vector<float> expected =
+          reference_kernel_transform(heightmap, 10, SHARPEN_DX, SHARPEN_DY, SHARPEN_WEIGHT, -0.5f, 0.5f);
+      for (const int threads : {1, 4}) {
+        TCOD_parallel_set_max_threads(threads);
+        TCOD_heightmap_kernel_transform_out(heightmap, out, 10, SHARPEN_DX, SHARPEN_DY, SHARPEN_WEIGHT, -0.5f, 0.5f);
+        REQUIRE(heightmap_values(out) == expected);
+      }
+      TCOD_heightmap_kernel_transform_out(heightmap, heightmap, 10, SHARPEN_DX, SHARPEN_DY, SHARPEN_WEIGHT, -0.5f, 0.5f);
+      REQUIRE(heightmap_values(heightmap) == expected);
+    }
+    SECTION("Separable kernels match a 2D convolution") {
+      static constexpr float GAUSSIAN[] = {1.0f, 4.0f, 6.0f, 4.0f, 1.0f};
+      int dx[25];
+      int dy[25];
+      float weight[25];
+      for (int i = 0; i < 25; ++i) {
+        dx[i] = i % 5 - 2;
+        dy[i] = i / 5 - 2;
+        weight[i] = GAUSSIAN[i % 5] * GAUSSIAN[i / 5];
+      }
+      const std::vector<float> expected = reference_kernel_transform(heightmap, 25, dx, dy, weight, -0.9f, 0.9f);
+      for (const int threads : {1, 4}) {
+        TCOD_parallel_set_max_threads(threads);
+        TCOD_heightmap_kernel_transform_out(heightmap, out, 25, dx, dy, weight, -0.9f, 0.9f);
+        for (size_t i = 0; i < expected.size(); ++i) REQUIRE(out->values[i] == Approx(expected[i]).margin(1e-5));
+        TCOD_heightmap_separable_transform(heightmap, out, 2, GAUSSIAN, -0.9f, 0.9f);
+        for (size_t i = 0; i < expected.size(); ++i) REQUIRE(out->values[i] == Approx(expected[i]).margin(1e-5));
+      }
+    }
+    TCOD_parallel_set_max_threads(max_threads);
+    TCOD_heightmap_delete(out);
+    TCOD_heightmap_delete(heightmap);
+  }
+}
+
+TEST_CASE("Heightmap kernel transform benchmark", "[.benchmark]") {
+  TCOD_heightmap_t* heightmap = random_heightmap(2048, 2048, 4);
+  TCOD_heightmap_t* out = TCOD_heightmap_new(2048, 2048);
+  int dx[25];
+  int dy[25];
+  float weight[25];
+  for (int i = 0; i < 25; ++i) {
+    dx[i] = i % 5 - 2;
+    dy[i] = i / 5 - 2;
+    weight[i] = 1.0f + (i % 3) * (i / 5);  // Not separable.
+  }
+  BENCHMARK("TCOD_heightmap_kernel_transform 2048x2048 5x5") {
+    TCOD_heightmap_kernel_transform(heightmap, 25, dx, dy, weight, -1.0f, 1.0f);
+    return heightmap->values[0];
+  };
+  BENCHMARK("TCOD_heightmap_kernel_transform_out 2048x2048 5x5") {
+    TCOD_heightmap_kernel_transform_out(heightmap, out, 25, dx, dy, weight, -1.0f, 1.0f);
+    return out->values[0];
+  };
+  for (int i = 0; i < 25; ++i) weight[i] = 1.0f;
+  BENCHMARK("TCOD_heightmap_kernel_transform_out 2048x2048 5x5 box") {
+    TCOD_heightmap_kernel_transform_out(heightmap, out, 25, dx, dy, weight, -1.0f, 1.0f);
+    return out->values[0];
+  };
+  TCOD_heightmap_delete(out);
+  TCOD_heightmap_delete(heightmap);
+}
+
+/// Thermal erosion computing each pass cell by cell with bounds checks.
+static void reference_thermal_erosion(
+    TCOD_heightmap_t* heightmap, int passes, float min_slope, float erosion_coef, float aggregation_coef) {
+  static const int dx[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+  static const int dy[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+  const int width = heightmap->w;
+  const int height = heightmap->h;
+  std::vector<float> amount(width * height);
+  std::vector<int> target(width * height);
+  while (passes-- > 0) {
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        float slope = 0.0f;
+        int steepest = -1;
+        for (int i = 0; i < 8; ++i) {
+          const int nx = x + dx[i];
+          const int ny = y + dy[i];
+          if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue;
+          const float n_slope = heightmap->values[x + y * width] - heightmap->values[nx + ny * width];
+          if (n_slope > slope) {
+            slope = n_slope;
+            steepest = i;
+          }
+        }
+        const bool erodes = steepest >= 0 && slope > min_slope;
+        amount[x + y * width] = erodes ? slope - min_slope : 0.0f;
+        target[x + y * width] = erodes ? steepest : -1;
+      }
+    }
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        float received = 0.0f;
+        for (int i = 0; i < 8; ++i) {
+          const int nx = x + dx[i];
+          const int ny = y + dy[i];
+          if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue;
+          if (target[nx + ny * width] == 7 - i) received += amount[nx + ny * width];
+        }
+        float& value = heightmap->values[x + y * width];
+        value = value - erosion_coef * amount[x + y * width] + aggregation_coef * received;
+      }
+    }
+  }
+}
+
+TEST_CASE("Heightmap thermal erosion") {
+  const int max_threads = TCOD_parallel_get_max_threads();
+  const int sizes[][2] = {{1, 1}, {2, 3}, {9, 9}, {67, 41}};
+  for (const auto& size : sizes) {
+    INFO(size[0] << "x" << size[1]);
+    TCOD_heightmap_t* heightmap = random_heightmap(size[0], size[1], 6);
+    TCOD_heightmap_t* expected = random_heightmap(size[0], size[1], 6);
+    reference_thermal_erosion(expected, 5, 1.0f, 0.25f, 0.2f);
+    for (int threads : {1, 4}) {
+      TCOD_parallel_set_max_threads(threads);
+      TCOD_heightmap_t* copy = random_heightmap(size[0], size[1], 6);
+      TCOD_heightmap_thermal_erosion(copy, 5, 1.0f, 0.25f, 0.2f);
+      REQUIRE(heightmap_values(copy) == heightmap_values(expected));
+      TCOD_heightmap_delete(copy);
+    }
+    TCOD_heightmap_delete(expected);
+    TCOD_heightmap_delete(heightmap);
+  }
+  TCOD_parallel_set_max_threads(max_threads);
+  // Material is only moved when the erosion and aggregation coefficients match, and steep slopes are worn down.
+  TCOD_heightmap_t* heightmap = random_heightmap(64, 64, 7);
+  float total_before = 0.0f;
+  for (float value : heightmap_values(heightmap)) total_before += value;
+  TCOD_heightmap_thermal_erosion(heightmap, 50, 0.5f, 0.1f, 0.1f);
+  float total_after = 0.0f;
+  for (float value : heightmap_values(heightmap)) total_after += value;
+  REQUIRE(total_after == Approx(total_before).margin(0.05));
+  float max_slope = 0.0f;
+  for (int y = 1; y < 63; ++y) {
+    for (int x = 1; x < 63; ++x) max_slope = std::max(max_slope, std::abs(TCOD_heightmap_get_slope(heightmap, x, y)));
+  }
+  REQUIRE(max_slope < 1.2f);  // atan(20) before erosion.
+  const std::vector<float> eroded = heightmap_values(heightmap);
+  TCOD_heightmap_thermal_erosion(heightmap, 0, 0.5f, 0.1f, 0.1f);
+  TCOD_heightmap_thermal_erosion(NULL, 10, 0.5f, 0.1f, 0.1f);
+  REQUIRE(heightmap_values(heightmap) == eroded);
+  TCOD_heightmap_delete(heightmap);
+}
+
+TEST_CASE("Heightmap thermal erosion benchmark", "[.benchmark]") {
+  TCOD_heightmap_t* heightmap = hilly_heightmap(2048, 2048);
+  TCOD_heightmap_scale(heightmap, 100.0f);
+  BENCHMARK("Scalar thermal erosion 2048x2048 4 passes") {
+    reference_thermal_erosion(heightmap, 4, 0.01f, 0.1f, 0.1f);
+    return heightmap->values[0];
+  };
+  BENCHMARK("TCOD_heightmap_thermal_erosion 2048x2048 4 passes") {
+    TCOD_heightmap_thermal_erosion(heightmap, 4, 0.01f, 0.1f, 0.1f);
+    return heightmap->values[0];
+  };
+  TCOD_heightmap_delete(heightmap);
+}
+
+TEST_CASE("Heightmap slope and normal fields") {
+  const int sizes[][2] = {{1, 1}, {2, 2}, {3, 7}, {19, 5}, {67, 41}};
+  for (const auto& size : sizes) {
+    const int width = size[0];
+    const int height = size[1];
+    INFO(width << "x" << height);
+    TCOD_heightmap_t* heightmap = random_heightmap(width, height, 5);
+    TCOD_heightmap_t* slopes = TCOD_heightmap_new(width, height);
+    std::vector<float> normals(width * height * 3);
+    TCOD_heightmap_get_slopes(heightmap, slopes);
+    TCOD_heightmap_get_normals(heightmap, normals.data(), 0.5f);
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        INFO(x << "," << y);
+        REQUIRE(slopes->values[x + y * width] == TCOD_heightmap_get_slope(heightmap, x, y));
+        float expected[3];
+        TCOD_heightmap_get_normal(heightmap, (float)x, (float)y, expected, 0.5f);
+        const float* normal = &normals[(x + y * width) * 3];
+        REQUIRE(std::vector<float>(normal, normal + 3) == std::vector<float>(expected, expected + 3));
+        float n[3];
+        TCOD_heightmap_get_interpolated_normal(width, height, normals.data(), (float)x, (float)y, n);
+        if (width > 1 && height > 1) REQUIRE(std::vector<float>(n, n + 3) == std::vector<float>(normal, normal + 3));
+      }
+    }
+    TCOD_heightmap_delete(slopes);
+    TCOD_heightmap_delete(heightmap);
+  }
+  // Interpolated normals are normalized blends of the nearest cells.
+  TCOD_heightmap_t* heightmap = hilly_heightmap(32, 32);
+  std::vector<float> normals(32 * 32 * 3);
+  TCOD_heightmap_get_normals(heightmap, normals.data(), 0.0f);
+  float n[3];
+  TCOD_heightmap_get_interpolated_normal(32, 32, normals.data(), 10.5f, 20.25f, n);
+  REQUIRE(n[0] * n[0] + n[1] * n[1] + n[2] * n[2] == Approx(1.0f));
+  float expected[3];
+  TCOD_heightmap_get_normal(heightmap, 10.5f, 20.25f, expected, 0.0f);
+  for (int i = 0; i < 3; ++i) REQUIRE(n[i] == Approx(expected[i]).margin(0.1));
+  TCOD_heightmap_delete(heightmap);
+}
+
+TEST_CASE("Heightmap slope and normal field benchmark", "[.benchmark]") {
+  TCOD_heightmap_t* heightmap = hilly_heightmap(1024, 1024);
+  TCOD_heightmap_t* slopes = TCOD_heightmap_new(1024, 1024);
+  std::vector<float> normals(1024 * 1024 * 3);
+  BENCHMARK("TCOD_heightmap_get_slope 1024x1024") {
+    for (int y = 0; y < 1024; ++y) {
+      for (int x = 0; x < 1024; ++x) slopes->values[x + y * 1024] = TCOD_heightmap_get_slope(heightmap, x, y);
+    }
+    return slopes->values[0];
+  };
+  BENCHMARK("TCOD_heightmap_get_slopes 1024x1024") {
+    TCOD_heightmap_get_slopes(heightmap, slopes);
+    return slopes->values[0];
+  };
+  BENCHMARK("TCOD_heightmap_get_normal 1024x1024") {
+    for (int y = 0; y < 1024; ++y) {
+      for (int x = 0; x < 1024; ++x) {
+        TCOD_heightmap_get_normal(heightmap, (float)x, (float)y, &normals[(x + y * 1024) * 3], 0.0f);
+      }
+    }
+    return normals[0];
+  };
+  BENCHMARK("TCOD_heightmap_get_normals 1024x1024") {
+    TCOD_heightmap_get_normals(heightmap, normals.data(), 0.0f);
+    return normals[0];
+  };
+  TCOD_heightmap_delete(slopes);
+  TCOD_heightmap_delete(heightmap);
+}
+
+/// A `TCOD_HeightmapPipelineFunc` which adds a gradient, so that a pipeline also has a step it cannot fuse.
+static void add_gradient(TCOD_heightmap_t* heightmap, void* userdata) {
+  const float scale = *static_cast<const float*>(userdata);
+  for (int i = 0; i < heightmap->w * heightmap->h; ++i) heightmap->values[i] += (i % heightmap->w) * scale;
+}
+
+TEST_CASE("Heightmap pipelines match eager execution") {
+  static constexpr int DX[] = {-1, 1, 0};
+  static constexpr int DY[] = {0, 0, 0};
+  static constexpr float WEIGHT[] = {0.33f, 0.33f, 0.33f};
+  float gradient_scale = 0.01f;
+  const int width = 97;
+  const int height = 61;
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  TCOD_Noise* noise = TCOD_noise_new(2, TCOD_NOISE_DEFAULT_HURST, TCOD_NOISE_DEFAULT_LACUNARITY, rng);
+  TCOD_heightmap_t* other = random_heightmap(width, height, 5);
+
+  TCOD_heightmap_t* expected = TCOD_heightmap_new(width, height);
+  TCOD_heightmap_normalize(expected, 0.0f, 1.0f);
+  TCOD_heightmap_add_fbm(expected, noise, 6.0f, 6.0f, 0.5f, 0.25f, 6.0f, 0.5f, 0.5f);
+  TCOD_heightmap_add_hill(expected, 20.0f, 30.0f, 12.0f, 0.7f);
+  TCOD_heightmap_add_hill(expected, 90.0f, -3.0f, 20.0f, 0.4f);
+  TCOD_heightmap_dig_hill(expected, 50.0f, 40.0f, 8.0f, -0.2f);
+  TCOD_heightmap_scale(expected, 3.0f);
+  TCOD_heightmap_normalize(expected, -1.0f, 1.0f);
+  TCOD_heightmap_lerp_hm(expected, other, expected, 0.1f);
+  TCOD_heightmap_kernel_transform(expected, 3, DX, DY, WEIGHT, -0.5f, 0.5f);
+  TCOD_heightmap_normalize(expected, 0.0f, 1.0f);
+  TCOD_heightmap_scale_fbm(expected, noise, 3.0f, 3.0f, 0.0f, 0.0f, 4.0f, 0.5f, 0.25f);
+  add_gradient(expected, &gradient_scale);
+  TCOD_heightmap_multiply_hm(expected, other, expected);
+  TCOD_heightmap_add_hm(expected, other, expected);
+  TCOD_heightmap_scale_add_clamp(expected, 0.5f, 0.1f, -2.0f, 2.0f);
+  TCOD_heightmap_add(expected, 1.0f);
+  TCOD_heightmap_clamp(expected, 0.0f, 2.5f);
+  TCOD_heightmap_normalize(expected, 0.0f, 1.0f);
+
+  TCOD_HeightmapPipeline* pipeline = TCOD_heightmap_pipeline_new();
+  REQUIRE(TCOD_heightmap_pipeline_normalize(pipeline, 0.0f, 1.0f) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_add_fbm(pipeline, noise, 6.0f, 6.0f, 0.5f, 0.25f, 6.0f, 0.5f, 0.5f) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_add_hill(pipeline, 20.0f, 30.0f, 12.0f, 0.7f) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_add_hill(pipeline, 90.0f, -3.0f, 20.0f, 0.4f) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_dig_hill(pipeline, 50.0f, 40.0f, 8.0f, -0.2f) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_scale(pipeline, 3.0f) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_normalize(pipeline, -1.0f, 1.0f) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_lerp_hm(pipeline, other, 0.1f) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_kernel_transform(pipeline, 3, DX, DY, WEIGHT, -0.5f, 0.5f) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_normalize(pipeline, 0.0f, 1.0f) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_scale_fbm(pipeline, noise, 3.0f, 3.0f, 0.0f, 0.0f, 4.0f, 0.5f, 0.25f) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_call(pipeline, add_gradient, &gradient_scale) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_multiply_hm(pipeline, other) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_add_hm(pipeline, other) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_scale_add_clamp(pipeline, 0.5f, 0.1f, -2.0f, 2.0f) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_add(pipeline, 1.0f) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_clamp(pipeline, 0.0f, 2.5f) == TCOD_E_OK);
+  REQUIRE(TCOD_heightmap_pipeline_normalize(pipeline, 0.0f, 1.0f) == TCOD_E_OK);
+
+  const int max_threads = TCOD_parallel_get_max_threads();
+  for (const int threads : {1, 4}) {
+    TCOD_parallel_set_max_threads(threads);
+    TCOD_heightmap_t* heightmap = TCOD_heightmap_new(width, height);
+    REQUIRE(TCOD_heightmap_pipeline_execute(pipeline, heightmap) == TCOD_E_OK);
+    REQUIRE(heightmap_values(heightmap) == heightmap_values(expected));
+    TCOD_heightmap_delete(heightmap);
+  }
+  TCOD_parallel_set_max_threads(max_threads);
+
+  TCOD_heightmap_t* wrong_size = TCOD_heightmap_new(width, height + 1);
+  REQUIRE(TCOD_heightmap_pipeline_execute(pipeline, wrong_size) == TCOD_E_INVALID_ARGUMENT);
+  REQUIRE(TCOD_heightmap_pipeline_lerp_hm(pipeline, nullptr, 0.5f) == TCOD_E_INVALID_ARGUMENT);
+  REQUIRE(TCOD_heightmap_pipeline_add(nullptr, 1.0f) == TCOD_E_INVALID_ARGUMENT);
+  TCOD_heightmap_delete(wrong_size);
+
+  TCOD_heightmap_pipeline_delete(pipeline);
+  TCOD_heightmap_delete(expected);
+  TCOD_heightmap_delete(other);
+  TCOD_noise_delete(noise);
+  TCOD_random_delete(rng);
+}
+
+TEST_CASE("Heightmap pipeline benchmark", "[.benchmark]") {
+  TCOD_heightmap_t* heightmap = random_heightmap(2048, 2048, 6);
+  TCOD_heightmap_t* other = random_heightmap(2048, 2048, 7);
+  TCOD_HeightmapPipeline* pipeline = TCOD_heightmap_pipeline_new();
+  for (int i = 0; i < 4; ++i) {
+    TCOD_heightmap_pipeline_scale(pipeline, 0.5f);
+    TCOD_heightmap_pipeline_add(pipeline, 0.25f);
+    TCOD_heightmap_pipeline_lerp_hm(pipeline, other, 0.1f);
+    TCOD_heightmap_pipeline_add_hill(pipeline, 1000.0f, 1000.0f, 500.0f, 0.1f);
+    TCOD_heightmap_pipeline_clamp(pipeline, -4.0f, 4.0f);
+    TCOD_heightmap_pipeline_normalize(pipeline, -8.0f, 8.0f);
+  }
+  BENCHMARK("Eager heightmap calls 2048x2048") {
+    for (int i = 0; i < 4; ++i) {
+      TCOD_heightmap_scale(heightmap, 0.5f);
+      TCOD_heightmap_add(heightmap, 0.25f);
+      TCOD_heightmap_lerp_hm(heightmap, other, heightmap, 0.1f);
+      TCOD_heightmap_add_hill(heightmap, 1000.0f, 1000.0f, 500.0f, 0.1f);
+      TCOD_heightmap_clamp(heightmap, -4.0f, 4.0f);
+      TCOD_heightmap_normalize(heightmap, -8.0f, 8.0f);
+    }
+    return heightmap->values[0];
+  };
+  BENCHMARK("TCOD_heightmap_pipeline_execute 2048x2048") {
+    TCOD_heightmap_pipeline_execute(pipeline, heightmap);
+    return heightmap->values[0];
+  };
+  TCOD_heightmap_pipeline_delete(pipeline);
+  TCOD_heightmap_delete(other);
+  TCOD_heightmap_delete(heightmap);
+}
+
+/// A tile generator giving each cell a value from its world position and counting how many tiles it generated.
+static TCOD_Error position_tile(TCOD_heightmap_t* tile, int x, int y, void* userdata) {
+  ++*static_cast<int*>(userdata);
+  for (int local_y = 0; local_y < tile->h; ++local_y) {
+    for (int local_x = 0; local_x < tile->w; ++local_x) {
+      tile->values[local_x + local_y * tile->w] = static_cast<float>((x + local_x) * 1000 + (y + local_y));
+    }
+  }
+  return TCOD_E_OK;
+}
+
+TEST_CASE("Chunked heightmaps") {
+  int generated = 0;
+  TCOD_ChunkedHeightmap* chunked = TCOD_chunked_heightmap_new(16, 8, 4, position_tile, &generated);
+  REQUIRE(chunked);
+  SECTION("Values are read across tile borders and negative coordinates") {
+    for (const int y : {-9, -8, -1, 0, 7, 8, 100}) {
+      for (const int x : {-17, -16, -1, 0, 15, 16, 33}) {
+        REQUIRE(TCOD_chunked_heightmap_get_value(chunked, x, y) == static_cast<float>(x * 1000 + y));
+      }
+    }
+    REQUIRE(TCOD_chunked_heightmap_get_interpolated_value(chunked, 15.5f, -0.25f) == Approx(15500.0f - 0.25f));
+    const TCOD_heightmap_t* tile = TCOD_chunked_heightmap_get_tile(chunked, -1, 2);
+    REQUIRE(tile);
+    REQUIRE(tile->w == 16);
+    REQUIRE(tile->h == 8);
+    REQUIRE(tile->values[0] == static_cast<float>(-16 * 1000 + 16));
+  }
+  SECTION("Only the least recently used tiles are regenerated") {
+    for (int tile = 0; tile < 4; ++tile) (void)TCOD_chunked_heightmap_get_value(chunked, tile * 16, 0);
+    REQUIRE(generated == 4);
+    (void)TCOD_chunked_heightmap_get_value(chunked, 0, 0);  // Tile 0 is now the most recently used.
+    (void)TCOD_chunked_heightmap_get_value(chunked, 64, 0);  // Discards tile 1.
+    REQUIRE(generated == 5);
+    (void)TCOD_chunked_heightmap_get_value(chunked, 0, 0);
+    (void)TCOD_chunked_heightmap_get_value(chunked, 32, 0);
+    (void)TCOD_chunked_heightmap_get_value(chunked, 48, 0);
+    REQUIRE(generated == 5);
+    REQUIRE(TCOD_chunked_heightmap_get_value(chunked, 16, 0) == 16000.0f);
+    REQUIRE(generated == 6);
+    for (int i = 0; i < 1000; ++i) {
+      const int x = (i * 37) % 200 - 100;
+      const int y = (i * 11) % 50 - 25;
+      REQUIRE(TCOD_chunked_heightmap_get_value(chunked, x, y) == static_cast<float>(x * 1000 + y));
+    }
+  }
+  SECTION("Areas larger than the cache can be read") {
+    TCOD_heightmap_t* area = TCOD_heightmap_new(70, 30);
+    REQUIRE(TCOD_chunked_heightmap_read(chunked, -21, -13, area) == TCOD_E_OK);
+    for (int y = 0; y < area->h; ++y) {
+      for (int x = 0; x < area->w; ++x) {
+        REQUIRE(area->values[x + y * area->w] == static_cast<float>((x - 21) * 1000 + (y - 13)));
+      }
+    }
+    TCOD_heightmap_delete(area);
+    REQUIRE(TCOD_chunked_heightmap_prefetch(chunked, 0, 0, 32, 16) == TCOD_E_OK);
+    const int before = generated;
+    (void)TCOD_chunked_heightmap_get_value(chunked, 31, 15);
+    REQUIRE(generated == before);
+  }
+  TCOD_chunked_heightmap_delete(chunked);
+}
+
+TEST_CASE("Chunked heightmaps generated by a pipeline are seamless") {
+  TCOD_HeightmapPipeline* pipeline = TCOD_heightmap_pipeline_new();
+  TCOD_heightmap_pipeline_add(pipeline, 0.5f);
+  TCOD_heightmap_pipeline_add_hill(pipeline, 20.0f, 10.0f, 15.0f, 1.0f);
+  TCOD_heightmap_pipeline_dig_hill(pipeline, 40.0f, 25.0f, 9.0f, -0.5f);
+  TCOD_heightmap_pipeline_clamp(pipeline, 0.0f, 1.2f);
+  TCOD_heightmap_t* expected = TCOD_heightmap_new(64, 40);
+  REQUIRE(TCOD_heightmap_pipeline_execute(pipeline, expected) == TCOD_E_OK);
+  TCOD_ChunkedHeightmap* chunked = TCOD_chunked_heightmap_new_pipeline(13, 7, 3, pipeline);
+  TCOD_heightmap_t* area = TCOD_heightmap_new(64, 40);
+  REQUIRE(TCOD_chunked_heightmap_read(chunked, 0, 0, area) == TCOD_E_OK);
+  REQUIRE(heightmap_values(area) == heightmap_values(expected));
+  TCOD_heightmap_delete(area);
+  TCOD_heightmap_delete(expected);
+  TCOD_chunked_heightmap_delete(chunked);
+  TCOD_heightmap_pipeline_delete(pipeline);
+}
+
+TEST_CASE("Pipeline fBm is seamless for any noise dimension") {
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  for (const int ndim : {1, 2, 3}) {
+    INFO("ndim: " << ndim);
+    TCOD_Noise* noise = TCOD_noise_new(ndim, TCOD_NOISE_DEFAULT_HURST, TCOD_NOISE_DEFAULT_LACUNARITY, rng);
+    TCOD_HeightmapPipeline* pipeline = TCOD_heightmap_pipeline_new();
+    TCOD_heightmap_pipeline_add_fbm(pipeline, noise, 4.0f, 4.0f, 0.5f, 0.25f, 4.0f, 0.5f, 0.5f);
+    TCOD_heightmap_pipeline_add(pipeline, 1.0f);
+    TCOD_heightmap_pipeline_scale_fbm(pipeline, noise, 2.0f, 3.0f, 0.0f, 0.0f, 3.0f, 1.0f, 0.5f);
+    TCOD_heightmap_t* left = TCOD_heightmap_new(16, 12);
+    TCOD_heightmap_t* right = TCOD_heightmap_new(16, 12);
+    REQUIRE(TCOD_heightmap_pipeline_execute_at(pipeline, left, 0, 0) == TCOD_E_OK);
+    REQUIRE(TCOD_heightmap_pipeline_execute_at(pipeline, right, 8, 4) == TCOD_E_OK);
+    for (int y = 4; y < 12; ++y) {
+      for (int x = 8; x < 16; ++x) {
+        REQUIRE(right->values[(x - 8) + (y - 4) * 16] == left->values[x + y * 16]);
+      }
+    }
+    TCOD_heightmap_t* expected = TCOD_heightmap_new(16, 12);
+    TCOD_heightmap_add_fbm(expected, noise, 4.0f, 4.0f, 0.5f, 0.25f, 4.0f, 0.5f, 0.5f);
+    TCOD_heightmap_add(expected, 1.0f);
+    TCOD_heightmap_scale_fbm(expected, noise, 2.0f, 3.0f, 0.0f, 0.0f, 3.0f, 1.0f, 0.5f);
+    for (int i = 0; i < 16 * 12; ++i) REQUIRE(left->values[i] == Approx(expected->values[i]).margin(1e-5));
+    TCOD_heightmap_delete(expected);
+    TCOD_heightmap_delete(right);
+    TCOD_heightmap_delete(left);
+    TCOD_heightmap_pipeline_delete(pipeline);
+    TCOD_noise_delete(noise);
+  }
+  TCOD_random_delete(rng);
+}
+
+TEST_CASE("Compact heightmaps") {
+  SECTION("Half floats round to the nearest value") {
+    TCOD_HeightmapCompact* compact = TCOD_heightmap_compact_new(8, 1, TCOD_HEIGHTMAP_FORMAT_HALF, 0, 0);
+    REQUIRE(compact);
+    const float values[8] = {0.0f, 1.0f, -2.5f, 65504.0f, 1.0f / 16777216.0f, 70000.0f, 1.0f + 1.0f / 4096.0f, 0.1f};
+    for (int x = 0; x < 8; ++x) TCOD_heightmap_compact_set_value(compact, x, 0, values[x]);
+    REQUIRE(TCOD_heightmap_compact_get_value(compact, 0, 0) == 0.0f);
+    REQUIRE(TCOD_heightmap_compact_get_value(compact, 1, 0) == 1.0f);
+    REQUIRE(TCOD_heightmap_compact_get_value(compact, 2, 0) == -2.5f);
+    REQUIRE(TCOD_heightmap_compact_get_value(compact, 3, 0) == 65504.0f);
+    REQUIRE(TCOD_heightmap_compact_get_value(compact, 4, 0) == 1.0f / 16777216.0f);
+    REQUIRE(std::isinf(TCOD_heightmap_compact_get_value(compact, 5, 0)));
+    REQUIRE(TCOD_heightmap_compact_get_value(compact, 6, 0) == 1.0f);  // A tie rounds to even.
+    REQUIRE(TCOD_heightmap_compact_get_value(compact, 7, 0) == 0.0999755859375f);
+    TCOD_heightmap_compact_delete(compact);
+  }
+  SECTION("UNORM16 heightmaps widen a single value range") {
+    TCOD_heightmap_t* flat = TCOD_heightmap_new(4, 4);
+    TCOD_heightmap_add(flat, 2.0f);
+    TCOD_HeightmapCompact* compact = TCOD_heightmap_compact_from_heightmap(flat, TCOD_HEIGHTMAP_FORMAT_UNORM16);
+    REQUIRE(compact);
+    REQUIRE(compact->scale == 0);
+    TCOD_heightmap_compact_set_value(compact, 1, 1, 5.0f);
+    REQUIRE(TCOD_heightmap_compact_get_value(compact, 0, 0) == 2.0f);
+    REQUIRE(TCOD_heightmap_compact_get_value(compact, 1, 1) == 5.0f);
+    TCOD_heightmap_compact_set_value(compact, 2, 2, -1.0f);  // Clamped once the range is no longer a single value.
+    REQUIRE(TCOD_heightmap_compact_get_value(compact, 2, 2) == 2.0f);
+
+    TCOD_heightmap_compact_normalize(compact, 0.0f, 0.0f);
+    TCOD_heightmap_compact_clamp(compact, 1.0f, 3.0f);
+    REQUIRE(TCOD_heightmap_compact_get_value(compact, 3, 3) == 1.0f);
+    TCOD_heightmap_compact_set_value(compact, 3, 3, -4.0f);
+    REQUIRE(TCOD_heightmap_compact_get_value(compact, 0, 0) == 1.0f);
+    REQUIRE(TCOD_heightmap_compact_get_value(compact, 3, 3) == -4.0f);
+
+    TCOD_heightmap_compact_scale(compact, 0.0f);
+    TCOD_heightmap_set_value(flat, 0, 0, 7.0f);
+    REQUIRE(TCOD_heightmap_compact_store(compact, flat) == TCOD_E_OK);
+    REQUIRE(TCOD_heightmap_compact_get_value(compact, 0, 0) == 7.0f);
+    REQUIRE(TCOD_heightmap_compact_get_value(compact, 1, 0) == 2.0f);
+    TCOD_heightmap_compact_delete(compact);
+    TCOD_heightmap_delete(flat);
+  }
+  TCOD_heightmap_t* heightmap = hilly_heightmap(67, 45);
+  TCOD_heightmap_normalize(heightmap, -3.0f, 5.0f);
+  TCOD_heightmap_t* decoded = TCOD_heightmap_new(67, 45);
+  for (const TCOD_HeightmapFormat format : {TCOD_HEIGHTMAP_FORMAT_HALF, TCOD_HEIGHTMAP_FORMAT_UNORM16}) {
+    const float tolerance = format == TCOD_HEIGHTMAP_FORMAT_HALF ? 5.0f / 2048.0f : 8.0f / 65535.0f;
+    TCOD_HeightmapCompact* compact = TCOD_heightmap_compact_from_heightmap(heightmap, format);
+    REQUIRE(compact);
+    REQUIRE(TCOD_heightmap_compact_to_heightmap(compact, decoded) == TCOD_E_OK);
+    for (int i = 0; i < 67 * 45; ++i) REQUIRE(decoded->values[i] == Approx(heightmap->values[i]).margin(tolerance));
+    REQUIRE(TCOD_heightmap_compact_get_interpolated_value(compact, 10.5f, 20.25f) ==
+            Approx(TCOD_heightmap_get_interpolated_value(heightmap, 10.5f, 20.25f)).margin(tolerance));
+
+    TCOD_heightmap_t* expected = TCOD_heightmap_new(67, 45);
+    TCOD_heightmap_copy(heightmap, expected);
+    TCOD_heightmap_add(expected, 1.0f);
+    TCOD_heightmap_scale(expected, 0.5f);
+    TCOD_heightmap_clamp(expected, -0.5f, 2.5f);
+    TCOD_heightmap_compact_add(compact, 1.0f);
+    TCOD_heightmap_compact_scale(compact, 0.5f);
+    TCOD_heightmap_compact_clamp(compact, -0.5f, 2.5f);
+    float min;
+    float max;
+    TCOD_heightmap_compact_get_minmax(compact, &min, &max);
+    REQUIRE(min == Approx(-0.5f).margin(tolerance));
+    REQUIRE(max == Approx(2.5f).margin(tolerance));
+    REQUIRE(TCOD_heightmap_compact_to_heightmap(compact, decoded) == TCOD_E_OK);
+    for (int i = 0; i < 67 * 45; ++i) REQUIRE(decoded->values[i] == Approx(expected->values[i]).margin(tolerance));
+
+    TCOD_heightmap_compact_normalize(compact, 0.0f, 1.0f);
+    TCOD_heightmap_compact_get_minmax(compact, &min, &max);
+    REQUIRE(min == Approx(0.0f).margin(1e-6));
+    REQUIRE(max == Approx(1.0f).margin(1e-6));
+    TCOD_heightmap_t* wrong_size = TCOD_heightmap_new(3, 3);
+    REQUIRE(TCOD_heightmap_compact_to_heightmap(compact, wrong_size) == TCOD_E_INVALID_ARGUMENT);
+    TCOD_heightmap_delete(wrong_size);
+    TCOD_heightmap_delete(expected);
+    TCOD_heightmap_compact_delete(compact);
+  }
+  TCOD_heightmap_delete(decoded);
+  TCOD_heightmap_delete(heightmap);
+}
+
+/// Fill depressions by lowering a flooded map until nothing changes, the result is the lowest surface which drains.
+static std::vector<float> reference_fill_depressions(const TCOD_heightmap_t* heightmap) {
+  const int width = heightmap->w;
+  const int height = heightmap->h;
+  std::vector<float> water(width * height, INFINITY);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      const bool border = x == 0 || y == 0 || x == width - 1 || y == height - 1;
+      if (border) water[x + y * width] = heightmap->values[x + y * width];
+    }
+  }
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (int y = 1; y < height - 1; ++y) {
+      for (int x = 1; x < width - 1; ++x) {
+        float lowest = INFINITY;
+        for (int ny = y - 1; ny <= y + 1; ++ny) {
+          for (int nx = x - 1; nx <= x + 1; ++nx) lowest = std::min(lowest, water[nx + ny * width]);
+        }
+        const float level = std::max(heightmap->values[x + y * width], lowest);
+        if (level < water[x + y * width]) {
+          water[x + y * width] = level;
+          changed = true;
+        }
+      }
+    }
+  }
+  return water;
+}
+
+/// Return the cell reached by following the flow directions from `index` until an outlet.
+static int follow_flow(int width, const std::vector<int8_t>& directions, int index) {
+  static const int dx[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+  static const int dy[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+  while (directions[index] != TCOD_HEIGHTMAP_FLOW_NONE) {
+    index += dx[directions[index]] + dy[directions[index]] * width;
+  }
+  return index;
+}
+
+TEST_CASE("Heightmap hydrology") {
+  SECTION("A bowl fills up to its rim") {
+    TCOD_heightmap_t* heightmap = TCOD_heightmap_new(5, 5);
+    for (int i = 0; i < 25; ++i) heightmap->values[i] = 2.0f;
+    heightmap->values[2] = 1.5f;  // The spill point.
+    for (int y = 1; y < 4; ++y) {
+      for (int x = 1; x < 4; ++x) heightmap->values[x + y * 5] = 0.0f;
+    }
+    REQUIRE(TCOD_heightmap_fill_depressions(heightmap, 0.0f) == TCOD_E_OK);
+    for (int y = 1; y < 4; ++y) {
+      for (int x = 1; x < 4; ++x) REQUIRE(heightmap->values[x + y * 5] == 1.5f);
+    }
+    REQUIRE(heightmap->values[0] == 2.0f);
+    TCOD_heightmap_delete(heightmap);
+  }
+  SECTION("Large maps with many depressions fill exactly") {
+    TCOD_heightmap_t* heightmap = hilly_heightmap(257, 131);
+    TCOD_heightmap_t* bumps = random_heightmap(257, 131, 3);
+    for (int i = 0; i < 257 * 131; ++i) heightmap->values[i] += bumps->values[i] * 0.002f;
+    const std::vector<float> expected = reference_fill_depressions(heightmap);
+    REQUIRE(TCOD_heightmap_fill_depressions(heightmap, 0.0f) == TCOD_E_OK);
+    REQUIRE(heightmap_values(heightmap) == expected);
+    TCOD_heightmap_delete(bumps);
+    TCOD_heightmap_delete(heightmap);
+  }
+  SECTION("Watersheds of directions with long cycles") {
+    // Every row flows east and its last cell flows back west, except for the first row which drains off the map.
+    const int size = 512;
+    std::vector<int8_t> directions(size * size, 4);
+    for (int y = 1; y < size; ++y) directions[size - 1 + y * size] = 3;
+    directions[5 + size] = 1;  // Drains into the first row.
+    std::vector<int> labels(size * size);
+    REQUIRE(TCOD_heightmap_watersheds(size, size, directions.data(), labels.data()) == 1);
+    for (int x = 0; x < size; ++x) REQUIRE(labels[x] == 0);
+    for (int x = 0; x < size; ++x) REQUIRE(labels[x + size] == (x <= 5 ? 0 : -1));
+    for (int i = size * 2; i < size * size; ++i) REQUIRE(labels[i] == -1);
+  }
+  const int width = 61;
+  const int height = 43;
+  TCOD_heightmap_t* heightmap = random_heightmap(width, height, 8);
+  const std::vector<float> original = heightmap_values(heightmap);
+  const std::vector<float> expected = reference_fill_depressions(heightmap);
+  REQUIRE(TCOD_heightmap_fill_depressions(heightmap, 0.0f) == TCOD_E_OK);
+  REQUIRE(heightmap_values(heightmap) == expected);
+  std::vector<float> raised(original);
+  TCOD_heightmap_t raised_map{width, height, raised.data()};
+  REQUIRE(TCOD_heightmap_fill_depressions(&raised_map, 1e-3f) == TCOD_E_OK);
+  for (int i = 0; i < width * height; ++i) REQUIRE(raised[i] >= expected[i]);
+
+  std::vector<int8_t> directions(width * height);
+  REQUIRE(TCOD_heightmap_flow_directions(&raised_map, directions.data()) == TCOD_E_OK);
+  for (int y = 1; y < height - 1; ++y) {
+    for (int x = 1; x < width - 1; ++x) REQUIRE(directions[x + y * width] != TCOD_HEIGHTMAP_FLOW_NONE);
+  }
+  TCOD_heightmap_t* accumulation = TCOD_heightmap_new(width, height);
+  REQUIRE(TCOD_heightmap_flow_accumulation(directions.data(), NULL, accumulation) == TCOD_E_OK);
+  std::vector<float> expected_accumulation(width * height);
+  for (int i = 0; i < width * height; ++i) {
+    static const int dx[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+    static const int dy[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+    int index = i;
+    ++expected_accumulation[index];
+    while (directions[index] != TCOD_HEIGHTMAP_FLOW_NONE) {
+      index += dx[directions[index]] + dy[directions[index]] * width;
+      ++expected_accumulation[index];
+    }
+  }
+  REQUIRE(heightmap_values(accumulation) == expected_accumulation);
+
+  std::vector<int> labels(width * height);
+  const int watersheds = TCOD_heightmap_watersheds(width, height, directions.data(), labels.data());
+  REQUIRE(watersheds > 0);
+  float drained = 0;
+  for (int i = 0; i < width * height; ++i) {
+    const int outlet = follow_flow(width, directions, i);
+    const int x = outlet % width;
+    const int y = outlet / width;
+    REQUIRE((x == 0 || y == 0 || x == width - 1 || y == height - 1));
+    REQUIRE(labels[i] == labels[outlet]);
+    if (outlet == i) drained += accumulation->values[i];
+  }
+  REQUIRE(drained == static_cast<float>(width * height));
+  REQUIRE(TCOD_heightmap_watersheds(width, height, NULL, labels.data()) == TCOD_E_INVALID_ARGUMENT);
+  REQUIRE(TCOD_heightmap_fill_depressions(NULL, 0.0f) == TCOD_E_INVALID_ARGUMENT);
+  TCOD_heightmap_delete(accumulation);
+  TCOD_heightmap_delete(heightmap);
+}
+
+TEST_CASE("Heightmap hydrology benchmark", "[.benchmark]") {
+  TCOD_heightmap_t* heightmap = hilly_heightmap(4096, 4096);
+  TCOD_heightmap_t* filled = TCOD_heightmap_new(4096, 4096);
+  TCOD_heightmap_t* accumulation = TCOD_heightmap_new(4096, 4096);
+  std::vector<int8_t> directions(4096 * 4096);
+  std::vector<int> labels(4096 * 4096);
+  BENCHMARK("TCOD_heightmap_fill_depressions 4096x4096") {
+    TCOD_heightmap_copy(heightmap, filled);
+    return TCOD_heightmap_fill_depressions(filled, 1e-5f);
+  };
+  BENCHMARK("TCOD_heightmap_flow_directions 4096x4096") {
+    return TCOD_heightmap_flow_directions(filled, directions.data());
+  };
+  BENCHMARK("TCOD_heightmap_flow_accumulation 4096x4096") {
+    return TCOD_heightmap_flow_accumulation(directions.data(), NULL, accumulation);
+  };
+  BENCHMARK("TCOD_heightmap_watersheds 4096x4096") {
+    return TCOD_heightmap_watersheds(4096, 4096, directions.data(), labels.data());
+  };
+  TCOD_heightmap_delete(accumulation);
+  TCOD_heightmap_delete(filled);
+  TCOD_heightmap_delete(heightmap);
+}
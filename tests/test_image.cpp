@@ -1,6 +1,16 @@
+#include <array>
 #include <catch2/catch_all.hpp>
+#include <cmath>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
 
+#include "libtcod/console_etc.h"
+#include "libtcod/console_types.h"
 #include "libtcod/image.hpp"
+#include "libtcod/mersenne.h"
+#include "libtcod/parallel.h"
 
 TEST_CASE("TCODImage") {
   auto img = TCODImage{};
@@ -19,3 +29,505 @@ TEST_CASE("TCODImage") {
     REQUIRE(img.getSize() == std::array{w, h});
   }
 }
+
+/// The per-cell column-major TCOD_image_blit loop, kept as a reference for the row-major implementation.
+static void reference_image_blit(
+    TCOD_Image* image,
+    TCOD_Console* console,
+    float x,
+    float y,
+    TCOD_bkgnd_flag_t bkgnd_flag,
+    float scale_x,
+    float scale_y,
+    float angle) {
+  int width, height;
+  TCOD_image_get_size(image, &width, &height);
+  const auto is_key = [&](TCOD_ColorRGB col) {
+    return image->has_key_color && image->key_color.r == col.r && image->key_color.g == col.g &&
+           image->key_color.b == col.b;
+  };
+  const float rx_ = x - width * 0.5f;
+  const float ry_ = y - height * 0.5f;
+  if (scale_x == 1.0f && scale_y == 1.0f && angle == 0.0f && rx_ == (int)rx_ && ry_ == (int)ry_) {
+    const int ix = (int)rx_;
+    const int iy = (int)ry_;
+    for (int cx = std::max(ix, 0); cx < std::min(ix + width, console->w); ++cx) {
+      for (int cy = std::max(iy, 0); cy < std::min(iy + height, console->h); ++cy) {
+        const TCOD_ColorRGB col = TCOD_image_get_pixel(image, cx - ix, cy - iy);
+        if (!is_key(col)) TCOD_console_set_char_background(console, cx, cy, col, bkgnd_flag);
+      }
+    }
+    return;
+  }
+  const float iw = width / 2 * scale_x;
+  const float ih = height / 2 * scale_y;
+  const float new_xx = cosf(angle);
+  const float new_xy = -sinf(angle);
+  const float new_yx = new_xy;
+  const float new_yy = -new_xx;
+  const int xs[4] = {
+      (int)(x - iw * new_xx + ih * new_yx),
+      (int)(x + iw * new_xx + ih * new_yx),
+      (int)(x + iw * new_xx - ih * new_yx),
+      (int)(x - iw * new_xx - ih * new_yx)};
+  const int ys[4] = {
+      (int)(y - iw * new_xy + ih * new_yy),
+      (int)(y + iw * new_xy + ih * new_yy),
+      (int)(y + iw * new_xy - ih * new_yy),
+      (int)(y - iw * new_xy - ih * new_yy)};
+  const int min_x = std::max(*std::min_element(xs, xs + 4), 0);
+  const int min_y = std::max(*std::min_element(ys, ys + 4), 0);
+  const int max_x = std::min(*std::max_element(xs, xs + 4), console->w);
+  const int max_y = std::min(*std::max_element(ys, ys + 4), console->h);
+  for (int cx = min_x; cx < max_x; ++cx) {
+    for (int cy = min_y; cy < max_y; ++cy) {
+      const float ix = (iw + (cx - x) * new_xx + (cy - y) * (-new_yx)) * (1.0f / scale_x);
+      const float iy = (ih + (cx - x) * new_xy - (cy - y) * new_yy) * (1.0f / scale_y);
+      TCOD_ColorRGB col = TCOD_image_get_pixel(image, (int)ix, (int)iy);
+      if (is_key(col)) continue;
+      if (scale_x < 1.0f || scale_y < 1.0f) col = TCOD_image_get_mipmap_pixel(image, ix, iy, ix + 1.0f, iy + 1.0f);
+      TCOD_console_set_char_background(console, cx, cy, col, bkgnd_flag);
+    }
+  }
+}
+
+/// Fill a console with random backgrounds, some of them translucent.
+static void randomize_console(TCOD_Console* console, TCOD_Random* rng) {
+  for (int i = 0; i < console->elements; ++i) {
+    auto& bg = console->tiles[i].bg;
+    bg.r = static_cast<uint8_t>(TCOD_random_get_int(rng, 0, 255));
+    bg.g = static_cast<uint8_t>(TCOD_random_get_int(rng, 0, 255));
+    bg.b = static_cast<uint8_t>(TCOD_random_get_int(rng, 0, 255));
+    bg.a = static_cast<uint8_t>(TCOD_random_get_int(rng, 0, 3) ? 255 : TCOD_random_get_int(rng, 0, 255));
+  }
+}
+
+/// Fill an image with a small palette so that the key color occurs often.
+static void randomize_image(TCOD_Image* image, TCOD_Random* rng) {
+  for (int i = 0; i < image->mipmaps[0].width * image->mipmaps[0].height; ++i) {
+    image->mipmaps[0].buf[i] = {
+        static_cast<uint8_t>(TCOD_random_get_int(rng, 0, 3) * 85),
+        static_cast<uint8_t>(TCOD_random_get_int(rng, 0, 255)),
+        static_cast<uint8_t>(TCOD_random_get_int(rng, 0, 1) * 255)};
+  }
+}
+
+TEST_CASE("Image blit matches the per-cell reference") {
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  TCOD_Image* image = TCOD_image_new(37, 23);
+  randomize_image(image, rng);
+  const TCOD_bkgnd_flag_t flags[] = {
+      TCOD_BKGND_SET,
+      TCOD_BKGND_MULTIPLY,
+      TCOD_BKGND_LIGHTEN,
+      TCOD_BKGND_DARKEN,
+      TCOD_BKGND_SCREEN,
+      TCOD_BKGND_COLOR_DODGE,
+      TCOD_BKGND_COLOR_BURN,
+      TCOD_BKGND_ADD,
+      TCOD_BKGND_ADDALPHA(0.5f),
+      TCOD_BKGND_BURN,
+      TCOD_BKGND_OVERLAY,
+      TCOD_BKGND_ALPHA(0.3f),
+      TCOD_BKGND_DEFAULT,
+  };
+  // x, y, scale_x, scale_y, angle
+  const std::tuple<float, float, float, float, float> placements[] = {
+      {20.5f, 11.5f, 1.0f, 1.0f, 0.0f},
+      {3.5f, -4.5f, 1.0f, 1.0f, 0.0f},
+      {60.5f, 30.5f, 1.0f, 1.0f, 0.0f},
+      {20.0f, 12.0f, 1.0f, 1.0f, 0.0f},
+      {20.0f, 12.0f, 2.0f, 1.5f, 0.0f},
+      {20.0f, 12.0f, 0.5f, 0.25f, 0.0f},
+      {15.3f, 9.7f, 1.0f, 1.0f, 0.7f},
+      {25.0f, 14.0f, 1.75f, 0.6f, -2.3f},
+      {-3.0f, 2.0f, 3.0f, 3.0f, 1.1f},
+  };
+  for (const bool key : {false, true}) {
+    image->has_key_color = key;
+    image->key_color = {85, 0, 255};
+    for (const auto& [x, y, scale_x, scale_y, angle] : placements) {
+      for (const auto flag : flags) {
+        tcod::Console expected{53, 29};
+        randomize_console(expected.get(), rng);
+        tcod::Console actual{expected};
+        expected.get()->bkgnd_flag = actual.get()->bkgnd_flag = TCOD_BKGND_MULTIPLY;
+        reference_image_blit(image, expected.get(), x, y, flag, scale_x, scale_y, angle);
+        TCOD_image_blit(image, actual.get(), x, y, flag, scale_x, scale_y, angle);
+        for (int i = 0; i < expected.get()->elements; ++i) {
+          INFO("key=" << key << " x=" << x << " y=" << y << " scale=" << scale_x << "," << scale_y
+                      << " angle=" << angle << " flag=" << flag << " cell=" << i);
+          REQUIRE(actual.get()->tiles[i] == expected.get()->tiles[i]);
+        }
+      }
+    }
+  }
+  TCOD_image_delete(image);
+  TCOD_random_delete(rng);
+}
+
+TEST_CASE("Image blit benchmark", "[.benchmark]") {
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  TCOD_Image* image = TCOD_image_new(256, 256);
+  randomize_image(image, rng);
+  tcod::Console console{256, 256};
+  BENCHMARK("TCOD_image_blit 256x256 SET") {
+    TCOD_image_blit(image, console.get(), 128, 128, TCOD_BKGND_SET, 1.0f, 1.0f, 0.0f);
+  };
+  BENCHMARK("TCOD_image_blit 256x256 MULTIPLY") {
+    TCOD_image_blit(image, console.get(), 128, 128, TCOD_BKGND_MULTIPLY, 1.0f, 1.0f, 0.0f);
+  };
+  BENCHMARK("TCOD_image_blit 256x256 rotated") {
+    TCOD_image_blit(image, console.get(), 128, 128, TCOD_BKGND_SET, 1.5f, 1.5f, 0.5f);
+  };
+  BENCHMARK("TCOD_image_blit 256x256 downscaled") {
+    TCOD_image_blit(image, console.get(), 128, 128, TCOD_BKGND_SET, 0.5f, 0.5f, 0.0f);
+  };
+  BENCHMARK("reference_image_blit 256x256 SET") {
+    reference_image_blit(image, console.get(), 128, 128, TCOD_BKGND_SET, 1.0f, 1.0f, 0.0f);
+  };
+  BENCHMARK("reference_image_blit 256x256 rotated") {
+    reference_image_blit(image, console.get(), 128, 128, TCOD_BKGND_SET, 1.5f, 1.5f, 0.5f);
+  };
+  TCOD_image_delete(image);
+  TCOD_random_delete(rng);
+}
+
+static int reference_rgb_squared_distance(const TCOD_ColorRGB* c1, const TCOD_ColorRGB* c2) {
+  const int dr = (int)c1->r - c2->r;
+  const int dg = (int)c1->g - c2->g;
+  const int db = (int)c1->b - c2->b;
+  return dr * dr + dg * dg + db * db;
+}
+
+/// The previous per-cell quadrant selection of TCOD_image_blit_2x, kept as a reference.
+static TCOD_ConsoleTile reference_quadrant_graphic(const TCOD_ColorRGB desired[4]) {
+  // adapted from Jeff Lait's code posted on r.g.r.d
+  /*
+    A quadrant bitmask.  A raised bit means the quadrant is part of the foreground.
+    Quadrants are arranged with the following bits:
+      X 1
+      2 4
+   */
+  int quadrant_mask = 0;
+  // Maps a mask of quadrants to a codepoint.  A negative codepoint means to swap the fg/bg values.
+  static const int quadrant_to_codepoint[8] = {
+      0,
+      0x259D,  // Quadrant upper right.
+      0x2597,  // Quadrant lower left.
+      -0x259A,  // Quadrant upper left and lower right.
+      0x2596,  // Quadrant lower right.
+      0x2590,  // Right half block.
+      -0x2580,  // Upper half block.
+      -0x2598  // Quadrant upper left.
+  };
+  int quadrant_index;  // The active color quadrant being checked.
+  // Ignore all quadrants matching the first color.
+  for (quadrant_index = 1; quadrant_index < 4; ++quadrant_index) {
+    if (!TCOD_color_equals(desired[quadrant_index], desired[0])) {
+      break;  // Found a second color, will continue to check for colors from this index.
+    }
+  }
+  if (quadrant_index == 4) {  // This tile is a solid color.
+    return TCOD_ConsoleTile{
+        ' ',
+        {desired[0].r, desired[0].g, desired[0].b, 255},
+        {desired[0].r, desired[0].g, desired[0].b, 255},
+    };
+  }
+  TCOD_ColorRGB palette[2] = {desired[0], desired[quadrant_index]};  // The current color palette: {bg color, fg color}.
+  int weight[2] = {quadrant_index, 1};  // Number of quadrants that each pallette color is assigned, respectively.
+  quadrant_mask |= 1 << (quadrant_index - 1);
+  /* remaining colours */
+  ++quadrant_index;
+  while (quadrant_index < 4) {
+    if (TCOD_color_equals(desired[quadrant_index], palette[0])) {
+      // Assign to the background color.
+      ++weight[0];
+    } else if (TCOD_color_equals(desired[quadrant_index], palette[1])) {
+      // Assign to the foreground color.
+      quadrant_mask |= 1 << (quadrant_index - 1);
+      ++weight[1];
+    } else {
+      // No more than two colors can be supported, so merge colors based on the smallest differences.
+      const int dist_0_q = reference_rgb_squared_distance(&desired[quadrant_index], &palette[0]);
+      const int dist_1_q = reference_rgb_squared_distance(&desired[quadrant_index], &palette[1]);
+      const int dist_0_1 = reference_rgb_squared_distance(&palette[0], &palette[1]);
+      if (dist_0_q < dist_1_q) {
+        if (dist_0_q <= dist_0_1) {
+          // Merge 0 and quadrant_index.
+          palette[0] = TCOD_color_lerp(desired[quadrant_index], palette[0], weight[0] / (1.0f + weight[0]));
+          ++weight[0];
+        } else {
+          // Merge 0 and 1.
+          palette[0] = TCOD_color_lerp(palette[0], palette[1], (float)weight[1] / (weight[0] + weight[1]));
+          ++weight[0];
+          palette[1] = desired[quadrant_index];
+          quadrant_mask = 1 << (quadrant_index - 1);
+        }
+      } else {
+        if (dist_1_q <= dist_0_1) {
+          // Merge 1 and quadrant_index.
+          palette[1] = TCOD_color_lerp(desired[quadrant_index], palette[1], weight[1] / (1.0f + weight[1]));
+          ++weight[1];
+          quadrant_mask |= 1 << (quadrant_index - 1);
+        } else {
+          // Merge 0 and 1.
+          palette[0] = TCOD_color_lerp(palette[0], palette[1], (float)weight[1] / (weight[0] + weight[1]));
+          ++weight[0];
+          palette[1] = desired[quadrant_index];
+          quadrant_mask = 1 << (quadrant_index - 1);
+        }
+      }
+    }
+    ++quadrant_index;
+  }
+  if (quadrant_to_codepoint[quadrant_mask] >= 0) {
+    return TCOD_ConsoleTile{
+        quadrant_to_codepoint[quadrant_mask],
+        TCOD_ColorRGBA{palette[1].r, palette[1].g, palette[1].b, 255},
+        TCOD_ColorRGBA{palette[0].r, palette[0].g, palette[0].b, 255},
+    };
+  } else {  // A negative codepoint means we invert the bg/fg colors.
+    return TCOD_ConsoleTile{
+        -quadrant_to_codepoint[quadrant_mask],
+        TCOD_ColorRGBA{palette[0].r, palette[0].g, palette[0].b, 255},
+        TCOD_ColorRGBA{palette[1].r, palette[1].g, palette[1].b, 255},
+    };
+  }
+}
+
+/// The previous column-major TCOD_image_blit_2x loop.
+static void reference_image_blit_2x(
+    const TCOD_Image* image,
+    TCOD_Console* console,
+    int dest_x,
+    int dest_y,
+    int src_x,
+    int src_y,
+    int src_width,
+    int src_height) {
+  int img_width, img_height;
+  TCOD_image_get_size(image, &img_width, &img_height);
+  if (src_width == -1) src_width = img_width;
+  if (src_height == -1) src_height = img_height;
+
+  if (!(src_width > 0 && src_height > 0)) return;
+
+  int max_x = dest_x + src_width / 2 <= console->w ? src_width : (console->w - dest_x) * 2;
+  int max_y = dest_y + src_height / 2 <= console->h ? src_height : (console->h - dest_y) * 2;
+  /* check that the image is not blitted outside the console */
+  if (!(dest_x + max_x / 2 >= 0 && dest_y + max_y / 2 >= 0 && dest_x < console->w && dest_y < console->h)) {
+    return;
+  }
+  max_x += src_x;
+  max_y += src_y;
+
+  for (int img_x = src_x; img_x < max_x; img_x += 2) {
+    for (int img_y = src_y; img_y < max_y; img_y += 2) {
+      TCOD_ColorRGB grid[4];
+      /* get the 2x2 super pixel colors from the image */
+      const int console_x = dest_x + (img_x - src_x) / 2;
+      const int console_y = dest_y + (img_y - src_y) / 2;
+      TCOD_ColorRGB consoleBack = TCOD_console_get_char_background(console, console_x, console_y);
+      grid[0] = TCOD_image_get_pixel(image, img_x, img_y);
+      if (image->has_key_color && TCOD_color_equals(grid[0], image->key_color)) {
+        grid[0] = consoleBack;
+      }
+      if (img_x < max_x - 1) {
+        grid[1] = TCOD_image_get_pixel(image, img_x + 1, img_y);
+        if (image->has_key_color && TCOD_color_equals(grid[1], image->key_color)) {
+          grid[1] = consoleBack;
+        }
+      } else {
+        grid[1] = consoleBack;
+      }
+      if (img_y < max_y - 1) {
+        grid[2] = TCOD_image_get_pixel(image, img_x, img_y + 1);
+        if (image->has_key_color && TCOD_color_equals(grid[2], image->key_color)) {
+          grid[2] = consoleBack;
+        }
+      } else {
+        grid[2] = consoleBack;
+      }
+      if (img_x < max_x - 1 && img_y < max_y - 1) {
+        grid[3] = TCOD_image_get_pixel(image, img_x + 1, img_y + 1);
+        if (image->has_key_color && TCOD_color_equals(grid[3], image->key_color)) {
+          grid[3] = consoleBack;
+        }
+      } else {
+        grid[3] = consoleBack;
+      }
+      /* analyze color, posterize, get pattern */
+      console->tiles[console_y * console->w + console_x] = reference_quadrant_graphic(grid);
+    }
+  }
+}
+
+/// Fill an image with 2x2 blocks of one, two, or several colors, as in rendered maps.
+static void randomize_image_blocks(TCOD_Image* image, TCOD_Random* rng) {
+  randomize_image(image, rng);
+  const int width = image->mipmaps[0].width;
+  for (int y = 0; y + 1 < image->mipmaps[0].height; y += 2) {
+    for (int x = 0; x + 1 < width; x += 2) {
+      TCOD_ColorRGB* block[4] = {
+          &image->mipmaps[0].buf[y * width + x],
+          &image->mipmaps[0].buf[y * width + x + 1],
+          &image->mipmaps[0].buf[(y + 1) * width + x],
+          &image->mipmaps[0].buf[(y + 1) * width + x + 1]};
+      const int colors = TCOD_random_get_int(rng, 1, 4);
+      for (int i = colors; i < 4; ++i) *block[i] = *block[TCOD_random_get_int(rng, 0, colors - 1)];
+    }
+  }
+}
+
+TEST_CASE("Image blit 2x matches the per-cell reference") {
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  for (const auto& [width, height] : {std::pair{64, 48}, std::pair{37, 23}, std::pair{1, 1}, std::pair{2, 9}}) {
+    TCOD_Image* image = TCOD_image_new(width, height);
+    for (const bool blocks : {false, true}) {
+      if (blocks) {
+        randomize_image_blocks(image, rng);
+      } else {
+        randomize_image(image, rng);
+      }
+      for (const bool key : {false, true}) {
+        image->has_key_color = key;
+        image->key_color = {85, 0, 255};
+        TCOD_parallel_set_max_threads(key ? 4 : 1);
+        // dest_x, dest_y, src_x, src_y, src_w, src_h
+        const std::array<int, 6> rects[] = {
+            {0, 0, 0, 0, -1, -1},
+            {3, 5, 0, 0, -1, -1},
+            {20, 10, 1, 1, width - 1, height - 1},
+            {0, 0, width / 3, height / 4, width - width / 3, height / 2},
+        };
+        for (const auto& [dest_x, dest_y, src_x, src_y, src_w, src_h] : rects) {
+          if ((src_w != -1 && src_w <= 0) || (src_h != -1 && src_h <= 0)) continue;
+          tcod::Console expected{40, 30};
+          randomize_console(expected.get(), rng);
+          tcod::Console actual{expected};
+          reference_image_blit_2x(image, expected.get(), dest_x, dest_y, src_x, src_y, src_w, src_h);
+          TCOD_image_blit_2x(image, actual.get(), dest_x, dest_y, src_x, src_y, src_w, src_h);
+          for (int i = 0; i < expected.get()->elements; ++i) {
+            INFO("size=" << width << "x" << height << " blocks=" << blocks << " key=" << key << " dest=" << dest_x
+                         << "," << dest_y << " cell=" << i);
+            REQUIRE(actual.get()->tiles[i] == expected.get()->tiles[i]);
+          }
+        }
+      }
+    }
+    TCOD_image_delete(image);
+  }
+  TCOD_parallel_set_max_threads(0);
+  TCOD_random_delete(rng);
+}
+
+TEST_CASE("Image blit 2x benchmark", "[.benchmark]") {
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  TCOD_Image* noise = TCOD_image_new(512, 512);
+  TCOD_Image* blocks = TCOD_image_new(512, 512);
+  randomize_image(noise, rng);
+  randomize_image_blocks(blocks, rng);
+  tcod::Console console{256, 256};
+  BENCHMARK("TCOD_image_blit_2x 512x512 noise") { TCOD_image_blit_2x(noise, console.get(), 0, 0, 0, 0, -1, -1); };
+  BENCHMARK("TCOD_image_blit_2x 512x512 blocks") { TCOD_image_blit_2x(blocks, console.get(), 0, 0, 0, 0, -1, -1); };
+  BENCHMARK("reference_image_blit_2x 512x512 noise") {
+    reference_image_blit_2x(noise, console.get(), 0, 0, 0, 0, -1, -1);
+  };
+  BENCHMARK("reference_image_blit_2x 512x512 blocks") {
+    reference_image_blit_2x(blocks, console.get(), 0, 0, 0, 0, -1, -1);
+  };
+  TCOD_image_delete(noise);
+  TCOD_image_delete(blocks);
+  TCOD_random_delete(rng);
+}
+
+/// Return mipmap level `mip` of `image` averaged directly from its pixels.
+static std::vector<TCOD_ColorRGB> reference_mipmap(const TCOD_Image* image, int mip) {
+  const auto& orig = image->mipmaps[0];
+  const auto& cur = image->mipmaps[mip];
+  std::vector<TCOD_ColorRGB> out(cur.width * cur.height);
+  for (int y = 0; y < cur.height; ++y) {
+    for (int x = 0; x < cur.width; ++x) {
+      int sum[3] = {0, 0, 0};
+      for (int sy = y << mip; sy < (y + 1) << mip; ++sy) {
+        for (int sx = x << mip; sx < (x + 1) << mip; ++sx) {
+          sum[0] += orig.buf[sy * orig.width + sx].r;
+          sum[1] += orig.buf[sy * orig.width + sx].g;
+          sum[2] += orig.buf[sy * orig.width + sx].b;
+        }
+      }
+      const int count = 1 << (mip * 2);
+      out[y * cur.width + x] = {
+          static_cast<uint8_t>(sum[0] / count),
+          static_cast<uint8_t>(sum[1] / count),
+          static_cast<uint8_t>(sum[2] / count)};
+    }
+  }
+  return out;
+}
+
+/// Sample every usable mipmap level of `image` and compare each level with the reference.
+static void check_mipmaps(TCOD_Image* image) {
+  // A texel size of `2 << mip` samples level `mip`, the smallest level is never sampled.
+  for (int mip = 1; mip < image->nb_mipmaps - 1; ++mip) {
+    const float size = static_cast<float>(2 << mip);
+    TCOD_image_get_mipmap_pixel(image, 0, 0, size, size);
+    const auto expected = reference_mipmap(image, mip);
+    const auto& cur = image->mipmaps[mip];
+    REQUIRE(!cur.dirty);
+    for (int i = 0; i < cur.width * cur.height; ++i) {
+      INFO("mip=" << mip << " texel=" << i);
+      REQUIRE(cur.buf[i] == expected[i]);
+    }
+  }
+}
+
+TEST_CASE("Image mipmaps match the box filter") {
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  for (const int threads : {1, 4}) {
+    TCOD_parallel_set_max_threads(threads);
+    for (const auto& [width, height] : {std::pair{64, 64}, std::pair{301, 77}, std::pair{600, 513}}) {
+      TCOD_Image* image = TCOD_image_new(width, height);
+      randomize_image(image, rng);
+      TCOD_image_invert(image);
+      check_mipmaps(image);
+      // Scattered edits only dirty parts of each level.
+      for (int edit = 0; edit < 20; ++edit) {
+        for (int i = 0; i < 5; ++i) {
+          TCOD_image_put_pixel(
+              image,
+              TCOD_random_get_int(rng, 0, width - 1),
+              TCOD_random_get_int(rng, 0, height - 1),
+              {static_cast<uint8_t>(TCOD_random_get_int(rng, 0, 255)), 7, 200});
+        }
+        check_mipmaps(image);
+      }
+      TCOD_image_invert(image);
+      check_mipmaps(image);
+      TCOD_image_delete(image);
+    }
+  }
+  TCOD_parallel_set_max_threads(0);
+  TCOD_random_delete(rng);
+}
+
+TEST_CASE("Image mipmap benchmark", "[.benchmark]") {
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  TCOD_Image* image = TCOD_image_new(1024, 1024);
+  randomize_image(image, rng);
+  BENCHMARK("TCOD_image_get_mipmap_pixel 1024x1024 full rebuild, levels 1-3") {
+    TCOD_image_invert(image);
+    for (int mip = 1; mip <= 3; ++mip) TCOD_image_get_mipmap_pixel(image, 0, 0, 2 << mip, 2 << mip);
+  };
+  BENCHMARK("TCOD_image_get_mipmap_pixel 1024x1024 after 16 edits, levels 1-3") {
+    for (int i = 0; i < 16; ++i) TCOD_image_put_pixel(image, 500 + i, 300 + i, {1, 2, 3});
+    for (int mip = 1; mip <= 3; ++mip) TCOD_image_get_mipmap_pixel(image, 0, 0, 2 << mip, 2 << mip);
+  };
+  BENCHMARK("reference_mipmap 1024x1024 levels 1-3") {
+    for (int mip = 1; mip <= 3; ++mip) reference_mipmap(image, mip);
+  };
+  TCOD_image_delete(image);
+  TCOD_random_delete(rng);
+}
@@ -0,0 +1,500 @@
+#include <libtcod/heightmap.h>
+#include <libtcod/mersenne.h>
+#include <libtcod/noise.h>
+#include <libtcod/noise_texture.h>
+#include <libtcod/parallel.h>
+
+#include <algorithm>
+#include <array>
+#include <catch2/catch_all.hpp>
+#include <cfloat>
+#include <cmath>
+#include <filesystem>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+/// Random coordinates for `count` points, including negative values and exact lattice points.
+std::array<std::vector<float>, 4> random_points(int count) {
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+  std::array<std::vector<float>, 4> points;
+  for (auto& axis : points) {
+    axis.resize(count);
+    for (auto& it : axis) it = dist(rng);
+    for (int i = 0; i < count; i += 7) axis.at(i) = std::floor(axis.at(i));
+  }
+  return points;
+}
+}  // namespace
+
+TEST_CASE("Noise vectorized matches scalar") {
+  constexpr int COUNT = 1003;  // Not a multiple of the SIMD width.
+  auto points = random_points(COUNT);
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  for (int ndim = 1; ndim <= 4; ++ndim) {
+    TCOD_Noise* noise = TCOD_noise_new(ndim, TCOD_NOISE_DEFAULT_HURST, TCOD_NOISE_DEFAULT_LACUNARITY, rng);
+    for (auto type : {TCOD_NOISE_PERLIN, TCOD_NOISE_SIMPLEX, TCOD_NOISE_WAVELET}) {
+      if (type == TCOD_NOISE_WAVELET && ndim > 3) continue;
+      for (float octaves : {0.0f, 4.0f, 3.5f}) {
+        std::vector<float> out(COUNT);
+        if (octaves == 0) {
+          TCOD_noise_get_vectorized(
+              noise,
+              type,
+              COUNT,
+              points[0].data(),
+              points[1].data(),
+              points[2].data(),
+              points[3].data(),
+              out.data());
+        } else {
+          TCOD_noise_get_fbm_vectorized(
+              noise,
+              type,
+              octaves,
+              COUNT,
+              points[0].data(),
+              points[1].data(),
+              points[2].data(),
+              points[3].data(),
+              out.data());
+        }
+        std::vector<float> turbulence(COUNT);
+        TCOD_noise_get_turbulence_vectorized(
+            noise,
+            type,
+            octaves ? octaves : 2.0f,
+            COUNT,
+            points[0].data(),
+            points[1].data(),
+            points[2].data(),
+            points[3].data(),
+            turbulence.data());
+        for (int i = 0; i < COUNT; ++i) {
+          const float point[4] = {points[0].at(i), points[1].at(i), points[2].at(i), points[3].at(i)};
+          const float expected =
+              octaves == 0 ? TCOD_noise_get_ex(noise, point, type) : TCOD_noise_get_fbm_ex(noise, point, octaves, type);
+          INFO("ndim=" << ndim << " type=" << type << " octaves=" << octaves << " i=" << i);
+          REQUIRE(out.at(i) == Catch::Approx(expected).margin(1e-5));
+          const float expected_turbulence = TCOD_noise_get_turbulence_ex(noise, point, octaves ? octaves : 2.0f, type);
+          REQUIRE(turbulence.at(i) == Catch::Approx(expected_turbulence).margin(1e-5));
+        }
+      }
+    }
+    TCOD_noise_delete(noise);
+  }
+  TCOD_random_delete(rng);
+}
+
+TEST_CASE("Noise fill grid") {
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  TCOD_Noise* noise = TCOD_noise_new(3, TCOD_NOISE_DEFAULT_HURST, TCOD_NOISE_DEFAULT_LACUNARITY, rng);
+  const float offset[3] = {-3.5f, 2.0f, 7.25f};
+  const float scale[3] = {0.1f, 0.15f, 0.2f};
+  for (auto type : {TCOD_NOISE_PERLIN, TCOD_NOISE_SIMPLEX, TCOD_NOISE_WAVELET}) {
+    for (auto mode : {TCOD_NOISE_MODE_PLAIN, TCOD_NOISE_MODE_FBM, TCOD_NOISE_MODE_TURBULENCE}) {
+      for (int ndim = 2; ndim <= 3; ++ndim) {
+        const int shape[3] = {301, 67, ndim == 3 ? 5 : 1};
+        const int count = shape[0] * shape[1] * shape[2];
+        // Every value is followed by a padding value to test strided output.
+        const size_t strides[3] = {
+            sizeof(float) * 2, sizeof(float) * 2 * shape[0], sizeof(float) * 2 * shape[0] * shape[1]};
+        std::vector<float> serial(count * 2, -2.0f);
+        std::vector<float> threaded(count * 2, -2.0f);
+        TCOD_parallel_set_max_threads(1);
+        REQUIRE(TCOD_noise_fill_grid(noise, type, mode, 4.5f, ndim, shape, strides, offset, scale, serial.data()) == 0);
+        TCOD_parallel_set_max_threads(4);
+        REQUIRE(
+            TCOD_noise_fill_grid(noise, type, mode, 4.5f, ndim, shape, strides, offset, scale, threaded.data()) == 0);
+        TCOD_parallel_set_max_threads(0);
+        REQUIRE(serial == threaded);
+        for (int z = 0; z < shape[2]; ++z) {
+          for (int y = 0; y < shape[1]; ++y) {
+            for (int x = 0; x < shape[0]; ++x) {
+              const float point[3] = {
+                  (x + offset[0]) * scale[0], (y + offset[1]) * scale[1], (z + offset[2]) * scale[2]};
+              float expected = 0;
+              switch (mode) {
+                case TCOD_NOISE_MODE_PLAIN:
+                  expected = TCOD_noise_get_ex(noise, point, type);
+                  break;
+                case TCOD_NOISE_MODE_FBM:
+                  expected = TCOD_noise_get_fbm_ex(noise, point, 4.5f, type);
+                  break;
+                case TCOD_NOISE_MODE_TURBULENCE:
+                  expected = TCOD_noise_get_turbulence_ex(noise, point, 4.5f, type);
+                  break;
+              }
+              const int i = x + y * shape[0] + z * shape[0] * shape[1];
+              INFO("type=" << type << " mode=" << mode << " ndim=" << ndim << " x=" << x << " y=" << y << " z=" << z);
+              REQUIRE(serial.at(i * 2) == Catch::Approx(expected).margin(1e-5));
+              REQUIRE(serial.at(i * 2 + 1) == -2.0f);
+            }
+          }
+        }
+      }
+    }
+  }
+  const int shape[2] = {4, 4};
+  float out[16];
+  CHECK(TCOD_noise_fill_grid(noise, TCOD_NOISE_DEFAULT, TCOD_NOISE_MODE_PLAIN, 0, 4, shape, NULL, NULL, NULL, out) < 0);
+  CHECK(
+      TCOD_noise_fill_grid(noise, TCOD_NOISE_DEFAULT, TCOD_NOISE_MODE_FBM, 1000, 2, shape, NULL, NULL, NULL, out) < 0);
+  TCOD_noise_delete(noise);
+  TCOD_random_delete(rng);
+}
+
+TEST_CASE("Heightmap fBm uses the noise fill") {
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  TCOD_Noise* noise = TCOD_noise_new(2, TCOD_NOISE_DEFAULT_HURST, TCOD_NOISE_DEFAULT_LACUNARITY, rng);
+  TCOD_heightmap_t* heightmap = TCOD_heightmap_new(123, 45);
+  TCOD_heightmap_add_fbm(heightmap, noise, 3.0f, 4.0f, 1.5f, -2.0f, 6.0f, 0.5f, 2.0f);
+  TCOD_heightmap_scale_fbm(heightmap, noise, 2.0f, 2.0f, 0.0f, 0.0f, 3.0f, 1.0f, 0.25f);
+  for (int y = 0; y < heightmap->h; ++y) {
+    for (int x = 0; x < heightmap->w; ++x) {
+      const float add_point[2] = {(x + 1.5f) * (3.0f / heightmap->w), (y + -2.0f) * (4.0f / heightmap->h)};
+      const float scale_point[2] = {x * (2.0f / heightmap->w), y * (2.0f / heightmap->h)};
+      const float expected = (0.5f + TCOD_noise_get_fbm(noise, add_point, 6.0f) * 2.0f) *
+                             (1.0f + TCOD_noise_get_fbm(noise, scale_point, 3.0f) * 0.25f);
+      REQUIRE(TCOD_heightmap_get_value(heightmap, x, y) == Catch::Approx(expected).margin(1e-5));
+    }
+  }
+  TCOD_heightmap_delete(heightmap);
+  TCOD_noise_delete(noise);
+  TCOD_random_delete(rng);
+}
+
+/// Compare a derivative to the central difference of three samples spaced `h` apart.
+/// 3D simplex noise is not continuous where its corners leave their radius, so the margin grows with the disagreement
+/// of the one-sided differences.
+static void check_difference(float derivative, float low, float mid, float high, float h) {
+  const float backward = (mid - low) / h;
+  const float forward = (high - mid) / h;
+  const float margin = 1e-2f + std::abs(forward - backward);
+  REQUIRE(derivative == Catch::Approx((high - low) / (2 * h)).epsilon(1e-2).margin(margin));
+}
+
+TEST_CASE("Noise gradients match finite differences") {
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  const TCOD_noise_type_t types[] = {TCOD_NOISE_PERLIN, TCOD_NOISE_SIMPLEX};
+  const float h = 1e-3f;
+  for (int ndim = 1; ndim <= 3; ++ndim) {
+    TCOD_Noise* noise = TCOD_noise_new(ndim, TCOD_NOISE_DEFAULT_HURST, TCOD_NOISE_DEFAULT_LACUNARITY, rng);
+    for (const TCOD_noise_type_t type : types) {
+      for (int i = 0; i < 200; ++i) {
+        float point[3];
+        for (int axis = 0; axis < 3; ++axis) point[axis] = TCOD_random_get_float(rng, -10.0f, 10.0f);
+        float gradient[3] = {0, 0, 0};
+        const float value = TCOD_noise_get_with_gradient(noise, point, type, gradient);
+        REQUIRE(value == TCOD_noise_get_ex(noise, point, type));
+        float fbm_gradient[3] = {0, 0, 0};
+        const float fbm = TCOD_noise_get_fbm_with_gradient(noise, point, 3.5f, type, fbm_gradient);
+        REQUIRE(fbm == TCOD_noise_get_fbm_ex(noise, point, 3.5f, type));
+        for (int axis = 0; axis < ndim; ++axis) {
+          float high[3] = {point[0], point[1], point[2]};
+          float low[3] = {point[0], point[1], point[2]};
+          high[axis] += h;
+          low[axis] -= h;
+          check_difference(
+              gradient[axis],
+              TCOD_noise_get_ex(noise, low, type),
+              value,
+              TCOD_noise_get_ex(noise, high, type),
+              h);
+          check_difference(
+              fbm_gradient[axis],
+              TCOD_noise_get_fbm_ex(noise, low, 3.5f, type),
+              fbm,
+              TCOD_noise_get_fbm_ex(noise, high, 3.5f, type),
+              h);
+        }
+      }
+      const int n = 37;
+      std::vector<float> coords[3];
+      for (auto& axis : coords) {
+        for (int i = 0; i < n; ++i) axis.push_back(TCOD_random_get_float(rng, -10.0f, 10.0f));
+      }
+      std::vector<float> out(n);
+      std::vector<float> derivatives[3] = {std::vector<float>(n), std::vector<float>(n), std::vector<float>(n)};
+      TCOD_noise_get_fbm_with_gradient_vectorized(
+          noise,
+          type,
+          4.0f,
+          n,
+          coords[0].data(),
+          ndim > 1 ? coords[1].data() : NULL,
+          ndim > 2 ? coords[2].data() : NULL,
+          out.data(),
+          derivatives[0].data(),
+          derivatives[1].data(),
+          derivatives[2].data());
+      for (int i = 0; i < n; ++i) {
+        const float point[3] = {coords[0][i], coords[1][i], coords[2][i]};
+        float gradient[3] = {0, 0, 0};
+        REQUIRE(out[i] == TCOD_noise_get_fbm_with_gradient(noise, point, 4.0f, type, gradient));
+        for (int axis = 0; axis < ndim; ++axis) REQUIRE(derivatives[axis][i] == gradient[axis]);
+      }
+      TCOD_noise_get_with_gradient_vectorized(
+          noise,
+          type,
+          n,
+          coords[0].data(),
+          ndim > 1 ? coords[1].data() : NULL,
+          ndim > 2 ? coords[2].data() : NULL,
+          out.data(),
+          derivatives[0].data(),
+          derivatives[1].data(),
+          derivatives[2].data());
+      for (int i = 0; i < n; ++i) {
+        const float point[3] = {coords[0][i], coords[1][i], coords[2][i]};
+        float gradient[3] = {0, 0, 0};
+        REQUIRE(out[i] == TCOD_noise_get_with_gradient(noise, point, type, gradient));
+        for (int axis = 0; axis < 3; ++axis) REQUIRE(derivatives[axis][i] == gradient[axis]);
+      }
+    }
+    float gradient[3] = {0, 0, 0};
+    const float point[3] = {0.5f, 0.5f, 0.5f};
+    REQUIRE(std::isnan(TCOD_noise_get_with_gradient(noise, point, TCOD_NOISE_WAVELET, gradient)));
+    TCOD_noise_delete(noise);
+  }
+  TCOD_random_delete(rng);
+}
+
+TEST_CASE("Noise shared wavelet tiles") {
+  const auto cache_path = std::filesystem::temp_directory_path() / "libtcod_wavelet_tile.bin";
+  std::filesystem::remove(cache_path);
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  TCOD_Noise* noise_a = TCOD_noise_new(3, TCOD_NOISE_DEFAULT_HURST, TCOD_NOISE_DEFAULT_LACUNARITY, rng);
+  TCOD_Noise* noise_b = TCOD_noise_new(3, TCOD_NOISE_DEFAULT_HURST, TCOD_NOISE_DEFAULT_LACUNARITY, rng);
+  std::vector<float> expected;
+  auto sample = [](TCOD_Noise* noise) {
+    std::vector<float> out;
+    for (int i = 0; i < 64; ++i) {
+      const float point[3] = {i * 0.37f, i * -0.21f, i * 0.11f};
+      out.push_back(TCOD_noise_get_ex(noise, point, TCOD_NOISE_WAVELET));
+    }
+    return out;
+  };
+  {
+    TCOD_NoiseWaveletTile* tile = TCOD_noise_wavelet_tile_get(42, cache_path.string().c_str());
+    REQUIRE(tile);
+    REQUIRE(std::filesystem::exists(cache_path));
+    TCOD_NoiseWaveletTile* same_tile = TCOD_noise_wavelet_tile_get(42, NULL);
+    REQUIRE(same_tile == tile);
+    TCOD_noise_wavelet_tile_release(same_tile);
+    TCOD_NoiseWaveletTile* other_tile = TCOD_noise_wavelet_tile_get(43, NULL);
+    REQUIRE(other_tile != tile);
+    REQUIRE(TCOD_noise_set_wavelet_tile(noise_a, tile) == TCOD_E_OK);
+    REQUIRE(TCOD_noise_set_wavelet_tile(noise_b, other_tile) == TCOD_E_OK);
+    REQUIRE(TCOD_noise_set_wavelet_tile(noise_b, tile) == TCOD_E_OK);
+    TCOD_noise_wavelet_tile_release(tile);
+    TCOD_noise_wavelet_tile_release(other_tile);
+    expected = sample(noise_a);
+    REQUIRE(sample(noise_b) == expected);
+  }
+  // Freeing the last user of a tile frees the tile, the next tile is then loaded from the cache file.
+  REQUIRE(TCOD_noise_set_wavelet_tile(noise_a, NULL) == TCOD_E_OK);
+  REQUIRE(sample(noise_a) != expected);
+  TCOD_noise_delete(noise_b);
+  {
+    TCOD_NoiseWaveletTile* tile = TCOD_noise_wavelet_tile_get(42, cache_path.string().c_str());
+    REQUIRE(tile);
+    REQUIRE(TCOD_noise_set_wavelet_tile(noise_a, tile) == TCOD_E_OK);
+    TCOD_noise_wavelet_tile_release(tile);
+    REQUIRE(sample(noise_a) == expected);
+  }
+  REQUIRE(TCOD_noise_set_wavelet_tile(NULL, NULL) == TCOD_E_INVALID_ARGUMENT);
+  TCOD_noise_delete(noise_a);
+  TCOD_random_delete(rng);
+  std::filesystem::remove(cache_path);
+}
+
+TEST_CASE("Worley noise") {
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  for (int ndim = 1; ndim <= 4; ++ndim) {
+    INFO("ndim=" << ndim);
+    TCOD_Noise* noise = TCOD_noise_new(ndim, TCOD_NOISE_DEFAULT_HURST, TCOD_NOISE_DEFAULT_LACUNARITY, rng);
+    const int n = 500;
+    std::vector<float> coords[4];
+    for (auto& axis : coords) {
+      for (int i = 0; i < n; ++i) axis.push_back(TCOD_random_get_float(rng, -20.0f, 20.0f));
+    }
+    std::vector<float> f1(n);
+    std::vector<float> f2(n);
+    std::vector<float> f2_f1(n);
+    TCOD_noise_get_vectorized(
+        noise, TCOD_NOISE_WORLEY_F1, n, coords[0].data(), coords[1].data(), coords[2].data(), coords[3].data(),
+        f1.data());
+    TCOD_noise_get_vectorized(
+        noise, TCOD_NOISE_WORLEY_F2, n, coords[0].data(), coords[1].data(), coords[2].data(), coords[3].data(),
+        f2.data());
+    TCOD_noise_get_vectorized(
+        noise, TCOD_NOISE_WORLEY_F2_F1, n, coords[0].data(), coords[1].data(), coords[2].data(), coords[3].data(),
+        f2_f1.data());
+    for (int i = 0; i < n; ++i) {
+      const float point[4] = {coords[0][i], coords[1][i], coords[2][i], coords[3][i]};
+      REQUIRE(f1[i] == TCOD_noise_get_ex(noise, point, TCOD_NOISE_WORLEY_F1));
+      REQUIRE(f1[i] <= f2[i]);
+      REQUIRE(f1[i] >= -1.0f);
+      REQUIRE(f2[i] <= 1.0f);
+      if (f2[i] < 0.99f) REQUIRE(f2[i] - f1[i] == Catch::Approx(f2_f1[i] + 1.0f).margin(1e-5));
+      // The distance to the nearest point can not change faster than the sample moves.
+      float moved[4] = {point[0], point[1], point[2], point[3]};
+      for (int axis = 0; axis < ndim; ++axis) moved[axis] += 0.01f;
+      const float step = 0.01f * std::sqrt(static_cast<float>(ndim));
+      REQUIRE(std::abs(TCOD_noise_get_ex(noise, moved, TCOD_NOISE_WORLEY_F1) - f1[i]) <= 2 * step + 1e-5f);
+    }
+    TCOD_noise_delete(noise);
+  }
+  TCOD_Noise* noise = TCOD_noise_new(2, TCOD_NOISE_DEFAULT_HURST, TCOD_NOISE_DEFAULT_LACUNARITY, rng);
+  const int shape[2] = {37, 23};
+  const float scale[2] = {0.3f, 0.2f};
+  std::vector<float> out(shape[0] * shape[1]);
+  REQUIRE(
+      TCOD_noise_fill_grid(
+          noise, TCOD_NOISE_WORLEY_F2_F1, TCOD_NOISE_MODE_FBM, 3.0f, 2, shape, NULL, NULL, scale, out.data()) ==
+      TCOD_E_OK);
+  for (int y = 0; y < shape[1]; ++y) {
+    for (int x = 0; x < shape[0]; ++x) {
+      const float point[2] = {x * scale[0], y * scale[1]};
+      REQUIRE(out[x + y * shape[0]] == TCOD_noise_get_fbm_ex(noise, point, 3.0f, TCOD_NOISE_WORLEY_F2_F1));
+    }
+  }
+  TCOD_noise_delete(noise);
+  TCOD_random_delete(rng);
+}
+
+/// Return the Worley F1 and F2 distances of `f` by checking every cell within 3 cells of the sample.
+static std::pair<float, float> reference_worley(const TCOD_Noise* noise, const float* f) {
+  int base[4] = {0, 0, 0, 0};
+  for (int i = 0; i < noise->ndim; ++i) base[i] = static_cast<int>(std::floor(f[i]));
+  int cells = 1;
+  for (int i = 0; i < noise->ndim; ++i) cells *= 7;
+  float nearest = FLT_MAX;
+  float second = FLT_MAX;
+  for (int neighbor = 0; neighbor < cells; ++neighbor) {
+    int cell[4];
+    for (int i = 0, rest = neighbor; i < noise->ndim; ++i, rest /= 7) cell[i] = base[i] + rest % 7 - 3;
+    int hash = 0;
+    for (int i = noise->ndim - 1; i >= 0; --i) hash = noise->map[(cell[i] + hash) & 0xFF];
+    float distance = 0;
+    for (int i = 0; i < noise->ndim; ++i) {
+      const int high = noise->map[(hash + 2 * i + 1) & 0xFF];
+      const int low = noise->map[(hash + 2 * i + 2) & 0xFF];
+      const float point = cell[i] + (high * 256 + low + 0.5f) * (1.0f / 65536.0f);
+      distance += (point - f[i]) * (point - f[i]);
+    }
+    if (distance < nearest) {
+      second = nearest;
+      nearest = distance;
+    } else if (distance < second) {
+      second = distance;
+    }
+  }
+  return {std::sqrt(nearest), std::sqrt(second)};
+}
+
+TEST_CASE("Worley noise matches a brute force search") {
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 1);
+  for (int ndim = 1; ndim <= 4; ++ndim) {
+    INFO("ndim=" << ndim);
+    TCOD_Noise* noise = TCOD_noise_new(ndim, TCOD_NOISE_DEFAULT_HURST, TCOD_NOISE_DEFAULT_LACUNARITY, rng);
+    const int samples = ndim == 4 ? 2000 : 20000;
+    for (int sample = 0; sample < samples; ++sample) {
+      float point[4] = {0, 0, 0, 0};
+      for (int i = 0; i < ndim; ++i) point[i] = TCOD_random_get_float(rng, -50.0f, 50.0f);
+      const auto [f1, f2] = reference_worley(noise, point);
+      const auto expected = [](float distance) { return std::clamp(distance * 2.0f - 1.0f, -1.0f + FLT_EPSILON, 1.0f - FLT_EPSILON); };
+      REQUIRE(TCOD_noise_get_ex(noise, point, TCOD_NOISE_WORLEY_F1) == expected(f1));
+      REQUIRE(TCOD_noise_get_ex(noise, point, TCOD_NOISE_WORLEY_F2) == expected(f2));
+      REQUIRE(TCOD_noise_get_ex(noise, point, TCOD_NOISE_WORLEY_F2_F1) == expected(f2 - f1));
+    }
+    TCOD_noise_delete(noise);
+  }
+  TCOD_random_delete(rng);
+}
+
+TEST_CASE("Noise textures") {
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  for (int ndim = 2; ndim <= 4; ndim += 2) {
+    INFO("ndim=" << ndim);
+    TCOD_Noise* noise = TCOD_noise_new(ndim, TCOD_NOISE_DEFAULT_HURST, TCOD_NOISE_DEFAULT_LACUNARITY, rng);
+    const int width = 48;
+    const int height = 32;
+    TCOD_NoiseTexture* texture =
+        TCOD_noise_texture_new(noise, TCOD_NOISE_SIMPLEX, TCOD_NOISE_MODE_FBM, 4.0f, width, height, 0.1f);
+    REQUIRE(texture);
+    REQUIRE(texture->width == width);
+    REQUIRE(texture->height == height);
+    if (ndim == 2) {
+      const float origin[2] = {0, 0};
+      REQUIRE(texture->values[0] == TCOD_noise_get_fbm_ex(noise, origin, 4.0f, TCOD_NOISE_SIMPLEX));
+    }
+    // The texture must tile, neighbors across the edges change no more than neighbors inside the texture.
+    float inner_step = 0;
+    float edge_step = 0;
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        const float value = texture->values[x + y * width];
+        const float right = std::abs(texture->values[(x + 1) % width + y * width] - value);
+        const float down = std::abs(texture->values[x + (y + 1) % height * width] - value);
+        inner_step = std::max(inner_step, std::max(x + 1 < width ? right : 0, y + 1 < height ? down : 0));
+        edge_step = std::max(edge_step, std::max(x + 1 == width ? right : 0, y + 1 == height ? down : 0));
+        REQUIRE(TCOD_noise_texture_sample(texture, (float)x, (float)y, TCOD_NOISE_TEXTURE_BILINEAR) == value);
+        REQUIRE(
+            TCOD_noise_texture_sample(texture, (float)(x - width), (float)(y + height), TCOD_NOISE_TEXTURE_BICUBIC) ==
+            Catch::Approx(value).margin(1e-6));
+      }
+    }
+    REQUIRE(edge_step <= inner_step * 1.25f);
+    std::vector<float> u;
+    std::vector<float> v;
+    for (int i = 0; i < 100; ++i) {
+      u.push_back(TCOD_random_get_float(rng, -100.0f, 100.0f));
+      v.push_back(TCOD_random_get_float(rng, -100.0f, 100.0f));
+    }
+    std::vector<float> out(u.size());
+    for (const auto filter : {TCOD_NOISE_TEXTURE_BILINEAR, TCOD_NOISE_TEXTURE_BICUBIC}) {
+      TCOD_noise_texture_sample_vectorized(texture, filter, (int)u.size(), u.data(), v.data(), out.data());
+      for (size_t i = 0; i < u.size(); ++i) {
+        REQUIRE(out[i] == TCOD_noise_texture_sample(texture, u[i], v[i], filter));
+        REQUIRE(out[i] == Catch::Approx(TCOD_noise_texture_sample(texture, u[i] + width, v[i], filter)).margin(1e-4));
+      }
+    }
+    TCOD_noise_texture_delete(texture);
+    TCOD_noise_delete(noise);
+  }
+  TCOD_Noise* noise = TCOD_noise_new(1, TCOD_NOISE_DEFAULT_HURST, TCOD_NOISE_DEFAULT_LACUNARITY, rng);
+  REQUIRE_FALSE(TCOD_noise_texture_new(noise, TCOD_NOISE_SIMPLEX, TCOD_NOISE_MODE_PLAIN, 0, 8, 8, 1.0f));
+  REQUIRE_FALSE(TCOD_noise_texture_new(NULL, TCOD_NOISE_SIMPLEX, TCOD_NOISE_MODE_PLAIN, 0, 8, 8, 1.0f));
+  TCOD_noise_delete(noise);
+  noise = TCOD_noise_new(2, TCOD_NOISE_DEFAULT_HURST, TCOD_NOISE_DEFAULT_LACUNARITY, rng);
+  REQUIRE_FALSE(TCOD_noise_texture_new(noise, TCOD_NOISE_SIMPLEX, TCOD_NOISE_MODE_PLAIN, 0, 0, 8, 1.0f));
+  TCOD_noise_delete(noise);
+  TCOD_random_delete(rng);
+}
+
+TEST_CASE("Noise fill grid benchmark", "[.benchmark]") {
+  TCOD_Random* rng = TCOD_random_new_from_seed(TCOD_RNG_MT, 0);
+  TCOD_Noise* noise = TCOD_noise_new(2, TCOD_NOISE_DEFAULT_HURST, TCOD_NOISE_DEFAULT_LACUNARITY, rng);
+  const int shape[2] = {1024, 1024};
+  const float scale[2] = {1.0f / 64, 1.0f / 64};
+  std::vector<float> out(shape[0] * shape[1]);
+  BENCHMARK("TCOD_noise_fill_grid 1024x1024 simplex fBm(6)") {
+    return TCOD_noise_fill_grid(
+        noise, TCOD_NOISE_SIMPLEX, TCOD_NOISE_MODE_FBM, 6.0f, 2, shape, NULL, NULL, scale, out.data());
+  };
+  BENCHMARK("TCOD_noise_get_fbm_ex 1024x1024 simplex fBm(6)") {
+    for (int y = 0; y < shape[1]; ++y) {
+      for (int x = 0; x < shape[0]; ++x) {
+        const float point[2] = {x * scale[0], y * scale[1]};
+        out[x + y * shape[0]] = TCOD_noise_get_fbm_ex(noise, point, 6.0f, TCOD_NOISE_SIMPLEX);
+      }
+    }
+    return out[0];
+  };
+  TCOD_noise_delete(noise);
+  TCOD_random_delete(rng);
+}
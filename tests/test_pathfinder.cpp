@@ -0,0 +1,413 @@
+
+#include <algorithm>
+#include <array>
+#include <catch2/catch_all.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <libtcod/fov.h>
+#include <libtcod/path.h>
+#include <libtcod/pathfinder.h>
+#include <limits>
+#include <queue>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+/// Return the byte strides of a C-contiguous array of `T` with the given `shape`.
+template <typename T, size_t N>
+std::array<size_t, N> c_strides(const std::array<size_t, N>& shape) {
+  std::array<size_t, N> strides{};
+  size_t stride = sizeof(T);
+  for (size_t i = N; i-- > 0;) {
+    strides.at(i) = stride;
+    stride *= shape.at(i);
+  }
+  return strides;
+}
+/// Generate a 2D cost map with scattered walls.
+std::vector<uint8_t> make_costs(int width, int height) {
+  std::vector<uint8_t> costs(static_cast<size_t>(width) * height, 1);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      if ((x * 7 + y * 13) % 11 == 0 && !(x == 0 && y == 0)) costs.at(y * width + x) = 0;
+      if ((x * 3 + y * 5) % 17 == 0) costs.at(y * width + x) = 3;
+    }
+  }
+  return costs;
+}
+/// A simple Dijkstra implementation used to verify the pathfinder results.
+template <typename Cost>
+std::vector<int> reference_dijkstra(
+    const std::vector<Cost>& costs, int width, int height, int start_x, int start_y, int cardinal, int diagonal) {
+  constexpr int UNREACHED = std::numeric_limits<int32_t>::max();
+  std::vector<int> dist(costs.size(), UNREACHED);
+  using Node = std::pair<int, int>;
+  std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+  dist.at(start_y * width + start_x) = 0;
+  queue.emplace(0, start_y * width + start_x);
+  while (!queue.empty()) {
+    const auto [d, index] = queue.top();
+    queue.pop();
+    if (d > dist.at(index)) continue;
+    const int x = index % width;
+    const int y = index / width;
+    for (int dy = -1; dy <= 1; ++dy) {
+      for (int dx = -1; dx <= 1; ++dx) {
+        if (!dx && !dy) continue;
+        const int edge = (dx && dy) ? diagonal : cardinal;
+        if (edge <= 0) continue;
+        const int nx = x + dx;
+        const int ny = y + dy;
+        if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+        const int cost = static_cast<int>(costs.at(ny * width + nx));
+        if (!cost) continue;
+        const int total = d + cost * edge;
+        if (total >= dist.at(ny * width + nx)) continue;
+        dist.at(ny * width + nx) = total;
+        queue.emplace(total, ny * width + nx);
+      }
+    }
+  }
+  return dist;
+}
+/// Run TCOD_Pathfinder on a 2D map with distance type `Dist` and cost type `Cost`.
+template <typename Dist, typename Cost>
+std::vector<Dist> pathfinder_distance(
+    const std::vector<Cost>& costs,
+    int width,
+    int height,
+    int start_x,
+    int start_y,
+    int cardinal,
+    int diagonal,
+    std::vector<int32_t>* traversal = nullptr,
+    const std::function<void(TCOD_Pathfinder*)>& setup = nullptr,
+    const std::function<void(TCOD_Pathfinder*, int)>& on_computed = nullptr) {
+  const auto shape = std::array<size_t, 2>{static_cast<size_t>(height), static_cast<size_t>(width)};
+  std::vector<Dist> dist(costs.size(), std::numeric_limits<Dist>::max());
+  dist.at(start_y * width + start_x) = 0;
+  TCOD_Pathfinder* path = TCOD_pf_new(2, shape.data());
+  REQUIRE(path);
+  TCOD_pf_set_distance_pointer(
+      path,
+      dist.data(),
+      std::is_signed_v<Dist> ? -int{sizeof(Dist)} : int{sizeof(Dist)},
+      c_strides<Dist>(shape).data());
+  TCOD_pf_set_graph2d_pointer(
+      path,
+      const_cast<Cost*>(costs.data()),
+      std::is_signed_v<Cost> ? -int{sizeof(Cost)} : int{sizeof(Cost)},
+      c_strides<Cost>(shape).data(),
+      cardinal,
+      diagonal);
+  if (traversal) {
+    traversal->assign(costs.size() * 2, -1);
+    const auto trav_shape = std::array<size_t, 3>{shape.at(0), shape.at(1), 2};
+    TCOD_pf_set_traversal_pointer(path, traversal->data(), -4, c_strides<int32_t>(trav_shape).data());
+  }
+  if (setup) setup(path);
+  REQUIRE(TCOD_pf_recompile(path) == 0);
+  const int result = TCOD_pf_compute(path);
+  REQUIRE(result >= 0);
+  if (on_computed) on_computed(path, result);
+  TCOD_pf_delete(path);
+  return dist;
+}
+template <typename Dist, typename Cost>
+void check_pathfinder_types() {
+  constexpr int WIDTH = 23;
+  constexpr int HEIGHT = 17;
+  const auto costs_u8 = make_costs(WIDTH, HEIGHT);
+  const auto expected = reference_dijkstra(costs_u8, WIDTH, HEIGHT, 5, 3, 2, 3);
+  const auto costs = std::vector<Cost>(costs_u8.begin(), costs_u8.end());
+  const auto result = pathfinder_distance<Dist>(costs, WIDTH, HEIGHT, 5, 3, 2, 3);
+  for (size_t i = 0; i < expected.size(); ++i) {
+    if (expected.at(i) == std::numeric_limits<int32_t>::max()) {
+      REQUIRE(result.at(i) == std::numeric_limits<Dist>::max());
+    } else {
+      REQUIRE(static_cast<int64_t>(result.at(i)) == expected.at(i));
+    }
+  }
+}
+}  // namespace
+
+TEST_CASE("TCOD_Pathfinder distance types") {
+  check_pathfinder_types<int32_t, uint8_t>();
+  check_pathfinder_types<uint32_t, uint8_t>();
+  check_pathfinder_types<int16_t, int8_t>();
+  check_pathfinder_types<uint16_t, uint16_t>();
+  check_pathfinder_types<int64_t, int32_t>();
+  check_pathfinder_types<uint64_t, uint64_t>();
+  check_pathfinder_types<int32_t, int64_t>();
+}
+
+TEST_CASE("TCOD_Pathfinder large costs") {
+  constexpr int WIDTH = 23;
+  constexpr int HEIGHT = 17;
+  auto costs = std::vector<uint16_t>{};
+  for (auto cost : make_costs(WIDTH, HEIGHT)) costs.emplace_back(static_cast<uint16_t>(cost * 1000));
+  const auto expected = reference_dijkstra(costs, WIDTH, HEIGHT, 5, 3, 2, 3);
+  const auto result = pathfinder_distance<int32_t>(costs, WIDTH, HEIGHT, 5, 3, 2, 3);
+  REQUIRE(std::vector<int>(result.begin(), result.end()) == expected);
+}
+
+namespace {
+/// Route around a cell whose cost pushes paths through it past INT_MAX, with and without a goal.
+template <typename Dist>
+void check_pathfinder_int_overflow() {
+  constexpr int WIDTH = 3;
+  constexpr int HEIGHT = 2;
+  const auto costs = std::vector<uint32_t>{1, 2147483658u, 100, 1, 100, 100};
+  const std::array<int, 2> goal{0, 2};
+  const auto heuristic = TCOD_PathfinderHeuristic{TCOD_PF_HEURISTIC_MANHATTAN, 1, 0};
+  for (const bool use_goal : {false, true}) {
+    const auto dist = pathfinder_distance<Dist>(
+        costs, WIDTH, HEIGHT, 0, 0, 1, 0, nullptr, [&](TCOD_Pathfinder* path) {
+          if (use_goal) REQUIRE(TCOD_pf_set_goals(path, 1, goal.data(), &heuristic) == 0);
+        });
+    REQUIRE(dist.at(2) == 301);
+    REQUIRE(dist.at(1) == std::numeric_limits<Dist>::max());  // Distances past INT_MAX are left unreached.
+  }
+}
+}  // namespace
+
+TEST_CASE("TCOD_Pathfinder distances past INT_MAX") {
+  check_pathfinder_int_overflow<uint32_t>();
+  check_pathfinder_int_overflow<uint64_t>();
+  check_pathfinder_int_overflow<int64_t>();
+}
+
+TEST_CASE("TCOD_BucketQueue") {
+  TCOD_BucketQueue queue{};
+  REQUIRE(TCOD_bucketq_init(&queue, 3) == 0);
+  const std::vector<std::pair<int, int>> INPUT{{5, 0}, {7, 1}, {6, 2}, {100, 3}, {-4, 4}, {8, 5}, {5, 6}};
+  for (const auto& [priority, value] : INPUT) REQUIRE(TCOD_bucketq_push(&queue, priority, value) == 0);
+  std::vector<int> popped;
+  int last_priority = std::numeric_limits<int>::min();
+  while (queue.size) {
+    int priority;
+    int value;
+    REQUIRE(TCOD_bucketq_pop(&queue, &priority, &value) == 0);
+    REQUIRE(last_priority <= priority);
+    last_priority = priority;
+    popped.emplace_back(value);
+    if (value == 2) REQUIRE(TCOD_bucketq_push(&queue, 9, 7) == 0);
+  }
+  REQUIRE(popped.size() == INPUT.size() + 1);
+  REQUIRE(popped.front() == 4);
+  REQUIRE(popped.back() == 3);
+  REQUIRE(TCOD_bucketq_pop(&queue, nullptr, nullptr) < 0);
+  TCOD_bucketq_uninit(&queue);
+}
+
+TEST_CASE("TCOD_Pathfinder traversal") {
+  constexpr int WIDTH = 20;
+  constexpr int HEIGHT = 15;
+  const auto costs = make_costs(WIDTH, HEIGHT);
+  std::vector<int32_t> traversal;
+  const auto dist = pathfinder_distance<int32_t>(costs, WIDTH, HEIGHT, 0, 0, 2, 3, &traversal);
+  for (int y = 0; y < HEIGHT; ++y) {
+    for (int x = 0; x < WIDTH; ++x) {
+      const int index = y * WIDTH + x;
+      if (dist.at(index) == std::numeric_limits<int32_t>::max() || dist.at(index) == 0) continue;
+      const int parent_y = traversal.at(index * 2 + 0);
+      const int parent_x = traversal.at(index * 2 + 1);
+      REQUIRE(std::max(std::abs(parent_x - x), std::abs(parent_y - y)) == 1);
+      const int edge = (parent_x != x && parent_y != y) ? 3 : 2;
+      REQUIRE(dist.at(parent_y * WIDTH + parent_x) + costs.at(index) * edge == dist.at(index));
+    }
+  }
+}
+
+TEST_CASE("TCOD_Pathfinder path extraction") {
+  constexpr int WIDTH = 20;
+  constexpr int HEIGHT = 15;
+  const auto costs = make_costs(WIDTH, HEIGHT);
+  std::vector<int32_t> traversal;
+  pathfinder_distance<int32_t>(
+      costs,
+      WIDTH,
+      HEIGHT,
+      0,
+      0,
+      2,
+      3,
+      &traversal,
+      [&](TCOD_Pathfinder*) { traversal.at(0) = traversal.at(1) = 0; },  // The origin points to itself.
+      [&](TCOD_Pathfinder* path, int) {
+        const auto* dist = reinterpret_cast<const int32_t*>(path->distance.data);
+        const std::array<int, 2> start{HEIGHT - 1, WIDTH - 1};
+        std::array<int, WIDTH * HEIGHT> indices{};
+        const int length = TCOD_pf_extract_path(path, start.data(), indices.data(), WIDTH * HEIGHT);
+        REQUIRE(length > 1);
+        REQUIRE(indices.at(0) == start.at(0) * WIDTH + start.at(1));
+        REQUIRE(indices.at(length - 1) == 0);
+        for (int i = 1; i < length; ++i) {
+          const int y0 = indices.at(i - 1) / WIDTH;
+          const int x0 = indices.at(i - 1) % WIDTH;
+          const int y1 = indices.at(i) / WIDTH;
+          const int x1 = indices.at(i) % WIDTH;
+          REQUIRE(std::max(std::abs(x1 - x0), std::abs(y1 - y0)) == 1);
+          REQUIRE(dist[indices.at(i)] < dist[indices.at(i - 1)]);
+        }
+        std::array<int, 2> truncated{-1, -1};
+        REQUIRE(TCOD_pf_extract_path(path, start.data(), truncated.data(), 2) == length);
+        REQUIRE(truncated.at(1) == indices.at(1));
+        REQUIRE(TCOD_pf_extract_path(path, std::array<int, 2>{0, 0}.data(), nullptr, 0) == 1);
+        const std::array<int, 2> wall{1, 6};  // make_costs puts a wall here.
+        REQUIRE(costs.at(wall.at(0) * WIDTH + wall.at(1)) == 0);
+        REQUIRE(TCOD_pf_extract_path(path, wall.data(), nullptr, 0) == 0);
+        const std::array<int, 2> out_of_bounds{HEIGHT, 0};
+        REQUIRE(TCOD_pf_extract_path(path, out_of_bounds.data(), nullptr, 0) < 0);
+
+        const std::array<int, 6> starts{HEIGHT - 1, WIDTH - 1, 1, 6, 5, 5};
+        std::array<int, 3 * WIDTH * HEIGHT> batch_indices{};
+        std::array<int, 3> lengths{};
+        REQUIRE(
+            TCOD_pf_extract_paths(path, 3, starts.data(), batch_indices.data(), WIDTH * HEIGHT, lengths.data()) == 0);
+        REQUIRE(lengths.at(0) == length);
+        REQUIRE(std::equal(indices.begin(), indices.begin() + length, batch_indices.begin()));
+        REQUIRE(lengths.at(1) == 0);
+        REQUIRE(lengths.at(2) == TCOD_pf_extract_path(path, &starts.at(4), indices.data(), WIDTH * HEIGHT));
+      });
+}
+
+TEST_CASE("TCOD_Pathfinder goals") {
+  constexpr int WIDTH = 40;
+  constexpr int HEIGHT = 30;
+  const auto costs = make_costs(WIDTH, HEIGHT);
+  const auto expected = reference_dijkstra(costs, WIDTH, HEIGHT, 2, 2, 2, 3);
+  for (auto type : {TCOD_PF_HEURISTIC_MANHATTAN, TCOD_PF_HEURISTIC_CHEBYSHEV, TCOD_PF_HEURISTIC_DIAGONAL}) {
+    const auto heuristic = TCOD_PathfinderHeuristic{type, type == TCOD_PF_HEURISTIC_MANHATTAN ? 1 : 2, 3};
+    const std::array<int, 4> goals{25, 30, 10, 12};  // {y, x} pairs, the second goal is closer.
+    const auto dist = pathfinder_distance<int32_t>(
+        costs,
+        WIDTH,
+        HEIGHT,
+        2,
+        2,
+        2,
+        3,
+        nullptr,
+        [&](TCOD_Pathfinder* path) { REQUIRE(TCOD_pf_set_goals(path, 2, goals.data(), &heuristic) == 0); },
+        [](TCOD_Pathfinder* path, int result) {
+          REQUIRE(result == 1);
+          REQUIRE(path->goal_reached == 1);
+        });
+    REQUIRE(dist.at(10 * WIDTH + 12) == expected.at(10 * WIDTH + 12));
+    const auto reached = std::count_if(dist.begin(), dist.end(), [](int32_t d) { return d != INT32_MAX; });
+    const auto reachable = std::count_if(expected.begin(), expected.end(), [](int d) { return d != INT32_MAX; });
+    REQUIRE(reached < reachable);
+  }
+}
+
+TEST_CASE("TCOD_Pathfinder custom graphs") {
+  SECTION("Knight moves") {
+    const std::array<size_t, 2> shape{8, 8};
+    const std::vector<uint8_t> costs(8 * 8, 1);
+    std::vector<int32_t> dist(8 * 8, std::numeric_limits<int32_t>::max());
+    std::vector<TCOD_PathfinderEdge> edges;
+    for (int y : {-2, -1, 1, 2}) {
+      for (int x : {-2, -1, 1, 2}) {
+        if (std::abs(x) != std::abs(y)) edges.push_back(TCOD_PathfinderEdge{{y, x}, 1, nullptr});
+      }
+    }
+    dist.at(0) = 0;
+    TCOD_Pathfinder* path = TCOD_pf_new(2, shape.data());
+    REQUIRE(path);
+    TCOD_pf_set_distance_pointer(path, dist.data(), -4, c_strides<int32_t>(shape).data());
+    REQUIRE(
+        TCOD_pf_set_graph_pointer(
+            path,
+            const_cast<uint8_t*>(costs.data()),
+            1,
+            c_strides<uint8_t>(shape).data(),
+            static_cast<int>(edges.size()),
+            edges.data()) == 0);
+    REQUIRE(TCOD_pf_recompile(path) == 0);
+    REQUIRE(TCOD_pf_compute(path) == 0);
+    TCOD_pf_delete(path);
+    CHECK(dist.at(1 * 8 + 2) == 1);
+    CHECK(dist.at(1 * 8 + 1) == 4);
+    CHECK(dist.at(7 * 8 + 7) == 6);
+    CHECK(*std::max_element(dist.begin(), dist.end()) == 6);
+  }
+  SECTION("3D levels connected by stairs") {
+    constexpr int DEPTH = 3;
+    constexpr int SIZE = 10;
+    const std::array<size_t, 3> shape{DEPTH, SIZE, SIZE};
+    const auto index = [&](int z, int y, int x) { return (z * SIZE + y) * SIZE + x; };
+    const std::vector<int16_t> costs(DEPTH * SIZE * SIZE, 1);
+    std::vector<int16_t> stairs_down(DEPTH * SIZE * SIZE, 0);
+    std::vector<int16_t> stairs_up(DEPTH * SIZE * SIZE, 0);
+    // Stairs between levels 0 and 1 at {2, 7}, and between levels 1 and 2 at {9, 0}.
+    stairs_down.at(index(1, 2, 7)) = 1;
+    stairs_up.at(index(0, 2, 7)) = 1;
+    stairs_down.at(index(2, 9, 0)) = 1;
+    stairs_up.at(index(1, 9, 0)) = 1;
+    const std::array<TCOD_PathfinderEdge, 6> edges{{
+        {{0, -1, 0}, 1, nullptr},
+        {{0, 1, 0}, 1, nullptr},
+        {{0, 0, -1}, 1, nullptr},
+        {{0, 0, 1}, 1, nullptr},
+        {{1, 0, 0}, 1, stairs_down.data()},
+        {{-1, 0, 0}, 1, stairs_up.data()},
+    }};
+    std::vector<int32_t> dist(DEPTH * SIZE * SIZE, std::numeric_limits<int32_t>::max());
+    dist.at(index(0, 0, 0)) = 0;
+    TCOD_Pathfinder* path = TCOD_pf_new(3, shape.data());
+    REQUIRE(path);
+    TCOD_pf_set_distance_pointer(path, dist.data(), -4, c_strides<int32_t>(shape).data());
+    REQUIRE(
+        TCOD_pf_set_graph_pointer(
+            path,
+            const_cast<int16_t*>(costs.data()),
+            -2,
+            c_strides<int16_t>(shape).data(),
+            static_cast<int>(edges.size()),
+            edges.data()) == 0);
+    REQUIRE(TCOD_pf_recompile(path) == 0);
+    REQUIRE(TCOD_pf_compute(path) == 0);
+    TCOD_pf_delete(path);
+    CHECK(dist.at(index(0, 9, 9)) == 18);
+    CHECK(dist.at(index(1, 2, 7)) == 10);
+    CHECK(dist.at(index(1, 0, 0)) == 19);
+    CHECK(dist.at(index(2, 9, 0)) == 10 + 14 + 1);
+    CHECK(dist.at(index(2, 0, 9)) == 10 + 14 + 1 + 18);
+  }
+  SECTION("Invalid edges") {
+    const std::array<size_t, 2> shape{4, 4};
+    const std::vector<uint8_t> costs(4 * 4, 1);
+    TCOD_Pathfinder* path = TCOD_pf_new(2, shape.data());
+    REQUIRE(path);
+    const TCOD_PathfinderEdge no_move{{0, 0}, 1, nullptr};
+    CHECK(TCOD_pf_set_graph_pointer(path, nullptr, 1, c_strides<uint8_t>(shape).data(), 1, &no_move) < 0);
+    CHECK(TCOD_pf_set_graph_pointer(path, nullptr, 1, c_strides<uint8_t>(shape).data(), 0, nullptr) < 0);
+    TCOD_pf_delete(path);
+  }
+}
+
+TEST_CASE("TCOD_Pathfinder benchmarks", "[.benchmark]") {
+  constexpr int SIZE = 1000;
+  const auto costs = std::vector<uint8_t>(SIZE * SIZE, 1);
+  BENCHMARK("TCOD_Pathfinder 1000x1000") { return pathfinder_distance<int32_t>(costs, SIZE, SIZE, 0, 0, 2, 3); };
+  BENCHMARK("TCOD_Pathfinder 1000x1000 A* to the center") {
+    return pathfinder_distance<int32_t>(costs, SIZE, SIZE, 0, 0, 2, 3, nullptr, [&](TCOD_Pathfinder* path) {
+      const auto heuristic = TCOD_PathfinderHeuristic{TCOD_PF_HEURISTIC_DIAGONAL, 2, 3};
+      const std::array<int, 2> goal{SIZE / 2, SIZE / 2};
+      TCOD_pf_set_goals(path, 1, goal.data(), &heuristic);
+    });
+  };
+  std::vector<int32_t> traversal;
+  BENCHMARK("TCOD_Pathfinder 1000x1000 with traversal") {
+    return pathfinder_distance<int32_t>(costs, SIZE, SIZE, 0, 0, 2, 3, &traversal);
+  };
+  TCOD_Map* map = TCOD_map_new(SIZE, SIZE);
+  TCOD_map_clear(map, 1, 1);
+  TCOD_Dijkstra* dijkstra = TCOD_dijkstra_new(map, 1.5f);
+  BENCHMARK("Classic libtcod Dijkstra 1000x1000") { TCOD_dijkstra_compute(dijkstra, 0, 0); };
+  TCOD_dijkstra_delete(dijkstra);
+  TCOD_map_delete(map);
+}